@@ -35,6 +35,11 @@ typedef struct FLACFILE {
    uint64_t buffer_pos, buffer_size;
    char *buffer;
 
+   /* The buffer is a segment of a sample being decoded in parallel, which
+    * must not grow.
+    */
+   bool in_place;
+
    /* Number of samples in the complete FLAC. */
    uint64_t total_samples;
 
@@ -271,8 +276,16 @@ static FLAC__StreamDecoderWriteStatus write_callback(
    int out_index;
 
    if (ff->buffer_pos + bytes > ff->buffer_size) {
-      ff->buffer = al_realloc(ff->buffer, ff->buffer_pos + bytes);
-      ff->buffer_size = ff->buffer_pos + bytes;
+      if (ff->in_place) {
+         /* Drop what lies past the end of the segment. */
+         len = (ff->buffer_size - ff->buffer_pos) /
+            (ff->channels * ff->sample_size);
+         bytes = len * ff->channels * ff->sample_size;
+      }
+      else {
+         ff->buffer = al_realloc(ff->buffer, ff->buffer_pos + bytes);
+         ff->buffer_size = ff->buffer_pos + bytes;
+      }
    }
 
    /* FLAC returns FLAC__int32 and I need to convert it to my own format. */
@@ -549,10 +562,81 @@ ALLEGRO_SAMPLE *_al_load_flac(const char *filename)
    return spl;
 }
 
+typedef struct FLAC_SEGMENTS {
+   const void *mem;
+   int64_t mem_size;
+   char *buffer;
+   int sample_bytes;
+} FLAC_SEGMENTS;
+
+
+/* Decodes one segment of a file read into memory, with a decoder of its
+ * own, straight into its place in the sample.  Runs on one of the threads
+ * of _al_acodec_decode_segments.
+ */
+static bool decode_segment(void *arg, int64_t start, int64_t end)
+{
+   FLAC_SEGMENTS *segs = arg;
+   char *buffer = segs->buffer + start * segs->sample_bytes;
+   uint64_t size = (end - start) * segs->sample_bytes;
+   ALLEGRO_FILE *fh;
+   FLACFILE *ff;
+   uint64_t pos = 0;
+
+   fh = _al_acodec_open_memory(segs->mem, segs->mem_size);
+   if (!fh)
+      goto error;
+
+   ff = flac_open(fh);
+   if (!ff) {
+      al_fclose(fh);
+      goto error;
+   }
+
+   ff->in_place = true;
+   ff->buffer = buffer;
+   ff->buffer_size = size;
+   ff->decoded_samples = start;
+
+   /* Seeking is sample accurate and delivers the frame containing the
+    * target sample, cut to start there, so the segments join seamlessly.
+    */
+   if (start == 0 ||
+         lib.FLAC__stream_decoder_seek_absolute(ff->decoder, start)) {
+      while (ff->buffer_pos < ff->buffer_size) {
+         if (!lib.FLAC__stream_decoder_process_single(ff->decoder))
+            break;
+         if (ff->buffer_pos == pos)
+            break; /* end of stream */
+         pos = ff->buffer_pos;
+      }
+   }
+   pos = ff->buffer_pos;
+
+   flac_close(ff);
+   al_fclose(fh);
+
+   if (pos < size) {
+      memset(buffer + pos, 0, size - pos);
+      return false;
+   }
+   return true;
+
+error:
+   memset(buffer, 0, size);
+   return false;
+}
+
+
 ALLEGRO_SAMPLE *_al_load_flac_f(ALLEGRO_FILE *f)
 {
    ALLEGRO_SAMPLE *sample;
    FLACFILE *ff;
+   FLAC_SEGMENTS segs;
+   int64_t start_pos;
+   int num_threads;
+
+   start_pos = al_ftell(f);
 
    ff = flac_open(f);
    if (!ff) {
@@ -562,7 +646,37 @@ ALLEGRO_SAMPLE *_al_load_flac_f(ALLEGRO_FILE *f)
    ff->buffer_size = ff->total_samples * ff->channels * ff->sample_size;
    ff->buffer = al_malloc(ff->buffer_size);
 
-   lib.FLAC__stream_decoder_process_until_end_of_stream(ff->decoder);
+   /* Long files are split into segments which are decoded in parallel, each
+    * from its own copy of the file in memory.  Otherwise (or if the file
+    * can't be read into memory) decode serially.
+    */
+   segs.mem = NULL;
+   num_threads = _al_acodec_get_decode_threads(ff->total_samples);
+   if (ff->buffer && num_threads > 1 && start_pos >= 0 &&
+         al_fseek(f, start_pos, ALLEGRO_SEEK_SET)) {
+      segs.mem = _al_acodec_read_file(f, &segs.mem_size);
+   }
+
+   if (segs.mem) {
+      ALLEGRO_DEBUG("decoding with %d threads\n", num_threads);
+      segs.buffer = ff->buffer;
+      segs.sample_bytes = ff->channels * ff->sample_size;
+      if (!_al_acodec_decode_segments(num_threads, ff->total_samples,
+            decode_segment, &segs)) {
+         ALLEGRO_WARN("FLAC file is truncated or damaged.\n");
+      }
+      al_free((void *)segs.mem);
+   }
+   else {
+      if (num_threads > 1) {
+         /* Trying to read the file into memory moved the file position
+          * behind the decoder's back.
+          */
+         lib.FLAC__stream_decoder_flush(ff->decoder);
+         lib.FLAC__stream_decoder_seek_absolute(ff->decoder, 0);
+      }
+      lib.FLAC__stream_decoder_process_until_end_of_stream(ff->decoder);
+   }
 
    sample = al_create_sample(ff->buffer, ff->total_samples, ff->sample_rate,
       _al_word_size_to_depth_conf(ff->sample_size),
@@ -34,3 +34,307 @@ void _al_acodec_stop_feed_thread(ALLEGRO_AUDIO_STREAM *stream)
 
    stream->feed_thread = NULL;
 }
+
+
+/* Segments shorter than this are not worth a thread of their own.  It is
+ * about six seconds at 44100 Hz, long enough to hide the cost of seeking.
+ */
+#define MIN_SEGMENT_SAMPLES   (1 << 18)
+#define MAX_DECODE_THREADS    16
+
+/* Returns how many threads to decode a sample of the given length with, as
+ * limited by the [acodec] decode_threads setting.
+ */
+int _al_acodec_get_decode_threads(int64_t total_samples)
+{
+   const char *value;
+   int64_t max_segments;
+   int threads = 0;
+
+   value = al_get_config_value(al_get_system_config(), "acodec",
+      "decode_threads");
+   if (value)
+      threads = atoi(value);
+   if (threads <= 0)
+      threads = al_get_cpu_count();
+   if (threads > MAX_DECODE_THREADS)
+      threads = MAX_DECODE_THREADS;
+
+   max_segments = total_samples / MIN_SEGMENT_SAMPLES;
+   if (threads > max_segments)
+      threads = (int)max_segments;
+
+   return _ALLEGRO_MAX(threads, 1);
+}
+
+
+typedef struct DECODE_SEGMENT
+{
+   _AL_ACODEC_DECODE_SEGMENT decode;
+   void *arg;
+   int64_t start;
+   int64_t end;
+   bool ok;
+} DECODE_SEGMENT;
+
+
+static void *decode_segment_thread(ALLEGRO_THREAD *thread, void *arg)
+{
+   DECODE_SEGMENT *seg = arg;
+   (void)thread;
+
+   seg->ok = seg->decode(seg->arg, seg->start, seg->end);
+   return NULL;
+}
+
+
+/* Splits [0, total_samples) into num_threads segments and decodes them in
+ * parallel, the last one on the calling thread.  Returns true if every
+ * segment was decoded.
+ */
+bool _al_acodec_decode_segments(int num_threads, int64_t total_samples,
+   _AL_ACODEC_DECODE_SEGMENT decode, void *arg)
+{
+   DECODE_SEGMENT segs[MAX_DECODE_THREADS];
+   ALLEGRO_THREAD *threads[MAX_DECODE_THREADS];
+   bool ok = true;
+   int i;
+
+   ASSERT(num_threads >= 1 && num_threads <= MAX_DECODE_THREADS);
+
+   for (i = 0; i < num_threads; i++) {
+      segs[i].decode = decode;
+      segs[i].arg = arg;
+      segs[i].start = total_samples * i / num_threads;
+      segs[i].end = total_samples * (i + 1) / num_threads;
+      segs[i].ok = false;
+      threads[i] = NULL;
+   }
+
+   for (i = 0; i < num_threads - 1; i++) {
+      threads[i] = al_create_thread(decode_segment_thread, &segs[i]);
+      if (threads[i])
+         al_start_thread(threads[i]);
+   }
+
+   segs[num_threads - 1].ok = decode(arg, segs[num_threads - 1].start,
+      segs[num_threads - 1].end);
+
+   for (i = 0; i < num_threads - 1; i++) {
+      if (threads[i]) {
+         al_join_thread(threads[i], NULL);
+         al_destroy_thread(threads[i]);
+      }
+      else {
+         /* Could not start a thread, so decode the segment here. */
+         segs[i].ok = decode(arg, segs[i].start, segs[i].end);
+      }
+   }
+
+   for (i = 0; i < num_threads; i++)
+      ok = ok && segs[i].ok;
+
+   return ok;
+}
+
+
+/* Reads the rest of the file, from the current position, into memory so
+ * that each decoding thread can have its own handle onto it.  Returns NULL
+ * if the file size is unknown.
+ */
+void *_al_acodec_read_file(ALLEGRO_FILE *f, int64_t *size)
+{
+   int64_t pos = al_ftell(f);
+   int64_t fsize = al_fsize(f);
+   void *mem;
+
+   if (pos < 0 || fsize <= pos)
+      return NULL;
+
+   *size = fsize - pos;
+   if ((uint64_t)*size > (size_t)-1)
+      return NULL;
+
+   mem = al_malloc(*size);
+   if (!mem)
+      return NULL;
+
+   if (al_fread(f, mem, *size) != (size_t)*size) {
+      al_free(mem);
+      return NULL;
+   }
+
+   return mem;
+}
+
+
+typedef struct MEMORY_FILE
+{
+   const char *mem;
+   int64_t size;
+   int64_t pos;
+   bool eof;
+} MEMORY_FILE;
+
+
+static bool memory_fclose(ALLEGRO_FILE *f)
+{
+   /* The memory itself belongs to the caller. */
+   al_free(al_get_file_userdata(f));
+   return true;
+}
+
+
+static size_t memory_fread(ALLEGRO_FILE *f, void *ptr, size_t size)
+{
+   MEMORY_FILE *mf = al_get_file_userdata(f);
+   size_t n = size;
+
+   if (mf->size - mf->pos < (int64_t)size) {
+      n = mf->size - mf->pos;
+      mf->eof = true;
+   }
+
+   memcpy(ptr, mf->mem + mf->pos, n);
+   mf->pos += n;
+   return n;
+}
+
+
+static size_t memory_fwrite(ALLEGRO_FILE *f, const void *ptr, size_t size)
+{
+   (void)f;
+   (void)ptr;
+   (void)size;
+   return 0;
+}
+
+
+static bool memory_fflush(ALLEGRO_FILE *f)
+{
+   (void)f;
+   return true;
+}
+
+
+static int64_t memory_ftell(ALLEGRO_FILE *f)
+{
+   MEMORY_FILE *mf = al_get_file_userdata(f);
+   return mf->pos;
+}
+
+
+static bool memory_fseek(ALLEGRO_FILE *f, int64_t offset, int whence)
+{
+   MEMORY_FILE *mf = al_get_file_userdata(f);
+   int64_t pos = mf->pos;
+
+   switch (whence) {
+      case ALLEGRO_SEEK_SET: pos = offset; break;
+      case ALLEGRO_SEEK_CUR: pos = mf->pos + offset; break;
+      case ALLEGRO_SEEK_END: pos = mf->size + offset; break;
+   }
+
+   if (pos < 0 || pos > mf->size)
+      return false;
+
+   mf->pos = pos;
+   mf->eof = false;
+   return true;
+}
+
+
+static bool memory_feof(ALLEGRO_FILE *f)
+{
+   MEMORY_FILE *mf = al_get_file_userdata(f);
+   return mf->eof;
+}
+
+
+static int memory_ferror(ALLEGRO_FILE *f)
+{
+   (void)f;
+   return 0;
+}
+
+
+static const char *memory_ferrmsg(ALLEGRO_FILE *f)
+{
+   (void)f;
+   return "";
+}
+
+
+static void memory_fclearerr(ALLEGRO_FILE *f)
+{
+   MEMORY_FILE *mf = al_get_file_userdata(f);
+   mf->eof = false;
+}
+
+
+static off_t memory_fsize(ALLEGRO_FILE *f)
+{
+   MEMORY_FILE *mf = al_get_file_userdata(f);
+   return mf->size;
+}
+
+
+static const void *memory_fread_span(ALLEGRO_FILE *f, size_t size,
+   size_t *ret_size)
+{
+   MEMORY_FILE *mf = al_get_file_userdata(f);
+   const char *span = mf->mem + mf->pos;
+   size_t n = size;
+
+   if (mf->size - mf->pos < (int64_t)size) {
+      n = mf->size - mf->pos;
+      mf->eof = true;
+   }
+
+   mf->pos += n;
+   *ret_size = n;
+   return span;
+}
+
+
+static const ALLEGRO_FILE_INTERFACE memory_vtable = {
+   NULL,    /* open */
+   memory_fclose,
+   memory_fread,
+   memory_fwrite,
+   memory_fflush,
+   memory_ftell,
+   memory_fseek,
+   memory_feof,
+   memory_ferror,
+   memory_ferrmsg,
+   memory_fclearerr,
+   NULL,    /* ungetc */
+   memory_fsize,
+   memory_fread_span,
+   NULL     /* prefetch */
+};
+
+
+/* Opens a read-only file handle onto memory returned by
+ * _al_acodec_read_file.  Any number of handles can read the same memory at
+ * once, each from its own thread.
+ */
+ALLEGRO_FILE *_al_acodec_open_memory(const void *mem, int64_t size)
+{
+   MEMORY_FILE *mf;
+   ALLEGRO_FILE *f;
+
+   mf = al_calloc(1, sizeof(*mf));
+   if (!mf)
+      return NULL;
+
+   mf->mem = mem;
+   mf->size = size;
+
+   f = al_create_file_handle(&memory_vtable, mf);
+   if (!f)
+      al_free(mf);
+
+   return f;
+}
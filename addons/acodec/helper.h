@@ -4,4 +4,16 @@
 void _al_acodec_start_feed_thread(ALLEGRO_AUDIO_STREAM *stream);
 void _al_acodec_stop_feed_thread(ALLEGRO_AUDIO_STREAM *stream);
 
+/* Decodes the sample range [start, end) of a file into its final place in
+ * the sample buffer.  Called concurrently from several threads.
+ */
+typedef bool (*_AL_ACODEC_DECODE_SEGMENT)(void *arg, int64_t start,
+   int64_t end);
+
+int _al_acodec_get_decode_threads(int64_t total_samples);
+bool _al_acodec_decode_segments(int num_threads, int64_t total_samples,
+   _AL_ACODEC_DECODE_SEGMENT decode, void *arg);
+void *_al_acodec_read_file(ALLEGRO_FILE *f, int64_t *size);
+ALLEGRO_FILE *_al_acodec_open_memory(const void *mem, int64_t size);
+
 #endif
@@ -56,12 +56,15 @@ static struct
    int (*ov_time_seek_lap)(OggVorbis_File *, double);
    double (*ov_time_tell)(OggVorbis_File *);
    long (*ov_read)(OggVorbis_File *, char *, int, int, int, int, int *);
+   long (*ov_read_float)(OggVorbis_File *, float ***, int, int *);
+   int (*ov_pcm_seek)(OggVorbis_File *, ogg_int64_t);
 #else
    int (*ov_open_callbacks)(void *, OggVorbis_File *, const char *, long, ov_callbacks);
    ogg_int64_t (*ov_time_total)(OggVorbis_File *, int);
    int (*ov_time_seek)(OggVorbis_File *, ogg_int64_t);
    ogg_int64_t (*ov_time_tell)(OggVorbis_File *);
    long (*ov_read)(OggVorbis_File *, char *, int, int *);
+   int (*ov_pcm_seek)(OggVorbis_File *, ogg_int64_t);
 #endif
 } lib;
 
@@ -123,11 +126,14 @@ static bool init_dynlib(void)
    INITSYM(ov_time_seek_lap);
    INITSYM(ov_time_tell);
    INITSYM(ov_read);
+   INITSYM(ov_read_float);
+   INITSYM(ov_pcm_seek);
 #else
    INITSYM(ov_time_total);
    INITSYM(ov_time_seek);
    INITSYM(ov_time_tell);
    INITSYM(ov_read);
+   INITSYM(ov_pcm_seek);
 #endif
 
    return true;
@@ -215,36 +221,166 @@ ALLEGRO_SAMPLE *_al_load_ogg_vorbis(const char *filename)
 }
 
 
-ALLEGRO_SAMPLE *_al_load_ogg_vorbis_f(ALLEGRO_FILE *file)
+/* Returns true if samples should be loaded as float32, as set by the
+ * [acodec] vorbis_depth config setting.  Tremor only decodes to integers.
+ */
+static bool want_float_samples(void)
 {
-   /* Note: decoding library returns floats.  I always return 16-bit (most
-    * commonly supported).
-    */
+#ifndef TREMOR
+   const char *value = al_get_config_value(al_get_system_config(), "acodec",
+      "vorbis_depth");
+   return value && 0 == _al_stricmp(value, "float32");
+#else
+   return false;
+#endif
+}
+
+
+/* Decodes the samples [start, end) of vf, which must be positioned at
+ * start, into their place in buffer.  Anything that could not be decoded
+ * is left silent.
+ */
+static bool decode_range(OggVorbis_File *vf, char *buffer, int channels,
+   int word_size, int64_t start, int64_t end)
+{
+   /* suggestion for how much to read at a time */
+   const int packet_samples = 1024;
 #ifdef ALLEGRO_LITTLE_ENDIAN
    const int endian = 0; /* 0 for Little-Endian, 1 for Big-Endian */
 #else
    const int endian = 1; /* 0 for Little-Endian, 1 for Big-Endian */
 #endif
-   int word_size = 2; /* 1 = 8bit, 2 = 16-bit. nothing else */
-   int signedness = 1; /* 0  for unsigned, 1 for signed */
-   const int packet_size = 4096; /* suggestion for size to read at a time */
+   const int signedness = 1; /* 0  for unsigned, 1 for signed */
+   const int sample_size = channels * word_size;
+   int64_t pos = start;
+   int bitstream = -1;
+   long read;
+
+   while (pos < end) {
+      const int wanted = (int)_ALLEGRO_MIN(packet_samples, end - pos);
+      char *out = buffer + pos * sample_size;
+
+#ifndef TREMOR
+      if (word_size == 4) {
+         float **pcm;
+         float *dst = (float *)out;
+         long i;
+         int c;
+
+         /* Vorbis decodes to planar floats, which only need interleaving. */
+         read = lib.ov_read_float(vf, &pcm, wanted, &bitstream);
+         for (i = 0; i < read; i++) {
+            for (c = 0; c < channels; c++)
+               *dst++ = pcm[c][i];
+         }
+      }
+      else {
+         read = lib.ov_read(vf, out, wanted * sample_size, endian, word_size,
+            signedness, &bitstream);
+         if (read > 0)
+            read /= sample_size;
+      }
+#else
+      (void)endian;
+      (void)signedness;
+      read = lib.ov_read(vf, out, wanted * sample_size, &bitstream);
+      if (read > 0)
+         read /= sample_size;
+#endif
+
+      if (read == OV_HOLE)
+         continue;
+      if (read <= 0)
+         break;
+      pos += read;
+   }
+
+   if (pos < end) {
+      memset(buffer + pos * sample_size, 0, (end - pos) * sample_size);
+      return false;
+   }
+   return true;
+}
+
+
+typedef struct OGG_SEGMENTS {
+   const void *mem;
+   int64_t mem_size;
+   char *buffer;
+   int channels;
+   int word_size;
+} OGG_SEGMENTS;
+
+
+/* Decodes one segment of a file read into memory, with a decoder of its
+ * own.  Runs on one of the threads of _al_acodec_decode_segments.
+ */
+static bool decode_segment(void *arg, int64_t start, int64_t end)
+{
+   OGG_SEGMENTS *segs = arg;
+   const int sample_size = segs->channels * segs->word_size;
+   OggVorbis_File vf;
+   AL_OV_DATA ov;
+   bool ret = false;
+
+   ov.file = _al_acodec_open_memory(segs->mem, segs->mem_size);
+   if (!ov.file)
+      goto error;
+
+   if (lib.ov_open_callbacks(&ov, &vf, NULL, 0, callbacks) < 0) {
+      al_fclose(ov.file);
+      goto error;
+   }
+
+   /* Seeking is sample accurate, so the segments join seamlessly. */
+   if (start == 0 || lib.ov_pcm_seek(&vf, start) == 0) {
+      ret = decode_range(&vf, segs->buffer, segs->channels, segs->word_size,
+         start, end);
+   }
+   else {
+      memset(segs->buffer + start * sample_size, 0,
+         (end - start) * sample_size);
+   }
+
+   lib.ov_clear(&vf);
+   al_fclose(ov.file);
+   return ret;
+
+error:
+   memset(segs->buffer + start * sample_size, 0, (end - start) * sample_size);
+   return false;
+}
+
+
+ALLEGRO_SAMPLE *_al_load_ogg_vorbis_f(ALLEGRO_FILE *file)
+{
+   /* Note: decoding library returns floats.  Unless float32 samples are
+    * asked for, I return 16-bit (most commonly supported).
+    */
+   int word_size = 2; /* 2 = 16-bit, 4 = float */
    OggVorbis_File vf;
    vorbis_info* vi;
    char *buffer;
-   long pos;
    ALLEGRO_SAMPLE *sample;
    int channels;
    long rate;
-   long total_samples;
-   int bitstream;
-   long total_size;
+   int64_t total_samples;
+   int64_t total_size;
+   int64_t start_pos;
+   int num_threads;
+   OGG_SEGMENTS segs;
    AL_OV_DATA ov;
-   long read;
+   bool ok;
 
    if (!init_dynlib()) {
       return NULL;
    }
 
+   if (want_float_samples())
+      word_size = 4;
+
+   start_pos = al_ftell(file);
+
    ov.file = file;
    if (lib.ov_open_callbacks(&ov, &vf, NULL, 0, callbacks) < 0) {
       ALLEGRO_WARN("Audio file does not appear to be an Ogg bitstream.\n");
@@ -256,40 +392,61 @@ ALLEGRO_SAMPLE *_al_load_ogg_vorbis_f(ALLEGRO_FILE *file)
    channels = vi->channels;
    rate = vi->rate;
    total_samples = lib.ov_pcm_total(&vf, -1);
-   bitstream = -1;
    total_size = total_samples * channels * word_size;
 
    ALLEGRO_DEBUG("channels %d\n", channels);
    ALLEGRO_DEBUG("word_size %d\n", word_size);
    ALLEGRO_DEBUG("rate %ld\n", rate);
-   ALLEGRO_DEBUG("total_samples %ld\n", total_samples);
-   ALLEGRO_DEBUG("total_size %ld\n", total_size);
+   ALLEGRO_DEBUG("total_samples %ld\n", (long)total_samples);
+   ALLEGRO_DEBUG("total_size %ld\n", (long)total_size);
+
+   if (total_samples <= 0 || (uint64_t)total_size > (size_t)-1) {
+      ALLEGRO_WARN("Cannot load Ogg Vorbis file of unknown length.\n");
+      lib.ov_clear(&vf);
+      return NULL;
+   }
 
    buffer = al_malloc(total_size);
    if (!buffer) {
+      lib.ov_clear(&vf);
       return NULL;
    }
 
-   pos = 0;
-   while (pos < total_size) {
-      const int read_size = _ALLEGRO_MIN(packet_size, total_size - pos);
-      ASSERT(pos + read_size <= total_size);
+   /* Long files are split into segments which are decoded in parallel, each
+    * from its own copy of the file in memory.  Otherwise (or if the file
+    * can't be read into memory) decode serially.
+    */
+   segs.mem = NULL;
+   num_threads = _al_acodec_get_decode_threads(total_samples);
+   if (num_threads > 1 && start_pos >= 0 &&
+         al_fseek(file, start_pos, ALLEGRO_SEEK_SET)) {
+      segs.mem = _al_acodec_read_file(file, &segs.mem_size);
+   }
 
-      /* XXX error handling */
-#ifndef TREMOR
-      read = lib.ov_read(&vf, buffer + pos, read_size, endian, word_size,
-         signedness, &bitstream);
-#else
-      (void)endian;
-      (void)signedness;
-      read = lib.ov_read(&vf, buffer + pos, read_size, &bitstream);
-#endif
-      pos += read;
-      if (read == 0)
-         break;
+   if (segs.mem) {
+      lib.ov_clear(&vf);
+
+      ALLEGRO_DEBUG("decoding with %d threads\n", num_threads);
+      segs.buffer = buffer;
+      segs.channels = channels;
+      segs.word_size = word_size;
+      ok = _al_acodec_decode_segments(num_threads, total_samples,
+         decode_segment, &segs);
+      al_free((void *)segs.mem);
+   }
+   else {
+      /* Trying to read the file into memory moved the file position
+       * behind the decoder's back.
+       */
+      if (num_threads > 1)
+         lib.ov_pcm_seek(&vf, 0);
+      ok = decode_range(&vf, buffer, channels, word_size, 0, total_samples);
+      lib.ov_clear(&vf);
    }
 
-   lib.ov_clear(&vf);
+   if (!ok) {
+      ALLEGRO_WARN("Ogg Vorbis file is truncated or damaged.\n");
+   }
 
    sample = al_create_sample(buffer, total_samples, rate,
       _al_word_size_to_depth_conf(word_size),
@@ -130,7 +130,8 @@ enum ALLEGRO_MIXER_QUALITY
 {
    ALLEGRO_MIXER_QUALITY_POINT   = 0x110,
    ALLEGRO_MIXER_QUALITY_LINEAR  = 0x111,
-   ALLEGRO_MIXER_QUALITY_CUBIC   = 0x112
+   ALLEGRO_MIXER_QUALITY_CUBIC   = 0x112,
+   ALLEGRO_MIXER_QUALITY_SINC    = 0x113
 };
 
 
@@ -153,6 +154,33 @@ struct ALLEGRO_SAMPLE_ID {
 };
 
 
+/* Enum: ALLEGRO_SAMPLE_STEAL_POLICY
+ */
+enum ALLEGRO_SAMPLE_STEAL_POLICY
+{
+   ALLEGRO_SAMPLE_STEAL_NONE              = 0,
+   ALLEGRO_SAMPLE_STEAL_OLDEST            = 1,
+   ALLEGRO_SAMPLE_STEAL_LOWEST_PRIORITY   = 2,
+   ALLEGRO_SAMPLE_STEAL_FARTHEST          = 3
+};
+
+
+/* Type: ALLEGRO_SAMPLE_TRIGGER
+ */
+typedef struct ALLEGRO_SAMPLE_TRIGGER ALLEGRO_SAMPLE_TRIGGER;
+
+struct ALLEGRO_SAMPLE_TRIGGER {
+   ALLEGRO_SAMPLE *sample;
+   float gain;
+   float pan;
+   float speed;
+   enum ALLEGRO_PLAYMODE loop;
+   float priority;
+   float distance;
+   ALLEGRO_SAMPLE_ID id;
+};
+
+
 /* Type: ALLEGRO_SAMPLE_INSTANCE
  */
 typedef struct ALLEGRO_SAMPLE_INSTANCE ALLEGRO_SAMPLE_INSTANCE;
@@ -183,6 +211,7 @@ typedef enum ALLEGRO_AUDIO_DEPTH ALLEGRO_AUDIO_DEPTH;
 typedef enum ALLEGRO_CHANNEL_CONF ALLEGRO_CHANNEL_CONF;
 typedef enum ALLEGRO_PLAYMODE ALLEGRO_PLAYMODE;
 typedef enum ALLEGRO_MIXER_QUALITY ALLEGRO_MIXER_QUALITY;
+typedef enum ALLEGRO_SAMPLE_STEAL_POLICY ALLEGRO_SAMPLE_STEAL_POLICY;
 #endif
 
 
@@ -232,6 +261,12 @@ ALLEGRO_KCM_AUDIO_FUNC(bool, al_set_sample_instance_pan, (ALLEGRO_SAMPLE_INSTANC
 ALLEGRO_KCM_AUDIO_FUNC(bool, al_set_sample_instance_playmode, (ALLEGRO_SAMPLE_INSTANCE *spl, ALLEGRO_PLAYMODE val));
 
 ALLEGRO_KCM_AUDIO_FUNC(bool, al_set_sample_instance_playing, (ALLEGRO_SAMPLE_INSTANCE *spl, bool val));
+
+ALLEGRO_KCM_AUDIO_FUNC(bool, al_set_sample_instance_playing_at, (ALLEGRO_SAMPLE_INSTANCE *spl, bool val, uint64_t time));
+ALLEGRO_KCM_AUDIO_FUNC(bool, al_set_sample_instance_gain_at, (ALLEGRO_SAMPLE_INSTANCE *spl, float val, uint64_t time));
+ALLEGRO_KCM_AUDIO_FUNC(bool, al_set_sample_instance_pan_at, (ALLEGRO_SAMPLE_INSTANCE *spl, float val, uint64_t time));
+ALLEGRO_KCM_AUDIO_FUNC(bool, al_set_sample_instance_speed_at, (ALLEGRO_SAMPLE_INSTANCE *spl, float val, uint64_t time));
+
 ALLEGRO_KCM_AUDIO_FUNC(bool, al_detach_sample_instance, (ALLEGRO_SAMPLE_INSTANCE *spl));
 
 ALLEGRO_KCM_AUDIO_FUNC(bool, al_set_sample, (ALLEGRO_SAMPLE_INSTANCE *spl, ALLEGRO_SAMPLE *data));
@@ -273,6 +308,12 @@ ALLEGRO_KCM_AUDIO_FUNC(bool, al_set_audio_stream_pan, (ALLEGRO_AUDIO_STREAM *str
 ALLEGRO_KCM_AUDIO_FUNC(bool, al_set_audio_stream_playmode, (ALLEGRO_AUDIO_STREAM *stream, ALLEGRO_PLAYMODE val));
 
 ALLEGRO_KCM_AUDIO_FUNC(bool, al_set_audio_stream_playing, (ALLEGRO_AUDIO_STREAM *stream, bool val));
+
+ALLEGRO_KCM_AUDIO_FUNC(bool, al_set_audio_stream_playing_at, (ALLEGRO_AUDIO_STREAM *stream, bool val, uint64_t time));
+ALLEGRO_KCM_AUDIO_FUNC(bool, al_set_audio_stream_gain_at, (ALLEGRO_AUDIO_STREAM *stream, float val, uint64_t time));
+ALLEGRO_KCM_AUDIO_FUNC(bool, al_set_audio_stream_pan_at, (ALLEGRO_AUDIO_STREAM *stream, float val, uint64_t time));
+ALLEGRO_KCM_AUDIO_FUNC(bool, al_set_audio_stream_speed_at, (ALLEGRO_AUDIO_STREAM *stream, float val, uint64_t time));
+
 ALLEGRO_KCM_AUDIO_FUNC(bool, al_detach_audio_stream, (ALLEGRO_AUDIO_STREAM *stream));
 ALLEGRO_KCM_AUDIO_FUNC(bool, al_set_audio_stream_fragment, (ALLEGRO_AUDIO_STREAM *stream, void *val));
 
@@ -300,6 +341,7 @@ ALLEGRO_KCM_AUDIO_FUNC(bool, al_set_mixer_postprocess_callback, (
       void *data));
 
 ALLEGRO_KCM_AUDIO_FUNC(unsigned int, al_get_mixer_frequency, (const ALLEGRO_MIXER *mixer));
+ALLEGRO_KCM_AUDIO_FUNC(uint64_t, al_get_mixer_sample_time, (const ALLEGRO_MIXER *mixer));
 ALLEGRO_KCM_AUDIO_FUNC(ALLEGRO_CHANNEL_CONF, al_get_mixer_channels, (const ALLEGRO_MIXER *mixer));
 ALLEGRO_KCM_AUDIO_FUNC(ALLEGRO_AUDIO_DEPTH, al_get_mixer_depth, (const ALLEGRO_MIXER *mixer));
 ALLEGRO_KCM_AUDIO_FUNC(ALLEGRO_MIXER_QUALITY, al_get_mixer_quality, (const ALLEGRO_MIXER *mixer));
@@ -352,8 +394,14 @@ ALLEGRO_KCM_AUDIO_FUNC(bool, al_set_default_mixer, (ALLEGRO_MIXER *mixer));
 ALLEGRO_KCM_AUDIO_FUNC(bool, al_restore_default_mixer, (void));
 ALLEGRO_KCM_AUDIO_FUNC(bool, al_play_sample, (ALLEGRO_SAMPLE *data,
       float gain, float pan, float speed, ALLEGRO_PLAYMODE loop, ALLEGRO_SAMPLE_ID *ret_id));
+ALLEGRO_KCM_AUDIO_FUNC(int, al_play_samples, (ALLEGRO_SAMPLE_TRIGGER *triggers,
+      int count));
 ALLEGRO_KCM_AUDIO_FUNC(void, al_stop_sample, (ALLEGRO_SAMPLE_ID *spl_id));
 ALLEGRO_KCM_AUDIO_FUNC(void, al_stop_samples, (void));
+ALLEGRO_KCM_AUDIO_FUNC(void, al_set_sample_steal_policy, (ALLEGRO_SAMPLE_STEAL_POLICY policy));
+ALLEGRO_KCM_AUDIO_FUNC(ALLEGRO_SAMPLE_STEAL_POLICY, al_get_sample_steal_policy, (void));
+ALLEGRO_KCM_AUDIO_FUNC(void, al_get_reserved_sample_counters, (int *played,
+      int *stolen, int *dropped));
 ALLEGRO_KCM_AUDIO_FUNC(ALLEGRO_VOICE *, al_get_default_voice, (void));
 ALLEGRO_KCM_AUDIO_FUNC(void, al_set_default_voice, (ALLEGRO_VOICE *voice));
 
@@ -6,6 +6,7 @@
 #define AINTERN_AUDIO_H
 
 #include "allegro5/allegro.h"
+#include "allegro5/internal/aintern_atomicops.h"
 #include "allegro5/internal/aintern_vector.h"
 #include "../allegro_audio.h"
 
@@ -179,6 +180,30 @@ struct ALLEGRO_SAMPLE_INSTANCE {
                         /* Used to convert from this format to the attached
                          * mixers, if any.  Otherwise is NULL.
                          * The gain is premultiplied in.
+                         * The same allocation holds the per-sample steps
+                         * and the target values of a ramp after it.
+                         */
+
+   int                  ramp_samples;
+                        /* Number of samples left until the matrix reaches
+                         * its target values, or 0 if it is not ramping.
+                         */
+
+   volatile _AL_ATOMIC  posted;
+   int                  posted_pos;
+                        /* Mask of _AL_KCM_POSTED_* changes made by the
+                         * setters while the parent mixer is running.  The
+                         * mixer applies them at the start of its next
+                         * buffer, so the setters need not take the mutex.
+                         */
+
+   float                *sinc_filter;
+   int                  sinc_filter_step;
+   int                  sinc_filter_denom;
+                        /* Polyphase filter with one phase per possible
+                         * sample position, built by the sinc resampler for
+                         * the step it was last used with.  NULL if the step
+                         * has too many phases for that to pay off.
                          */
 
    bool                 is_mixer;
@@ -196,11 +221,46 @@ struct ALLEGRO_SAMPLE_INSTANCE {
    sample_parent_t      parent;
                         /* The object that this sample is attached to, if any.
                          */
+
+   _AL_VECTOR           scheduled;
+                        /* Vector of _AL_KCM_SCHEDULED_EVENT, sorted by time.
+                         * Changes to apply when the parent mixer's sample
+                         * clock reaches the given time.
+                         */
 };
 
+typedef enum {
+   _AL_KCM_SCHEDULE_PLAY,
+   _AL_KCM_SCHEDULE_STOP,
+   _AL_KCM_SCHEDULE_GAIN,
+   _AL_KCM_SCHEDULE_PAN,
+   _AL_KCM_SCHEDULE_SPEED
+} _AL_KCM_SCHEDULE_TYPE;
+
+typedef struct {
+   uint64_t             time;
+   _AL_KCM_SCHEDULE_TYPE type;
+   float                value;
+} _AL_KCM_SCHEDULED_EVENT;
+
+enum {
+   _AL_KCM_POSTED_MATRIX   = 0x1,
+   _AL_KCM_POSTED_SPEED    = 0x2,
+   _AL_KCM_POSTED_POSITION = 0x4
+};
+
+void _al_kcm_apply_posted_changes(ALLEGRO_SAMPLE_INSTANCE *spl,
+   unsigned int samples);
+bool _al_kcm_schedule_event(ALLEGRO_SAMPLE_INSTANCE *spl,
+   _AL_KCM_SCHEDULE_TYPE type, float value, uint64_t time);
+void _al_kcm_apply_scheduled_event(ALLEGRO_SAMPLE_INSTANCE *spl,
+   const _AL_KCM_SCHEDULED_EVENT *event);
 void _al_kcm_destroy_sample(ALLEGRO_SAMPLE_INSTANCE *sample, bool unregister);
 void _al_kcm_stream_set_mutex(ALLEGRO_SAMPLE_INSTANCE *stream, ALLEGRO_MUTEX *mutex);
 void _al_kcm_detach_from_parent(ALLEGRO_SAMPLE_INSTANCE *spl);
+bool _al_kcm_trigger_sample_instance(ALLEGRO_SAMPLE_INSTANCE *spl,
+   ALLEGRO_SAMPLE *data, float gain, float pan, float speed,
+   ALLEGRO_PLAYMODE loop);
 
 
 typedef size_t (*stream_callback_t)(ALLEGRO_AUDIO_STREAM *, void *, size_t);
@@ -225,7 +285,7 @@ struct ALLEGRO_AUDIO_STREAM {
    void                 *main_buffer;
                         /* Pointer to a single buffer big enough to hold all
                          * the fragments. Each fragment has additional samples
-                         * at the start for linear/cubic interpolation.
+                         * at the start for linear/cubic/sinc interpolation.
                          */
 
    void                 **pending_bufs;
@@ -277,6 +337,7 @@ struct ALLEGRO_AUDIO_STREAM {
 };
 
 bool _al_kcm_refill_stream(ALLEGRO_AUDIO_STREAM *stream);
+void _al_kcm_reset_stopped_stream(ALLEGRO_AUDIO_STREAM *stream);
 
 
 typedef void (*postprocess_callback_t)(void *buf, unsigned int samples,
@@ -301,10 +362,22 @@ struct ALLEGRO_MIXER {
                            /* Vector of ALLEGRO_SAMPLE_INSTANCE*.  Holds the list of
                             * streams being mixed together.
                             */
+
+   uint64_t                sample_time;
+                           /* Number of sample frames mixed so far.  This is
+                            * the clock scheduled changes are timed against.
+                            */
+
+   float                   current_gain;
+                           /* The gain applied at the end of the last buffer.
+                            * A change to ss.gain is ramped from this value.
+                            */
 };
 
 extern void _al_kcm_mixer_rejig_sample_matrix(ALLEGRO_MIXER *mixer,
    ALLEGRO_SAMPLE_INSTANCE *spl);
+extern void _al_kcm_mixer_ramp_sample_matrix(ALLEGRO_MIXER *mixer,
+   ALLEGRO_SAMPLE_INSTANCE *spl, unsigned int samples);
 extern void _al_kcm_mixer_read(void *source, void **buf, unsigned int *samples,
    ALLEGRO_AUDIO_DEPTH buffer_depth, size_t dest_maxc);
 
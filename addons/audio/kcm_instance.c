@@ -95,6 +95,7 @@ static void stream_free(ALLEGRO_SAMPLE_INSTANCE *spl)
 
       ASSERT(! spl->spl_data.free_buf);
 
+      _al_vector_free(&spl->scheduled);
       al_free(spl);
    }
 }
@@ -132,6 +133,13 @@ void _al_kcm_detach_from_parent(ALLEGRO_SAMPLE_INSTANCE *spl)
 
          spl->spl_read = NULL;
 
+         /* Scheduled times refer to the old mixer's clock. */
+         _al_vector_free(&spl->scheduled);
+
+         /* The rest of the posted changes are redone on attaching. */
+         if (_al_fetch_and_and(&spl->posted, 0) & _AL_KCM_POSTED_POSITION)
+            spl->pos = spl->posted_pos;
+
          maybe_unlock_mutex(mixer->ss.mutex);
 
          break;
@@ -140,6 +148,11 @@ void _al_kcm_detach_from_parent(ALLEGRO_SAMPLE_INSTANCE *spl)
 
    al_free(spl->matrix);
    spl->matrix = NULL;
+
+   al_free(spl->sinc_filter);
+   spl->sinc_filter = NULL;
+   spl->sinc_filter_step = 0;
+   spl->sinc_filter_denom = 0;
 }
 
 
@@ -178,6 +191,8 @@ ALLEGRO_SAMPLE_INSTANCE *al_create_sample_instance(ALLEGRO_SAMPLE *sample_data)
    spl->mutex = NULL;
    spl->parent.u.ptr = NULL;
 
+   _al_vector_init(&spl->scheduled, sizeof(_AL_KCM_SCHEDULED_EVENT));
+
    _al_kcm_register_destructor(spl, (void (*)(void *)) al_destroy_sample_instance);
 
    return spl;
@@ -259,6 +274,8 @@ unsigned int al_get_sample_instance_position(const ALLEGRO_SAMPLE_INSTANCE *spl)
       return al_get_voice_position(voice);
    }
 
+   if (spl->posted & _AL_KCM_POSTED_POSITION)
+      return spl->posted_pos;
    return spl->pos;
 }
 
@@ -372,10 +389,13 @@ bool al_set_sample_instance_position(ALLEGRO_SAMPLE_INSTANCE *spl,
       if (!al_set_voice_position(voice, val))
          return false;
    }
+   else if (spl->mutex) {
+      /* Leave it to the mixer. */
+      spl->posted_pos = val;
+      _al_fetch_and_or(&spl->posted, _AL_KCM_POSTED_POSITION);
+   }
    else {
-      maybe_lock_mutex(spl->mutex);
       spl->pos = val;
-      maybe_unlock_mutex(spl->mutex);
    }
 
    return true;
@@ -400,6 +420,23 @@ bool al_set_sample_instance_length(ALLEGRO_SAMPLE_INSTANCE *spl,
 }
 
 
+/* Recompute the step for the speed and the parent mixer's frequency. */
+static void update_step(ALLEGRO_SAMPLE_INSTANCE *spl)
+{
+   ALLEGRO_MIXER *mixer = spl->parent.u.mixer;
+
+   spl->step = (spl->spl_data.frequency) * spl->speed;
+   spl->step_denom = mixer->ss.spl_data.frequency;
+   /* Don't wanna be trapped with a step value of 0 */
+   if (spl->step == 0) {
+      if (spl->speed > 0.0f)
+         spl->step = 1;
+      else
+         spl->step = -1;
+   }
+}
+
+
 /* Function: al_set_sample_instance_speed
  */
 bool al_set_sample_instance_speed(ALLEGRO_SAMPLE_INSTANCE *spl, float val)
@@ -420,21 +457,10 @@ bool al_set_sample_instance_speed(ALLEGRO_SAMPLE_INSTANCE *spl, float val)
 
    spl->speed = val;
    if (spl->parent.u.mixer) {
-      ALLEGRO_MIXER *mixer = spl->parent.u.mixer;
-
-      maybe_lock_mutex(spl->mutex);
-
-      spl->step = (spl->spl_data.frequency) * spl->speed;
-      spl->step_denom = mixer->ss.spl_data.frequency;
-      /* Don't wanna be trapped with a step value of 0 */
-      if (spl->step == 0) {
-         if (spl->speed > 0.0f)
-            spl->step = 1;
-         else
-            spl->step = -1;
-      }
-
-      maybe_unlock_mutex(spl->mutex);
+      if (spl->mutex)
+         _al_fetch_and_or(&spl->posted, _AL_KCM_POSTED_SPEED);
+      else
+         update_step(spl);
    }
 
    return true;
@@ -457,14 +483,14 @@ bool al_set_sample_instance_gain(ALLEGRO_SAMPLE_INSTANCE *spl, float val)
       spl->gain = val;
 
       /* If attached to a mixer already, need to recompute the sample
-       * matrix to take into account the gain.
+       * matrix to take into account the gain.  While the mixer is running
+       * it does that itself at the start of the next buffer.
        */
       if (spl->parent.u.mixer) {
-         ALLEGRO_MIXER *mixer = spl->parent.u.mixer;
-
-         maybe_lock_mutex(spl->mutex);
-         _al_kcm_mixer_rejig_sample_matrix(mixer, spl);
-         maybe_unlock_mutex(spl->mutex);
+         if (spl->mutex)
+            _al_fetch_and_or(&spl->posted, _AL_KCM_POSTED_MATRIX);
+         else
+            _al_kcm_mixer_rejig_sample_matrix(spl->parent.u.mixer, spl);
       }
    }
 
@@ -492,14 +518,14 @@ bool al_set_sample_instance_pan(ALLEGRO_SAMPLE_INSTANCE *spl, float val)
       spl->pan = val;
 
       /* If attached to a mixer already, need to recompute the sample
-       * matrix to take into account the panning.
+       * matrix to take into account the panning.  While the mixer is running
+       * it does that itself at the start of the next buffer.
        */
       if (spl->parent.u.mixer) {
-         ALLEGRO_MIXER *mixer = spl->parent.u.mixer;
-
-         maybe_lock_mutex(spl->mutex);
-         _al_kcm_mixer_rejig_sample_matrix(mixer, spl);
-         maybe_unlock_mutex(spl->mutex);
+         if (spl->mutex)
+            _al_fetch_and_or(&spl->posted, _AL_KCM_POSTED_MATRIX);
+         else
+            _al_kcm_mixer_rejig_sample_matrix(spl->parent.u.mixer, spl);
       }
    }
 
@@ -557,13 +583,179 @@ bool al_set_sample_instance_playing(ALLEGRO_SAMPLE_INSTANCE *spl, bool val)
    /* parent is mixer */
    maybe_lock_mutex(spl->mutex);
    spl->is_playing = val;
-   if (!val)
+   if (!val) {
+      _al_fetch_and_and(&spl->posted, ~_AL_KCM_POSTED_POSITION);
       spl->pos = 0;
+   }
+   maybe_unlock_mutex(spl->mutex);
+   return true;
+}
+
+
+/* Function: al_set_sample_instance_playing_at
+ */
+bool al_set_sample_instance_playing_at(ALLEGRO_SAMPLE_INSTANCE *spl, bool val,
+   uint64_t time)
+{
+   ASSERT(spl);
+
+   return _al_kcm_schedule_event(spl,
+      val ? _AL_KCM_SCHEDULE_PLAY : _AL_KCM_SCHEDULE_STOP, 0.0f, time);
+}
+
+
+/* Function: al_set_sample_instance_gain_at
+ */
+bool al_set_sample_instance_gain_at(ALLEGRO_SAMPLE_INSTANCE *spl, float val,
+   uint64_t time)
+{
+   ASSERT(spl);
+
+   return _al_kcm_schedule_event(spl, _AL_KCM_SCHEDULE_GAIN, val, time);
+}
+
+
+/* Function: al_set_sample_instance_pan_at
+ */
+bool al_set_sample_instance_pan_at(ALLEGRO_SAMPLE_INSTANCE *spl, float val,
+   uint64_t time)
+{
+   ASSERT(spl);
+
+   if (val != ALLEGRO_AUDIO_PAN_NONE && (val < -1.0 || val > 1.0)) {
+      _al_set_error(ALLEGRO_GENERIC_ERROR, "Invalid pan value");
+      return false;
+   }
+
+   return _al_kcm_schedule_event(spl, _AL_KCM_SCHEDULE_PAN, val, time);
+}
+
+
+/* Function: al_set_sample_instance_speed_at
+ */
+bool al_set_sample_instance_speed_at(ALLEGRO_SAMPLE_INSTANCE *spl, float val,
+   uint64_t time)
+{
+   ASSERT(spl);
+
+   if (fabsf(val) < (1.0f/64.0f)) {
+      _al_set_error(ALLEGRO_INVALID_PARAM,
+         "Attempted to set zero speed");
+      return false;
+   }
+
+   return _al_kcm_schedule_event(spl, _AL_KCM_SCHEDULE_SPEED, val, time);
+}
+
+
+/* _al_kcm_apply_posted_changes:
+ *  Called by the parent mixer, which holds the mutex, at the start of each
+ *  buffer of `samples' samples to make the changes posted by the setters.
+ *  Gain and pan changes are ramped over the buffer.
+ */
+void _al_kcm_apply_posted_changes(ALLEGRO_SAMPLE_INSTANCE *spl,
+   unsigned int samples)
+{
+   int changes = _al_fetch_and_and(&spl->posted, 0);
+
+   if (changes & _AL_KCM_POSTED_POSITION)
+      spl->pos = spl->posted_pos;
+   if (changes & _AL_KCM_POSTED_SPEED)
+      update_step(spl);
+   if (changes & _AL_KCM_POSTED_MATRIX)
+      _al_kcm_mixer_ramp_sample_matrix(spl->parent.u.mixer, spl, samples);
+}
+
+
+/* _al_kcm_schedule_event:
+ *  Queues a change to the sample, stream or mixer, to be made by the parent
+ *  mixer when its sample clock reaches `time'.  Changes scheduled for the
+ *  same time are made in the order they were scheduled.
+ */
+bool _al_kcm_schedule_event(ALLEGRO_SAMPLE_INSTANCE *spl,
+   _AL_KCM_SCHEDULE_TYPE type, float value, uint64_t time)
+{
+   _AL_KCM_SCHEDULED_EVENT *event;
+   unsigned int i;
+
+   if (!spl->parent.u.ptr || spl->parent.is_voice) {
+      _al_set_error(ALLEGRO_INVALID_OBJECT,
+         "Scheduled changes need a sample attached to a mixer");
+      return false;
+   }
+
+   maybe_lock_mutex(spl->mutex);
+
+   for (i = _al_vector_size(&spl->scheduled); i > 0; i--) {
+      _AL_KCM_SCHEDULED_EVENT *prev = _al_vector_ref(&spl->scheduled, i - 1);
+      if (prev->time <= time)
+         break;
+   }
+
+   event = _al_vector_alloc_mid(&spl->scheduled, i);
+   if (event) {
+      event->time = time;
+      event->type = type;
+      event->value = value;
+   }
+
    maybe_unlock_mutex(spl->mutex);
+
+   if (!event) {
+      _al_set_error(ALLEGRO_GENERIC_ERROR,
+         "Out of memory allocating scheduled change");
+      return false;
+   }
    return true;
 }
 
 
+/* _al_kcm_apply_scheduled_event:
+ *  Makes a scheduled change.  Called by the parent mixer, which holds the
+ *  mutex, at the sample the change is due.
+ */
+void _al_kcm_apply_scheduled_event(ALLEGRO_SAMPLE_INSTANCE *spl,
+   const _AL_KCM_SCHEDULED_EVENT *event)
+{
+   ALLEGRO_MIXER *mixer = spl->parent.u.mixer;
+   bool is_stream = (spl->loop == _ALLEGRO_PLAYMODE_STREAM_ONCE ||
+      spl->loop == _ALLEGRO_PLAYMODE_STREAM_ONEDIR);
+
+   ASSERT(mixer && !spl->parent.is_voice);
+
+   switch (event->type) {
+      case _AL_KCM_SCHEDULE_PLAY:
+         spl->is_playing = true;
+         if (is_stream)
+            _al_kcm_emit_stream_events((ALLEGRO_AUDIO_STREAM *)spl);
+         break;
+
+      case _AL_KCM_SCHEDULE_STOP:
+         spl->is_playing = false;
+         if (is_stream)
+            _al_kcm_reset_stopped_stream((ALLEGRO_AUDIO_STREAM *)spl);
+         else
+            spl->pos = 0;
+         break;
+
+      case _AL_KCM_SCHEDULE_GAIN:
+         spl->gain = event->value;
+         _al_kcm_mixer_rejig_sample_matrix(mixer, spl);
+         break;
+
+      case _AL_KCM_SCHEDULE_PAN:
+         spl->pan = event->value;
+         _al_kcm_mixer_rejig_sample_matrix(mixer, spl);
+         break;
+
+      case _AL_KCM_SCHEDULE_SPEED:
+         spl->speed = event->value;
+         update_step(spl);
+         break;
+   }
+}
+
+
 /* Function: al_detach_sample_instance
  */
 bool al_detach_sample_instance(ALLEGRO_SAMPLE_INSTANCE *spl)
@@ -641,6 +833,55 @@ bool al_set_sample(ALLEGRO_SAMPLE_INSTANCE *spl, ALLEGRO_SAMPLE *data)
 }
 
 
+/* Internal function: _al_kcm_trigger_sample_instance
+ *  Does the work of al_set_sample, setting the gain, pan, speed and playmode,
+ *  and al_play_sample_instance for an instance attached to a mixer, while
+ *  the caller holds the instance's mutex.  This lets several instances be
+ *  started together.  Returns false without changing anything if the
+ *  instance has to go through al_set_sample instead, i.e. when it would need
+ *  reattaching or a value is invalid.
+ */
+bool _al_kcm_trigger_sample_instance(ALLEGRO_SAMPLE_INSTANCE *spl,
+   ALLEGRO_SAMPLE *data, float gain, float pan, float speed,
+   ALLEGRO_PLAYMODE loop)
+{
+   ASSERT(spl);
+   ASSERT(data);
+
+   if (!spl->parent.u.ptr || spl->parent.is_voice)
+      return false;
+   if (spl->spl_data.frequency != data->frequency ||
+         spl->spl_data.depth != data->depth ||
+         spl->spl_data.chan_conf != data->chan_conf)
+      return false;
+   if (fabsf(speed) < (1.0f/64.0f))
+      return false;
+   if (pan != ALLEGRO_AUDIO_PAN_NONE && (pan < -1.0 || pan > 1.0))
+      return false;
+   if (loop < ALLEGRO_PLAYMODE_ONCE || loop > ALLEGRO_PLAYMODE_BIDIR)
+      return false;
+
+   _al_fetch_and_and(&spl->posted, 0);
+   spl->spl_data = *data;
+   spl->spl_data.free_buf = false;
+   spl->pos = 0;
+   spl->loop_start = 0;
+   spl->loop_end = data->len;
+   spl->loop = loop;
+   spl->speed = speed;
+   update_step(spl);
+
+   if (spl->gain != gain || spl->pan != pan) {
+      spl->gain = gain;
+      spl->pan = pan;
+      _al_kcm_mixer_rejig_sample_matrix(spl->parent.u.mixer, spl);
+   }
+
+   spl->is_playing = true;
+   return true;
+}
+
+
 /* Function: al_get_sample
  */
 ALLEGRO_SAMPLE *al_get_sample(ALLEGRO_SAMPLE_INSTANCE *spl)
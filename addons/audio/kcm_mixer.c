@@ -15,6 +15,7 @@
 #include "allegro5/internal/aintern.h"
 #include "allegro5/internal/aintern_audio.h"
 #include "allegro5/internal/aintern_audio_cfg.h"
+#include "allegro5/internal/aintern_profile.h"
 
 ALLEGRO_DEBUG_CHANNEL("audio")
 
@@ -44,23 +45,21 @@ static void maybe_unlock_mutex(ALLEGRO_MUTEX *mutex)
 
 
 /* _al_rechannel_matrix:
- *  This function provides a (temporary!) matrix that can be used to convert
- *  one channel configuration into another.
- *
- *  Returns a pointer to a statically allocated array.
+ *  This function fills in a matrix that can be used to convert one channel
+ *  configuration into another.  It is called from the mixer as well as
+ *  the user's thread, so it doesn't use static storage.
  */
-static float *_al_rechannel_matrix(ALLEGRO_CHANNEL_CONF orig,
-   ALLEGRO_CHANNEL_CONF target, float gain, float pan)
+static void _al_rechannel_matrix(ALLEGRO_CHANNEL_CONF orig,
+   ALLEGRO_CHANNEL_CONF target, float gain, float pan,
+   float mat[ALLEGRO_MAX_CHANNELS][ALLEGRO_MAX_CHANNELS])
 {
    /* Max 7.1 (8 channels) for input and output */
-   static float mat[ALLEGRO_MAX_CHANNELS][ALLEGRO_MAX_CHANNELS];
-
    size_t dst_chans = al_get_channel_count(target);
    size_t src_chans = al_get_channel_count(orig);
    size_t i, j;
 
    /* Start with a simple identity matrix */
-   memset(mat, 0, sizeof(mat));
+   memset(mat, 0, ALLEGRO_MAX_CHANNELS * ALLEGRO_MAX_CHANNELS * sizeof(float));
    for (i = 0; i < src_chans && i < dst_chans; i++) {
       mat[i][i] = 1.0;
    }
@@ -128,40 +127,97 @@ static float *_al_rechannel_matrix(ALLEGRO_CHANNEL_CONF orig,
       }
    }
 #endif
-
-   return &mat[0][0];
 }
 
 
-/* _al_kcm_mixer_rejig_sample_matrix:
- *  Recompute the mixing matrix for a sample attached to a mixer.
- *  The caller must be holding the mixer mutex.
- */
-void _al_kcm_mixer_rejig_sample_matrix(ALLEGRO_MIXER *mixer,
-   ALLEGRO_SAMPLE_INSTANCE *spl)
+/* Computes the mixing matrix for the sample's current gain and pan. */
+static void compute_sample_matrix(ALLEGRO_MIXER *mixer,
+   ALLEGRO_SAMPLE_INSTANCE *spl, float *matrix)
 {
-   float *mat;
+   float mat[ALLEGRO_MAX_CHANNELS][ALLEGRO_MAX_CHANNELS];
    size_t dst_chans;
    size_t src_chans;
    size_t i, j;
 
-   mat = _al_rechannel_matrix(spl->spl_data.chan_conf,
-      mixer->ss.spl_data.chan_conf, spl->gain, spl->pan);
+   _al_rechannel_matrix(spl->spl_data.chan_conf,
+      mixer->ss.spl_data.chan_conf, spl->gain, spl->pan, mat);
 
    dst_chans = al_get_channel_count(mixer->ss.spl_data.chan_conf);
    src_chans = al_get_channel_count(spl->spl_data.chan_conf);
 
-   if (!spl->matrix)
-      spl->matrix = al_calloc(1, src_chans * dst_chans * sizeof(float));
-
    for (i = 0; i < dst_chans; i++) {
       for (j = 0; j < src_chans; j++) {
-         spl->matrix[i*src_chans + j] = mat[i*ALLEGRO_MAX_CHANNELS + j];
+         matrix[i*src_chans + j] = mat[i][j];
       }
    }
 }
 
 
+/* _al_kcm_mixer_rejig_sample_matrix:
+ *  Recompute the mixing matrix for a sample attached to a mixer.
+ *  The caller must be holding the mixer mutex.
+ */
+void _al_kcm_mixer_rejig_sample_matrix(ALLEGRO_MIXER *mixer,
+   ALLEGRO_SAMPLE_INSTANCE *spl)
+{
+   size_t n = al_get_channel_count(mixer->ss.spl_data.chan_conf) *
+      al_get_channel_count(spl->spl_data.chan_conf);
+
+   /* Room for the matrix and the steps and targets of a ramp. */
+   if (!spl->matrix)
+      spl->matrix = al_calloc(3, n * sizeof(float));
+
+   compute_sample_matrix(mixer, spl, spl->matrix);
+   spl->ramp_samples = 0;
+}
+
+
+/* _al_kcm_mixer_ramp_sample_matrix:
+ *  Like _al_kcm_mixer_rejig_sample_matrix, but the matrix moves linearly to
+ *  its new values over the next `samples' samples mixed, to avoid clicks.
+ *  Called by the mixer.
+ */
+void _al_kcm_mixer_ramp_sample_matrix(ALLEGRO_MIXER *mixer,
+   ALLEGRO_SAMPLE_INSTANCE *spl, unsigned int samples)
+{
+   size_t n = al_get_channel_count(mixer->ss.spl_data.chan_conf) *
+      al_get_channel_count(spl->spl_data.chan_conf);
+   float *step;
+   float *target;
+   size_t i;
+
+   /* There is nothing to ramp from if the sample is silent anyway. */
+   if (!spl->matrix || !spl->is_playing || samples == 0) {
+      _al_kcm_mixer_rejig_sample_matrix(mixer, spl);
+      return;
+   }
+
+   step = spl->matrix + n;
+   target = step + n;
+   compute_sample_matrix(mixer, spl, target);
+   for (i = 0; i < n; i++) {
+      step[i] = (target[i] - spl->matrix[i]) / samples;
+   }
+   spl->ramp_samples = samples;
+}
+
+
+/* Advances a ramping matrix of n elements by one sample. */
+static INLINE void ramp_sample_matrix(ALLEGRO_SAMPLE_INSTANCE *spl, size_t n)
+{
+   const float *step = spl->matrix + n;
+   size_t i;
+
+   if (--spl->ramp_samples == 0) {
+      memcpy(spl->matrix, step + n, n * sizeof(float));
+      return;
+   }
+   for (i = 0; i < n; i++) {
+      spl->matrix[i] += step[i];
+   }
+}
+
+
 /* fix_looped_position:
  *  When a stream loops, this will fix up the position and anything else to
  *  allow it to safely continue playing as expected. Returns false if it
@@ -323,6 +379,8 @@ static void NAME(void *source, void **vbuf, unsigned int *samples,            \
          }                                                                    \
          buf++;                                                               \
       }                                                                       \
+      if (spl->ramp_samples > 0)                                              \
+         ramp_sample_matrix(spl, maxc * dest_maxc);                           \
                                                                               \
       spl->pos += delta;                                                      \
       spl->pos_bresenham_error += delta_error;                                \
@@ -345,18 +403,605 @@ MAKE_MIXER(read_to_mixer_linear_int16_t_16, linear_spl16, int16_t)
 #undef MAKE_MIXER
 
 
-/* _al_kcm_mixer_read:
- *  Mixes the streams attached to the mixer and writes additively to the
- *  specified buffer (or if *buf is NULL, indicating a voice, convert it and
- *  set it to the buffer pointer).
+/* Windowed sinc resampling.
+ *
+ * Each output sample value is the dot product of SINC_TAPS input sample
+ * values around the current position with a Kaiser windowed sinc filter.
+ * The filter depends on the fractional part of the position (the phase) and
+ * on the cutoff, which is lowered when the step is above one so that the
+ * skipped high frequencies are removed instead of aliased.
+ *
+ * When the step is a simple ratio, e.g. 44100/48000, only a few phases ever
+ * occur and each instance gets an exact filter for every one of them.
+ * Otherwise the filter is interpolated from one of the shared tables below,
+ * computed for SINC_PHASES phases and SINC_CUTOFFS cutoffs.
+ *
+ * Runs of output samples whose taps all lie inside the sample data are
+ * produced without any of the per-sample looping checks.
  */
-void _al_kcm_mixer_read(void *source, void **buf, unsigned int *samples,
+#define SINC_TAPS             8
+#define SINC_PHASES           128
+#define SINC_CUTOFFS          8
+#define SINC_MAX_EXACT_PHASES 512
+#define SINC_BETA             6.0
+#define SINC_BANDWIDTH        0.9
+
+typedef struct SINC_PHASE {
+   float coef[SINC_TAPS];
+   float delta[SINC_TAPS];
+} SINC_PHASE;
+
+static SINC_PHASE sinc_tables[SINC_CUTOFFS][SINC_PHASES];
+static bool sinc_tables_ready = false;
+
+
+static double bessel_i0(double x)
+{
+   double sum = 1.0;
+   double term = 1.0;
+   int k;
+
+   for (k = 1; k < 32; k++) {
+      term *= (x / (2 * k)) * (x / (2 * k));
+      sum += term;
+   }
+   return sum;
+}
+
+
+/* Computes the filter taps for a position t (0 <= t < 1) past the tap
+ * SINC_TAPS/2 - 1, normalised to unit gain.
+ */
+static void make_sinc_filter(double cutoff, double t, double *taps)
+{
+   const double half = SINC_TAPS / 2;
+   double sum = 0.0;
+   int k;
+
+   for (k = 0; k < SINC_TAPS; k++) {
+      double x = k - (half - 1) - t;
+      double u = x / half;
+      double h = cutoff;
+      if (x != 0.0)
+         h = sin(ALLEGRO_PI * cutoff * x) / (ALLEGRO_PI * x);
+      if (u >= 1.0 || u <= -1.0)
+         h = 0.0;
+      else
+         h *= bessel_i0(SINC_BETA * sqrt(1.0 - u * u)) / bessel_i0(SINC_BETA);
+      taps[k] = h;
+      sum += h;
+   }
+
+   for (k = 0; k < SINC_TAPS; k++)
+      taps[k] /= sum;
+}
+
+
+static void init_sinc_tables(void)
+{
+   double taps[SINC_PHASES + 1][SINC_TAPS];
+   int c, p, k;
+
+   if (sinc_tables_ready)
+      return;
+
+   for (c = 0; c < SINC_CUTOFFS; c++) {
+      const double cutoff = SINC_BANDWIDTH * (c + 1) / SINC_CUTOFFS;
+
+      for (p = 0; p <= SINC_PHASES; p++)
+         make_sinc_filter(cutoff, (double)p / SINC_PHASES, taps[p]);
+
+      for (p = 0; p < SINC_PHASES; p++) {
+         for (k = 0; k < SINC_TAPS; k++) {
+            sinc_tables[c][p].coef[k] = taps[p][k];
+            sinc_tables[c][p].delta[k] = taps[p + 1][k] - taps[p][k];
+         }
+      }
+   }
+
+   sinc_tables_ready = true;
+}
+
+
+static int gcd(int a, int b)
+{
+   while (b != 0) {
+      int t = a % b;
+      a = b;
+      b = t;
+   }
+   return a;
+}
+
+
+/* Makes sure spl->sinc_filter matches the current step. */
+static void update_sinc_filter(ALLEGRO_SAMPLE_INSTANCE *spl)
+{
+   const int step = abs(spl->step);
+   double cutoff = SINC_BANDWIDTH;
+   double taps[SINC_TAPS];
+   int phases;
+   int p, k;
+
+   /* Bidirectional loops only flip the sign of the step. */
+   if (spl->sinc_filter_step == step &&
+         spl->sinc_filter_denom == spl->step_denom)
+      return;
+
+   al_free(spl->sinc_filter);
+   spl->sinc_filter = NULL;
+   spl->sinc_filter_step = step;
+   spl->sinc_filter_denom = spl->step_denom;
+
+   phases = spl->step_denom / gcd(step, spl->step_denom);
+   if (phases > SINC_MAX_EXACT_PHASES)
+      return;
+
+   spl->sinc_filter = al_malloc(phases * SINC_TAPS * sizeof(float));
+   if (!spl->sinc_filter)
+      return;
+
+   if (step > spl->step_denom)
+      cutoff *= (double)spl->step_denom / step;
+
+   for (p = 0; p < phases; p++) {
+      make_sinc_filter(cutoff, (double)p / phases, taps);
+      for (k = 0; k < SINC_TAPS; k++)
+         spl->sinc_filter[p * SINC_TAPS + k] = taps[k];
+   }
+}
+
+
+typedef struct SINC_STATE {
+   const float *exact;
+   int exact_div;
+   const SINC_PHASE *table;
+   int denom;
+   float inv_denom;
+} SINC_STATE;
+
+
+static void init_sinc_state(SINC_STATE *st, ALLEGRO_SAMPLE_INSTANCE *spl)
+{
+   const int step = abs(spl->step);
+   int c;
+
+   update_sinc_filter(spl);
+
+   st->exact = spl->sinc_filter;
+   st->exact_div = gcd(step, spl->step_denom);
+   st->denom = spl->step_denom;
+   st->inv_denom = 1.0f / spl->step_denom;
+
+   /* Pick the widest shared table whose cutoff is below the new Nyquist
+    * frequency.
+    */
+   c = SINC_CUTOFFS - 1;
+   if (step > spl->step_denom) {
+      c = (int)((int64_t)SINC_CUTOFFS * spl->step_denom / step) - 1;
+      if (c < 0)
+         c = 0;
+   }
+   st->table = sinc_tables[c];
+}
+
+
+/* Returns the filter taps for the fractional position err / denom. */
+static INLINE const float *sinc_weights(const SINC_STATE *st, int err,
+   float *w)
+{
+   const SINC_PHASE *ph;
+   float frac;
+   int p, k;
+
+   if (st->exact)
+      return st->exact + (err / st->exact_div) * SINC_TAPS;
+
+   p = (int)((int64_t)err * SINC_PHASES / st->denom);
+   frac = (float)((int64_t)err * SINC_PHASES - (int64_t)p * st->denom)
+      * st->inv_denom;
+   ph = &st->table[p];
+   for (k = 0; k < SINC_TAPS; k++)
+      w[k] = ph->coef[k] + frac * ph->delta[k];
+   return w;
+}
+
+
+/* Streams keep MAX_LAG sample values from the previous fragment before the
+ * start of the buffer, so the sinc resampler lags them by half its taps.
+ */
+static INLINE int sinc_lag(const ALLEGRO_SAMPLE_INSTANCE *spl)
+{
+   if (spl->loop == _ALLEGRO_PLAYMODE_STREAM_ONCE ||
+         spl->loop == _ALLEGRO_PLAYMODE_STREAM_ONEDIR)
+      return SINC_TAPS / 2;
+   return 0;
+}
+
+
+/* Maps a tap position to the sample value it reads, following the loop
+ * mode.  Returns false if the tap lies outside of the sample.
+ */
+static bool sinc_tap_position(const ALLEGRO_SAMPLE_INSTANCE *spl, int *pos)
+{
+   const int span = spl->loop_end - spl->loop_start;
+   int p = *pos;
+
+   switch (spl->loop) {
+      case ALLEGRO_PLAYMODE_ONCE:
+         return p >= 0 && p < spl->spl_data.len;
+
+      case ALLEGRO_PLAYMODE_LOOP:
+         if (span <= 0)
+            return false;
+         if (p >= spl->loop_end)
+            p -= span * ((p - spl->loop_start) / span);
+         else if (p < 0)
+            p += span * ((spl->loop_end - 1 - p) / span);
+         break;
+
+      case ALLEGRO_PLAYMODE_BIDIR:
+         if (span <= 0)
+            return false;
+         if (p >= spl->loop_end)
+            p = 2 * spl->loop_end - 1 - p;
+         else if (p < 0)
+            p = 2 * spl->loop_start - 1 - p;
+         if (p < spl->loop_start)
+            p = spl->loop_start;
+         else if (p >= spl->loop_end)
+            p = spl->loop_end - 1;
+         break;
+
+      case _ALLEGRO_PLAYMODE_STREAM_ONCE:
+      case _ALLEGRO_PLAYMODE_STREAM_ONEDIR:
+         break;
+   }
+
+   *pos = p;
+   return true;
+}
+
+
+static INLINE float get_sample_value(const ALLEGRO_SAMPLE_INSTANCE *spl,
+   int i)
+{
+   switch (spl->spl_data.depth) {
+      case ALLEGRO_AUDIO_DEPTH_FLOAT32:
+         return spl->spl_data.buffer.f32[i];
+      case ALLEGRO_AUDIO_DEPTH_INT24:
+         return (float) spl->spl_data.buffer.s24[i] / ((float) 0x7FFFFF + 0.5f);
+      case ALLEGRO_AUDIO_DEPTH_UINT24:
+         return (float) spl->spl_data.buffer.u24[i] / ((float) 0x7FFFFF + 0.5f) - 1.0f;
+      case ALLEGRO_AUDIO_DEPTH_INT16:
+         return (float) spl->spl_data.buffer.s16[i] / ((float) 0x7FFF + 0.5f);
+      case ALLEGRO_AUDIO_DEPTH_UINT16:
+         return (float) spl->spl_data.buffer.u16[i] / ((float) 0x7FFF + 0.5f) - 1.0f;
+      case ALLEGRO_AUDIO_DEPTH_INT8:
+         return (float) spl->spl_data.buffer.s8[i] / ((float) 0x7F + 0.5f);
+      case ALLEGRO_AUDIO_DEPTH_UINT8:
+         return (float) spl->spl_data.buffer.u8[i] / ((float) 0x7F + 0.5f) - 1.0f;
+   }
+   return 0.0f;
+}
+
+
+/* Computes one sample value, checking every tap against the loop points. */
+static void sinc_spl32(const ALLEGRO_SAMPLE_INSTANCE *spl, const float *w,
+   size_t maxc, float *s)
+{
+   const int first = spl->pos - sinc_lag(spl) - (SINC_TAPS / 2 - 1);
+   size_t c;
+   int k;
+
+   for (c = 0; c < maxc; c++)
+      s[c] = 0.0f;
+
+   for (k = 0; k < SINC_TAPS; k++) {
+      int p = first + k;
+      if (!sinc_tap_position(spl, &p))
+         continue;
+      for (c = 0; c < maxc; c++)
+         s[c] += w[k] * get_sample_value(spl, p * maxc + c);
+   }
+}
+
+
+/* Returns how many of the next output samples, at most max, can be computed
+ * without checking the taps against the ends of the sample or loop.
+ */
+static unsigned int sinc_run_length(const ALLEGRO_SAMPLE_INSTANCE *spl,
+   unsigned int max)
+{
+   const int lag = sinc_lag(spl);
+   int lo, hi;
+   int64_t n;
+
+   if (spl->step <= 0)
+      return 0;
+
+   switch (spl->loop) {
+      case ALLEGRO_PLAYMODE_ONCE:
+         lo = 0;
+         hi = spl->spl_data.len;
+         break;
+      case ALLEGRO_PLAYMODE_LOOP:
+      case ALLEGRO_PLAYMODE_BIDIR:
+         lo = spl->loop_start;
+         hi = spl->loop_end;
+         break;
+      default:
+         /* The lag keeps every tap inside the buffer and its history. */
+         lo = -(SINC_TAPS - 1);
+         hi = spl->spl_data.len;
+         break;
+   }
+
+   /* The first tap of the first sample and the last tap of the last sample
+    * must be inside [lo, hi), and the position must stay below hi.
+    */
+   if (spl->pos - lag - (SINC_TAPS / 2 - 1) < lo)
+      return 0;
+   hi = _ALLEGRO_MIN(hi, hi + lag - SINC_TAPS / 2);
+   if (spl->pos >= hi)
+      return 0;
+
+   n = ((int64_t)(hi - spl->pos) * spl->step_denom - spl->pos_bresenham_error
+      + spl->step - 1) / spl->step;
+   return (unsigned int)_ALLEGRO_MIN(n, (int64_t)max);
+}
+
+
+static INLINE float *mix_sample_values(float *buf, const float *s,
+   const float *matrix, size_t maxc, size_t dest_maxc)
+{
+   size_t c, i;
+
+   if (maxc == 2 && dest_maxc == 2) {
+      buf[0] += s[0] * matrix[0] + s[1] * matrix[1];
+      buf[1] += s[0] * matrix[2] + s[1] * matrix[3];
+      return buf + 2;
+   }
+
+   for (c = 0; c < dest_maxc; c++) {
+      float v = *buf;
+      for (i = 0; i < maxc; i++)
+         v += s[i] * matrix[c * maxc + i];
+      *buf++ = v;
+   }
+   return buf;
+}
+
+
+#define SINC_ADVANCE                                                          \
+   do {                                                                       \
+      spl->pos += delta;                                                      \
+      spl->pos_bresenham_error += delta_error;                                \
+      if (spl->pos_bresenham_error >= spl->step_denom) {                      \
+         spl->pos++;                                                          \
+         spl->pos_bresenham_error -= spl->step_denom;                         \
+      }                                                                       \
+   } while (0)
+
+/* Computes a run of sample values from sample data of type TYPE.  The taps
+ * sum to one, so the conversion to float, SCALE(x) - OFFSET, can be applied
+ * to the dot product instead of to every tap.  Mono and stereo data get
+ * loops of their own.
+ */
+#define SINC_RUN(TYPE, FIELD, SCALE, OFFSET)                                  \
+   do {                                                                       \
+      const TYPE *data = spl->spl_data.buffer.FIELD;                          \
+      const int first = sinc_lag(spl) + SINC_TAPS / 2 - 1;                    \
+      for (; n > 0; n--) {                                                    \
+         const TYPE *src = data + (spl->pos - first) * (int)maxc;             \
+         const float *w = sinc_weights(&st, spl->pos_bresenham_error, wbuf);  \
+         if (maxc == 1) {                                                     \
+            float x = 0.0f;                                                   \
+            for (k = 0; k < SINC_TAPS; k++)                                   \
+               x += w[k] * src[k];                                            \
+            s[0] = x;                                                         \
+         }                                                                    \
+         else if (maxc == 2) {                                                \
+            float l = 0.0f;                                                   \
+            float r = 0.0f;                                                   \
+            for (k = 0; k < SINC_TAPS; k++) {                                 \
+               l += w[k] * src[2 * k];                                        \
+               r += w[k] * src[2 * k + 1];                                    \
+            }                                                                 \
+            s[0] = l;                                                         \
+            s[1] = r;                                                         \
+         }                                                                    \
+         else {                                                               \
+            for (c = 0; c < maxc; c++)                                        \
+               s[c] = 0.0f;                                                   \
+            for (k = 0; k < SINC_TAPS; k++) {                                 \
+               for (c = 0; c < maxc; c++)                                     \
+                  s[c] += w[k] * src[c];                                      \
+               src += maxc;                                                   \
+            }                                                                 \
+         }                                                                    \
+         for (c = 0; c < maxc; c++)                                           \
+            s[c] = s[c] * (SCALE) - (OFFSET);                                 \
+         buf = mix_sample_values(buf, s, spl->matrix, maxc, dest_maxc);       \
+         if (spl->ramp_samples > 0)                                           \
+            ramp_sample_matrix(spl, maxc * dest_maxc);                        \
+         SINC_ADVANCE;                                                        \
+      }                                                                       \
+   } while (0)
+
+
+/* Implements stream_reader_t for ALLEGRO_MIXER_QUALITY_SINC, like the
+ * MAKE_MIXER readers above but producing as many samples as possible at a
+ * time.
+ */
+static void read_to_mixer_sinc_float_32(void *source, void **vbuf,
+   unsigned int *samples, ALLEGRO_AUDIO_DEPTH buffer_depth, size_t dest_maxc)
+{
+   ALLEGRO_SAMPLE_INSTANCE *spl = (ALLEGRO_SAMPLE_INSTANCE *)source;
+   float *buf = *vbuf;
+   size_t maxc = al_get_channel_count(spl->spl_data.chan_conf);
+   unsigned int samples_l = *samples;
+   int delta, delta_error;
+   float s[ALLEGRO_MAX_CHANNELS];
+   float wbuf[SINC_TAPS];
+   SINC_STATE st;
+   size_t c;
+   int k;
+
+   BRESENHAM;
+
+   if (!spl->is_playing)
+      return;
+
+   init_sinc_state(&st, spl);
+
+   while (samples_l > 0) {
+      int old_step = spl->step;
+      unsigned int n;
+
+      if (!fix_looped_position(spl))
+         return;
+      if (old_step != spl->step) {
+         BRESENHAM;
+      }
+
+      n = sinc_run_length(spl, samples_l);
+      if (n > 0) {
+         samples_l -= n;
+         switch (spl->spl_data.depth) {
+            case ALLEGRO_AUDIO_DEPTH_FLOAT32:
+               SINC_RUN(float, f32, 1.0f, 0.0f);
+               break;
+            case ALLEGRO_AUDIO_DEPTH_INT24:
+               SINC_RUN(int32_t, s24, 1.0f / ((float) 0x7FFFFF + 0.5f), 0.0f);
+               break;
+            case ALLEGRO_AUDIO_DEPTH_UINT24:
+               SINC_RUN(uint32_t, u24, 1.0f / ((float) 0x7FFFFF + 0.5f), 1.0f);
+               break;
+            case ALLEGRO_AUDIO_DEPTH_INT16:
+               SINC_RUN(int16_t, s16, 1.0f / ((float) 0x7FFF + 0.5f), 0.0f);
+               break;
+            case ALLEGRO_AUDIO_DEPTH_UINT16:
+               SINC_RUN(uint16_t, u16, 1.0f / ((float) 0x7FFF + 0.5f), 1.0f);
+               break;
+            case ALLEGRO_AUDIO_DEPTH_INT8:
+               SINC_RUN(int8_t, s8, 1.0f / ((float) 0x7F + 0.5f), 0.0f);
+               break;
+            case ALLEGRO_AUDIO_DEPTH_UINT8:
+               SINC_RUN(uint8_t, u8, 1.0f / ((float) 0x7F + 0.5f), 1.0f);
+               break;
+         }
+         continue;
+      }
+
+      sinc_spl32(spl, sinc_weights(&st, spl->pos_bresenham_error, wbuf),
+         maxc, s);
+      buf = mix_sample_values(buf, s, spl->matrix, maxc, dest_maxc);
+      if (spl->ramp_samples > 0)
+         ramp_sample_matrix(spl, maxc * dest_maxc);
+      SINC_ADVANCE;
+      samples_l--;
+   }
+   fix_looped_position(spl);
+   (void)buffer_depth;
+}
+
+#undef SINC_RUN
+#undef SINC_ADVANCE
+
+
+/* Mix an instance with scheduled changes pending, splitting the buffer so
+ * that each change due within it is made at the exact sample.
+ */
+static void read_scheduled(ALLEGRO_MIXER *m, ALLEGRO_SAMPLE_INSTANCE *spl,
+   unsigned int samples, size_t maxc)
+{
+   const size_t frame_size = maxc *
+      al_get_audio_depth_size(m->ss.spl_data.depth);
+   char *buf = m->ss.spl_data.buffer.ptr;
+   unsigned int done = 0;
+   unsigned int at;
+   void *p;
+
+   while (_al_vector_is_nonempty(&spl->scheduled)) {
+      _AL_KCM_SCHEDULED_EVENT *event = _al_vector_ref_front(&spl->scheduled);
+
+      if (event->time >= m->sample_time + samples)
+         break;
+      at = 0;
+      if (event->time > m->sample_time)
+         at = event->time - m->sample_time;
+
+      if (at > done) {
+         unsigned int n = at - done;
+         p = buf + done * frame_size;
+         spl->spl_read(spl, &p, &n, m->ss.spl_data.depth, maxc);
+         done = at;
+      }
+
+      _al_kcm_apply_scheduled_event(spl, event);
+      _al_vector_delete_at(&spl->scheduled, 0);
+   }
+
+   if (done < samples) {
+      unsigned int n = samples - done;
+      p = buf + done * frame_size;
+      spl->spl_read(spl, &p, &n, m->ss.spl_data.depth, maxc);
+   }
+}
+
+
+/* Scale the mixer buffer by a gain moving linearly from `from' to `to'. */
+static void ramp_mixer_gain(ALLEGRO_MIXER *m, float from, float to,
+   unsigned int samples, int maxc)
+{
+   const float step = (to - from) / samples;
+   float g = from;
+   int c;
+
+   switch (m->ss.spl_data.depth) {
+      case ALLEGRO_AUDIO_DEPTH_FLOAT32: {
+         float *p = m->ss.spl_data.buffer.f32;
+         while (samples-- > 0) {
+            g += step;
+            for (c = 0; c < maxc; c++) {
+               *p++ *= g;
+            }
+         }
+         break;
+      }
+
+      case ALLEGRO_AUDIO_DEPTH_INT16: {
+         int16_t *p = m->ss.spl_data.buffer.s16;
+         while (samples-- > 0) {
+            g += step;
+            for (c = 0; c < maxc; c++) {
+               *p++ *= g;
+            }
+         }
+         break;
+      }
+
+      case ALLEGRO_AUDIO_DEPTH_INT8:
+      case ALLEGRO_AUDIO_DEPTH_INT24:
+      case ALLEGRO_AUDIO_DEPTH_UINT8:
+      case ALLEGRO_AUDIO_DEPTH_UINT16:
+      case ALLEGRO_AUDIO_DEPTH_UINT24:
+         /* Unsupported mixer depths. */
+         ASSERT(false);
+         break;
+   }
+}
+
+
+static void mixer_read(void *source, void **buf, unsigned int *samples,
    ALLEGRO_AUDIO_DEPTH buffer_depth, size_t dest_maxc)
 {
    const ALLEGRO_MIXER *mixer;
    ALLEGRO_MIXER *m = (ALLEGRO_MIXER *)source;
    int maxc = al_get_channel_count(m->ss.spl_data.chan_conf);
    int samples_l = *samples;
+   float mixer_gain;
    int i;
 
    if (!m->ss.is_playing)
@@ -385,9 +1030,17 @@ void _al_kcm_mixer_read(void *source, void **buf, unsigned int *samples,
       ALLEGRO_SAMPLE_INSTANCE **slot = _al_vector_ref(&mixer->streams, i);
       ALLEGRO_SAMPLE_INSTANCE *spl = *slot;
       ASSERT(spl->spl_read);
+      if (spl->posted) {
+         _al_kcm_apply_posted_changes(spl, *samples);
+      }
+      if (_al_vector_is_nonempty(&spl->scheduled)) {
+         read_scheduled(m, spl, *samples, maxc);
+         continue;
+      }
       spl->spl_read(spl, (void **) &mixer->ss.spl_data.buffer.ptr, samples,
          m->ss.spl_data.depth, maxc);
    }
+   m->sample_time += samples_l;
 
    /* Call the post-processing callback. */
    if (mixer->postprocess_callback) {
@@ -395,12 +1048,16 @@ void _al_kcm_mixer_read(void *source, void **buf, unsigned int *samples,
          *samples, mixer->pp_callback_userdata);
    }
 
-   samples_l *= maxc;
-
-   /* Apply the gain if necessary. */
-   if (mixer->ss.gain != 1.0f) {
-      float mixer_gain = mixer->ss.gain;
-      unsigned long i = samples_l;
+   /* Apply the gain if necessary.  A change since the last buffer is ramped
+    * over this one.
+    */
+   mixer_gain = mixer->ss.gain;
+   if (mixer_gain != mixer->current_gain) {
+      ramp_mixer_gain(m, mixer->current_gain, mixer_gain, samples_l, maxc);
+      m->current_gain = mixer_gain;
+   }
+   else if (mixer_gain != 1.0f) {
+      unsigned long i = samples_l * maxc;
 
       switch (m->ss.spl_data.depth) {
          case ALLEGRO_AUDIO_DEPTH_FLOAT32: {
@@ -430,6 +1087,8 @@ void _al_kcm_mixer_read(void *source, void **buf, unsigned int *samples,
       }
    }
 
+   samples_l *= maxc;
+
    /* Feeding to a non-voice.
     * Currently we only support mixers of the same audio depth doing this.
     */
@@ -604,6 +1263,24 @@ void _al_kcm_mixer_read(void *source, void **buf, unsigned int *samples,
 }
 
 
+_AL_PROFILE_ZONE(mixer_read_zone, "audio/mixer_read");
+
+/* _al_kcm_mixer_read:
+ *  Mixes the streams attached to the mixer and writes additively to the
+ *  specified buffer (or if *buf is NULL, indicating a voice, convert it and
+ *  set it to the buffer pointer).
+ */
+void _al_kcm_mixer_read(void *source, void **buf, unsigned int *samples,
+   ALLEGRO_AUDIO_DEPTH buffer_depth, size_t dest_maxc)
+{
+   _AL_PROFILE_DECL(mixer_read_zone);
+
+   _AL_PROFILE_BEGIN(mixer_read_zone);
+   mixer_read(source, buf, samples, buffer_depth, dest_maxc);
+   _AL_PROFILE_END(mixer_read_zone);
+}
+
+
 /* Function: al_create_mixer
  */
 ALLEGRO_MIXER *al_create_mixer(unsigned int freq,
@@ -629,6 +1306,10 @@ ALLEGRO_MIXER *al_create_mixer(unsigned int freq,
          ALLEGRO_INFO("Cubic interpolation\n");
          default_mixer_quality = ALLEGRO_MIXER_QUALITY_CUBIC;
       }
+      else if (!_al_stricmp(p, "sinc")) {
+         ALLEGRO_INFO("Windowed sinc interpolation\n");
+         default_mixer_quality = ALLEGRO_MIXER_QUALITY_SINC;
+      }
    }
 
    if (!freq) {
@@ -656,6 +1337,7 @@ ALLEGRO_MIXER *al_create_mixer(unsigned int freq,
    mixer->ss.loop = ALLEGRO_PLAYMODE_ONCE;
    /* XXX should we have a specific loop mode? */
    mixer->ss.gain = 1.0f;
+   mixer->current_gain = 1.0f;
    mixer->ss.spl_data.depth     = depth;
    mixer->ss.spl_data.chan_conf = chan_conf;
    mixer->ss.spl_data.frequency = freq;
@@ -666,6 +1348,7 @@ ALLEGRO_MIXER *al_create_mixer(unsigned int freq,
    mixer->quality = default_mixer_quality;
 
    _al_vector_init(&mixer->streams, sizeof(ALLEGRO_SAMPLE_INSTANCE *));
+   _al_vector_init(&mixer->ss.scheduled, sizeof(_AL_KCM_SCHEDULED_EVENT));
 
    _al_kcm_register_destructor(mixer, (void (*)(void *)) al_destroy_mixer);
 
@@ -745,6 +1428,10 @@ bool al_attach_sample_instance_to_mixer(ALLEGRO_SAMPLE_INSTANCE *spl,
                case ALLEGRO_MIXER_QUALITY_CUBIC:
                   spl->spl_read = read_to_mixer_cubic_float_32;
                   break;
+               case ALLEGRO_MIXER_QUALITY_SINC:
+                  init_sinc_tables();
+                  spl->spl_read = read_to_mixer_sinc_float_32;
+                  break;
             }
             break;
 
@@ -754,6 +1441,7 @@ bool al_attach_sample_instance_to_mixer(ALLEGRO_SAMPLE_INSTANCE *spl,
                   spl->spl_read = read_to_mixer_point_int16_t_16;
                   break;
                case ALLEGRO_MIXER_QUALITY_CUBIC:
+               case ALLEGRO_MIXER_QUALITY_SINC:
                   ALLEGRO_WARN("Falling back to linear interpolation\n");
                   /* fallthrough */
                case ALLEGRO_MIXER_QUALITY_LINEAR:
@@ -848,6 +1536,21 @@ unsigned int al_get_mixer_frequency(const ALLEGRO_MIXER *mixer)
 }
 
 
+/* Function: al_get_mixer_sample_time
+ */
+uint64_t al_get_mixer_sample_time(const ALLEGRO_MIXER *mixer)
+{
+   uint64_t time;
+   ASSERT(mixer);
+
+   maybe_lock_mutex(mixer->ss.mutex);
+   time = mixer->sample_time;
+   maybe_unlock_mutex(mixer->ss.mutex);
+
+   return time;
+}
+
+
 /* Function: al_get_mixer_channels
  */
 ALLEGRO_CHANNEL_CONF al_get_mixer_channels(const ALLEGRO_MIXER *mixer)
@@ -960,22 +1663,17 @@ bool al_set_mixer_quality(ALLEGRO_MIXER *mixer, ALLEGRO_MIXER_QUALITY new_qualit
  */
 bool al_set_mixer_gain(ALLEGRO_MIXER *mixer, float new_gain)
 {
-   int i;
    ASSERT(mixer);
 
-   maybe_lock_mutex(mixer->ss.mutex);
-
-   if (mixer->ss.gain != new_gain) {
-      mixer->ss.gain = new_gain;
-
-      for (i = _al_vector_size(&mixer->streams) - 1; i >= 0; i--) {
-         ALLEGRO_SAMPLE_INSTANCE **slot = _al_vector_ref(&mixer->streams, i);
-         _al_kcm_mixer_rejig_sample_matrix(mixer, *slot);
-      }
+   /* The mixer gain is applied to the mixed buffer, not folded into the
+    * sample matrices, so the mixer can pick it up by itself and ramp to it
+    * over its next buffer.
+    */
+   mixer->ss.gain = new_gain;
+   if (!mixer->ss.mutex) {
+      mixer->current_gain = new_gain;
    }
 
-   maybe_unlock_mutex(mixer->ss.mutex);
-
    return true;
 }
 
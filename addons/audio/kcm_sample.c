@@ -18,6 +18,8 @@
 /* Title: Sample audio interface
  */
 
+#include <string.h>
+
 #include "allegro5/allegro.h"
 #include "allegro5/allegro_audio.h"
 #include "allegro5/internal/aintern.h"
@@ -31,14 +33,32 @@ static ALLEGRO_VOICE *allegro_voice = NULL;
 static ALLEGRO_MIXER *allegro_mixer = NULL;
 static ALLEGRO_MIXER *default_mixer = NULL;
 
+/* Bookkeeping for each of the instances in auto_samples. */
+typedef struct AUTO_SAMPLE {
+   int id;              /* Id of the last sound played, 0 if none. */
+   bool busy;           /* Not in the free list. */
+   int next_free;       /* Next slot in the free list, or -1. */
+   int batch;           /* The al_play_samples call that last used it. */
+   float priority;
+   float distance;
+} AUTO_SAMPLE;
+
 static _AL_VECTOR auto_samples = _AL_VECTOR_INITIALIZER(ALLEGRO_SAMPLE_INSTANCE *);
-static _AL_VECTOR auto_sample_ids = _AL_VECTOR_INITIALIZER(int);
+static _AL_VECTOR auto_sample_slots = _AL_VECTOR_INITIALIZER(AUTO_SAMPLE);
+static int free_slots = -1;
+static int current_batch = 0;
+
+static ALLEGRO_SAMPLE_STEAL_POLICY steal_policy = ALLEGRO_SAMPLE_STEAL_NONE;
+static int num_played = 0;
+static int num_stolen = 0;
+static int num_dropped = 0;
 
 
 static bool create_default_mixer(void);
 static bool do_play_sample(ALLEGRO_SAMPLE_INSTANCE *spl, ALLEGRO_SAMPLE *data,
       float gain, float pan, float speed, ALLEGRO_PLAYMODE loop);
 static void free_sample_vector(void);
+static void reset_free_slots(void);
 
 
 static int string_to_depth(const char *s)
@@ -218,8 +238,8 @@ bool al_reserve_samples(int reserve_samples)
       /* We need to reserve more samples than currently are reserved. */
       for (i = 0; i < reserve_samples - current_samples_count; i++) {
          ALLEGRO_SAMPLE_INSTANCE **slot = _al_vector_alloc_back(&auto_samples);
-         int *id = _al_vector_alloc_back(&auto_sample_ids);
-         *id = 0;
+         AUTO_SAMPLE *info = _al_vector_alloc_back(&auto_sample_slots);
+         memset(info, 0, sizeof(*info));
          *slot = al_create_sample_instance(NULL);
          if (!*slot) {
             ALLEGRO_ERROR("al_create_sample failed\n");
@@ -235,10 +255,11 @@ bool al_reserve_samples(int reserve_samples)
       /* We need to reserve fewer samples than currently are reserved. */
       while (current_samples_count-- > reserve_samples) {
          _al_vector_delete_at(&auto_samples, current_samples_count);
-         _al_vector_delete_at(&auto_sample_ids, current_samples_count);
+         _al_vector_delete_at(&auto_sample_slots, current_samples_count);
       }
    }
 
+   reset_free_slots();
    return true;
 
  Error:
@@ -271,9 +292,9 @@ bool al_set_default_mixer(ALLEGRO_MIXER *mixer)
        * attach them to the new mixer */
       for (i = 0; i < (int) _al_vector_size(&auto_samples); i++) {
          ALLEGRO_SAMPLE_INSTANCE **slot = _al_vector_ref(&auto_samples, i);
-         int *id = _al_vector_ref(&auto_sample_ids, i);
+         AUTO_SAMPLE *info = _al_vector_ref(&auto_sample_slots, i);
 
-         *id = 0;
+         memset(info, 0, sizeof(*info));
          al_destroy_sample_instance(*slot);
 
          *slot = al_create_sample_instance(NULL);
@@ -286,6 +307,7 @@ bool al_set_default_mixer(ALLEGRO_MIXER *mixer)
             goto Error;
          }
       }      
+      reset_free_slots();
    }
 
    return true;
@@ -330,41 +352,240 @@ void al_set_default_voice(ALLEGRO_VOICE *voice)
 }
 
 
+/* Put every slot which isn't busy in the free list, lowest index first. */
+static void reset_free_slots(void)
+{
+   int i;
+
+   free_slots = -1;
+   for (i = (int) _al_vector_size(&auto_sample_slots) - 1; i >= 0; i--) {
+      AUTO_SAMPLE *info = _al_vector_ref(&auto_sample_slots, i);
+      if (!info->busy) {
+         info->next_free = free_slots;
+         free_slots = i;
+      }
+   }
+}
+
+
+/* Return slots whose sound has finished, or was stopped, to the free list.
+ * Only needed once the free list runs dry.
+ */
+static void reclaim_slots(void)
+{
+   int i;
+
+   for (i = (int) _al_vector_size(&auto_sample_slots) - 1; i >= 0; i--) {
+      AUTO_SAMPLE *info = _al_vector_ref(&auto_sample_slots, i);
+      ALLEGRO_SAMPLE_INSTANCE **slot = _al_vector_ref(&auto_samples, i);
+
+      if (info->busy && !al_get_sample_instance_playing(*slot)) {
+         info->busy = false;
+         info->next_free = free_slots;
+         free_slots = i;
+      }
+   }
+}
+
+
+/* Whether the sound in slot a should be stolen before the one in slot b,
+ * under the current policy.  Ties go to the older sound.
+ */
+static bool is_better_victim(const AUTO_SAMPLE *a, const AUTO_SAMPLE *b)
+{
+   switch (steal_policy) {
+      case ALLEGRO_SAMPLE_STEAL_LOWEST_PRIORITY:
+         if (a->priority != b->priority)
+            return a->priority < b->priority;
+         break;
+      case ALLEGRO_SAMPLE_STEAL_FARTHEST:
+         if (a->distance != b->distance)
+            return a->distance > b->distance;
+         break;
+      default:
+         break;
+   }
+   return a->id < b->id;
+}
+
+
+/* Pick a playing sound to make way for a new one, or -1 if none may be
+ * stolen.  Sounds started by the current al_play_samples call are safe.
+ */
+static int find_victim(const ALLEGRO_SAMPLE_TRIGGER *trigger)
+{
+   AUTO_SAMPLE *victim = NULL;
+   int victim_index = -1;
+   int i;
+
+   if (steal_policy == ALLEGRO_SAMPLE_STEAL_NONE)
+      return -1;
+
+   for (i = 0; i < (int) _al_vector_size(&auto_sample_slots); i++) {
+      AUTO_SAMPLE *info = _al_vector_ref(&auto_sample_slots, i);
+      if (!info->busy || info->batch == current_batch)
+         continue;
+      if (!victim || is_better_victim(info, victim)) {
+         victim = info;
+         victim_index = i;
+      }
+   }
+
+   if (!victim)
+      return -1;
+   if (steal_policy == ALLEGRO_SAMPLE_STEAL_LOWEST_PRIORITY &&
+         victim->priority > trigger->priority)
+      return -1;
+   if (steal_policy == ALLEGRO_SAMPLE_STEAL_FARTHEST &&
+         victim->distance < trigger->distance)
+      return -1;
+   return victim_index;
+}
+
+
+/* Claim a slot for the trigger, taking it from the free list, or failing
+ * that from the sound chosen by the steal policy.  Returns -1 if the sound
+ * has to be dropped.
+ */
+static int claim_slot(const ALLEGRO_SAMPLE_TRIGGER *trigger)
+{
+   AUTO_SAMPLE *info;
+   int i;
+
+   if (free_slots < 0)
+      reclaim_slots();
+
+   if (free_slots >= 0) {
+      i = free_slots;
+      info = _al_vector_ref(&auto_sample_slots, i);
+      free_slots = info->next_free;
+   }
+   else {
+      i = find_victim(trigger);
+      if (i < 0) {
+         num_dropped++;
+         return -1;
+      }
+      info = _al_vector_ref(&auto_sample_slots, i);
+      num_stolen++;
+   }
+
+   info->busy = true;
+   info->batch = current_batch;
+   info->priority = trigger->priority;
+   info->distance = trigger->distance;
+   return i;
+}
+
+
 /* Function: al_play_sample
  */
 bool al_play_sample(ALLEGRO_SAMPLE *spl, float gain, float pan, float speed,
    ALLEGRO_PLAYMODE loop, ALLEGRO_SAMPLE_ID *ret_id)
 {
-   static int next_id = 0;
-   unsigned int i;
+   ALLEGRO_SAMPLE_TRIGGER trigger;
    
    ASSERT(spl);
 
+   trigger.sample = spl;
+   trigger.gain = gain;
+   trigger.pan = pan;
+   trigger.speed = speed;
+   trigger.loop = loop;
+   trigger.priority = 0.0f;
+   trigger.distance = 0.0f;
+
+   if (al_play_samples(&trigger, 1) == 1) {
+      if (ret_id != NULL)
+         *ret_id = trigger.id;
+      return true;
+   }
+
    if (ret_id != NULL) {
       ret_id->_id = -1;
       ret_id->_index = 0;
    }
+   return false;
+}
 
-   for (i = 0; i < _al_vector_size(&auto_samples); i++) {
-      ALLEGRO_SAMPLE_INSTANCE **slot = _al_vector_ref(&auto_samples, i);
-      ALLEGRO_SAMPLE_INSTANCE *splinst = (*slot);
 
-      if (!al_get_sample_instance_playing(splinst)) {
-         int *id = _al_vector_ref(&auto_sample_ids, i);
+/* Function: al_play_samples
+ */
+int al_play_samples(ALLEGRO_SAMPLE_TRIGGER *triggers, int count)
+{
+   static int next_id = 0;
+   ALLEGRO_MUTEX *mutex;
+   int *slots;
+   int played = 0;
+   int i;
 
-         if (!do_play_sample(splinst, spl, gain, pan, speed, loop))
-            break;
+   ASSERT(triggers || count == 0);
 
-         if (ret_id != NULL) {
-            ret_id->_index = (int) i;
-            ret_id->_id = *id = ++next_id;
-         }
+   if (count <= 0 || !default_mixer)
+      return 0;
+
+   slots = al_malloc(count * sizeof(int));
+   if (!slots)
+      return 0;
+
+   current_batch++;
+   for (i = 0; i < count; i++) {
+      ASSERT(triggers[i].sample);
+      triggers[i].id._id = -1;
+      triggers[i].id._index = 0;
+      slots[i] = claim_slot(&triggers[i]);
+   }
 
-         return true;
+   /* Start everything that can be under a single lock of the mixer. */
+   mutex = default_mixer->ss.mutex;
+   if (mutex)
+      al_lock_mutex(mutex);
+   for (i = 0; i < count; i++) {
+      ALLEGRO_SAMPLE_INSTANCE **slot;
+      ALLEGRO_SAMPLE_TRIGGER *t = &triggers[i];
+
+      if (slots[i] < 0)
+         continue;
+      slot = _al_vector_ref(&auto_samples, slots[i]);
+      if (_al_kcm_trigger_sample_instance(*slot, t->sample, t->gain, t->pan,
+            t->speed, t->loop)) {
+         AUTO_SAMPLE *info = _al_vector_ref(&auto_sample_slots, slots[i]);
+         t->id._index = slots[i];
+         t->id._id = info->id = ++next_id;
+         slots[i] = -1;
+         played++;
       }
    }
+   if (mutex)
+      al_unlock_mutex(mutex);
 
-   return false;
+   /* The rest need reattaching for a different sample format, which takes
+    * the lock itself.
+    */
+   for (i = 0; i < count; i++) {
+      ALLEGRO_SAMPLE_INSTANCE **slot;
+      AUTO_SAMPLE *info;
+      ALLEGRO_SAMPLE_TRIGGER *t = &triggers[i];
+
+      if (slots[i] < 0)
+         continue;
+      slot = _al_vector_ref(&auto_samples, slots[i]);
+      info = _al_vector_ref(&auto_sample_slots, slots[i]);
+      if (!do_play_sample(*slot, t->sample, t->gain, t->pan, t->speed,
+            t->loop)) {
+         /* Let the next reclaim_slots pick it up. */
+         al_stop_sample_instance(*slot);
+         num_dropped++;
+         continue;
+      }
+      t->id._index = slots[i];
+      t->id._id = info->id = ++next_id;
+      played++;
+   }
+
+   num_played += played;
+   al_free(slots);
+   return played;
 }
 
 
@@ -396,14 +617,14 @@ static bool do_play_sample(ALLEGRO_SAMPLE_INSTANCE *splinst,
  */
 void al_stop_sample(ALLEGRO_SAMPLE_ID *spl_id)
 {
-   int *id;
+   AUTO_SAMPLE *info;
 
    ASSERT(spl_id->_id != -1);
    ASSERT(spl_id->_index < (int) _al_vector_size(&auto_samples));
-   ASSERT(spl_id->_index < (int) _al_vector_size(&auto_sample_ids));
+   ASSERT(spl_id->_index < (int) _al_vector_size(&auto_sample_slots));
 
-   id = _al_vector_ref(&auto_sample_ids, spl_id->_index);
-   if (*id == spl_id->_id) {
+   info = _al_vector_ref(&auto_sample_slots, spl_id->_index);
+   if (info->id == spl_id->_id) {
       ALLEGRO_SAMPLE_INSTANCE **slot, *spl;
       slot = _al_vector_ref(&auto_samples, spl_id->_index);
       spl = (*slot);
@@ -426,6 +647,38 @@ void al_stop_samples(void)
 }
 
 
+/* Function: al_set_sample_steal_policy
+ */
+void al_set_sample_steal_policy(ALLEGRO_SAMPLE_STEAL_POLICY policy)
+{
+   ASSERT(policy >= ALLEGRO_SAMPLE_STEAL_NONE);
+   ASSERT(policy <= ALLEGRO_SAMPLE_STEAL_FARTHEST);
+
+   steal_policy = policy;
+}
+
+
+/* Function: al_get_sample_steal_policy
+ */
+ALLEGRO_SAMPLE_STEAL_POLICY al_get_sample_steal_policy(void)
+{
+   return steal_policy;
+}
+
+
+/* Function: al_get_reserved_sample_counters
+ */
+void al_get_reserved_sample_counters(int *played, int *stolen, int *dropped)
+{
+   if (played)
+      *played = num_played;
+   if (stolen)
+      *stolen = num_stolen;
+   if (dropped)
+      *dropped = num_dropped;
+}
+
+
 /* Function: al_get_sample_frequency
  */
 unsigned int al_get_sample_frequency(const ALLEGRO_SAMPLE *spl)
@@ -486,7 +739,8 @@ static void free_sample_vector(void)
       al_destroy_sample_instance(*slot);
    }
    _al_vector_free(&auto_samples);
-   _al_vector_free(&auto_sample_ids);
+   _al_vector_free(&auto_sample_slots);
+   free_slots = -1;
 }
 
 
@@ -17,11 +17,11 @@
 ALLEGRO_DEBUG_CHANNEL("audio")
 
 /*
- * The highest quality interpolator is a cubic interpolator requiring
- * four sample points.  In the streaming case we lag the true sample
- * position by three.
+ * The highest quality interpolator is the windowed sinc resampler, which
+ * reads eight sample points.  In the streaming case we lag the true sample
+ * position by up to seven.
  */
-#define MAX_LAG   (3)
+#define MAX_LAG   (7)
 
 
 static void maybe_lock_mutex(ALLEGRO_MUTEX *mutex)
@@ -88,6 +88,7 @@ ALLEGRO_AUDIO_STREAM *al_create_audio_stream(size_t fragment_count,
    stream->spl.speed     = 1.0f;
    stream->spl.gain      = 1.0f;
    stream->spl.pan       = 0.0f;
+   _al_vector_init(&stream->spl.scheduled, sizeof(_AL_KCM_SCHEDULED_EVENT));
 
    stream->spl.step = 0;
    stream->spl.pos  = frag_samples;
@@ -372,7 +373,11 @@ bool al_set_audio_stream_speed(ALLEGRO_AUDIO_STREAM *stream, float val)
    if (stream->spl.parent.u.mixer) {
       ALLEGRO_MIXER *mixer = stream->spl.parent.u.mixer;
 
-      maybe_lock_mutex(stream->spl.mutex);
+      /* While the mixer is running it picks up the speed itself. */
+      if (stream->spl.mutex) {
+         _al_fetch_and_or(&stream->spl.posted, _AL_KCM_POSTED_SPEED);
+         return true;
+      }
 
       stream->spl.step = (stream->spl.spl_data.frequency) * stream->spl.speed;
       stream->spl.step_denom = mixer->ss.spl_data.frequency;
@@ -380,8 +385,6 @@ bool al_set_audio_stream_speed(ALLEGRO_AUDIO_STREAM *stream, float val)
       if (stream->spl.step == 0) {
          stream->spl.step = 1;
       }
-
-      maybe_unlock_mutex(stream->spl.mutex);
    }
 
    return true;
@@ -404,14 +407,15 @@ bool al_set_audio_stream_gain(ALLEGRO_AUDIO_STREAM *stream, float val)
       stream->spl.gain = val;
 
       /* If attached to a mixer already, need to recompute the sample
-       * matrix to take into account the gain.
+       * matrix to take into account the gain.  While the mixer is running
+       * it does that itself at the start of the next buffer.
        */
       if (stream->spl.parent.u.mixer) {
-         ALLEGRO_MIXER *mixer = stream->spl.parent.u.mixer;
-
-         maybe_lock_mutex(stream->spl.mutex);
-         _al_kcm_mixer_rejig_sample_matrix(mixer, &stream->spl);
-         maybe_unlock_mutex(stream->spl.mutex);
+         if (stream->spl.mutex)
+            _al_fetch_and_or(&stream->spl.posted, _AL_KCM_POSTED_MATRIX);
+         else
+            _al_kcm_mixer_rejig_sample_matrix(stream->spl.parent.u.mixer,
+               &stream->spl);
       }
    }
 
@@ -439,14 +443,15 @@ bool al_set_audio_stream_pan(ALLEGRO_AUDIO_STREAM *stream, float val)
       stream->spl.pan = val;
 
       /* If attached to a mixer already, need to recompute the sample
-       * matrix to take into account the panning.
+       * matrix to take into account the panning.  While the mixer is running
+       * it does that itself at the start of the next buffer.
        */
       if (stream->spl.parent.u.mixer) {
-         ALLEGRO_MIXER *mixer = stream->spl.parent.u.mixer;
-
-         maybe_lock_mutex(stream->spl.mutex);
-         _al_kcm_mixer_rejig_sample_matrix(mixer, &stream->spl);
-         maybe_unlock_mutex(stream->spl.mutex);
+         if (stream->spl.mutex)
+            _al_fetch_and_or(&stream->spl.posted, _AL_KCM_POSTED_MATRIX);
+         else
+            _al_kcm_mixer_rejig_sample_matrix(stream->spl.parent.u.mixer,
+               &stream->spl);
       }
    }
 
@@ -480,7 +485,12 @@ bool al_set_audio_stream_playmode(ALLEGRO_AUDIO_STREAM *stream,
 }
 
 
-static void reset_stopped_stream(ALLEGRO_AUDIO_STREAM *stream)
+/* _al_kcm_reset_stopped_stream:
+ *  Returns all fragments to the user after the stream has been stopped, so
+ *  that playing it again starts with fresh data.  The caller must hold the
+ *  stream's mutex.
+ */
+void _al_kcm_reset_stopped_stream(ALLEGRO_AUDIO_STREAM *stream)
 {
    const int bytes_per_sample =
       al_get_channel_count(stream->spl.spl_data.chan_conf) *
@@ -551,7 +561,7 @@ bool al_set_audio_stream_playing(ALLEGRO_AUDIO_STREAM *stream, bool val)
       _al_kcm_emit_stream_events(stream);
    }
    else if (!val) {
-      reset_stopped_stream(stream);
+      _al_kcm_reset_stopped_stream(stream);
    }
 
    maybe_unlock_mutex(stream->spl.mutex);
@@ -560,6 +570,65 @@ bool al_set_audio_stream_playing(ALLEGRO_AUDIO_STREAM *stream, bool val)
 }
 
 
+/* Function: al_set_audio_stream_playing_at
+ */
+bool al_set_audio_stream_playing_at(ALLEGRO_AUDIO_STREAM *stream, bool val,
+   uint64_t time)
+{
+   ASSERT(stream);
+
+   return _al_kcm_schedule_event(&stream->spl,
+      val ? _AL_KCM_SCHEDULE_PLAY : _AL_KCM_SCHEDULE_STOP, 0.0f, time);
+}
+
+
+/* Function: al_set_audio_stream_gain_at
+ */
+bool al_set_audio_stream_gain_at(ALLEGRO_AUDIO_STREAM *stream, float val,
+   uint64_t time)
+{
+   ASSERT(stream);
+
+   return _al_kcm_schedule_event(&stream->spl, _AL_KCM_SCHEDULE_GAIN, val,
+      time);
+}
+
+
+/* Function: al_set_audio_stream_pan_at
+ */
+bool al_set_audio_stream_pan_at(ALLEGRO_AUDIO_STREAM *stream, float val,
+   uint64_t time)
+{
+   ASSERT(stream);
+
+   if (val != ALLEGRO_AUDIO_PAN_NONE && (val < -1.0 || val > 1.0)) {
+      _al_set_error(ALLEGRO_GENERIC_ERROR, "Invalid pan value");
+      return false;
+   }
+
+   return _al_kcm_schedule_event(&stream->spl, _AL_KCM_SCHEDULE_PAN, val,
+      time);
+}
+
+
+/* Function: al_set_audio_stream_speed_at
+ */
+bool al_set_audio_stream_speed_at(ALLEGRO_AUDIO_STREAM *stream, float val,
+   uint64_t time)
+{
+   ASSERT(stream);
+
+   if (val <= 0.0f) {
+      _al_set_error(ALLEGRO_INVALID_PARAM,
+         "Attempted to set stream speed to a zero or negative value");
+      return false;
+   }
+
+   return _al_kcm_schedule_event(&stream->spl, _AL_KCM_SCHEDULE_SPEED, val,
+      time);
+}
+
+
 /* Function: al_detach_audio_stream
  */
 bool al_detach_audio_stream(ALLEGRO_AUDIO_STREAM *stream)
@@ -22,6 +22,8 @@ ALLEGRO_IIO_FUNC(bool, _al_osx_register_image_loader, (void));
 
 #endif
 
+ALLEGRO_IIO_FUNC(int, _al_get_load_scale_denominator, (int flags));
+
 ALLEGRO_IIO_FUNC(ALLEGRO_BITMAP *, _al_load_pcx, (const char *filename, int flags));
 ALLEGRO_IIO_FUNC(bool, _al_save_pcx, (const char *filename, ALLEGRO_BITMAP *bmp));
 ALLEGRO_IIO_FUNC(ALLEGRO_BITMAP *, _al_load_pcx_f, (ALLEGRO_FILE *f, int flags));
@@ -42,7 +44,9 @@ ALLEGRO_IIO_FUNC(bool, _al_save_tga_f, (ALLEGRO_FILE *f, ALLEGRO_BITMAP *bmp));
 ALLEGRO_IIO_FUNC(bool, _al_identify_tga, (ALLEGRO_FILE *f));
 
 ALLEGRO_IIO_FUNC(ALLEGRO_BITMAP *, _al_load_dds, (const char *filename, int flags));
+ALLEGRO_IIO_FUNC(bool, _al_save_dds, (const char *filename, ALLEGRO_BITMAP *bmp));
 ALLEGRO_IIO_FUNC(ALLEGRO_BITMAP *, _al_load_dds_f, (ALLEGRO_FILE *f, int flags));
+ALLEGRO_IIO_FUNC(bool, _al_save_dds_f, (ALLEGRO_FILE *f, ALLEGRO_BITMAP *bmp));
 ALLEGRO_IIO_FUNC(bool, _al_identify_dds, (ALLEGRO_FILE *f));
 
 ALLEGRO_IIO_FUNC(bool, _al_identify_png, (ALLEGRO_FILE *f));
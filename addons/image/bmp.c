@@ -195,241 +195,176 @@ static int read_os2_bminfoheader(ALLEGRO_FILE *f, BMPINFOHEADER *infoheader)
 static void read_palette(int ncolors, PalEntry *pal, ALLEGRO_FILE *f,
    int win_flag)
 {
+   unsigned char raw[256 * 4];
+   int bytes_per_color = win_flag ? 4 : 3;
+   size_t size = ncolors * bytes_per_color;
+   size_t n;
    int i;
 
-   for (i = 0; i < ncolors; i++) {
-      pal[i].b = al_fgetc(f);
-      pal[i].g = al_fgetc(f);
-      pal[i].r = al_fgetc(f);
+   ASSERT(ncolors >= 0 && ncolors <= 256);
 
-      if (win_flag) {
-         al_fgetc(f);
-      }
+   n = al_fread(f, raw, size);
+   memset(raw + n, 0, size - n);
+
+   for (i = 0; i < ncolors; i++) {
+      const unsigned char *c = raw + i * bytes_per_color;
+      pal[i].b = c[0];
+      pal[i].g = c[1];
+      pal[i].r = c[2];
    }
 }
 
 
 
-/* read_1bit_line:
- *  Support function for reading the 1 bit bitmap file format.
+/* bmp_row_size:
+ *  Returns the size of one stored scanline, which is padded to a multiple of
+ *  four bytes.
  */
-static void read_1bit_line(int length, ALLEGRO_FILE *f, unsigned char *buf)
+static size_t bmp_row_size(unsigned long width, int bits_per_pixel)
 {
-   unsigned char b[32];
-   unsigned long n;
-   int i, j, k;
+   return ((width * bits_per_pixel + 31) / 32) * 4;
+}
 
-   for (i = 0; i < length; i++) {
-      j = i % 32;
-      if (j == 0) {
-         n = al_fread32be(f);
-         for (k = 0; k < 32; k++) {
-            b[31 - k] = (char)(n & 1);
-            n = n >> 1;
-         }
-      }
-      buf[i] = b[j];
-   }
+
+
+/* read_row:
+ *  Reads one whole scanline, padding included, with a single al_fread.
+ *  Bytes missing at the end of a truncated file read as zero.
+ */
+static void read_row(ALLEGRO_FILE *f, unsigned char *row, size_t size)
+{
+   size_t n = al_fread(f, row, size);
+
+   if (n < size)
+      memset(row + n, 0, size - n);
 }
 
 
 
-/* read_2bit_line:
- *  Support function for reading the 2 bit bitmap file format.
+/* unpack_1bit_line:
+ *  Support function for reading the 1 bit bitmap file format.
  */
-static void read_2bit_line(int length, ALLEGRO_FILE *f, unsigned char *buf)
+static void unpack_1bit_line(int length, const unsigned char *row,
+   unsigned char *buf)
 {
-   unsigned char b[16];
-   unsigned long n;
-   int i, j, k;
-   int temp;
+   int i;
 
-   for (i = 0; i < length; i++) {
-      j = i % 16;
-      if (j == 0) {
-         n = al_fread32le(f);
-         for (k = 0; k < 4; k++) {
-            temp = n & 255;
-            b[k * 4 + 3] = temp & 3;
-            temp = temp >> 2;
-            b[k * 4 + 2] = temp & 3;
-            temp = temp >> 2;
-            b[k * 4 + 1] = temp & 3;
-            temp = temp >> 2;
-            b[k * 4] = temp & 3;
-            n = n >> 8;
-         }
-      }
-      buf[i] = b[j];
-   }
+   for (i = 0; i < length; i++)
+      buf[i] = (row[i >> 3] >> (7 - (i & 7))) & 1;
 }
 
 
 
-/* read_4bit_line:
- *  Support function for reading the 4 bit bitmap file format.
+/* unpack_2bit_line:
+ *  Support function for reading the 2 bit bitmap file format.
  */
-static void read_4bit_line(int length, ALLEGRO_FILE *f, unsigned char *buf)
+static void unpack_2bit_line(int length, const unsigned char *row,
+   unsigned char *buf)
 {
-   unsigned char b[8];
-   unsigned long n;
-   int i, j, k;
-   int temp;
+   int i;
 
-   for (i = 0; i < length; i++) {
-      j = i % 8;
-      if (j == 0) {
-         n = al_fread32le(f);
-         for (k = 0; k < 4; k++) {
-            temp = n & 255;
-            b[k * 2 + 1] = temp & 15;
-            temp = temp >> 4;
-            b[k * 2] = temp & 15;
-            n = n >> 8;
-         }
-      }
-      buf[i] = b[j];
-   }
+   for (i = 0; i < length; i++)
+      buf[i] = (row[i >> 2] >> (6 - 2 * (i & 3))) & 3;
 }
 
 
 
-/* read_8bit_line:
- *  Support function for reading the 8 bit bitmap file format.
+/* unpack_4bit_line:
+ *  Support function for reading the 4 bit bitmap file format.
  */
-static void read_8bit_line(int length, ALLEGRO_FILE *f, unsigned char *buf)
+static void unpack_4bit_line(int length, const unsigned char *row,
+   unsigned char *buf)
 {
-   unsigned char b[4];
-   unsigned long n;
-   int i, j, k;
+   int i;
 
-   for (i = 0; i < length; i++) {
-      j = i % 4;
-      if (j == 0) {
-         n = al_fread32le(f);
-         for (k = 0; k < 4; k++) {
-            b[k] = (char)(n & 255);
-            n = n >> 8;
-         }
-      }
-      buf[i] = b[j];
-   }
+   for (i = 0; i < length; i++)
+      buf[i] = (row[i >> 1] >> (4 - 4 * (i & 1))) & 15;
 }
 
 
 
-/* read_16bit_line:
+/* convert_16bit_line:
  *  Support function for reading the 16 bit bitmap file format.
  */
-static void read_16bit_line(int length, ALLEGRO_FILE *f, unsigned char *data)
+static void convert_16bit_line(int length, const unsigned char *row,
+   unsigned char *data)
 {
-   int i, w;
-   unsigned char r, g, b;
+   int i;
 
    for (i = 0; i < length; i++) {
-      w = al_fread16le(f);
+      int w = row[0] | (row[1] << 8);
 
       /* the format is like a 15-bpp bitmap, not 16bpp */
-      r = _al_rgb_scale_5[(w >> 10) & 0x1f];
-      g = _al_rgb_scale_5[(w >> 5) & 0x1f];
-      b = _al_rgb_scale_5[w & 0x1f];
-
-      data[0] = r;
-      data[1] = g;
-      data[2] = b;
+      data[0] = _al_rgb_scale_5[(w >> 10) & 0x1f];
+      data[1] = _al_rgb_scale_5[(w >> 5) & 0x1f];
+      data[2] = _al_rgb_scale_5[w & 0x1f];
       data[3] = 255;
+      row += 2;
       data += 4;
    }
-
-   /* padding */
-   i = (i * 2) % 4;
-   if (i != 0) {
-      while (i++ < 4)
-         al_fgetc(f);
-   }
 }
 
 
 
-/* read_24bit_line:
+/* convert_24bit_line:
  *  Support function for reading the 24 bit bitmap file format.
  */
-static void read_24bit_line(int length, ALLEGRO_FILE *f, unsigned char *data)
+static void convert_24bit_line(int length, const unsigned char *row,
+   unsigned char *data)
 {
    int i;
-   unsigned char c[3];
-   unsigned char r, g, b;
 
    for (i = 0; i < length; i++) {
-      al_fread(f, c, 3);
-      r = c[2];
-      g = c[1];
-      b = c[0];
-
-      data[0] = r;
-      data[1] = g;
-      data[2] = b;
+      data[0] = row[2];
+      data[1] = row[1];
+      data[2] = row[0];
       data[3] = 255;
+      row += 3;
       data += 4;
    }
-
-   /* padding */
-   i = (i * 3) % 4;
-   if (i != 0) {
-      while (i++ < 4)
-         al_fgetc(f);
-   }
 }
 
 
 
-/* read_32bit_line:
+/* convert_32bit_line:
  *  Support function for reading the 32 bit bitmap file format.
  */
-static void read_32bit_line(int length, ALLEGRO_FILE *f, unsigned char *data)
+static void convert_32bit_line(int length, const unsigned char *row,
+   unsigned char *data)
 {
    int i;
-   unsigned char c[4];
-   unsigned char r, g, b;
 
    for (i = 0; i < length; i++) {
-      al_fread(f, c, 4);
-      r = c[2];
-      g = c[1];
-      b = c[0];
-
-      data[0] = r;
-      data[1] = g;
-      data[2] = b;
-      data[3] = 0xFF;
+      data[0] = row[2];
+      data[1] = row[1];
+      data[2] = row[0];
+      data[3] = 255;
+      row += 4;
       data += 4;
    }
 }
 
 
 
-/* read_32bit_alpha_line:
+/* convert_32bit_alpha_line:
  *  Support function for reading the 32 bit bitmap file format.
  */
-static void read_32bit_alpha_line(int length, ALLEGRO_FILE *f, unsigned char *data,
-   int as, int am, int flags)
+static void convert_32bit_alpha_line(int length, const unsigned char *row,
+   unsigned char *data, int as, int am, int flags)
 {
    int i;
-   unsigned char c[4];
    unsigned char r, g, b, a;
    bool premul = !(flags & ALLEGRO_NO_PREMULTIPLIED_ALPHA);
 
    for (i = 0; i < length; i++) {
-      al_fread(f, c, 4);
-      r = c[2];
-      g = c[1];
-      b = c[0];
-
-      unsigned int pixel = ((unsigned int)(c[3]) << 24)
-                         | ((unsigned int)(c[2]) << 16)
-                         | ((unsigned int)(c[1]) << 8)
-                         |  (unsigned int)(c[0]);
-
+      unsigned int pixel = ((unsigned int)(row[3]) << 24)
+                         | ((unsigned int)(row[2]) << 16)
+                         | ((unsigned int)(row[1]) << 8)
+                         |  (unsigned int)(row[0]);
+
+      r = row[2];
+      g = row[1];
+      b = row[0];
       a = ((pixel >> as) & am) * 255 / am;
 
       if (premul) {
@@ -442,6 +377,7 @@ static void read_32bit_alpha_line(int length, ALLEGRO_FILE *f, unsigned char *da
       data[1] = g;
       data[2] = b;
       data[3] = a;
+      row += 4;
       data += 4;
    }
 }
@@ -492,7 +428,8 @@ static bool read_bitfields_image(ALLEGRO_FILE *f, int flags,
 {
    int k, i, line, height, dir;
    int bytes_per_pixel;
-   unsigned char buffer[4];
+   size_t row_size;
+   unsigned char *row;
    bool hasAlpha = infoheader->biAlphaMask != 0;
    bool premul = !(flags & ALLEGRO_NO_PREMULTIPLIED_ALPHA);
 
@@ -521,17 +458,24 @@ static bool read_bitfields_image(ALLEGRO_FILE *f, int flags,
    if (bytes_per_pixel > 4)
       return false;
 
+   row_size = bmp_row_size(infoheader->biWidth, bytes_per_pixel * 8);
+   row = al_malloc(row_size);
+   if (!row)
+      return false;
+
    for (i = 0; i < height; i++, line += dir) {
       unsigned char *data = (unsigned char *)lr->data + lr->pitch * line;
+      const unsigned char *src = row;
 
-      for (k = 0; k < (int)infoheader->biWidth; k++) {
+      read_row(f, row, row_size);
 
-         al_fread(f, &buffer, bytes_per_pixel);
+      for (k = 0; k < (int)infoheader->biWidth; k++) {
+         unsigned int pixel = 0;
+         int j;
 
-         unsigned int pixel = ((unsigned int)(buffer[3]) << 24)
-                            | ((unsigned int)(buffer[2]) << 16)
-                            | ((unsigned int)(buffer[1]) << 8)
-                            |  (unsigned int)(buffer[0]);
+         for (j = bytes_per_pixel - 1; j >= 0; j--)
+            pixel = (pixel << 8) | src[j];
+         src += bytes_per_pixel;
 
          int r = ((pixel >> rs) & rm);
          int g = ((pixel >> gs) & gm);
@@ -561,15 +505,10 @@ static bool read_bitfields_image(ALLEGRO_FILE *f, int flags,
 
          data += 4;
       }
-
-      /* padding */
-      k = (k * bytes_per_pixel) % 4;
-      if (k > 0) {
-         while (k++ < 4)
-            al_fgetc(f);
-      }
    }
 
+   al_free(row);
+
    return true;
 }
 
@@ -578,13 +517,20 @@ static bool read_bitfields_image(ALLEGRO_FILE *f, int flags,
 /* read_RGB_image:
  *  For reading the non-compressed BMP image format (all except 32-bit with
  *  alpha).
+ *  Each scanline is read with one al_fread and converted straight into the
+ *  locked region.
  */
 static void read_RGB_image(ALLEGRO_FILE *f, int flags,
    const BMPINFOHEADER *infoheader, PalEntry *pal, ALLEGRO_LOCKED_REGION *lr)
 {
    int i, j, line, height, dir;
+   int width = infoheader->biWidth;
+   size_t row_size;
+   unsigned char *row;
    unsigned char *buf;
+   const unsigned char *indices;
    unsigned char *data;
+   unsigned char colors[256][4];
    bool keep_index = INT_TO_BOOL(flags & ALLEGRO_KEEP_INDEX);
 
    height = infoheader->biHeight;
@@ -592,59 +538,71 @@ static void read_RGB_image(ALLEGRO_FILE *f, int flags,
    dir = height < 0 ? 1 : -1;
    height = abs(height);
 
-   buf = al_malloc(infoheader->biWidth);
+   row_size = bmp_row_size(infoheader->biWidth, infoheader->biBitCount);
+   row = al_malloc(row_size + width);
+   if (!row)
+      return;
+   buf = row + row_size;
+
+   if (infoheader->biBitCount <= 8) {
+      for (j = 0; j < 256; j++) {
+         colors[j][0] = pal[j].r;
+         colors[j][1] = pal[j].g;
+         colors[j][2] = pal[j].b;
+         colors[j][3] = 255;
+      }
+   }
 
    for (i = 0; i < height; i++, line += dir) {
       data = (unsigned char *)lr->data + lr->pitch * line;
 
+      read_row(f, row, row_size);
+      indices = buf;
+
       switch (infoheader->biBitCount) {
 
          case 1:
-            read_1bit_line(infoheader->biWidth, f, buf);
+            unpack_1bit_line(width, row, buf);
             break;
 
          case 2:
-            read_2bit_line(infoheader->biWidth, f, buf);
+            unpack_2bit_line(width, row, buf);
             break;
 
          case 4:
-            read_4bit_line(infoheader->biWidth, f, buf);
+            unpack_4bit_line(width, row, buf);
             break;
 
          case 8:
-            read_8bit_line(infoheader->biWidth, f, buf);
+            indices = row;
             break;
 
          case 16:
-            read_16bit_line(infoheader->biWidth, f, data);
+            convert_16bit_line(width, row, data);
             break;
 
          case 24:
-            read_24bit_line(infoheader->biWidth, f, data);
+            convert_24bit_line(width, row, data);
             break;
 
          case 32:
-            read_32bit_line(infoheader->biWidth, f, data);
+            convert_32bit_line(width, row, data);
             break;
       }
       if (infoheader->biBitCount <= 8) {
-         for (j = 0; j < (int)infoheader->biWidth; j++) {
-            if (keep_index) {
-               data[0] = buf[j];
-               data++;
-            }
-            else {
-               data[0] = pal[buf[j]].r;
-               data[1] = pal[buf[j]].g;
-               data[2] = pal[buf[j]].b;
-               data[3] = 255;
+         if (keep_index) {
+            memcpy(data, indices, width);
+         }
+         else {
+            for (j = 0; j < width; j++) {
+               memcpy(data, colors[indices[j]], 4);
                data += 4;
             }
          }
       }
    }
 
-   al_free(buf);
+   al_free(row);
 }
 
 
@@ -657,7 +615,8 @@ static bool read_RGB_alpha_image(ALLEGRO_FILE *f, int flags,
    const BMPINFOHEADER *infoheader, ALLEGRO_LOCKED_REGION *lr)
 {
    int i, line, height, dir;
-   unsigned char *buf;
+   size_t row_size;
+   unsigned char *row;
    unsigned char *data;
 
    int as, am;
@@ -670,14 +629,18 @@ static bool read_RGB_alpha_image(ALLEGRO_FILE *f, int flags,
    dir = height < 0 ? 1 : -1;
    height = abs(height);
 
-   buf = al_malloc(infoheader->biWidth);
+   row_size = bmp_row_size(infoheader->biWidth, 32);
+   row = al_malloc(row_size);
+   if (!row)
+      return false;
 
    for (i = 0; i < height; i++, line += dir) {
       data = (unsigned char *)lr->data + lr->pitch * line;
-      read_32bit_alpha_line(infoheader->biWidth, f, data, as, am, flags);
+      read_row(f, row, row_size);
+      convert_32bit_alpha_line(infoheader->biWidth, row, data, as, am, flags);
    }
 
-   al_free(buf);
+   al_free(row);
 
    return true;
 }
@@ -700,6 +663,9 @@ static void read_RGB_image_32bit_alpha_hack(ALLEGRO_FILE *f, int flags,
    const BMPINFOHEADER *infoheader, ALLEGRO_LOCKED_REGION *lr)
 {
    int i, j, line, height, dir;
+   int width = infoheader->biWidth;
+   size_t row_size;
+   unsigned char *row;
    unsigned char *data;
    unsigned char r, g, b, a;
    unsigned char have_alpha = 0;
@@ -710,30 +676,36 @@ static void read_RGB_image_32bit_alpha_hack(ALLEGRO_FILE *f, int flags,
    dir = height < 0 ? 1 : -1;
    height = abs(height);
 
+   row_size = bmp_row_size(infoheader->biWidth, 32);
+   row = al_malloc(row_size);
+   if (!row)
+      return;
+
    /* Read data. */
    for (i = 0; i < height; i++, line += dir) {
+      const unsigned char *src = row;
       data = (unsigned char *)lr->data + lr->pitch * line;
 
-      for (j = 0; j < (int)infoheader->biWidth; j++) {
-         b = al_fgetc(f);
-         g = al_fgetc(f);
-         r = al_fgetc(f);
-         a = al_fgetc(f);
-         have_alpha |= a;
+      read_row(f, row, row_size);
 
-         data[0] = r;
-         data[1] = g;
-         data[2] = b;
-         data[3] = a;
+      for (j = 0; j < width; j++) {
+         data[0] = src[2];
+         data[1] = src[1];
+         data[2] = src[0];
+         data[3] = src[3];
+         have_alpha |= src[3];
+         src += 4;
          data += 4;
       }
    }
 
+   al_free(row);
+
    /* Fixup pass. */
    if (!have_alpha) {
       for (i = 0; i < height; i++) {
          data = (unsigned char *)lr->data + lr->pitch * i;
-         for (j = 0; j < (int)infoheader->biWidth; j++) {
+         for (j = 0; j < width; j++) {
             data[3] = 255; /* a */
             data += 4;
          }
@@ -742,7 +714,7 @@ static void read_RGB_image_32bit_alpha_hack(ALLEGRO_FILE *f, int flags,
    else if (premul) {
       for (i = 0; i < height; i++) {
          data = (unsigned char *)lr->data + lr->pitch * i;
-         for (j = 0; j < (int)infoheader->biWidth; j++) {
+         for (j = 0; j < width; j++) {
             r = data[0];
             g = data[1];
             b = data[2];
@@ -1073,7 +1045,12 @@ ALLEGRO_BITMAP *_al_load_bmp_f(ALLEGRO_FILE *f, int flags)
          }
       }
 
-      if (ncolors > 256) {
+      if (ncolors < 0) {
+         /* A huge biClrUsed or a bogus bfOffBits. */
+         ALLEGRO_WARN("Invalid number of colors: %d\n", ncolors);
+         ncolors = 0;
+      }
+      else if (ncolors > 256) {
          ALLEGRO_WARN("Too many colors: %d\n", ncolors);
          ncolors = 256;
          extracolors = ncolors - 256;
@@ -8,7 +8,7 @@
  *                                           /\____/
  *                                           \_/__/
  *
- *      A simple DDS reader.
+ *      A simple DDS reader and writer.
  *
  *      See readme.txt for copyright information.
  */
@@ -16,6 +16,7 @@
 #include "allegro5/allegro.h"
 #include "allegro5/allegro_image.h"
 #include "allegro5/internal/aintern_image.h"
+#include "allegro5/internal/aintern_pixels.h"
 
 #include "iio.h"
 
@@ -58,6 +59,13 @@ typedef struct {
 
 #define DDPF_FOURCC 0x4
 
+#define DDSD_CAPS 0x1
+#define DDSD_HEIGHT 0x2
+#define DDSD_WIDTH 0x4
+#define DDSD_PIXELFORMAT 0x1000
+#define DDSD_LINEARSIZE 0x80000
+#define DDSCAPS_TEXTURE 0x1000
+
 ALLEGRO_BITMAP *_al_load_dds_f(ALLEGRO_FILE *f, int flags)
 {
    ALLEGRO_BITMAP *bmp;
@@ -112,8 +120,10 @@ ALLEGRO_BITMAP *_al_load_dds_f(ALLEGRO_FILE *f, int flags)
    block_height = al_get_pixel_block_height(format);
    block_size = al_get_pixel_block_size(format);
 
+   /* Memory bitmaps can hold the blocks too, so respect the new bitmap
+    * flags; without a display this loads into a memory bitmap.
+    */
    al_store_state(&state, ALLEGRO_STATE_NEW_BITMAP_PARAMETERS);
-   al_set_new_bitmap_flags(ALLEGRO_VIDEO_BITMAP);
    al_set_new_bitmap_format(format);
    bmp = al_create_bitmap(w, h);
    if (!bmp) {
@@ -143,8 +153,8 @@ ALLEGRO_BITMAP *_al_load_dds_f(ALLEGRO_FILE *f, int flags)
 
    bitmap_data = lr->data;
 
-   for (ii = 0; ii < h / block_height; ii++) {
-      size_t pitch = (size_t)(w / block_width * block_size);
+   for (ii = 0; ii < (h + block_height - 1) / block_height; ii++) {
+      size_t pitch = (size_t)((w + block_width - 1) / block_width * block_size);
       num_read = al_fread(f, bitmap_data, pitch);
       if (num_read != pitch) {
          ALLEGRO_ERROR("DDS file too short.\n");
@@ -182,6 +192,114 @@ ALLEGRO_BITMAP *_al_load_dds(const char *filename, int flags)
    return bmp;
 }
 
+/* Bitmaps which aren't compressed already are encoded as DXT5, or DXT1 if
+ * the format has no alpha.
+ */
+bool _al_save_dds_f(ALLEGRO_FILE *f, ALLEGRO_BITMAP *bmp)
+{
+   ALLEGRO_BITMAP *tmp = NULL;
+   ALLEGRO_LOCKED_REGION *lr;
+   ALLEGRO_STATE state;
+   int format = al_get_bitmap_format(bmp);
+   int w = al_get_bitmap_width(bmp);
+   int h = al_get_bitmap_height(bmp);
+   int fourcc, blocks_w, blocks_h, row_size;
+   int ii;
+   bool ret = true;
+
+   if (!_al_pixel_format_is_compressed(format)) {
+      format = _al_pixel_format_has_alpha(format) ?
+         ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT5 :
+         ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT1;
+      al_store_state(&state, ALLEGRO_STATE_NEW_BITMAP_PARAMETERS);
+      al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP);
+      al_set_new_bitmap_format(format);
+      tmp = al_clone_bitmap(bmp);
+      al_restore_state(&state);
+      if (!tmp) {
+         ALLEGRO_ERROR("Couldn't compress the bitmap.\n");
+         return false;
+      }
+      bmp = tmp;
+   }
+
+   switch (format) {
+      case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT1:
+         fourcc = FOURCC('D', 'X', 'T', '1');
+         break;
+      case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT3:
+         fourcc = FOURCC('D', 'X', 'T', '3');
+         break;
+      default:
+         fourcc = FOURCC('D', 'X', 'T', '5');
+         break;
+   }
+
+   lr = al_lock_bitmap_blocked(bmp, ALLEGRO_LOCK_READONLY);
+   if (!lr) {
+      ALLEGRO_ERROR("Could not lock the bitmap.\n");
+      al_destroy_bitmap(tmp);
+      return false;
+   }
+
+   blocks_w = (w + al_get_pixel_block_width(format) - 1)
+      / al_get_pixel_block_width(format);
+   blocks_h = (h + al_get_pixel_block_height(format) - 1)
+      / al_get_pixel_block_height(format);
+   row_size = blocks_w * al_get_pixel_block_size(format);
+
+   al_fwrite32le(f, 0x20534444);
+   al_fwrite32le(f, DDS_HEADER_SIZE);
+   al_fwrite32le(f, DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT
+      | DDSD_LINEARSIZE);
+   al_fwrite32le(f, h);
+   al_fwrite32le(f, w);
+   al_fwrite32le(f, row_size * blocks_h);
+   al_fwrite32le(f, 0); /* dwDepth */
+   al_fwrite32le(f, 0); /* dwMipMapCount */
+   for (ii = 0; ii < 11; ii++)
+      al_fwrite32le(f, 0); /* dwReserved1 */
+   al_fwrite32le(f, DDS_PIXELFORMAT_SIZE);
+   al_fwrite32le(f, DDPF_FOURCC);
+   al_fwrite32le(f, fourcc);
+   for (ii = 0; ii < 5; ii++)
+      al_fwrite32le(f, 0); /* bit count and masks */
+   al_fwrite32le(f, DDSCAPS_TEXTURE);
+   for (ii = 0; ii < 4; ii++)
+      al_fwrite32le(f, 0); /* dwCaps2 to dwReserved2 */
+
+   for (ii = 0; ii < blocks_h; ii++) {
+      if (al_fwrite(f, (char *)lr->data + ii * lr->pitch, row_size)
+            != (size_t)row_size) {
+         ret = false;
+         break;
+      }
+   }
+
+   al_unlock_bitmap(bmp);
+   al_destroy_bitmap(tmp);
+
+   return ret && !al_ferror(f);
+}
+
+bool _al_save_dds(const char *filename, ALLEGRO_BITMAP *bmp)
+{
+   ALLEGRO_FILE *f;
+   bool retsave;
+   bool retclose;
+   ASSERT(filename);
+
+   f = al_fopen(filename, "wb");
+   if (!f)
+      return false;
+
+   retsave = _al_save_dds_f(f, bmp);
+
+   retclose = al_fclose(f);
+
+   return retsave && retclose;
+}
+
 bool _al_identify_dds(ALLEGRO_FILE *f)
 {
    uint8_t x[4];
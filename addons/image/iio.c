@@ -39,7 +39,9 @@ bool al_init_image_addon(void)
    success |= al_register_bitmap_identifier(".tga", _al_identify_tga);
 
    success |= al_register_bitmap_loader(".dds", _al_load_dds);
+   success |= al_register_bitmap_saver(".dds", _al_save_dds);
    success |= al_register_bitmap_loader_f(".dds", _al_load_dds_f);
+   success |= al_register_bitmap_saver_f(".dds", _al_save_dds_f);
    success |= al_register_bitmap_identifier(".dds", _al_identify_dds);
 
    /* Even if we don't have libpng or libjpeg we most likely have a
@@ -152,4 +154,19 @@ uint32_t al_get_allegro_image_version(void)
 }
 
 
+/* Returns the factor by which the ALLEGRO_LOAD_*_SIZE loader flags ask for
+ * the image to be reduced.  If several are given the smallest size wins.
+ */
+int _al_get_load_scale_denominator(int flags)
+{
+   if (flags & ALLEGRO_LOAD_EIGHTH_SIZE)
+      return 8;
+   if (flags & ALLEGRO_LOAD_QUARTER_SIZE)
+      return 4;
+   if (flags & ALLEGRO_LOAD_HALF_SIZE)
+      return 2;
+   return 1;
+}
+
+
 /* vim: set sts=3 sw=3 et: */
@@ -10,6 +10,7 @@
 #endif
 
 #define BUFFER_SIZE 4096
+#define MAX_SCANLINES 16
 
 #include "allegro5/allegro.h"
 #include "allegro5/allegro_image.h"
@@ -165,11 +166,11 @@ static void load_jpg_entry_helper(ALLEGRO_FILE *fp,
    struct my_err_mgr jerr;
    ALLEGRO_LOCKED_REGION *lock;
    int w, h, s;
+   int i, n;
 
    /* ALLEGRO_NO_PREMULTIPLIED_ALPHA does not apply.
     * ALLEGRO_KEEP_INDEX does not apply.
     */
-   (void)flags;
 
    data->error = false;
 
@@ -181,15 +182,23 @@ static void load_jpg_entry_helper(ALLEGRO_FILE *fp,
       goto longjmp_error;
    }
 
+   jpeg_create_decompress(&cinfo);
+
    data->buffer = al_malloc(BUFFER_SIZE);
    if (!data->buffer) {
       data->error = true;
-      goto error;
+      goto longjmp_error;
    }
 
-   jpeg_create_decompress(&cinfo);
    jpeg_packfile_src(&cinfo, fp, data->buffer);
    jpeg_read_header(&cinfo, true);
+
+   /* Let the IDCT produce the reduced size directly, which is much faster
+    * than decoding at full size and scaling afterwards.
+    */
+   cinfo.scale_num = 1;
+   cinfo.scale_denom = _al_get_load_scale_denominator(flags);
+
    jpeg_start_decompress(&cinfo);
 
    w = cinfo.output_width;
@@ -226,15 +235,25 @@ static void load_jpg_entry_helper(ALLEGRO_FILE *fp,
    lock = al_lock_bitmap(data->bmp, ALLEGRO_PIXEL_FORMAT_BGR_888,
        ALLEGRO_LOCK_WRITEONLY);
 #endif
+   if (!lock) {
+      data->error = true;
+      goto longjmp_error;
+   }
+
+   /* Offer libjpeg room for several scanlines per call, so that it can
+    * hand over a whole row group at once instead of one row at a time.
+    */
+   n = MAX_SCANLINES;
 
    if (s == 3) {
       /* Colour. */
       int y;
 
       for (y = cinfo.output_scanline; y < h; y = cinfo.output_scanline) {
-         unsigned char *out[1];
-         out[0] = ((unsigned char *)lock->data) + y * lock->pitch;
-         jpeg_read_scanlines(&cinfo, (void *)out, 1);
+         unsigned char *out[MAX_SCANLINES];
+         for (i = 0; i < n && y + i < h; i++)
+            out[i] = ((unsigned char *)lock->data) + (y + i) * lock->pitch;
+         jpeg_read_scanlines(&cinfo, (void *)out, i);
       }
    }
    else if (s == 1) {
@@ -243,16 +262,26 @@ static void load_jpg_entry_helper(ALLEGRO_FILE *fp,
       unsigned char *out;
       int x, y;
 
-      data->row = al_malloc(w);
+      data->row = al_malloc(w * n);
+      if (!data->row) {
+         data->error = true;
+         goto longjmp_error;
+      }
       for (y = cinfo.output_scanline; y < h; y = cinfo.output_scanline) {
-         jpeg_read_scanlines(&cinfo, (void *)&data->row, 1);
-         in = data->row;
-         out = ((unsigned char *)lock->data) + y * lock->pitch;
-         for (x = 0; x < w; x++) {
-            *out++ = *in;
-            *out++ = *in;
-            *out++ = *in;
-            in++;
+         unsigned char *rows[MAX_SCANLINES];
+         int count;
+         for (i = 0; i < n; i++)
+            rows[i] = data->row + i * w;
+         count = jpeg_read_scanlines(&cinfo, (void *)rows, n);
+         for (i = 0; i < count; i++) {
+            in = rows[i];
+            out = ((unsigned char *)lock->data) + (y + i) * lock->pitch;
+            for (x = 0; x < w; x++) {
+               *out++ = *in;
+               *out++ = *in;
+               *out++ = *in;
+               in++;
+            }
          }
       }
    }
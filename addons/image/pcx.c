@@ -1,3 +1,5 @@
+#include <string.h>
+
 #include "allegro5/allegro.h"
 #include "allegro5/allegro_image.h"
 #include "allegro5/internal/aintern_image.h"
@@ -7,16 +9,85 @@
 /* Do NOT simplify this to just (x), it doesn't work in MSVC. */
 #define INT_TO_BOOL(x)   ((x) != 0)
 
+/* PCX_READER:
+ *  Buffers the RLE stream so that decoding does not go through the file
+ *  layer for every byte.
+ */
+typedef struct PCX_READER
+{
+   ALLEGRO_FILE *f;
+   size_t pos;
+   size_t len;
+   unsigned char buf[4096];
+} PCX_READER;
+
+static int pcx_getc(PCX_READER *r)
+{
+   if (r->pos == r->len) {
+      /* Reading ahead into the end of the file is not an error. */
+      int err = al_get_errno();
+      r->len = al_fread(r->f, r->buf, sizeof(r->buf));
+      if (r->len < sizeof(r->buf) && !al_ferror(r->f))
+         al_set_errno(err);
+      r->pos = 0;
+      if (r->len == 0)
+         return EOF;
+   }
+   return r->buf[r->pos++];
+}
+
+/* Returns the bytes read ahead but not consumed to the file, so the offset is
+ * left just after the image data.
+ */
+static void pcx_reader_done(PCX_READER *r)
+{
+   if (r->pos < r->len)
+      al_fseek(r->f, -(int64_t)(r->len - r->pos), ALLEGRO_SEEK_CUR);
+}
+
+/* Decodes one RLE encoded scanline, all planes included, into line.
+ * Bytes missing at the end of a truncated file read as zero.
+ */
+static void pcx_read_line(PCX_READER *r, unsigned char *line, int size)
+{
+   int x = 0;
+   int ch, c;
+
+   while (x < size) {
+      ch = pcx_getc(r);
+      if (ch == EOF)
+         break;
+      if ((ch & 0xC0) == 0xC0) {    /* a run */
+         c = (ch & 0x3F);
+         ch = pcx_getc(r);
+         if (ch == EOF)
+            break;
+      }
+      else {
+         c = 1;                     /* single pixel */
+      }
+
+      if (c > size - x)
+         c = size - x;
+      memset(line + x, ch, c);
+      x += c;
+   }
+
+   if (x < size)
+      memset(line + x, 0, size - x);
+}
+
 ALLEGRO_BITMAP *_al_load_pcx_f(ALLEGRO_FILE *f, int flags)
 {
    ALLEGRO_BITMAP *b;
    int c;
    int width, height;
    int bpp, bytes_per_line;
-   int x, xx, y;
-   char ch;
+   int x, y;
    ALLEGRO_LOCKED_REGION *lr;
    unsigned char *buf;
+   unsigned char *line;
+   PCX_READER *reader;
    PalEntry pal[256];
    bool keep_index;
    ASSERT(f);
@@ -57,6 +128,10 @@ ALLEGRO_BITMAP *_al_load_pcx_f(ALLEGRO_FILE *f, int flags)
       return NULL;
    }
 
+   if (bytes_per_line < width) {
+      return NULL;
+   }
+
    b = al_create_bitmap(width, height);
    if (!b) {
       return NULL;
@@ -70,12 +145,14 @@ ALLEGRO_BITMAP *_al_load_pcx_f(ALLEGRO_FILE *f, int flags)
       /* The palette comes after the image data.  We need to to keep the
        * whole image in a temporary buffer before mapping the final colours.
        */
-      buf = (unsigned char *)al_malloc(bytes_per_line * height);
+      buf = (unsigned char *)al_malloc(width * height);
    }
    else {
-      /* We can read one line at a time. */
-      buf = (unsigned char *)al_malloc(bytes_per_line * 3);
+      /* We can convert one line at a time. */
+      buf = NULL;
    }
+   line = (unsigned char *)al_malloc(bytes_per_line * bpp / 8);
+   reader = (PCX_READER *)al_malloc(sizeof(PCX_READER));
 
    if (bpp == 8 && keep_index) {
       lr = al_lock_bitmap(b, ALLEGRO_PIXEL_FORMAT_SINGLE_CHANNEL_8, ALLEGRO_LOCK_WRITEONLY);
@@ -83,84 +160,81 @@ ALLEGRO_BITMAP *_al_load_pcx_f(ALLEGRO_FILE *f, int flags)
    else {
       lr = al_lock_bitmap(b, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE, ALLEGRO_LOCK_WRITEONLY);
    }
-   if (!lr) {
+   if (!lr || !line || !reader || (bpp == 8 && !buf)) {
+      if (lr)
+         al_unlock_bitmap(b);
+      al_destroy_bitmap(b);
       al_free(buf);
+      al_free(line);
+      al_free(reader);
       return NULL;
    }
 
-   xx = 0;                      /* index into buf, only for bpp = 8 */
+   reader->f = f;
+   reader->pos = 0;
+   reader->len = 0;
 
    for (y = 0; y < height; y++) {       /* read RLE encoded PCX data */
+      pcx_read_line(reader, line, bytes_per_line * bpp / 8);
 
-      x = 0;
-
-      while (x < bytes_per_line * bpp / 8) {
-         ch = al_fgetc(f);
-         if ((ch & 0xC0) == 0xC0) { /* a run */
-            c = (ch & 0x3F);
-            ch = al_fgetc(f);
-         }
-         else {
-            c = 1;                  /* single pixel */
-         }
-
-         if (bpp == 8) {
-            while (c--) {
-               if (x < width)       /* ignore padding */
-                  buf[xx++] = ch;
-               x++;
-            }
-         }
-         else {
-            while (c--) {
-               if (x < width * 3)   /* ignore padding */
-                  buf[x] = ch;
-               x++;
-            }
-         }
+      if (bpp == 8) {
+         memcpy(buf + y * width, line, width);   /* ignore padding */
       }
-      if (bpp == 24) {
-         char *dest = (char*)lr->data + y*lr->pitch;
+      else {
+         unsigned char *dest = (unsigned char *)lr->data + y*lr->pitch;
+         const unsigned char *red = line;
+         const unsigned char *green = line + bytes_per_line;
+         const unsigned char *blue = line + bytes_per_line * 2;
          for (x = 0; x < width; x++) {
-            dest[x*4    ] = buf[x];
-            dest[x*4 + 1] = buf[x + width];
-            dest[x*4 + 2] = buf[x + width * 2];
+            dest[x*4    ] = red[x];
+            dest[x*4 + 1] = green[x];
+            dest[x*4 + 2] = blue[x];
             dest[x*4 + 3] = 255;
          }
       }
    }
 
    if (bpp == 8) {               /* look for a 256 color palette */
-      while ((c = al_fgetc(f)) != EOF) {
+      unsigned char colors[256][4];
+
+      memset(pal, 0, sizeof(pal));
+      while ((c = pcx_getc(reader)) != EOF) {
          if (c == 12) {
             for (c = 0; c < 256; c++) {
-               pal[c].r = al_fgetc(f);
-               pal[c].g = al_fgetc(f);
-               pal[c].b = al_fgetc(f);
+               pal[c].r = pcx_getc(reader);
+               pal[c].g = pcx_getc(reader);
+               pal[c].b = pcx_getc(reader);
             }
             break;
          }
       }
+      for (c = 0; c < 256; c++) {
+         colors[c][0] = pal[c].r;
+         colors[c][1] = pal[c].g;
+         colors[c][2] = pal[c].b;
+         colors[c][3] = 255;
+      }
       for (y = 0; y < height; y++) {
-         char *dest = (char*)lr->data + y*lr->pitch;
-         for (x = 0; x < width; x++) {
-            int index = buf[y * width + x];
-            if (keep_index) {
-               dest[x] = index;
-            }
-            else {
-               dest[x*4    ] = pal[index].r;
-               dest[x*4 + 1] = pal[index].g;
-               dest[x*4 + 2] = pal[index].b;
-               dest[x*4 + 3] = 255;
+         unsigned char *dest = (unsigned char *)lr->data + y*lr->pitch;
+         const unsigned char *src = buf + y * width;
+         if (keep_index) {
+            memcpy(dest, src, width);
+         }
+         else {
+            for (x = 0; x < width; x++) {
+               memcpy(dest + x*4, colors[src[x]], 4);
             }
          }
       }
    }
 
+   pcx_reader_done(reader);
+
    al_unlock_bitmap(b);
 
    al_free(buf);
+   al_free(line);
+   al_free(reader);
 
    if (al_get_errno()) {
       al_destroy_bitmap(b);
@@ -8,6 +8,7 @@
 
 #include "allegro5/allegro.h"
 #include "allegro5/allegro_image.h"
+#include "allegro5/internal/aintern.h"
 #include "allegro5/internal/aintern_image.h"
 
 #include "iio.h"
@@ -86,6 +87,166 @@ static int check_if_png(ALLEGRO_FILE *fp)
 
 
 
+/* PNG_ROW_FORMAT:
+ *  What convert_row needs to know about the rows libpng hands us.
+ */
+typedef struct PNG_ROW_FORMAT
+{
+   int bpp;
+   bool paletted;
+   bool index_only;
+   bool premul;
+   PalEntry *pal;
+   png_bytep trans;
+   int num_trans;
+} PNG_ROW_FORMAT;
+
+
+
+/* convert_row:
+ *  Converts one row decoded by libpng to RGBA (or palette indices).
+ */
+static void convert_row(const PNG_ROW_FORMAT *fmt, unsigned char *ptr,
+   unsigned char *dest, png_uint_32 width)
+{
+   unsigned int i;
+
+   switch (fmt->bpp) {
+      case 8:
+         if (fmt->index_only) {
+            for (i = 0; i < width; i++) {
+               *(dest++) = *(ptr++);
+            }
+         }
+         else if (fmt->paletted) {
+            for (i = 0; i < width; i++) {
+               int pix = ptr[0];
+               ptr++;
+               dest[0] = fmt->pal[pix].r;
+               dest[1] = fmt->pal[pix].g;
+               dest[2] = fmt->pal[pix].b;
+               if (pix < fmt->num_trans) {
+                  int a = fmt->trans[pix];
+                  dest[3] = a;
+                  if (fmt->premul) {
+                     dest[0] = dest[0] * a / 255;
+                     dest[1] = dest[1] * a / 255;
+                     dest[2] = dest[2] * a / 255;
+                  }
+               } else {
+                  dest[3] = 255;
+               }
+               dest += 4;
+            }
+         }
+         else {
+            for (i = 0; i < width; i++) {
+               int pix = ptr[0];
+               ptr++;
+               *(dest++) = pix;
+               *(dest++) = pix;
+               *(dest++) = pix;
+               *(dest++) = 255;
+            }
+         }
+         break;
+
+      case 24:
+         for (i = 0; i < width; i++) {
+            uint32_t pix = READ3BYTES(ptr);
+            ptr += 3;
+            *(dest++) = pix & 0xff;
+            *(dest++) = (pix >> 8) & 0xff;
+            *(dest++) = (pix >> 16) & 0xff;
+            *(dest++) = 255;
+         }
+         break;
+
+      case 32:
+         for (i = 0; i < width; i++) {
+            uint32_t pix = bmp_read32(ptr);
+            int r = pix & 0xff;
+            int g = (pix >> 8) & 0xff;
+            int b = (pix >> 16) & 0xff;
+            int a = (pix >> 24) & 0xff;
+            ptr += 4;
+
+            if (fmt->premul) {
+               r = r * a / 255;
+               g = g * a / 255;
+               b = b * a / 255;
+            }
+
+            *(dest++) = r;
+            *(dest++) = g;
+            *(dest++) = b;
+            *(dest++) = a;
+         }
+         break;
+
+      default:
+         ALLEGRO_ASSERT(fmt->bpp == 8 || fmt->bpp == 24 || fmt->bpp == 32);
+         break;
+   }
+}
+
+
+
+/* add_row_to_box:
+ *  Adds an RGBA row to the per-box sums of a row of output pixels, each of
+ *  which covers denom source pixels horizontally.
+ */
+static void add_row_to_box(const unsigned char *src, uint32_t *sums,
+   png_uint_32 width, int denom)
+{
+   png_uint_32 x = 0;
+
+   while (x < width) {
+      png_uint_32 end = _ALLEGRO_MIN(x + denom, width);
+      uint32_t r = 0, g = 0, b = 0, a = 0;
+
+      for (; x < end; x++) {
+         r += src[0];
+         g += src[1];
+         b += src[2];
+         a += src[3];
+         src += 4;
+      }
+      sums[0] += r;
+      sums[1] += g;
+      sums[2] += b;
+      sums[3] += a;
+      sums += 4;
+   }
+}
+
+
+
+/* write_box_row:
+ *  Writes the averages of a row of boxes of denom x rows source pixels and
+ *  clears the sums for the next row of boxes.
+ */
+static void write_box_row(uint32_t *sums, unsigned char *dest,
+   png_uint_32 width, int denom, int rows)
+{
+   png_uint_32 out_w = (width + denom - 1) / denom;
+   png_uint_32 x;
+   int j;
+
+   for (x = 0; x < out_w; x++) {
+      uint32_t count = _ALLEGRO_MIN((png_uint_32)denom, width - x * denom) * rows;
+
+      for (j = 0; j < 4; j++) {
+         dest[j] = (sums[j] + count / 2) / count;
+         sums[j] = 0;
+      }
+      sums += 4;
+      dest += 4;
+   }
+}
+
+
+
 /* really_load_png:
  *  Worker routine, used by load_png and load_memory_png.
  */
@@ -101,10 +262,15 @@ static ALLEGRO_BITMAP *really_load_png(png_structp png_ptr, png_infop info_ptr,
    int number_passes, pass;
    int num_trans = 0;
    PalEntry pal[256];
-   png_bytep trans;
+   png_bytep trans = NULL;
    ALLEGRO_LOCKED_REGION *lock;
    unsigned char *buf;
    unsigned char *dest;
+   unsigned char *row = NULL;
+   uint32_t *sums = NULL;
+   PNG_ROW_FORMAT fmt;
+   png_uint_32 out_width, out_height;
+   int denom;
    bool premul = !(flags & ALLEGRO_NO_PREMULTIPLIED_ALPHA);
    bool index_only;
 
@@ -202,7 +368,15 @@ static ALLEGRO_BITMAP *really_load_png(png_structp png_ptr, png_infop info_ptr,
 #endif
    }
 
-   bmp = al_create_bitmap(width, height);
+   /* With the ALLEGRO_LOAD_*_SIZE flags every output pixel is the average
+    * of a box of denom x denom source pixels, accumulated while the rows are
+    * decoded so the full size image is never stored.
+    */
+   denom = _al_get_load_scale_denominator(flags);
+   out_width = (width + denom - 1) / denom;
+   out_height = (height + denom - 1) / denom;
+
+   bmp = al_create_bitmap(out_width, out_height);
    if (!bmp) {
       ALLEGRO_ERROR("al_create_bitmap failed while loading PNG.\n");
       return NULL;
@@ -215,6 +389,13 @@ static ALLEGRO_BITMAP *really_load_png(png_structp png_ptr, png_infop info_ptr,
    else
       buf = al_malloc(real_rowbytes);
 
+   fmt.bpp = bpp;
+   fmt.paletted = (color_type & PNG_COLOR_MASK_PALETTE);
+   fmt.premul = premul;
+   fmt.pal = pal;
+   fmt.trans = trans;
+   fmt.num_trans = num_trans;
+
    if (bpp == 8 && (color_type & PNG_COLOR_MASK_PALETTE) &&
       (flags & ALLEGRO_KEEP_INDEX))
    {
@@ -227,16 +408,39 @@ static ALLEGRO_BITMAP *really_load_png(png_structp png_ptr, png_infop info_ptr,
          ALLEGRO_LOCK_WRITEONLY);
       index_only = false;
    }
+   fmt.index_only = index_only;
+
+   if (denom > 1) {
+      /* Indices cannot be averaged, so those just take every denom'th
+       * pixel.
+       */
+      if (!index_only) {
+         row = al_malloc(width * 4);
+         sums = al_calloc(out_width * 4, sizeof(uint32_t));
+      }
+   }
+
+   if (!buf || !lock || (denom > 1 && !index_only && (!row || !sums))) {
+      ALLEGRO_ERROR("Out of memory while loading PNG.\n");
+      al_free(row);
+      al_free(sums);
+      if (lock)
+         al_unlock_bitmap(bmp);
+      al_destroy_bitmap(bmp);
+      al_free(buf);
+      return NULL;
+   }
 
    /* Read the image, one line at a time (easier to debug!) */
    for (pass = 0; pass < number_passes; pass++) {
       png_uint_32 y;
-      unsigned int i;
       unsigned char *ptr;
-      dest = lock->data;
+      /* For interlaced pictures buf holds the whole image, which is only
+       * complete after the last pass.
+       */
+      bool last_pass = (pass == number_passes - 1);
 
       for (y = 0; y < height; y++) {
-         unsigned char *dest_row_start = dest;
          /* For interlaced pictures, the row needs to be initialized with
           * the contents of the previous pass.
           */
@@ -245,88 +449,34 @@ static ALLEGRO_BITMAP *really_load_png(png_structp png_ptr, png_infop info_ptr,
          else
             ptr = buf;
          png_read_row(png_ptr, NULL, ptr);
-   
-         switch (bpp) {
-            case 8:
-               if (index_only) {
-                  for (i = 0; i < width; i++) {
-                     *(dest++) = *(ptr++);
-                  }
-               }
-               else if (color_type & PNG_COLOR_MASK_PALETTE) {
-                  for (i = 0; i < width; i++) {
-                     int pix = ptr[0];
-                     ptr++;
-                     dest[0] = pal[pix].r;
-                     dest[1] = pal[pix].g;
-                     dest[2] = pal[pix].b;
-                     if (pix < num_trans) {
-                        int a = trans[pix];
-                        dest[3] = a;
-                        if (premul) {
-                           dest[0] = dest[0] * a / 255;
-                           dest[1] = dest[1] * a / 255;
-                           dest[2] = dest[2] * a / 255;
-                        }
-                     } else {
-                        dest[3] = 255;
-                     }
-                     dest += 4;
-                  }
-               }
-               else {
-                  for (i = 0; i < width; i++) {
-                     int pix = ptr[0];
-                     ptr++;
-                     *(dest++) = pix;
-                     *(dest++) = pix;
-                     *(dest++) = pix;
-                     *(dest++) = 255;
-                  }
-               }
-               break;
-
-            case 24:
-               for (i = 0; i < width; i++) {
-                  uint32_t pix = READ3BYTES(ptr);
-                  ptr += 3;
-                  *(dest++) = pix & 0xff;
-                  *(dest++) = (pix >> 8) & 0xff;
-                  *(dest++) = (pix >> 16) & 0xff;
-                  *(dest++) = 255;
-               }
-               break;
-
-            case 32:
-               for (i = 0; i < width; i++) {
-                  uint32_t pix = bmp_read32(ptr);
-                  int r = pix & 0xff;
-                  int g = (pix >> 8) & 0xff;
-                  int b = (pix >> 16) & 0xff;
-                  int a = (pix >> 24) & 0xff;
-                  ptr += 4;
-
-                  if (premul) {
-                     r = r * a / 255;
-                     g = g * a / 255;
-                     b = b * a / 255;
-                  }
 
-                  *(dest++) = r;
-                  *(dest++) = g;
-                  *(dest++) = b;
-                  *(dest++) = a;
-               }
-               break;
+         if (!last_pass)
+            continue;
 
-            default:
-               ALLEGRO_ASSERT(bpp == 8 || bpp == 24 || bpp == 32);
-               break;
+         dest = (unsigned char *)lock->data + (y / denom) * lock->pitch;
+
+         if (denom == 1) {
+            convert_row(&fmt, ptr, dest, width);
+         }
+         else if (index_only) {
+            if (y % denom == 0) {
+               png_uint_32 x;
+               for (x = 0; x < out_width; x++)
+                  dest[x] = ptr[x * denom];
+            }
+         }
+         else {
+            convert_row(&fmt, ptr, row, width);
+            add_row_to_box(row, sums, width, denom);
+            if (y % denom == (png_uint_32)denom - 1 || y == height - 1)
+               write_box_row(sums, dest, width, denom, y % denom + 1);
          }
-         dest = dest_row_start + lock->pitch;
       }
    }
 
+   al_free(row);
+   al_free(sums);
+
    al_unlock_bitmap(bmp);
 
    al_free(buf);
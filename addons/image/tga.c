@@ -22,8 +22,11 @@
  */
 
 
+#include <string.h>
+
 #include "allegro5/allegro.h"
 #include "allegro5/allegro_image.h"
+#include "allegro5/internal/aintern.h"
 #include "allegro5/internal/aintern_image.h"
 #include "allegro5/internal/aintern_pixels.h"
 
@@ -31,199 +34,79 @@
 
 
 
-/* raw_tga_read8:
- *  Helper for reading 256-color raw data from TGA files.
+/* TGA_RLE_STATE:
+ *  Decoder state for RLE data.  Packets may run across scanlines, so what is
+ *  left of the current packet is carried over from one line to the next.
  */
-static INLINE unsigned char *raw_tga_read8(unsigned char *b, int w, ALLEGRO_FILE *f)
+typedef struct TGA_RLE_STATE
 {
-   return b + al_fread(f, b, w);
-}
+   int run;                   /* pixels left in the current run packet */
+   int raw;                   /* pixels left in the current raw packet */
+   unsigned char color[4];    /* pixel repeated by the run packet */
+} TGA_RLE_STATE;
 
 
 
-/* rle_tga_read8:
- *  Helper for reading 256-color RLE data from TGA files.
+/* raw_tga_read:
+ *  Helper for reading a line of raw data from TGA files with a single
+ *  al_fread.  Bytes missing at the end of a truncated file read as zero.
  */
-static void rle_tga_read8(unsigned char *b, int w, ALLEGRO_FILE *f)
+static void raw_tga_read(unsigned char *b, int w, int pixel_size,
+   ALLEGRO_FILE *f)
 {
-   int value, count, c = 0;
-
-   do {
-      count = al_fgetc(f);
-      if (count & 0x80) {
-         /* run-length packet */
-         count = (count & 0x7F) + 1;
-         c += count;
-         value = al_fgetc(f);
-         while (count--)
-            *b++ = value;
-      }
-      else {
-         /* raw packet */
-         count++;
-         c += count;
-         b = raw_tga_read8(b, count, f);
-      }
-   } while (c < w);
-}
+   size_t size = (size_t)w * pixel_size;
+   size_t n = al_fread(f, b, size);
 
-
-
-/* single_tga_read32:
- *  Helper for reading a single 32-bit data from TGA files.
- */
-static INLINE int32_t single_tga_read32(ALLEGRO_FILE *f)
-{
-   return al_fread32le(f);
+   if (n < size)
+      memset(b + n, 0, size - n);
 }
 
 
 
-/* raw_tga_read32:
- *  Helper for reading 32-bit raw data from TGA files.
+/* rle_tga_read:
+ *  Helper for reading a line of RLE data from TGA files.  Raw packets are
+ *  read in one go and run packets are expanded from their single pixel.
  */
-static unsigned int *raw_tga_read32(unsigned int *b, int w, ALLEGRO_FILE *f)
+static void rle_tga_read(TGA_RLE_STATE *rle, unsigned char *b, int w,
+   int pixel_size, ALLEGRO_FILE *f)
 {
-   while (w--)
-      *b++ = single_tga_read32(f);
-
-   return b;
-}
-
-
-
-/* rle_tga_read32:
- *  Helper for reading 32-bit RLE data from TGA files.
- */
-static void rle_tga_read32(unsigned int *b, int w, ALLEGRO_FILE *f)
-{
-   int color, count, c = 0;
-
-   do {
-      count = al_fgetc(f);
-      if (count & 0x80) {
-         /* run-length packet */
-         count = (count & 0x7F) + 1;
-         c += count;
-         color = single_tga_read32(f);
-         while (count--)
-            *b++ = color;
-      }
-      else {
-         /* raw packet */
-         count++;
-         c += count;
-         b = raw_tga_read32(b, count, f);
+   int count;
+
+   while (w > 0) {
+      if (rle->run == 0 && rle->raw == 0) {
+         count = al_fgetc(f);
+         if (count == EOF) {
+            memset(b, 0, (size_t)w * pixel_size);
+            return;
+         }
+         if (count & 0x80) {
+            /* run-length packet */
+            rle->run = (count & 0x7F) + 1;
+            raw_tga_read(rle->color, 1, pixel_size, f);
+         }
+         else {
+            /* raw packet */
+            rle->raw = count + 1;
+         }
       }
-   } while (c < w);
-}
-
-
-/* single_tga_read24:
- *  Helper for reading a single 24-bit data from TGA files.
- */
-static INLINE void single_tga_read24(ALLEGRO_FILE *f, unsigned char color[3])
-{
-   al_fread(f, color, 3);
-}
-
-
 
-/* raw_tga_read24:
- *  Helper for reading 24-bit raw data from TGA files.
- */
-static unsigned char *raw_tga_read24(unsigned char *b, int w, ALLEGRO_FILE *f)
-{
-   while (w--) {
-      single_tga_read24(f, b);
-      b += 3;
-   }
-
-   return b;
-}
-
-
-
-/* rle_tga_read24:
- *  Helper for reading 24-bit RLE data from TGA files.
- */
-static void rle_tga_read24(unsigned char *b, int w, ALLEGRO_FILE *f)
-{
-   int count, c = 0;
-   unsigned char color[3];
-
-   do {
-      count = al_fgetc(f);
-      if (count & 0x80) {
-         /* run-length packet */
-         count = (count & 0x7F) + 1;
-         c += count;
-         single_tga_read24(f, color);
+      if (rle->run > 0) {
+         count = _ALLEGRO_MIN(rle->run, w);
+         rle->run -= count;
+         w -= count;
          while (count--) {
-            b[0] = color[0];
-            b[1] = color[1];
-            b[2] = color[2];
-            b += 3;
+            memcpy(b, rle->color, pixel_size);
+            b += pixel_size;
          }
       }
       else {
-         /* raw packet */
-         count++;
-         c += count;
-         b = raw_tga_read24(b, count, f);
+         count = _ALLEGRO_MIN(rle->raw, w);
+         rle->raw -= count;
+         w -= count;
+         raw_tga_read(b, count, pixel_size, f);
+         b += count * pixel_size;
       }
-   } while (c < w);
-}
-
-
-
-/* single_tga_read16:
- *  Helper for reading a single 16-bit data from TGA files.
- */
-static INLINE int single_tga_read16(ALLEGRO_FILE *f)
-{
-   return al_fread16le(f);
-}
-
-
-
-/* raw_tga_read16:
- *  Helper for reading 16-bit raw data from TGA files.
- */
-static unsigned short *raw_tga_read16(unsigned short *b, int w, ALLEGRO_FILE *f)
-{
-   while (w--)
-      *b++ = single_tga_read16(f);
-
-   return b;
-}
-
-
-
-/* rle_tga_read16:
- *  Helper for reading 16-bit RLE data from TGA files.
- */
-static void rle_tga_read16(unsigned short *b, int w, ALLEGRO_FILE *f)
-{
-   int color, count, c = 0;
-
-   do {
-      count = al_fgetc(f);
-      if (count & 0x80) {
-         /* run-length packet */
-         count = (count & 0x7F) + 1;
-         c += count;
-         color = single_tga_read16(f);
-         while (count--)
-            *b++ = color;
-      }
-      else {
-         /* raw packet */
-         count++;
-         c += count;
-         b = raw_tga_read16(b, count, f);
-      }
-   } while (c < w);
+   }
 }
 
 
@@ -245,6 +128,9 @@ ALLEGRO_BITMAP *_al_load_tga_f(ALLEGRO_FILE *f, int flags)
    unsigned int c, i;
    int y;
    int compressed;
+   int pixel_size;
+   TGA_RLE_STATE rle = {0, 0, {0, 0, 0, 0}};
+   unsigned char colors[256][4];
    ALLEGRO_BITMAP *bmp;
    ALLEGRO_LOCKED_REGION *lr;
    unsigned char *buf;
@@ -269,6 +155,8 @@ ALLEGRO_BITMAP *_al_load_tga_f(ALLEGRO_FILE *f, int flags)
 
    al_fread(f, image_id, id_length);
 
+   memset(image_palette, 0, sizeof(image_palette));
+
    if (palette_type == 1) {
 
       for (i = 0; i < palette_colors; i++) {
@@ -366,62 +254,55 @@ ALLEGRO_BITMAP *_al_load_tga_f(ALLEGRO_FILE *f, int flags)
    }
 
    /* bpp + 1 accounts for 15 bpp. */
-   buf = al_malloc(image_width * ((bpp + 1) / 8));
+   pixel_size = (bpp + 1) / 8;
+   buf = al_malloc(image_width * pixel_size);
    if (!buf) {
       al_unlock_bitmap(bmp);
       al_destroy_bitmap(bmp);
       return NULL;
    }
 
+   for (i = 0; i < 256; i++) {
+      colors[i][0] = image_palette[i][2];
+      colors[i][1] = image_palette[i][1];
+      colors[i][2] = image_palette[i][0];
+      colors[i][3] = 255;
+   }
+
    for (y = 0; y < image_height; y++) {
       int true_y = (top_to_bottom) ? y : (image_height - 1 - y);
+      unsigned char *dest = (unsigned char *)lr->data + lr->pitch*true_y;
+      const unsigned char *src = buf;
+      int step = 4;
+
+      if (!left_to_right) {
+         dest += (image_width - 1) * 4;
+         step = -4;
+      }
+
+      if (compressed)
+         rle_tga_read(&rle, buf, image_width, pixel_size, f);
+      else
+         raw_tga_read(buf, image_width, pixel_size, f);
 
       switch (image_type) {
 
          case 1:
          case 3:
-            if (compressed)
-               rle_tga_read8(buf, image_width, f);
-            else
-               raw_tga_read8(buf, image_width, f);
-
             for (i = 0; i < image_width; i++) {
-               int true_x = (left_to_right) ? i : (image_width - 1 - i);
-               int pix = buf[i];
-
-               unsigned char *dest = (unsigned char *)lr->data +
-                  lr->pitch*true_y + true_x*4;
-               dest[0] = image_palette[pix][2];
-               dest[1] = image_palette[pix][1];
-               dest[2] = image_palette[pix][0];
-               dest[3] = 255;
+               memcpy(dest, colors[src[i]], 4);
+               dest += step;
             }
-
             break;
 
          case 2:
             if (bpp == 32) {
-               if (compressed)
-                  rle_tga_read32((unsigned int *)buf, image_width, f);
-               else
-                  raw_tga_read32((unsigned int *)buf, image_width, f);
-
                for (i = 0; i < image_width; i++) {
-                  int true_x = (left_to_right) ? i : (image_width - 1 - i);
-                  unsigned char *dest = (unsigned char *)lr->data +
-                     lr->pitch*true_y + true_x*4;
-
-#ifdef ALLEGRO_BIG_ENDIAN
-                  int a = buf[i * 4 + 0];
-                  int r = buf[i * 4 + 1];
-                  int g = buf[i * 4 + 2];
-                  int b = buf[i * 4 + 3];
-#else					 
-                  int b = buf[i * 4 + 0];
-                  int g = buf[i * 4 + 1];
-                  int r = buf[i * 4 + 2];
-                  int a = buf[i * 4 + 3];
-#endif                  
+                  int b = src[0];
+                  int g = src[1];
+                  int r = src[2];
+                  int a = src[3];
+
                   if (premul) {
                      r = r * a / 255;
                      g = g * a / 255;
@@ -432,45 +313,30 @@ ALLEGRO_BITMAP *_al_load_tga_f(ALLEGRO_FILE *f, int flags)
                   dest[1] = g;
                   dest[2] = b;
                   dest[3] = a;
+                  src += 4;
+                  dest += step;
                }
             }
             else if (bpp == 24) {
-               if (compressed)
-                  rle_tga_read24(buf, image_width, f);
-               else
-                  raw_tga_read24(buf, image_width, f);
                for (i = 0; i < image_width; i++) {
-                  int true_x = (left_to_right) ? i : (image_width - 1 - i);
-                  int b = buf[i * 3 + 0];
-                  int g = buf[i * 3 + 1];
-                  int r = buf[i * 3 + 2];
-
-                  unsigned char *dest = (unsigned char *)lr->data +
-                     lr->pitch*true_y + true_x*4;
-                  dest[0] = r;
-                  dest[1] = g;
-                  dest[2] = b;
+                  dest[0] = src[2];
+                  dest[1] = src[1];
+                  dest[2] = src[0];
                   dest[3] = 255;
+                  src += 3;
+                  dest += step;
                }
             }
             else {
-               if (compressed)
-                  rle_tga_read16((unsigned short *)buf, image_width, f);
-               else
-                  raw_tga_read16((unsigned short *)buf, image_width, f);
                for (i = 0; i < image_width; i++) {
-                  int true_x = (left_to_right) ? i : (image_width - 1 - i);
-                  int pix = *((unsigned short *)(buf + i * 2));
-                  int r = _al_rgb_scale_5[(pix >> 10)];
-                  int g = _al_rgb_scale_5[(pix >> 5) & 0x1F];
-                  int b = _al_rgb_scale_5[(pix & 0x1F)];
-
-                  unsigned char *dest = (unsigned char *)lr->data +
-                     lr->pitch*true_y + true_x*4;
-                  dest[0] = r;
-                  dest[1] = g;
-                  dest[2] = b;
+                  int pix = src[0] | (src[1] << 8);
+
+                  dest[0] = _al_rgb_scale_5[(pix >> 10) & 0x1F];
+                  dest[1] = _al_rgb_scale_5[(pix >> 5) & 0x1F];
+                  dest[2] = _al_rgb_scale_5[(pix & 0x1F)];
                   dest[3] = 255;
+                  src += 2;
+                  dest += step;
                }
             }
             break;
@@ -148,6 +148,30 @@ static off_t memfile_fsize(ALLEGRO_FILE *fp)
    return mf->size;
 }
 
+static const void *memfile_fread_span(ALLEGRO_FILE *fp, size_t size,
+   size_t *ret_size)
+{
+   ALLEGRO_FILE_MEMFILE *mf = al_get_file_userdata(fp);
+   const char *span = mf->mem + mf->pos;
+
+   if (!mf->readable) {
+      al_set_errno(EPERM);
+      return NULL;
+   }
+
+   /* Same as memfile_fread, minus the copy. */
+   if (mf->size - mf->pos < (int64_t)size) {
+      *ret_size = mf->size - mf->pos;
+      mf->eof = true;
+   }
+   else {
+      *ret_size = size;
+   }
+
+   mf->pos += *ret_size;
+   return span;
+}
+
 static struct ALLEGRO_FILE_INTERFACE memfile_vtable = {
    NULL,    /* open */
    memfile_fclose,
@@ -161,7 +185,9 @@ static struct ALLEGRO_FILE_INTERFACE memfile_vtable = {
    memfile_ferrmsg,
    memfile_fclearerr,
    NULL,   /* ungetc */
-   memfile_fsize
+   memfile_fsize,
+   memfile_fread_span,
+   NULL    /* prefetch, everything is resident */
 };
 
 /* Function: al_open_memfile
@@ -18,6 +18,17 @@ struct ALLEGRO_FILE_PHYSFS
    PHYSFS_file *phys;
    bool error_indicator;
    char error_msg[80];
+
+   /* Files read through the block cache.  phys is only opened once a
+    * block isn't cached.
+    */
+   bool cached;
+   unsigned id;
+   char *path;
+   int64_t size;
+   int64_t pos;
+   bool eof;
+   _AL_PHYSFS_BLOCK *lent;  /* behind the last span */
 };
 
 /* forward declaration */
@@ -62,54 +73,196 @@ static void phys_set_errno(ALLEGRO_FILE_PHYSFS *fp)
 
 static void *file_phys_fopen(const char *filename, const char *mode)
 {
-   ALLEGRO_USTR *us;
-   PHYSFS_file *phys;
+   char buf[512];
+   ALLEGRO_USTR *us = NULL;
+   const char *path;
+   PHYSFS_file *phys = NULL;
    ALLEGRO_FILE_PHYSFS *fp;
+   bool reading = streq(mode, "r") || streq(mode, "rb");
+   bool cached = false;
+   unsigned id = 0;
+   int64_t size = -1;
+
+   path = _al_physfs_apply_cwd_buf(filename, buf, sizeof(buf));
+   if (!path) {
+      us = _al_physfs_apply_cwd(filename);
+      path = al_cstr(us);
+   }
 
-   us = _al_physfs_apply_cwd(filename);
+   if (reading) {
+      switch (_al_physfs_lookup(path, &id, &size)) {
+         case _AL_PHYSFS_MISSING:
+            al_ustr_free(us);
+            al_set_errno(ENOENT);
+            return NULL;
+         case _AL_PHYSFS_FOUND:
+            /* Known files are read through the cache without opening
+             * them in PhysFS, unless their blocks have to be read.
+             */
+            cached = _al_physfs_cache_enabled() && size >= 0;
+            break;
+      }
+   }
 
    /* XXX handle '+' modes */
    /* It might be worth adding a function to parse mode strings, to be
     * shared amongst these kinds of addons.
     */
-   if (streq(mode, "r") || streq(mode, "rb"))
-      phys = PHYSFS_openRead(al_cstr(us));
+   if (cached)
+      phys = NULL;
+   else if (reading)
+      phys = PHYSFS_openRead(path);
    else if (streq(mode, "w") || streq(mode, "wb"))
-      phys = PHYSFS_openWrite(al_cstr(us));
+      phys = PHYSFS_openWrite(path);
    else if (streq(mode, "a") || streq(mode, "ab"))
-      phys = PHYSFS_openAppend(al_cstr(us));
+      phys = PHYSFS_openAppend(path);
    else
       phys = NULL;
 
-   al_ustr_free(us);
-
-   if (!phys) {
+   if (!cached && !phys) {
+      al_ustr_free(us);
       phys_set_errno(NULL);
       return NULL;
    }
 
-   fp = al_malloc(sizeof(*fp));
+   if (phys) {
+      _al_physfs_count_physfs_open();
+      if (!reading) {
+         _al_physfs_file_changed(path, true);
+      }
+      else if (_al_physfs_cache_enabled()) {
+         size = PHYSFS_fileLength(phys);
+         if (size >= 0) {
+            id = _al_physfs_remember_file(path, size,
+               PHYSFS_getLastModTime(path));
+            cached = (id != 0);
+         }
+      }
+   }
+
+   fp = al_calloc(1, sizeof(*fp));
+   if (fp && cached) {
+      fp->path = al_malloc(strlen(path) + 1);
+      if (fp->path) {
+         strcpy(fp->path, path);
+      }
+      else {
+         al_free(fp);
+         fp = NULL;
+      }
+   }
+   al_ustr_free(us);
    if (!fp) {
       al_set_errno(ENOMEM);
-      PHYSFS_close(phys);
+      if (phys)
+         PHYSFS_close(phys);
       return NULL;
    }
 
    fp->phys = phys;
    fp->error_indicator = false;
    fp->error_msg[0] = '\0';
+   fp->cached = cached;
+   fp->id = id;
+   fp->size = size;
 
    return fp;
 }
 
 
+/* Reads a block for the cache, opening the file on first use. */
+static bool read_block(void *arg, unsigned index, unsigned char *buf,
+   size_t size)
+{
+   ALLEGRO_FILE_PHYSFS *fp = arg;
+   PHYSFS_sint64 offset = (PHYSFS_sint64)index * _AL_PHYSFS_BLOCK_SIZE;
+
+   if (!fp->phys) {
+      fp->phys = PHYSFS_openRead(fp->path);
+      if (!fp->phys)
+         return false;
+      _al_physfs_count_physfs_open();
+   }
+
+   if (PHYSFS_tell(fp->phys) != offset && !PHYSFS_seek(fp->phys, offset))
+      return false;
+   return PHYSFS_read(fp->phys, buf, 1, size) == (PHYSFS_sint64)size;
+}
+
+
+static _AL_PHYSFS_BLOCK *get_block(ALLEGRO_FILE_PHYSFS *fp, unsigned index)
+{
+   int64_t start = (int64_t)index * _AL_PHYSFS_BLOCK_SIZE;
+   size_t size = _AL_PHYSFS_BLOCK_SIZE;
+   _AL_PHYSFS_BLOCK *block;
+
+   if (fp->size - start < (int64_t)size)
+      size = fp->size - start;
+
+   block = _al_physfs_get_block(fp->id, index, size, read_block, fp);
+   if (!block)
+      phys_set_errno(fp);
+   return block;
+}
+
+
+static void release_lent_block(ALLEGRO_FILE_PHYSFS *fp)
+{
+   if (fp->lent) {
+      _al_physfs_release_block(fp->lent);
+      fp->lent = NULL;
+   }
+}
+
+
+static size_t cached_fread(ALLEGRO_FILE_PHYSFS *fp, unsigned char *buf,
+   size_t size)
+{
+   size_t done = 0;
+
+   release_lent_block(fp);
+
+   while (done < size) {
+      _AL_PHYSFS_BLOCK *block;
+      size_t offset;
+      size_t n;
+
+      if (fp->pos >= fp->size) {
+         fp->eof = true;
+         break;
+      }
+
+      block = get_block(fp, fp->pos / _AL_PHYSFS_BLOCK_SIZE);
+      if (!block)
+         break;
+      offset = fp->pos % _AL_PHYSFS_BLOCK_SIZE;
+      n = block->size - offset;
+      if (n > size - done)
+         n = size - done;
+      memcpy(buf + done, block->data + offset, n);
+      _al_physfs_release_block(block);
+
+      fp->pos += n;
+      done += n;
+   }
+
+   return done;
+}
+
+
 static bool file_phys_fclose(ALLEGRO_FILE *f)
 {
    ALLEGRO_FILE_PHYSFS *fp = cast_stream(f);
    PHYSFS_file *phys_fp = fp->phys;
 
+   release_lent_block(fp);
+   al_free(fp->path);
    al_free(fp);
 
+   /* Cached files may never have needed PhysFS. */
+   if (!phys_fp)
+      return true;
+
    if (PHYSFS_close(phys_fp) != 0) {
       al_set_errno(-1);
       return false;
@@ -127,6 +280,9 @@ static size_t file_phys_fread(ALLEGRO_FILE *f, void *buf, size_t buf_size)
    if (buf_size == 0)
       return 0;
 
+   if (fp->cached)
+      return cached_fread(fp, buf, buf_size);
+
    n = PHYSFS_read(fp->phys, buf, 1, buf_size);
    if (n < 0) {
       phys_set_errno(fp);
@@ -142,6 +298,12 @@ static size_t file_phys_fwrite(ALLEGRO_FILE *f, const void *buf,
    ALLEGRO_FILE_PHYSFS *fp = cast_stream(f);
    PHYSFS_sint64 n;
 
+   if (fp->cached) {
+      /* Only files opened for reading are cached. */
+      al_set_errno(EPERM);
+      return 0;
+   }
+
    n = PHYSFS_write(fp->phys, buf, 1, buf_size);
    if (n < 0) {
       phys_set_errno(fp);
@@ -156,6 +318,9 @@ static bool file_phys_fflush(ALLEGRO_FILE *f)
 {
    ALLEGRO_FILE_PHYSFS *fp = cast_stream(f);
 
+   if (fp->cached)
+      return true;
+
    if (!PHYSFS_flush(fp->phys)) {
       phys_set_errno(fp);
       return false;
@@ -170,6 +335,9 @@ static int64_t file_phys_ftell(ALLEGRO_FILE *f)
    ALLEGRO_FILE_PHYSFS *fp = cast_stream(f);
    PHYSFS_sint64 n;
 
+   if (fp->cached)
+      return fp->pos;
+
    n = PHYSFS_tell(fp->phys);
    if (n < 0) {
       phys_set_errno(fp);
@@ -185,6 +353,26 @@ static bool file_phys_seek(ALLEGRO_FILE *f, int64_t offset, int whence)
    ALLEGRO_FILE_PHYSFS *fp = cast_stream(f);
    PHYSFS_sint64 base;
 
+   if (fp->cached) {
+      release_lent_block(fp);
+      if (whence == ALLEGRO_SEEK_CUR)
+         offset += fp->pos;
+      else if (whence == ALLEGRO_SEEK_END)
+         offset += fp->size;
+      else if (whence != ALLEGRO_SEEK_SET) {
+         al_set_errno(EINVAL);
+         return false;
+      }
+      /* PHYSFS_seek refuses the same. */
+      if (offset < 0 || offset > fp->size) {
+         al_set_errno(EINVAL);
+         return false;
+      }
+      fp->pos = offset;
+      fp->eof = false;
+      return true;
+   }
+
    switch (whence) {
       case ALLEGRO_SEEK_SET:
          base = 0;
@@ -224,6 +412,9 @@ static bool file_phys_feof(ALLEGRO_FILE *f)
 {
    ALLEGRO_FILE_PHYSFS *fp = cast_stream(f);
 
+   if (fp->cached)
+      return fp->eof;
+
    return PHYSFS_eof(fp->phys);
 }
 
@@ -252,6 +443,7 @@ static void file_phys_fclearerr(ALLEGRO_FILE *f)
    ALLEGRO_FILE_PHYSFS *fp = cast_stream(f);
 
    fp->error_indicator = false;
+   fp->eof = false;
 
    /* PhysicsFS doesn't provide a way to clear the EOF indicator. */
 }
@@ -262,6 +454,9 @@ static off_t file_phys_fsize(ALLEGRO_FILE *f)
    ALLEGRO_FILE_PHYSFS *fp = cast_stream(f);
    PHYSFS_sint64 n;
 
+   if (fp->cached)
+      return fp->size;
+
    n = PHYSFS_fileLength(fp->phys);
    if (n < 0) {
       phys_set_errno(fp);
@@ -272,6 +467,72 @@ static off_t file_phys_fsize(ALLEGRO_FILE *f)
 }
 
 
+static const void *file_phys_fread_span(ALLEGRO_FILE *f, size_t size,
+   size_t *ret_size)
+{
+   ALLEGRO_FILE_PHYSFS *fp = cast_stream(f);
+   _AL_PHYSFS_BLOCK *block;
+   size_t offset;
+
+   if (!fp->cached)
+      return NULL;
+
+   release_lent_block(fp);
+
+   if (fp->size - fp->pos < (int64_t)size) {
+      size = fp->size - fp->pos;
+      fp->eof = true;
+   }
+   if (size == 0) {
+      *ret_size = 0;
+      return "";
+   }
+
+   /* Spans can only be lent out of a single block. */
+   offset = fp->pos % _AL_PHYSFS_BLOCK_SIZE;
+   if (offset + size > _AL_PHYSFS_BLOCK_SIZE) {
+      fp->eof = false;
+      return NULL;
+   }
+   block = get_block(fp, fp->pos / _AL_PHYSFS_BLOCK_SIZE);
+   if (!block) {
+      fp->eof = false;
+      return NULL;
+   }
+
+   fp->lent = block;
+   fp->pos += size;
+   *ret_size = size;
+   return block->data + offset;
+}
+
+
+static void file_phys_fprefetch(ALLEGRO_FILE *f, size_t size)
+{
+   ALLEGRO_FILE_PHYSFS *fp = cast_stream(f);
+   int64_t end;
+   int64_t pos;
+
+   if (!fp->cached)
+      return;
+
+   release_lent_block(fp);
+
+   end = fp->pos + size;
+   if (end > fp->size)
+      end = fp->size;
+
+   /* Pull the blocks into the cache; there is nowhere else to keep them. */
+   for (pos = fp->pos - fp->pos % _AL_PHYSFS_BLOCK_SIZE; pos < end;
+         pos += _AL_PHYSFS_BLOCK_SIZE) {
+      _AL_PHYSFS_BLOCK *block = get_block(fp, pos / _AL_PHYSFS_BLOCK_SIZE);
+      if (!block)
+         break;
+      _al_physfs_release_block(block);
+   }
+}
+
+
 static const ALLEGRO_FILE_INTERFACE file_phys_vtable =
 {
    file_phys_fopen,
@@ -286,7 +547,9 @@ static const ALLEGRO_FILE_INTERFACE file_phys_vtable =
    file_phys_ferrmsg,
    file_phys_fclearerr,
    NULL,  /* ungetc */
-   file_phys_fsize
+   file_phys_fsize,
+   file_phys_fread_span,
+   file_phys_fprefetch
 };
 
 
@@ -296,6 +559,42 @@ void al_set_physfs_file_interface(void)
 {
    al_set_new_file_interface(&file_phys_vtable);
    _al_set_physfs_fs_interface();
+   _al_physfs_init_cache();
+}
+
+
+/* Function: al_fopen_physfs_batch
+ */
+int al_fopen_physfs_batch(const char * const *paths, int count,
+   ALLEGRO_FILE **files)
+{
+   int opened = 0;
+   int i;
+   ASSERT(paths || count == 0);
+   ASSERT(files || count == 0);
+
+   for (i = 0; i < count; i++) {
+      ALLEGRO_FILE_PHYSFS *fp;
+
+      files[i] = al_fopen_interface(&file_phys_vtable, paths[i], "rb");
+      if (!files[i])
+         continue;
+      opened++;
+
+      /* Load cached files whole and let go of their PhysFS handles,
+       * which are expensive to keep open for archives.
+       */
+      fp = cast_stream(files[i]);
+      if (fp->cached) {
+         file_phys_fprefetch(files[i], fp->size);
+         if (fp->phys) {
+            PHYSFS_close(fp->phys);
+            fp->phys = NULL;
+         }
+      }
+   }
+
+   return opened;
 }
 
 
@@ -0,0 +1,659 @@
+/*
+ *       Path index and block cache for the PhysFS addon.
+ */
+
+#include <physfs.h>
+#include "allegro5/allegro.h"
+#include "allegro5/allegro_physfs.h"
+#include "allegro5/internal/aintern_exitfunc.h"
+
+#include "allegro_physfs_intern.h"
+
+
+typedef struct INDEX_ENTRY INDEX_ENTRY;
+
+struct INDEX_ENTRY
+{
+   INDEX_ENTRY *next;
+   uint32_t hash;
+   unsigned id;         /* names the contents in the block cache */
+   int64_t size;        /* -1 until known */
+   int64_t mtime;       /* when size was learned, -1 if unknown */
+   double checked;      /* al_get_time() when mtime was last confirmed */
+   bool is_dir;
+   char *path;
+};
+
+#define BLOCK_BUCKETS 1024
+
+/* Seconds for which a file's modification time is trusted without asking
+ * PhysFS again; about the resolution of the times themselves.
+ */
+#define MTIME_CHECK_INTERVAL 1.0
+
+static ALLEGRO_MUTEX *cache_mutex;
+
+static INDEX_ENTRY **entries;
+static unsigned num_buckets;
+static unsigned num_entries;
+static bool index_complete;
+static unsigned next_id = 1;
+static char *search_path;        /* the search path the index is for */
+
+static _AL_PHYSFS_BLOCK *blocks[BLOCK_BUCKETS];
+static _AL_PHYSFS_BLOCK *lru_head;
+static _AL_PHYSFS_BLOCK *lru_tail;
+static size_t cache_budget;
+static size_t cache_used;
+
+static ALLEGRO_PHYSFS_STATS stats;
+
+
+static uint32_t hash_path(const char *path)
+{
+   uint32_t hash = 2166136261u;
+
+   while (*path) {
+      hash ^= (unsigned char)*path++;
+      hash *= 16777619u;
+   }
+   return hash;
+}
+
+
+/* The index holds paths the way PhysFS lists them.  Anything else might
+ * still name a file, so the index can only rule out plain paths.
+ */
+static bool is_plain_path(const char *path)
+{
+   const char *p;
+
+   if (path[0] != '/')
+      return false;
+
+   for (p = path; *p; p++) {
+      if (*p == '/') {
+         if (p[1] == '/' || p[1] == '\0')
+            return false;
+         if (p[1] == '.' && (p[2] == '/' || p[2] == '\0' ||
+               (p[2] == '.' && (p[3] == '/' || p[3] == '\0'))))
+            return false;
+      }
+      else if (*p == '\\' || *p == ':') {
+         return false;
+      }
+   }
+   return true;
+}
+
+
+static INDEX_ENTRY *find_entry(const char *path)
+{
+   uint32_t hash = hash_path(path);
+   INDEX_ENTRY *e;
+
+   if (!num_buckets)
+      return NULL;
+
+   for (e = entries[hash & (num_buckets - 1)]; e; e = e->next) {
+      if (e->hash == hash && strcmp(e->path, path) == 0)
+         return e;
+   }
+   return NULL;
+}
+
+
+static bool grow_index(void)
+{
+   unsigned new_num_buckets = num_buckets ? num_buckets * 2 : 256;
+   INDEX_ENTRY **new_entries;
+   unsigned i;
+
+   new_entries = al_calloc(new_num_buckets, sizeof *new_entries);
+   if (!new_entries)
+      return false;
+
+   for (i = 0; i < num_buckets; i++) {
+      while (entries[i]) {
+         INDEX_ENTRY *e = entries[i];
+         entries[i] = e->next;
+         e->next = new_entries[e->hash & (new_num_buckets - 1)];
+         new_entries[e->hash & (new_num_buckets - 1)] = e;
+      }
+   }
+
+   al_free(entries);
+   entries = new_entries;
+   num_buckets = new_num_buckets;
+   return true;
+}
+
+
+static INDEX_ENTRY *add_entry(const char *path)
+{
+   size_t len = strlen(path);
+   INDEX_ENTRY *e;
+
+   if (num_entries >= num_buckets && !grow_index())
+      return NULL;
+
+   e = al_malloc(sizeof *e + len + 1);
+   if (!e)
+      return NULL;
+   e->path = (char *)(e + 1);
+   memcpy(e->path, path, len + 1);
+   e->hash = hash_path(path);
+   e->id = next_id++;
+   e->size = -1;
+   e->mtime = -1;
+   e->checked = 0.0;
+   e->is_dir = false;
+
+   e->next = entries[e->hash & (num_buckets - 1)];
+   entries[e->hash & (num_buckets - 1)] = e;
+   num_entries++;
+   return e;
+}
+
+
+static void remove_entry(INDEX_ENTRY *e)
+{
+   INDEX_ENTRY **link = &entries[e->hash & (num_buckets - 1)];
+
+   while (*link != e)
+      link = &(*link)->next;
+   *link = e->next;
+   al_free(e);
+   num_entries--;
+}
+
+
+static void clear_entries(void)
+{
+   unsigned i;
+
+   for (i = 0; i < num_buckets; i++) {
+      while (entries[i]) {
+         INDEX_ENTRY *e = entries[i];
+         entries[i] = e->next;
+         al_free(e);
+      }
+   }
+   al_free(entries);
+   entries = NULL;
+   num_buckets = 0;
+   num_entries = 0;
+   index_complete = false;
+}
+
+
+static unsigned block_bucket(unsigned id, unsigned index)
+{
+   return (id * 2654435761u ^ index * 40503u) & (BLOCK_BUCKETS - 1);
+}
+
+
+static _AL_PHYSFS_BLOCK *find_block(unsigned id, unsigned index)
+{
+   _AL_PHYSFS_BLOCK *b;
+
+   for (b = blocks[block_bucket(id, index)]; b; b = b->hash_next) {
+      if (b->id == id && b->index == index)
+         return b;
+   }
+   return NULL;
+}
+
+
+static void unlink_lru(_AL_PHYSFS_BLOCK *b)
+{
+   if (b->lru_prev)
+      b->lru_prev->lru_next = b->lru_next;
+   else
+      lru_head = b->lru_next;
+   if (b->lru_next)
+      b->lru_next->lru_prev = b->lru_prev;
+   else
+      lru_tail = b->lru_prev;
+}
+
+
+static void link_lru(_AL_PHYSFS_BLOCK *b)
+{
+   b->lru_prev = NULL;
+   b->lru_next = lru_head;
+   if (lru_head)
+      lru_head->lru_prev = b;
+   else
+      lru_tail = b;
+   lru_head = b;
+}
+
+
+/* Takes the block out of the cache.  Blocks still lent out to files
+ * are freed when released.
+ */
+static void drop_block(_AL_PHYSFS_BLOCK *b)
+{
+   _AL_PHYSFS_BLOCK **link = &blocks[block_bucket(b->id, b->index)];
+
+   while (*link != b)
+      link = &(*link)->hash_next;
+   *link = b->hash_next;
+   unlink_lru(b);
+   cache_used -= b->size;
+   b->cached = false;
+   if (b->refcount == 0)
+      al_free(b);
+}
+
+
+static void evict_blocks(size_t budget)
+{
+   while (lru_tail && cache_used > budget)
+      drop_block(lru_tail);
+}
+
+
+/* Forgets the index if the PhysFS search path changed since it was
+ * made, as any path may then name a different file, or none.  Walking
+ * the search path is too slow for every open, so this is only done when
+ * the index is built or revalidated.
+ */
+static void check_search_path(void)
+{
+   char **list = PHYSFS_getSearchPath();
+   char **dir;
+   ALLEGRO_USTR *joined;
+
+   if (!list)
+      return;
+
+   joined = al_ustr_new("");
+   for (dir = list; *dir; dir++) {
+      al_ustr_append_cstr(joined, *dir);
+      al_ustr_append_chr(joined, '\n');
+   }
+   PHYSFS_freeList(list);
+
+   if (!search_path || strcmp(search_path, al_cstr(joined)) != 0) {
+      /* Also when there are no entries, or index_complete would stay. */
+      clear_entries();
+      evict_blocks(0);
+      al_free(search_path);
+      search_path = al_malloc(al_ustr_size(joined) + 1);
+      if (search_path)
+         strcpy(search_path, al_cstr(joined));
+   }
+   al_ustr_free(joined);
+}
+
+
+static void shutdown_cache(void)
+{
+   evict_blocks(0);
+   clear_entries();
+   al_free(search_path);
+   search_path = NULL;
+   cache_budget = 0;
+   memset(&stats, 0, sizeof stats);
+   al_destroy_mutex(cache_mutex);
+   cache_mutex = NULL;
+}
+
+
+/* Recursively adds everything below dir, which ends in a slash. */
+static bool index_directory(ALLEGRO_USTR *dir)
+{
+   int size = al_ustr_size(dir);
+   char **list;
+   char **name;
+   bool ok = true;
+
+   list = PHYSFS_enumerateFiles(al_cstr(dir));
+   if (!list)
+      return false;
+
+   for (name = list; *name && ok; name++) {
+      INDEX_ENTRY *e;
+
+      al_ustr_append_cstr(dir, *name);
+      e = find_entry(al_cstr(dir));
+      if (!e)
+         e = add_entry(al_cstr(dir));
+      if (!e) {
+         ok = false;
+      }
+      else if (PHYSFS_isDirectory(al_cstr(dir))) {
+         e->is_dir = true;
+         al_ustr_append_chr(dir, '/');
+         ok = index_directory(dir);
+      }
+      al_ustr_truncate(dir, size);
+   }
+
+   PHYSFS_freeList(list);
+   return ok;
+}
+
+
+void _al_physfs_init_cache(void)
+{
+   if (cache_mutex)
+      return;
+
+   cache_mutex = al_create_mutex();
+   if (cache_mutex)
+      _al_add_exit_func(shutdown_cache, "shutdown_physfs_cache");
+}
+
+
+bool _al_physfs_cache_enabled(void)
+{
+   return cache_budget > 0;
+}
+
+
+/* Looks up a path about to be opened for reading, returning its id in
+ * the block cache and its size (or -1) if found.
+ */
+int _al_physfs_lookup(const char *path, unsigned *id, int64_t *size)
+{
+   INDEX_ENTRY *e;
+   double now;
+   int ret;
+
+   if (!cache_mutex)
+      return _AL_PHYSFS_UNKNOWN;
+
+   now = al_get_time();
+   al_lock_mutex(cache_mutex);
+   stats.opens++;
+   e = find_entry(path);
+   if (e && !e->is_dir && e->size >= 0 &&
+         now - e->checked >= MTIME_CHECK_INTERVAL) {
+      /* The file may be served from the cache alone, so make sure it
+       * wasn't changed or removed behind our back.
+       */
+      int64_t mtime = PHYSFS_getLastModTime(path);
+      if (mtime < 0 && !PHYSFS_exists(path)) {
+         remove_entry(e);
+         e = NULL;
+      }
+      else if (mtime != e->mtime) {
+         e->id = next_id++;
+         e->size = -1;
+         e->mtime = -1;
+      }
+      else {
+         e->checked = now;
+      }
+   }
+   if (e && !e->is_dir) {
+      *id = e->id;
+      *size = e->size;
+      stats.index_hits++;
+      ret = _AL_PHYSFS_FOUND;
+   }
+   else if (index_complete && is_plain_path(path)) {
+      stats.index_rejects++;
+      ret = _AL_PHYSFS_MISSING;
+   }
+   else {
+      ret = _AL_PHYSFS_UNKNOWN;
+   }
+   al_unlock_mutex(cache_mutex);
+   return ret;
+}
+
+
+/* Records the size and modification time of a file PhysFS has opened.
+ * Returns its id in the block cache, or 0 if out of memory.
+ */
+unsigned _al_physfs_remember_file(const char *path, int64_t size,
+   int64_t mtime)
+{
+   INDEX_ENTRY *e;
+   double now;
+   unsigned id = 0;
+
+   if (!cache_mutex)
+      return 0;
+
+   now = al_get_time();
+   al_lock_mutex(cache_mutex);
+   e = find_entry(path);
+   if (!e)
+      e = add_entry(path);
+   if (e) {
+      if (e->size != size || e->mtime != mtime) {
+         /* Blocks cached under the old id don't match this file. */
+         if (e->size >= 0)
+            e->id = next_id++;
+         e->size = size;
+         e->mtime = mtime;
+      }
+      e->checked = now;
+      id = e->id;
+   }
+   al_unlock_mutex(cache_mutex);
+   return id;
+}
+
+
+/* Called when a file is written to or removed through the addon. */
+void _al_physfs_file_changed(const char *path, bool exists)
+{
+   INDEX_ENTRY *e;
+
+   if (!cache_mutex)
+      return;
+
+   al_lock_mutex(cache_mutex);
+   e = find_entry(path);
+   if (!exists) {
+      if (e)
+         remove_entry(e);
+   }
+   else if (e) {
+      e->id = next_id++;
+      e->size = -1;
+      e->mtime = -1;
+      e->is_dir = false;
+   }
+   else if (index_complete && is_plain_path(path)) {
+      add_entry(path);
+   }
+   al_unlock_mutex(cache_mutex);
+}
+
+
+void _al_physfs_count_physfs_open(void)
+{
+   if (!cache_mutex)
+      return;
+
+   al_lock_mutex(cache_mutex);
+   stats.physfs_opens++;
+   al_unlock_mutex(cache_mutex);
+}
+
+
+/* Returns the given block of a file, calling read to fill it in if it
+ * isn't cached.  The block must be released again.
+ */
+_AL_PHYSFS_BLOCK *_al_physfs_get_block(unsigned id, unsigned index,
+   size_t size, bool (*read)(void *arg, unsigned index, unsigned char *buf,
+   size_t size), void *arg)
+{
+   _AL_PHYSFS_BLOCK *b;
+   _AL_PHYSFS_BLOCK *other;
+
+   al_lock_mutex(cache_mutex);
+   b = find_block(id, index);
+   if (b) {
+      b->refcount++;
+      unlink_lru(b);
+      link_lru(b);
+      stats.cache_hits++;
+      al_unlock_mutex(cache_mutex);
+      return b;
+   }
+   stats.cache_misses++;
+   al_unlock_mutex(cache_mutex);
+
+   /* Read without holding the lock; PhysFS may have to decompress. */
+   b = al_malloc(sizeof *b + size);
+   if (!b)
+      return NULL;
+   b->data = (unsigned char *)(b + 1);
+   b->size = size;
+   b->id = id;
+   b->index = index;
+   b->refcount = 1;
+   b->cached = false;
+   if (!read(arg, index, b->data, size)) {
+      al_free(b);
+      return NULL;
+   }
+
+   al_lock_mutex(cache_mutex);
+   stats.bytes_read += size;
+   other = find_block(id, index);
+   if (other) {
+      /* Another file read the same block meanwhile. */
+      other->refcount++;
+      al_unlock_mutex(cache_mutex);
+      al_free(b);
+      return other;
+   }
+   if (cache_budget > 0) {
+      b->hash_next = blocks[block_bucket(id, index)];
+      blocks[block_bucket(id, index)] = b;
+      link_lru(b);
+      b->cached = true;
+      cache_used += size;
+      evict_blocks(cache_budget);
+   }
+   al_unlock_mutex(cache_mutex);
+   return b;
+}
+
+
+void _al_physfs_release_block(_AL_PHYSFS_BLOCK *b)
+{
+   al_lock_mutex(cache_mutex);
+   b->refcount--;
+   if (b->refcount == 0 && !b->cached)
+      al_free(b);
+   al_unlock_mutex(cache_mutex);
+}
+
+
+/* Function: al_build_physfs_index
+ */
+bool al_build_physfs_index(void)
+{
+   ALLEGRO_USTR *dir;
+   bool ok;
+
+   _al_physfs_init_cache();
+   if (!cache_mutex)
+      return false;
+
+   al_lock_mutex(cache_mutex);
+   check_search_path();
+   clear_entries();
+   evict_blocks(0);
+   dir = al_ustr_new("/");
+   ok = index_directory(dir);
+   al_ustr_free(dir);
+   if (ok)
+      index_complete = true;
+   else
+      clear_entries();
+   al_unlock_mutex(cache_mutex);
+   return ok;
+}
+
+
+/* Function: al_revalidate_physfs_index
+ */
+void al_revalidate_physfs_index(void)
+{
+   unsigned i;
+   INDEX_ENTRY *e;
+
+   if (!cache_mutex)
+      return;
+
+   al_lock_mutex(cache_mutex);
+   check_search_path();
+   for (i = 0; i < num_buckets; i++) {
+      for (e = entries[i]; e; e = e->next)
+         e->checked = -MTIME_CHECK_INTERVAL;
+   }
+   al_unlock_mutex(cache_mutex);
+}
+
+
+/* Function: al_clear_physfs_index
+ */
+void al_clear_physfs_index(void)
+{
+   if (!cache_mutex)
+      return;
+
+   al_lock_mutex(cache_mutex);
+   clear_entries();
+   evict_blocks(0);
+   al_unlock_mutex(cache_mutex);
+}
+
+
+/* Function: al_set_physfs_cache_size
+ */
+void al_set_physfs_cache_size(size_t size)
+{
+   _al_physfs_init_cache();
+   if (!cache_mutex)
+      return;
+
+   al_lock_mutex(cache_mutex);
+   cache_budget = size;
+   evict_blocks(cache_budget);
+   al_unlock_mutex(cache_mutex);
+}
+
+
+/* Function: al_get_physfs_stats
+ */
+void al_get_physfs_stats(ALLEGRO_PHYSFS_STATS *s)
+{
+   ASSERT(s);
+
+   if (!cache_mutex) {
+      memset(s, 0, sizeof *s);
+      return;
+   }
+
+   al_lock_mutex(cache_mutex);
+   *s = stats;
+   s->cache_size = cache_used;
+   al_unlock_mutex(cache_mutex);
+}
+
+
+/* Function: al_reset_physfs_stats
+ */
+void al_reset_physfs_stats(void)
+{
+   if (!cache_mutex)
+      return;
+
+   al_lock_mutex(cache_mutex);
+   memset(&stats, 0, sizeof stats);
+   al_unlock_mutex(cache_mutex);
+}
+
+/* vim: set sts=3 sw=3 et: */
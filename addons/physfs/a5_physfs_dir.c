@@ -66,6 +66,25 @@ ALLEGRO_USTR *_al_physfs_apply_cwd(const char *path)
    return us;
 }
 
+/* Like _al_physfs_apply_cwd, but without allocating.  Returns NULL if
+ * the result doesn't fit into buf.
+ */
+const char *_al_physfs_apply_cwd_buf(const char *path, char *buf,
+   size_t size)
+{
+   size_t cwd_len = 0;
+   size_t path_len = strlen(path);
+
+   if (!path_is_absolute(path))
+      cwd_len = strlen(fs_phys_cwd);
+   if (cwd_len + path_len >= size)
+      return NULL;
+
+   memcpy(buf, fs_phys_cwd, cwd_len);
+   memcpy(buf + cwd_len, path, path_len + 1);
+   return buf;
+}
+
 static ALLEGRO_FS_ENTRY *fs_phys_create_entry(const char *path)
 {
    ALLEGRO_FS_ENTRY_PHYSFS *e;
@@ -150,6 +169,8 @@ static bool fs_phys_remove_filename(const char *path)
 
    us = _al_physfs_apply_cwd(path);
    ret = PHYSFS_delete(al_cstr(us)) ? true : false;
+   if (ret)
+      _al_physfs_file_changed(al_cstr(us), false);
    al_ustr_free(us);
    return ret;
 }
@@ -215,7 +236,11 @@ static bool fs_phys_entry_exists(ALLEGRO_FS_ENTRY *fse)
 static bool fs_phys_remove_entry(ALLEGRO_FS_ENTRY *fse)
 {
    ALLEGRO_FS_ENTRY_PHYSFS *e = (ALLEGRO_FS_ENTRY_PHYSFS *)fse;
-   return PHYSFS_delete(e->path_cstr) != 0;
+
+   if (!PHYSFS_delete(e->path_cstr))
+      return false;
+   _al_physfs_file_changed(e->path_cstr, false);
+   return true;
 }
 
 static bool fs_phys_open_directory(ALLEGRO_FS_ENTRY *fse)
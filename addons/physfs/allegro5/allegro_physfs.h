@@ -30,9 +30,35 @@ extern "C" {
 #endif
 
 
+/* Type: ALLEGRO_PHYSFS_STATS
+ */
+typedef struct ALLEGRO_PHYSFS_STATS ALLEGRO_PHYSFS_STATS;
+
+struct ALLEGRO_PHYSFS_STATS
+{
+   int64_t opens;
+   int64_t index_hits;
+   int64_t index_rejects;
+   int64_t physfs_opens;
+   int64_t cache_hits;
+   int64_t cache_misses;
+   int64_t bytes_read;
+   size_t cache_size;
+};
+
+
 ALLEGRO_PHYSFS_FUNC(void, al_set_physfs_file_interface, (void));
 ALLEGRO_PHYSFS_FUNC(uint32_t, al_get_allegro_physfs_version, (void));
 
+ALLEGRO_PHYSFS_FUNC(bool, al_build_physfs_index, (void));
+ALLEGRO_PHYSFS_FUNC(void, al_revalidate_physfs_index, (void));
+ALLEGRO_PHYSFS_FUNC(void, al_clear_physfs_index, (void));
+ALLEGRO_PHYSFS_FUNC(void, al_set_physfs_cache_size, (size_t size));
+ALLEGRO_PHYSFS_FUNC(int, al_fopen_physfs_batch, (const char * const *paths,
+   int count, ALLEGRO_FILE **files));
+ALLEGRO_PHYSFS_FUNC(void, al_get_physfs_stats, (ALLEGRO_PHYSFS_STATS *stats));
+ALLEGRO_PHYSFS_FUNC(void, al_reset_physfs_stats, (void));
+
 
 #ifdef __cplusplus
 }
@@ -4,5 +4,46 @@
 void _al_set_physfs_fs_interface(void);
 const ALLEGRO_FILE_INTERFACE *_al_get_phys_vtable(void);
 ALLEGRO_USTR *_al_physfs_apply_cwd(const char *path);
+const char *_al_physfs_apply_cwd_buf(const char *path, char *buf,
+   size_t size);
+
+/* Path index and block cache, in a5_physfs_cache.c. */
+
+#define _AL_PHYSFS_BLOCK_SIZE 65536
+
+enum {
+   _AL_PHYSFS_MISSING,  /* the index says there is no such file */
+   _AL_PHYSFS_UNKNOWN,  /* ask PhysFS */
+   _AL_PHYSFS_FOUND
+};
+
+typedef struct _AL_PHYSFS_BLOCK _AL_PHYSFS_BLOCK;
+
+struct _AL_PHYSFS_BLOCK
+{
+   unsigned char *data;
+   size_t size;
+
+   /* Private to the cache. */
+   unsigned id;
+   unsigned index;
+   int refcount;
+   bool cached;
+   _AL_PHYSFS_BLOCK *hash_next;
+   _AL_PHYSFS_BLOCK *lru_prev;
+   _AL_PHYSFS_BLOCK *lru_next;
+};
+
+void _al_physfs_init_cache(void);
+bool _al_physfs_cache_enabled(void);
+int _al_physfs_lookup(const char *path, unsigned *id, int64_t *size);
+unsigned _al_physfs_remember_file(const char *path, int64_t size,
+   int64_t mtime);
+void _al_physfs_file_changed(const char *path, bool exists);
+void _al_physfs_count_physfs_open(void);
+_AL_PHYSFS_BLOCK *_al_physfs_get_block(unsigned id, unsigned index,
+   size_t size, bool (*read)(void *arg, unsigned index, unsigned char *buf,
+   size_t size), void *arg);
+void _al_physfs_release_block(_AL_PHYSFS_BLOCK *block);
 
 #endif
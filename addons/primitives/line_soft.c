@@ -633,7 +633,7 @@ void al_draw_soft_line(ALLEGRO_VERTEX* v1, ALLEGRO_VERTEX* v2, uintptr_t state,
 
    if (al_is_bitmap_locked(target)) {
       if (!_al_bitmap_region_is_locked(target, min_x, min_y, max_x - min_x, max_y - min_y) ||
-          _al_pixel_format_is_video_only(target->locked_region.format))
+          _al_pixel_format_is_compressed(target->locked_region.format))
          return;
    } else {
       if (!(lr = al_lock_bitmap_region(target, min_x, min_y, max_x - min_x, max_y - min_y, ALLEGRO_PIXEL_FORMAT_ANY, 0)))
@@ -114,7 +114,7 @@ int _al_draw_prim_soft(ALLEGRO_BITMAP* texture, const void* vtxs, const ALLEGRO_
    use_cache = num_vtx < ALLEGRO_VERTEX_CACHE_SIZE;
 
    if (texture)
-      al_lock_bitmap(texture, ALLEGRO_PIXEL_FORMAT_ANY, ALLEGRO_LOCK_READONLY);
+      _al_lock_bitmap_for_sampling(texture);
       
    if (use_cache) {
       int ii;
@@ -317,7 +317,7 @@ int _al_draw_prim_indexed_soft(ALLEGRO_BITMAP* texture, const void* vtxs, const
    }
 
    if (texture)
-      al_lock_bitmap(texture, ALLEGRO_PIXEL_FORMAT_ANY, ALLEGRO_LOCK_READONLY);
+      _al_lock_bitmap_for_sampling(texture);
       
    if (use_cache) {
       int ii;
@@ -1,6 +1,7 @@
 set(ALLEGRO_SRC_FILES
     src/allegro.c
     src/bitmap.c
+    src/bitmap_atlas.c
     src/bitmap_draw.c
     src/bitmap_io.c
     src/bitmap_lock.c
@@ -16,6 +17,7 @@ set(ALLEGRO_SRC_FILES
     src/display_settings.c
     src/drawing.c
     src/dtor.c
+    src/dxt.c
     src/events.c
     src/evtsrc.c
     src/exitfunc.c
@@ -23,6 +25,7 @@ set(ALLEGRO_SRC_FILES
     src/file_slice.c
     src/file_stdio.c
     src/fshook.c
+    src/fshook_scan.c
     src/fshook_stdio.c
     src/fullscreen_mode.c
     src/haptic.c
@@ -34,11 +37,13 @@ set(ALLEGRO_SRC_FILES
     src/memblit.c
     src/memdraw.c
     src/memory.c
+    src/mempool.c
     src/monitor.c
     src/mousenu.c
     src/mouse_cursor.c
     src/path.c
     src/pixels.c
+    src/profile.c
     src/shader.c
     src/system.c
     src/threads.c
@@ -50,6 +55,7 @@ set(ALLEGRO_SRC_FILES
     src/utf8.c
     src/misc/aatree.c
     src/misc/bstrlib.c
+    src/misc/hash.c
     src/misc/list.c
     src/misc/vector.c
     )
@@ -242,6 +248,7 @@ set(ALLEGRO_INCLUDE_ALLEGRO_FILES
     include/allegro5/mouse.h
     include/allegro5/mouse_cursor.h
     include/allegro5/path.h
+    include/allegro5/profile.h
     include/allegro5/render_state.h
     include/allegro5/shader.h
     include/allegro5/system.h
@@ -21,6 +21,7 @@ set(PAGES
     monitor
     mouse
     path
+    profile
     state
     system
     threads
@@ -0,0 +1,180 @@
+/*
+ *    Example program for the Allegro library.
+ *
+ *    Bake images into DXT compressed DDS files ahead of time.  Each image
+ *    named on the command line is loaded into a memory bitmap, compressed
+ *    with Allegro's own DXT encoder and saved next to the original with a
+ *    .dds extension.  The compression error and size are reported.
+ *
+ *    The options --dxt1, --dxt3 and --dxt5 select the format for the files
+ *    named after them.  By default DXT5 is used for images with alpha and
+ *    DXT1 for those without.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_image.h>
+
+#include "common.c"
+
+
+/* Root mean square error over all four channels, in 0-255 units. */
+static double compare(ALLEGRO_BITMAP *a, ALLEGRO_BITMAP *b)
+{
+   ALLEGRO_LOCKED_REGION *lra, *lrb;
+   int w = al_get_bitmap_width(a);
+   int h = al_get_bitmap_height(a);
+   double sum = 0;
+   int x, y;
+
+   lra = al_lock_bitmap(a, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE,
+      ALLEGRO_LOCK_READONLY);
+   lrb = al_lock_bitmap(b, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE,
+      ALLEGRO_LOCK_READONLY);
+
+   for (y = 0; y < h; y++) {
+      unsigned char *pa = (unsigned char *)lra->data + y * lra->pitch;
+      unsigned char *pb = (unsigned char *)lrb->data + y * lrb->pitch;
+      for (x = 0; x < w * 4; x++) {
+         double d = pa[x] - pb[x];
+         sum += d * d;
+      }
+   }
+
+   al_unlock_bitmap(a);
+   al_unlock_bitmap(b);
+
+   return sqrt(sum / (w * h * 4.0));
+}
+
+
+static const char *format_name(int format)
+{
+   switch (format) {
+      case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT1:
+         return "DXT1";
+      case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT3:
+         return "DXT3";
+      default:
+         return "DXT5";
+   }
+}
+
+
+static bool has_alpha(ALLEGRO_BITMAP *bmp)
+{
+   ALLEGRO_LOCKED_REGION *lr;
+   int w = al_get_bitmap_width(bmp);
+   int h = al_get_bitmap_height(bmp);
+   bool alpha = false;
+   int x, y;
+
+   lr = al_lock_bitmap(bmp, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE,
+      ALLEGRO_LOCK_READONLY);
+   for (y = 0; y < h && !alpha; y++) {
+      unsigned char *p = (unsigned char *)lr->data + y * lr->pitch;
+      for (x = 0; x < w; x++) {
+         if (p[x * 4 + 3] != 255) {
+            alpha = true;
+            break;
+         }
+      }
+   }
+   al_unlock_bitmap(bmp);
+
+   return alpha;
+}
+
+
+static bool bake(const char *filename, int format)
+{
+   ALLEGRO_BITMAP *bmp, *dxt;
+   ALLEGRO_PATH *path;
+   double t0, t1;
+   int w, h;
+   bool ret;
+
+   al_set_new_bitmap_format(ALLEGRO_PIXEL_FORMAT_ANY);
+   bmp = al_load_bitmap(filename);
+   if (!bmp) {
+      log_printf("%s: failed to load\n", filename);
+      return false;
+   }
+   w = al_get_bitmap_width(bmp);
+   h = al_get_bitmap_height(bmp);
+
+   if (format == ALLEGRO_PIXEL_FORMAT_ANY) {
+      format = has_alpha(bmp) ? ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT5 :
+         ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT1;
+   }
+
+   t0 = al_get_time();
+   al_set_new_bitmap_format(format);
+   dxt = al_clone_bitmap(bmp);
+   t1 = al_get_time();
+   if (!dxt) {
+      log_printf("%s: failed to compress\n", filename);
+      al_destroy_bitmap(bmp);
+      return false;
+   }
+
+   path = al_create_path(filename);
+   al_set_path_extension(path, ".dds");
+   ret = al_save_bitmap(al_path_cstr(path, ALLEGRO_NATIVE_PATH_SEP), dxt);
+
+   log_printf("%s -> %s: %dx%d %s, %d KiB -> %d KiB, "
+      "RMS error %.2f, %.1f Mpixel/s%s\n",
+      filename, al_get_path_filename(path), w, h, format_name(format),
+      w * h * 4 / 1024,
+      ((w + 3) / 4) * ((h + 3) / 4) * al_get_pixel_block_size(format) / 1024,
+      compare(bmp, dxt), w * h / (t1 - t0) / 1e6,
+      ret ? "" : " (SAVE FAILED)");
+
+   al_destroy_path(path);
+   al_destroy_bitmap(dxt);
+   al_destroy_bitmap(bmp);
+   return ret;
+}
+
+
+int main(int argc, char **argv)
+{
+   int format = ALLEGRO_PIXEL_FORMAT_ANY;
+   int failed = 0;
+   int i;
+
+   if (!al_init()) {
+      abort_example("Could not init Allegro.\n");
+   }
+   if (!al_init_image_addon()) {
+      abort_example("Could not init image addon.\n");
+   }
+   open_log();
+
+   if (argc < 2) {
+      log_printf("Usage: %s [--dxt1 | --dxt3 | --dxt5] image...\n", argv[0]);
+      close_log(true);
+      return 1;
+   }
+
+   al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP);
+
+   for (i = 1; i < argc; i++) {
+      if (0 == strcmp(argv[i], "--dxt1"))
+         format = ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT1;
+      else if (0 == strcmp(argv[i], "--dxt3"))
+         format = ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT3;
+      else if (0 == strcmp(argv[i], "--dxt5"))
+         format = ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT5;
+      else if (!bake(argv[i], format))
+         failed++;
+   }
+
+   close_log(failed > 0);
+
+   return failed > 0;
+}
+
+/* vim: set sts=3 sw=3 et: */
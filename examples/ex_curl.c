@@ -348,7 +348,9 @@ static ALLEGRO_FILE_INTERFACE curl_file_vtable =
    curl_file_ferrmsg,
    curl_file_fclearerr,
    curl_file_fungetc,
-   curl_file_fsize
+   curl_file_fsize,
+   NULL,
+   NULL
 };
 
 
@@ -0,0 +1,192 @@
+/*
+ *    Example program for the Allegro library.
+ *
+ *    Benchmark the image loaders.  Each argument is either an image file or
+ *    a test_driver style .ini file, e.g. tests/manual_bmpsuite1.ini, whose
+ *    [bitmaps] section lists the files to load relative to the .ini file.
+ *    Every file is loaded into a memory bitmap repeatedly and the decoding
+ *    speed is reported in MB/s of file data, per file and per format.
+ *
+ *    The options --half, --quarter and --eighth apply the matching
+ *    ALLEGRO_LOAD_*_SIZE flag to all files named after them.
+ *
+ *    The bitmap suites can be fetched with tests/grab_bitmap_suites.sh.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_image.h>
+
+#include "common.c"
+
+/* Minimum time spent loading each file. */
+#define MIN_TIME     0.25
+#define MAX_FORMATS  16
+
+typedef struct FORMAT_STATS {
+   char ext[16];
+   int files;
+   double bytes;
+   double seconds;
+} FORMAT_STATS;
+
+static FORMAT_STATS formats[MAX_FORMATS];
+static int num_formats;
+static int num_failed;
+static int load_flags;
+
+
+static FORMAT_STATS *get_format_stats(const char *filename)
+{
+   const char *ext = strrchr(filename, '.');
+   int i;
+
+   if (!ext)
+      ext = "";
+
+   for (i = 0; i < num_formats; i++) {
+      if (0 == strcmp(formats[i].ext, ext))
+         return &formats[i];
+   }
+   if (num_formats == MAX_FORMATS)
+      return NULL;
+
+   strncpy(formats[num_formats].ext, ext, sizeof(formats[0].ext) - 1);
+   return &formats[num_formats++];
+}
+
+
+static void bench_file(const char *filename)
+{
+   ALLEGRO_FILE *f;
+   ALLEGRO_BITMAP *bmp;
+   FORMAT_STATS *stats;
+   int64_t size;
+   double t0, t;
+   int rounds = 0;
+
+   f = al_fopen(filename, "rb");
+   if (!f) {
+      log_printf("%-40s cannot open\n", filename);
+      num_failed++;
+      return;
+   }
+   size = al_fsize(f);
+   al_fclose(f);
+
+   /* Load once untimed, which also warms the file cache. */
+   bmp = al_load_bitmap_flags(filename, load_flags);
+   if (!bmp) {
+      log_printf("%-40s failed to load\n", filename);
+      num_failed++;
+      return;
+   }
+   al_destroy_bitmap(bmp);
+
+   t0 = al_get_time();
+   do {
+      bmp = al_load_bitmap_flags(filename, load_flags);
+      al_destroy_bitmap(bmp);
+      rounds++;
+      t = al_get_time() - t0;
+   } while (t < MIN_TIME);
+
+   log_printf("%-40s %8.2f MB/s\n", filename,
+      (double)size * rounds / t / 1e6);
+
+   stats = get_format_stats(filename);
+   if (stats) {
+      stats->files++;
+      stats->bytes += (double)size * rounds;
+      stats->seconds += t;
+   }
+}
+
+
+static void bench_ini(const char *filename)
+{
+   ALLEGRO_CONFIG *cfg;
+   ALLEGRO_CONFIG_ENTRY *iter;
+   ALLEGRO_PATH *dir;
+   const char *key;
+
+   cfg = al_load_config_file(filename);
+   if (!cfg) {
+      abort_example("Error loading %s\n", filename);
+   }
+
+   dir = al_create_path(filename);
+   al_set_path_filename(dir, NULL);
+
+   for (key = al_get_first_config_entry(cfg, "bitmaps", &iter);
+        key != NULL;
+        key = al_get_next_config_entry(&iter)) {
+      const char *value = al_get_config_value(cfg, "bitmaps", key);
+      ALLEGRO_PATH *path = al_create_path(value);
+
+      al_rebase_path(dir, path);
+      bench_file(al_path_cstr(path, ALLEGRO_NATIVE_PATH_SEP));
+      al_destroy_path(path);
+   }
+
+   al_destroy_path(dir);
+   al_destroy_config(cfg);
+}
+
+
+int main(int argc, char **argv)
+{
+   double bytes = 0;
+   double seconds = 0;
+   int i;
+
+   if (!al_init()) {
+      abort_example("Could not init Allegro.\n");
+   }
+   if (!al_init_image_addon()) {
+      abort_example("Could not init image addon.\n");
+   }
+   open_log();
+
+   if (argc < 2) {
+      log_printf("Usage: %s [--half | --quarter | --eighth] "
+         "{image | file.ini}...\n", argv[0]);
+      close_log(true);
+      return 1;
+   }
+
+   al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP);
+
+   for (i = 1; i < argc; i++) {
+      const char *ext = strrchr(argv[i], '.');
+      if (0 == strcmp(argv[i], "--half"))
+         load_flags = ALLEGRO_LOAD_HALF_SIZE;
+      else if (0 == strcmp(argv[i], "--quarter"))
+         load_flags = ALLEGRO_LOAD_QUARTER_SIZE;
+      else if (0 == strcmp(argv[i], "--eighth"))
+         load_flags = ALLEGRO_LOAD_EIGHTH_SIZE;
+      else if (ext && 0 == strcmp(ext, ".ini"))
+         bench_ini(argv[i]);
+      else
+         bench_file(argv[i]);
+   }
+
+   log_printf("\n");
+   for (i = 0; i < num_formats; i++) {
+      log_printf("%-8s %4d files %8.2f MB/s\n", formats[i].ext,
+         formats[i].files, formats[i].bytes / formats[i].seconds / 1e6);
+      bytes += formats[i].bytes;
+      seconds += formats[i].seconds;
+   }
+   if (seconds > 0) {
+      log_printf("%-8s %4d failed %7.2f MB/s\n", "total", num_failed,
+         bytes / seconds / 1e6);
+   }
+
+   close_log(true);
+
+   return 0;
+}
+
+/* vim: set sts=3 sw=3 et: */
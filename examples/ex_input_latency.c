@@ -0,0 +1,184 @@
+/*
+ *    Example program for the Allegro library.
+ *
+ *    Measure how long input events take to reach the application.  Each
+ *    event is timestamped by the driver when it is generated; we compare
+ *    that against the time the event is taken off the queue, and report
+ *    min/avg/max latency per device class every couple of seconds.
+ *
+ *    On Linux the joystick (and console keyboard/mouse) drivers generate
+ *    their events from the fdwatch thread, so this is also a way to check
+ *    the responsiveness of that thread.
+ */
+
+#include <stdio.h>
+#include <allegro5/allegro.h>
+
+#include "common.c"
+
+enum {
+   SRC_KEYBOARD,
+   SRC_MOUSE,
+   SRC_JOYSTICK,
+   SRC_MAX
+};
+
+static char const *src_names[SRC_MAX] = {
+   "keyboard", "mouse", "joystick"
+};
+
+typedef struct LATENCY_STATS {
+   int count;
+   double min;
+   double max;
+   double total;
+} LATENCY_STATS;
+
+static LATENCY_STATS stats[SRC_MAX];
+
+
+static void reset_stats(void)
+{
+   int i;
+
+   for (i = 0; i < SRC_MAX; i++) {
+      stats[i].count = 0;
+      stats[i].min = 1e9;
+      stats[i].max = 0;
+      stats[i].total = 0;
+   }
+}
+
+
+static void add_sample(int src, double latency)
+{
+   LATENCY_STATS *s = &stats[src];
+
+   s->count++;
+   s->total += latency;
+   if (latency < s->min)
+      s->min = latency;
+   if (latency > s->max)
+      s->max = latency;
+}
+
+
+static void report_stats(void)
+{
+   int i;
+
+   for (i = 0; i < SRC_MAX; i++) {
+      LATENCY_STATS *s = &stats[i];
+      if (s->count == 0)
+         continue;
+      log_printf("%-8s %6d events  min %8.1f us  avg %8.1f us  max %8.1f us\n",
+         src_names[i], s->count,
+         s->min * 1e6, s->total / s->count * 1e6, s->max * 1e6);
+   }
+}
+
+
+static int classify_event(ALLEGRO_EVENT const *event)
+{
+   switch (event->type) {
+      case ALLEGRO_EVENT_KEY_DOWN:
+      case ALLEGRO_EVENT_KEY_CHAR:
+      case ALLEGRO_EVENT_KEY_UP:
+         return SRC_KEYBOARD;
+
+      case ALLEGRO_EVENT_MOUSE_AXES:
+      case ALLEGRO_EVENT_MOUSE_BUTTON_DOWN:
+      case ALLEGRO_EVENT_MOUSE_BUTTON_UP:
+         return SRC_MOUSE;
+
+      case ALLEGRO_EVENT_JOYSTICK_AXIS:
+      case ALLEGRO_EVENT_JOYSTICK_BUTTON_DOWN:
+      case ALLEGRO_EVENT_JOYSTICK_BUTTON_UP:
+         return SRC_JOYSTICK;
+   }
+
+   return -1;
+}
+
+
+int main(int argc, char **argv)
+{
+   ALLEGRO_DISPLAY *display;
+   ALLEGRO_TIMER *timer;
+   ALLEGRO_EVENT_QUEUE *queue;
+   ALLEGRO_EVENT event;
+   bool done = false;
+
+   (void)argc;
+   (void)argv;
+
+   if (!al_init()) {
+      abort_example("Could not init Allegro.\n");
+   }
+
+   open_log_monospace();
+
+   /* A display is only needed for keyboard and mouse input on some
+    * platforms, so carry on without one.
+    */
+   display = al_create_display(320, 200);
+   if (!display) {
+      log_printf("No display, measuring joystick input only.\n");
+   }
+
+   queue = al_create_event_queue();
+   if (al_install_keyboard())
+      al_register_event_source(queue, al_get_keyboard_event_source());
+   if (al_install_mouse())
+      al_register_event_source(queue, al_get_mouse_event_source());
+   if (al_install_joystick())
+      al_register_event_source(queue, al_get_joystick_event_source());
+   if (display)
+      al_register_event_source(queue, al_get_display_event_source(display));
+
+   timer = al_create_timer(2.0);
+   al_register_event_source(queue, al_get_timer_event_source(timer));
+   al_start_timer(timer);
+
+   log_printf("Generate some input. Press Escape to quit.\n");
+   reset_stats();
+
+   while (!done) {
+      int src;
+
+      al_wait_for_event(queue, &event);
+
+      src = classify_event(&event);
+      if (src >= 0) {
+         add_sample(src, al_get_time() - event.any.timestamp);
+      }
+
+      switch (event.type) {
+         case ALLEGRO_EVENT_KEY_DOWN:
+            if (event.keyboard.keycode == ALLEGRO_KEY_ESCAPE)
+               done = true;
+            break;
+
+         case ALLEGRO_EVENT_DISPLAY_CLOSE:
+            done = true;
+            break;
+
+         case ALLEGRO_EVENT_JOYSTICK_CONFIGURATION:
+            al_reconfigure_joysticks();
+            break;
+
+         case ALLEGRO_EVENT_TIMER:
+            report_stats();
+            reset_stats();
+            break;
+      }
+   }
+
+   al_destroy_timer(timer);
+   al_destroy_event_queue(queue);
+   close_log(false);
+
+   return 0;
+}
+
+/* vim: set sts=3 sw=3 et: */
@@ -0,0 +1,150 @@
+/*
+ *    Example program for the Allegro library.
+ *
+ *    Compare reading back a video bitmap with al_lock_bitmap_region against
+ *    al_lock_bitmap_region_async.  Each round the bitmap is cleared to a new
+ *    colour and read back; the time the caller is blocked in each case is
+ *    reported, and the pixels read are checked against the colour drawn.
+ *
+ *    This also runs under a software OpenGL implementation, e.g.
+ *    xvfb-run with LIBGL_ALWAYS_SOFTWARE=1.
+ */
+
+#include <stdio.h>
+#include <allegro5/allegro.h>
+
+#include "common.c"
+
+#define SIZE      1024
+#define ROUNDS    50
+
+
+static ALLEGRO_COLOR round_color(int i)
+{
+   return al_map_rgb(i * 5 % 256, 255 - i * 3 % 256, i * 11 % 256);
+}
+
+
+static bool check_region(ALLEGRO_LOCKED_REGION *lr, int i)
+{
+   unsigned char r, g, b;
+   uint32_t *row;
+   uint32_t pixel;
+
+   /* We asked for ABGR_8888_LE, so this is RGBA in memory order. */
+   row = (uint32_t *)((char *)lr->data + lr->pitch * (SIZE / 2));
+   pixel = row[SIZE / 2];
+   al_unmap_rgb(round_color(i), &r, &g, &b);
+   return ((unsigned char *)&pixel)[0] == r &&
+      ((unsigned char *)&pixel)[1] == g &&
+      ((unsigned char *)&pixel)[2] == b;
+}
+
+
+static double run_sync(ALLEGRO_BITMAP *bmp, int *errors)
+{
+   ALLEGRO_LOCKED_REGION *lr;
+   double blocked = 0;
+   double t;
+   int i;
+
+   for (i = 0; i < ROUNDS; i++) {
+      al_set_target_bitmap(bmp);
+      al_clear_to_color(round_color(i));
+
+      t = al_get_time();
+      lr = al_lock_bitmap_region(bmp, 0, 0, SIZE, SIZE,
+         ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE, ALLEGRO_LOCK_READONLY);
+      blocked += al_get_time() - t;
+      if (!lr || !check_region(lr, i))
+         (*errors)++;
+      if (lr)
+         al_unlock_bitmap(bmp);
+   }
+
+   return blocked;
+}
+
+
+static double run_async(ALLEGRO_BITMAP *bmp, int *errors, int *polls)
+{
+   ALLEGRO_ASYNC_LOCK *lock;
+   ALLEGRO_LOCKED_REGION *lr;
+   double blocked = 0;
+   double t;
+   int i;
+
+   for (i = 0; i < ROUNDS; i++) {
+      al_set_target_bitmap(bmp);
+      al_clear_to_color(round_color(i));
+
+      t = al_get_time();
+      lock = al_lock_bitmap_region_async(bmp, 0, 0, SIZE, SIZE,
+         ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE);
+      blocked += al_get_time() - t;
+      if (!lock) {
+         (*errors)++;
+         continue;
+      }
+
+      /* Stand-in for other work the application would be doing. */
+      while (!al_is_async_lock_ready(lock)) {
+         (*polls)++;
+         al_rest(0.0001);
+      }
+
+      t = al_get_time();
+      lr = al_wait_for_async_lock(lock);
+      blocked += al_get_time() - t;
+      if (!lr || !check_region(lr, i))
+         (*errors)++;
+      al_release_async_lock(lock);
+   }
+
+   return blocked;
+}
+
+
+int main(int argc, char **argv)
+{
+   ALLEGRO_DISPLAY *display;
+   ALLEGRO_BITMAP *bmp;
+   double sync_time, async_time;
+   int sync_errors = 0;
+   int async_errors = 0;
+   int polls = 0;
+
+   (void)argc;
+   (void)argv;
+
+   if (!al_init()) {
+      abort_example("Could not init Allegro.\n");
+   }
+   open_log();
+
+   display = al_create_display(320, 200);
+   if (!display) {
+      abort_example("Error creating display\n");
+   }
+
+   bmp = al_create_bitmap(SIZE, SIZE);
+   if (!bmp) {
+      abort_example("Error creating bitmap\n");
+   }
+
+   sync_time = run_sync(bmp, &sync_errors);
+   async_time = run_async(bmp, &async_errors, &polls);
+
+   log_printf("%d reads of %dx%d pixels\n", ROUNDS, SIZE, SIZE);
+   log_printf("sync:  %.3f ms blocked per read, %d errors\n",
+      sync_time * 1000 / ROUNDS, sync_errors);
+   log_printf("async: %.3f ms blocked per read, %d errors, %d polls\n",
+      async_time * 1000 / ROUNDS, async_errors, polls);
+
+   al_destroy_bitmap(bmp);
+   close_log(true);
+
+   return 0;
+}
+
+/* vim: set sts=3 sw=3 et: */
@@ -1192,6 +1192,173 @@ static void t51(void)
    CHECK(0 == memcmp(str, "Al", 3));
 }
 
+/* Reference versions of al_ustr_length and al_ustr_offset, which step through
+ * the string one code point at a time.
+ */
+static int slow_length(const ALLEGRO_USTR *us)
+{
+   int pos = 0;
+   int n = 0;
+
+   while (al_ustr_next(us, &pos))
+      n++;
+   return n;
+}
+
+static int slow_offset(const ALLEGRO_USTR *us, int index)
+{
+   int pos = 0;
+
+   if (index < 0)
+      index += slow_length(us);
+   while (index-- > 0) {
+      if (!al_ustr_next(us, &pos))
+         break;
+   }
+   return pos;
+}
+
+static bool matches_slow(const ALLEGRO_USTR *us)
+{
+   int length = slow_length(us);
+   int i;
+
+   if ((int)al_ustr_length(us) != length)
+      return false;
+   for (i = -length - 2; i <= length + 2; i++) {
+      if (al_ustr_offset(us, i) != slow_offset(us, i))
+         return false;
+   }
+   return true;
+}
+
+/* Build a long string mixing 1 to 4 byte sequences. */
+static ALLEGRO_USTR *new_long_string(int n)
+{
+   static const int32_t chars[] = {'a', U_thorn, U_euro, 0x1d160, 'z'};
+   ALLEGRO_USTR *us = al_ustr_new("");
+   int i;
+
+   for (i = 0; i < n; i++)
+      al_ustr_append_chr(us, chars[(i * 7) % 5]);
+   return us;
+}
+
+/* Test al_ustr_length and al_ustr_offset with invalid bytes. */
+static void t52(void)
+{
+   ALLEGRO_USTR *us;
+   int i;
+
+   /* 0xFE and 0xFF never start a code point. */
+   us = al_ustr_new("\xff\xfe");
+   CHECK(1 == al_ustr_length(us));
+   CHECK(al_ustr_offset(us, 1) == 2);
+   al_ustr_free(us);
+
+   us = al_ustr_new("a\xffz\xfe\xfe");
+   CHECK(2 == al_ustr_length(us));
+   CHECK(al_ustr_offset(us, 1) == 2);
+   CHECK(al_ustr_offset(us, 2) == 5);
+   CHECK(al_ustr_offset(us, -1) == 2);
+   al_ustr_free(us);
+
+   /* Stray trail bytes and truncated sequences, long enough to exercise the
+    * block-wise scans.
+    */
+   us = al_ustr_new("");
+   for (i = 0; i < 100; i++) {
+      al_ustr_append_cstr(us, "ab\xbf\xe2\x82\xff\xc3\xbe\xf0\x9d\x85\xa0\xfe");
+   }
+   CHECK(matches_slow(us));
+   al_ustr_free(us);
+
+   us = new_long_string(1000);
+   al_ustr_append_cstr(us, "\xfe\xff\x80");
+   CHECK(matches_slow(us));
+   al_ustr_free(us);
+}
+
+/* Test indexed strings as they are modified. */
+static void t53(void)
+{
+   ALLEGRO_USTR *us = new_long_string(1500);
+   ALLEGRO_USTR *copy;
+
+   CHECK(al_ustr_enable_index(us));
+   CHECK(al_ustr_enable_index(us));
+   CHECK(1500 == al_ustr_length(us));
+   CHECK(matches_slow(us));
+
+   /* Insert near the end, in the middle, and at the start. */
+   al_ustr_insert_cstr(us, al_ustr_offset(us, 1400), "€€");
+   CHECK(1502 == al_ustr_length(us));
+   CHECK(matches_slow(us));
+   al_ustr_insert_chr(us, al_ustr_offset(us, 700), 0x1d160);
+   CHECK(matches_slow(us));
+   al_ustr_insert_cstr(us, 0, "þ");
+   CHECK(1504 == al_ustr_length(us));
+   CHECK(matches_slow(us));
+
+   /* Remove code points and ranges. */
+   al_ustr_remove_chr(us, al_ustr_offset(us, 300));
+   CHECK(1503 == al_ustr_length(us));
+   CHECK(matches_slow(us));
+   al_ustr_remove_range(us, al_ustr_offset(us, 10), al_ustr_offset(us, 610));
+   CHECK(903 == al_ustr_length(us));
+   CHECK(matches_slow(us));
+
+   /* Invalid bytes in an indexed string. */
+   al_ustr_insert_cstr(us, al_ustr_offset(us, 500), "\xff\xfe\xbf");
+   CHECK(903 == al_ustr_length(us));
+   CHECK(matches_slow(us));
+
+   /* Truncate, then grow again. */
+   al_ustr_truncate(us, al_ustr_offset(us, 600));
+   CHECK(600 == al_ustr_length(us));
+   CHECK(matches_slow(us));
+   copy = new_long_string(400);
+   al_ustr_append(us, copy);
+   al_ustr_free(copy);
+   CHECK(1000 == al_ustr_length(us));
+   CHECK(matches_slow(us));
+
+   al_ustr_assign_cstr(us, "aþ€");
+   CHECK(3 == al_ustr_length(us));
+   CHECK(matches_slow(us));
+
+   al_ustr_disable_index(us);
+   al_ustr_disable_index(us);
+   CHECK(3 == al_ustr_length(us));
+   al_ustr_free(us);
+}
+
+/* Test offsets past either end of an indexed string. */
+static void t54(void)
+{
+   ALLEGRO_USTR *us = new_long_string(512);
+   int size = al_ustr_size(us);
+
+   al_ustr_enable_index(us);
+   CHECK(al_ustr_offset(us, 512) == size);
+   CHECK(al_ustr_offset(us, 513) == size);
+   CHECK(al_ustr_offset(us, 100000) == size);
+   CHECK(al_ustr_offset(us, -512) == 0);
+   CHECK(al_ustr_offset(us, -513) == 0);
+   CHECK(al_ustr_offset(us, -100000) == 0);
+   CHECK(al_ustr_offset(us, 256) == slow_offset(us, 256));
+   CHECK(al_ustr_offset(us, -256) == slow_offset(us, -256));
+   al_ustr_free(us);
+
+   us = al_ustr_new("");
+   al_ustr_enable_index(us);
+   CHECK(0 == al_ustr_length(us));
+   CHECK(al_ustr_offset(us, 0) == 0);
+   CHECK(al_ustr_offset(us, 1) == 0);
+   CHECK(al_ustr_offset(us, -1) == 0);
+   al_ustr_free(us);
+}
+
 /*---------------------------------------------------------------------------*/
 
 const test_t all_tests[] =
@@ -1201,7 +1368,7 @@ const test_t all_tests[] =
    t20, t21, t22, t23, t24, t25, t26, t27, t28, t29,
    t30, t31, t32, t33, t34, t35, t36, t37, t38, t39,
    t40, t41, t42, t43, t44, t45, t46, t47, t48, t49,
-   t50, t51
+   t50, t51, t52, t53, t54
 };
 
 #define NUM_TESTS (int)(sizeof(all_tests) / sizeof(all_tests[0]))
@@ -170,6 +170,8 @@ AL_FUNC(void,                  al_get_opengl_texture_position,   (ALLEGRO_BITMAP
 AL_FUNC(GLuint,                al_get_opengl_program_object,     (ALLEGRO_SHADER *shader));
 AL_FUNC(void,                  al_set_current_opengl_context,    (ALLEGRO_DISPLAY *display));
 AL_FUNC(int,                   al_get_opengl_variant,            (void));
+AL_FUNC(void,                  al_get_opengl_transfer_counters,  (ALLEGRO_DISPLAY *display,
+                                                                  uint64_t *bytes_read, uint64_t *bytes_written));
 
 #ifdef __cplusplus
    }
@@ -11,6 +11,10 @@
  */
 typedef struct ALLEGRO_BITMAP ALLEGRO_BITMAP;
 
+/* Type: ALLEGRO_BITMAP_ATLAS
+ */
+typedef struct ALLEGRO_BITMAP_ATLAS ALLEGRO_BITMAP_ATLAS;
+
 
 /*
  * Bitmap flags
@@ -27,7 +31,9 @@ enum {
    ALLEGRO_MIPMAP                   = 0x0100,
    _ALLEGRO_NO_PREMULTIPLIED_ALPHA  = 0x0200,	/* now a bitmap loader flag */
    ALLEGRO_VIDEO_BITMAP             = 0x0400,
-   ALLEGRO_CONVERT_BITMAP           = 0x1000
+   ALLEGRO_CONVERT_BITMAP           = 0x1000,
+   ALLEGRO_TILED_MEMORY_BITMAP      = 0x2000,
+   ALLEGRO_COPY_ON_WRITE            = 0x4000
 };
 
 
@@ -36,6 +42,8 @@ AL_FUNC(void, al_set_new_bitmap_flags, (int flags));
 AL_FUNC(int, al_get_new_bitmap_format, (void));
 AL_FUNC(int, al_get_new_bitmap_flags, (void));
 AL_FUNC(void, al_add_new_bitmap_flag, (int flag));
+AL_FUNC(void, al_set_new_bitmap_alignment, (int alignment));
+AL_FUNC(int, al_get_new_bitmap_alignment, (void));
 
 AL_FUNC(int, al_get_bitmap_width, (ALLEGRO_BITMAP *bitmap));
 AL_FUNC(int, al_get_bitmap_height, (ALLEGRO_BITMAP *bitmap));
@@ -43,6 +51,9 @@ AL_FUNC(int, al_get_bitmap_format, (ALLEGRO_BITMAP *bitmap));
 AL_FUNC(int, al_get_bitmap_flags, (ALLEGRO_BITMAP *bitmap));
 
 AL_FUNC(ALLEGRO_BITMAP*, al_create_bitmap, (int w, int h));
+AL_FUNC(ALLEGRO_BITMAP*, al_create_bitmap_from_memory, (void *data,
+   int w, int h, int format, int pitch,
+   void (*destroy)(void *data, void *userdata), void *userdata));
 AL_FUNC(void, al_destroy_bitmap, (ALLEGRO_BITMAP *bitmap));
 
 AL_FUNC(void, al_put_pixel, (int x, int y, ALLEGRO_COLOR color));
@@ -66,6 +77,14 @@ AL_FUNC(int, al_get_bitmap_y, (ALLEGRO_BITMAP *bitmap));
 AL_FUNC(void, al_reparent_bitmap, (ALLEGRO_BITMAP *bitmap,
    ALLEGRO_BITMAP *parent, int x, int y, int w, int h));
 
+/* Atlases */
+AL_FUNC(ALLEGRO_BITMAP_ATLAS *, al_create_bitmap_atlas, (int page_width, int page_height));
+AL_FUNC(void, al_destroy_bitmap_atlas, (ALLEGRO_BITMAP_ATLAS *atlas));
+AL_FUNC(bool, al_add_bitmap_to_atlas, (ALLEGRO_BITMAP_ATLAS *atlas, ALLEGRO_BITMAP *bitmap));
+AL_FUNC(int, al_add_bitmaps_to_atlas, (ALLEGRO_BITMAP_ATLAS *atlas, ALLEGRO_BITMAP **bitmaps, int count));
+AL_FUNC(int, al_get_bitmap_atlas_page_count, (ALLEGRO_BITMAP_ATLAS *atlas));
+AL_FUNC(ALLEGRO_BITMAP *, al_get_bitmap_atlas_page, (ALLEGRO_BITMAP_ATLAS *atlas, int index));
+
 /* Miscellaneous */
 AL_FUNC(ALLEGRO_BITMAP *, al_clone_bitmap, (ALLEGRO_BITMAP *bitmap));
 AL_FUNC(void, al_convert_bitmap, (ALLEGRO_BITMAP *bitmap));
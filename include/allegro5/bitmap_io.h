@@ -14,7 +14,10 @@
 enum {
    ALLEGRO_KEEP_BITMAP_FORMAT       = 0x0002,   /* was a bitmap flag in 5.0 */
    ALLEGRO_NO_PREMULTIPLIED_ALPHA   = 0x0200,   /* was a bitmap flag in 5.0 */
-   ALLEGRO_KEEP_INDEX               = 0x0800
+   ALLEGRO_KEEP_INDEX               = 0x0800,
+   ALLEGRO_LOAD_HALF_SIZE           = 0x10000,
+   ALLEGRO_LOAD_QUARTER_SIZE        = 0x20000,
+   ALLEGRO_LOAD_EIGHTH_SIZE         = 0x40000
 };
 
 typedef ALLEGRO_BITMAP *(*ALLEGRO_IIO_LOADER_FUNCTION)(const char *filename, int flags);
@@ -29,6 +29,16 @@ struct ALLEGRO_LOCKED_REGION {
 };
 
 
+/* Type: ALLEGRO_ASYNC_LOCK
+ */
+typedef struct ALLEGRO_ASYNC_LOCK ALLEGRO_ASYNC_LOCK;
+
+
+/* Type: ALLEGRO_CONCURRENT_LOCK
+ */
+typedef struct ALLEGRO_CONCURRENT_LOCK ALLEGRO_CONCURRENT_LOCK;
+
+
 AL_FUNC(ALLEGRO_LOCKED_REGION*, al_lock_bitmap, (ALLEGRO_BITMAP *bitmap, int format, int flags));
 AL_FUNC(ALLEGRO_LOCKED_REGION*, al_lock_bitmap_region, (ALLEGRO_BITMAP *bitmap, int x, int y, int width, int height, int format, int flags));
 AL_FUNC(ALLEGRO_LOCKED_REGION*, al_lock_bitmap_blocked, (ALLEGRO_BITMAP *bitmap, int flags));
@@ -37,6 +47,15 @@ AL_FUNC(ALLEGRO_LOCKED_REGION*, al_lock_bitmap_region_blocked, (ALLEGRO_BITMAP *
 AL_FUNC(void, al_unlock_bitmap, (ALLEGRO_BITMAP *bitmap));
 AL_FUNC(bool, al_is_bitmap_locked, (ALLEGRO_BITMAP *bitmap));
 
+AL_FUNC(ALLEGRO_ASYNC_LOCK*, al_lock_bitmap_region_async, (ALLEGRO_BITMAP *bitmap, int x, int y, int width, int height, int format));
+AL_FUNC(bool, al_is_async_lock_ready, (ALLEGRO_ASYNC_LOCK *lock));
+AL_FUNC(ALLEGRO_LOCKED_REGION*, al_wait_for_async_lock, (ALLEGRO_ASYNC_LOCK *lock));
+AL_FUNC(void, al_release_async_lock, (ALLEGRO_ASYNC_LOCK *lock));
+
+AL_FUNC(ALLEGRO_CONCURRENT_LOCK*, al_lock_bitmap_region_concurrent, (ALLEGRO_BITMAP *bitmap, int x, int y, int width, int height, int format, int flags));
+AL_FUNC(ALLEGRO_LOCKED_REGION*, al_get_concurrent_lock_region, (ALLEGRO_CONCURRENT_LOCK *lock));
+AL_FUNC(void, al_unlock_concurrent_lock, (ALLEGRO_CONCURRENT_LOCK *lock));
+
 
 #ifdef __cplusplus
    }
@@ -19,11 +19,18 @@ typedef struct ALLEGRO_CONFIG_SECTION ALLEGRO_CONFIG_SECTION;
  */
 typedef struct ALLEGRO_CONFIG_ENTRY ALLEGRO_CONFIG_ENTRY;
 
+/* Type: ALLEGRO_CONFIG_KEY
+ */
+typedef struct ALLEGRO_CONFIG_KEY ALLEGRO_CONFIG_KEY;
+
 AL_FUNC(ALLEGRO_CONFIG *, al_create_config, (void));
 AL_FUNC(void, al_add_config_section, (ALLEGRO_CONFIG *config, const char *name));
 AL_FUNC(void, al_set_config_value, (ALLEGRO_CONFIG *config, const char *section, const char *key, const char *value));
 AL_FUNC(void, al_add_config_comment, (ALLEGRO_CONFIG *config, const char *section, const char *comment));
 AL_FUNC(const char*, al_get_config_value, (const ALLEGRO_CONFIG *config, const char *section, const char *key));
+AL_FUNC(ALLEGRO_CONFIG_KEY *, al_create_config_key, (const char *section, const char *key));
+AL_FUNC(void, al_destroy_config_key, (ALLEGRO_CONFIG_KEY *key));
+AL_FUNC(const char*, al_get_config_value_by_key, (const ALLEGRO_CONFIG *config, const ALLEGRO_CONFIG_KEY *key));
 AL_FUNC(ALLEGRO_CONFIG*, al_load_config_file, (const char *filename));
 AL_FUNC(ALLEGRO_CONFIG*, al_load_config_file_f, (ALLEGRO_FILE *filename));
 AL_FUNC(bool, al_save_config_file, (const char *filename, const ALLEGRO_CONFIG *config));
@@ -10,6 +10,7 @@
 
 /* Drawing primitives */
 AL_FUNC(void, al_clear_to_color, (ALLEGRO_COLOR color));
+AL_FUNC(void, al_clear_rectangles, (const int *rects, int num_rects, ALLEGRO_COLOR color));
 AL_FUNC(void, al_clear_depth_buffer, (float x));
 AL_FUNC(void, al_draw_pixel, (float x, float y, ALLEGRO_COLOR color));
 
@@ -32,6 +32,8 @@ typedef struct ALLEGRO_FILE_INTERFACE
    AL_METHOD(void,    fi_fclearerr, (ALLEGRO_FILE *f));
    AL_METHOD(int,     fi_fungetc, (ALLEGRO_FILE *f, int c));
    AL_METHOD(off_t,   fi_fsize, (ALLEGRO_FILE *f));
+   AL_METHOD(const void *, fi_fread_span, (ALLEGRO_FILE *f, size_t size, size_t *ret_size));
+   AL_METHOD(void,    fi_fprefetch, (ALLEGRO_FILE *f, size_t size));
 } ALLEGRO_FILE_INTERFACE;
 
 
@@ -61,6 +63,8 @@ AL_FUNC(const char *, al_ferrmsg, (ALLEGRO_FILE *f));
 AL_FUNC(void, al_fclearerr, (ALLEGRO_FILE *f));
 AL_FUNC(int, al_fungetc, (ALLEGRO_FILE *f, int c));
 AL_FUNC(int64_t, al_fsize, (ALLEGRO_FILE *f));
+AL_FUNC(const void *, al_fread_span, (ALLEGRO_FILE *f, size_t size, size_t *ret_size));
+AL_FUNC(void, al_fprefetch, (ALLEGRO_FILE *f, size_t size));
 
 /* Convenience functions. */
 AL_FUNC(int, al_fgetc, (ALLEGRO_FILE *f));
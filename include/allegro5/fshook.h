@@ -133,6 +133,32 @@ AL_FUNC(int,  al_for_each_fs_entry, (ALLEGRO_FS_ENTRY *dir,
                                      void *extra));
 
 
+/* Parallel scanning of a directory tree. */
+
+/* Type: ALLEGRO_FS_SCAN_RECORD
+ */
+typedef struct ALLEGRO_FS_SCAN_RECORD ALLEGRO_FS_SCAN_RECORD;
+
+struct ALLEGRO_FS_SCAN_RECORD {
+   const char *path;
+   uint32_t mode;
+   off_t size;
+   time_t mtime;
+};
+
+/* Enum: ALLEGRO_FS_SCAN_FLAGS
+ */
+enum {
+   ALLEGRO_FS_SCAN_NO_STAT = 1
+};
+
+AL_FUNC(int,  al_scan_fs_tree, (const char *path, int flags,
+                                const char *cache_filename,
+                                int (*callback)(const ALLEGRO_FS_SCAN_RECORD *records,
+                                                int num_records, void *extra),
+                                void *extra));
+
+
 /* Thread-local state. */
 AL_FUNC(const ALLEGRO_FS_INTERFACE *, al_get_fs_interface, (void));
 AL_FUNC(void, al_set_fs_interface, (const ALLEGRO_FS_INTERFACE *vtable));
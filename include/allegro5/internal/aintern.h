@@ -47,6 +47,12 @@ AL_FUNC(int, _al_rand, (void));
 
 AL_FUNC(int, _al_stricmp, (const char *s1, const char *s2));
 
+/* memory pool */
+void _al_flush_memory_pool_cache(void);
+
+/* UTF-8 string indexes */
+void _al_init_ustr_index(void);
+
 #ifdef __cplusplus
    }
 #endif
@@ -19,6 +19,18 @@
       return __sync_sub_and_fetch(ptr, 1);
    })
 
+   AL_INLINE_STATIC(_AL_ATOMIC,
+      _al_fetch_and_or, (volatile _AL_ATOMIC *ptr, _AL_ATOMIC bits),
+   {
+      return __sync_fetch_and_or(ptr, bits);
+   })
+
+   AL_INLINE_STATIC(_AL_ATOMIC,
+      _al_fetch_and_and, (volatile _AL_ATOMIC *ptr, _AL_ATOMIC bits),
+   {
+      return __sync_fetch_and_and(ptr, bits);
+   })
+
 #elif defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
 
    /* gcc, x86 or x86-64 */
@@ -49,23 +61,79 @@
       return old - 1;
    })
 
-#elif defined(_MSC_VER) && _M_IX86 >= 400
+   #define __al_compare_and_swap(ptr, oldval, newval, result)                 \
+      __asm__ __volatile__ (                                                  \
+         "lock; cmpxchgl %2, %1"                                              \
+         : "=a" (result), "+m" (*ptr)                                         \
+         : "r" (newval), "0" (oldval)                                         \
+         : "memory"                                                           \
+      )
 
-   /* MSVC, x86 */
-   /* MinGW supports these too, but we already have asm code above. */
+   AL_INLINE_STATIC(_AL_ATOMIC,
+      _al_fetch_and_or, (volatile _AL_ATOMIC *ptr, _AL_ATOMIC bits),
+   {
+      _AL_ATOMIC old;
+      _AL_ATOMIC prev;
+      do {
+         old = *ptr;
+         __al_compare_and_swap(ptr, old, old | bits, prev);
+      } while (prev != old);
+      return old;
+   })
+
+   AL_INLINE_STATIC(_AL_ATOMIC,
+      _al_fetch_and_and, (volatile _AL_ATOMIC *ptr, _AL_ATOMIC bits),
+   {
+      _AL_ATOMIC old;
+      _AL_ATOMIC prev;
+      do {
+         old = *ptr;
+         __al_compare_and_swap(ptr, old, old & bits, prev);
+      } while (prev != old);
+      return old;
+   })
 
-   typedef LONG _AL_ATOMIC;
+#elif defined(_MSC_VER)
+
+   /* MSVC, x86 or x64 */
+   /* MinGW supports these too, but we already have asm code above.
+    * The compiler intrinsics don't need <windows.h>.
+    */
+
+   #include <intrin.h>
+
+   typedef long _AL_ATOMIC;
 
    AL_INLINE(_AL_ATOMIC,
       _al_fetch_and_add1, (volatile _AL_ATOMIC *ptr),
    {
-      return InterlockedIncrement(ptr) - 1;
+      return _InterlockedIncrement(ptr) - 1;
    })
 
    AL_INLINE(_AL_ATOMIC,
       _al_sub1_and_fetch, (volatile _AL_ATOMIC *ptr),
    {
-      return InterlockedDecrement(ptr);
+      return _InterlockedDecrement(ptr);
+   })
+
+   AL_INLINE_STATIC(_AL_ATOMIC,
+      _al_fetch_and_or, (volatile _AL_ATOMIC *ptr, _AL_ATOMIC bits),
+   {
+      _AL_ATOMIC old;
+      do {
+         old = *ptr;
+      } while (_InterlockedCompareExchange(ptr, old | bits, old) != old);
+      return old;
+   })
+
+   AL_INLINE_STATIC(_AL_ATOMIC,
+      _al_fetch_and_and, (volatile _AL_ATOMIC *ptr, _AL_ATOMIC bits),
+   {
+      _AL_ATOMIC old;
+      do {
+         old = *ptr;
+      } while (_InterlockedCompareExchange(ptr, old & bits, old) != old);
+      return old;
    })
 
 #elif defined(ALLEGRO_HAVE_OSATOMIC_H)
@@ -93,6 +161,28 @@
       return OSAtomicDecrement32Barrier((_AL_ATOMIC *)ptr);
    })
 
+   AL_INLINE_STATIC(_AL_ATOMIC,
+      _al_fetch_and_or, (volatile _AL_ATOMIC *ptr, _AL_ATOMIC bits),
+   {
+      _AL_ATOMIC old;
+      do {
+         old = *ptr;
+      } while (!OSAtomicCompareAndSwap32Barrier(old, old | bits,
+         (_AL_ATOMIC *)ptr));
+      return old;
+   })
+
+   AL_INLINE_STATIC(_AL_ATOMIC,
+      _al_fetch_and_and, (volatile _AL_ATOMIC *ptr, _AL_ATOMIC bits),
+   {
+      _AL_ATOMIC old;
+      do {
+         old = *ptr;
+      } while (!OSAtomicCompareAndSwap32Barrier(old, old & bits,
+         (_AL_ATOMIC *)ptr));
+      return old;
+   })
+
 
 #else
 
@@ -113,6 +203,22 @@
       return --(*ptr);
    })
 
+   AL_INLINE_STATIC(_AL_ATOMIC,
+      _al_fetch_and_or, (volatile _AL_ATOMIC *ptr, _AL_ATOMIC bits),
+   {
+      _AL_ATOMIC old = *ptr;
+      *ptr = old | bits;
+      return old;
+   })
+
+   AL_INLINE_STATIC(_AL_ATOMIC,
+      _al_fetch_and_and, (volatile _AL_ATOMIC *ptr, _AL_ATOMIC bits),
+   {
+      _AL_ATOMIC old = *ptr;
+      *ptr = old & bits;
+      return old;
+   })
+
 #endif
 
 #endif
@@ -73,6 +73,12 @@ struct ALLEGRO_BITMAP
    int lock_flags;
    ALLEGRO_LOCKED_REGION locked_region;
 
+   /* Regions handed out by al_lock_bitmap_region_concurrent.  locked is
+    * set while the list is non-empty.  Protected by a global mutex in
+    * bitmap_lock.c.
+    */
+   ALLEGRO_CONCURRENT_LOCK *concurrent_locks;
+
    /* Transformation for this bitmap */
    ALLEGRO_TRANSFORM transform;
    ALLEGRO_TRANSFORM inverse_transform;
@@ -92,11 +98,85 @@ struct ALLEGRO_BITMAP
    /* A memory copy of the bitmap data. May be NULL for an empty bitmap. */
    unsigned char *memory;
 
+   /* If set, called to release `memory' instead of al_free, e.g. for
+    * memory supplied by the user or allocated with extra alignment.
+    */
+   void (*free_memory)(void *memory, void *userdata);
+   void *free_memory_data;
+
    /* Extra data for display bitmaps, like texture id and so on. */
    void *extra;
 
    /* set_target_bitmap and lock_bitmap mark bitmaps as dirty for preservation */
    bool dirty;
+
+   /* Which parts of a dirty bitmap need preserving, one flag per
+    * _AL_DIRTY_TILE_SIZE square, row major.  When this is NULL and dirty is
+    * set the whole bitmap is dirty.  Use _al_mark_bitmap_dirty and
+    * _al_mark_bitmap_clean rather than touching this directly.
+    */
+   unsigned char *dirty_tiles;
+};
+
+#define _AL_DIRTY_TILE_SIZE   64
+
+/* Memory bitmaps created with ALLEGRO_TILED_MEMORY_BITMAP store their pixels
+ * in square blocks of _AL_MEMORY_TILE_SIZE, each block row-major and the
+ * blocks themselves row-major.  The width and height are padded to whole
+ * blocks and bitmap->pitch is the size of one row of blocks.
+ */
+#define _AL_MEMORY_TILE_SHIFT 3
+#define _AL_MEMORY_TILE_SIZE  (1 << _AL_MEMORY_TILE_SHIFT)
+#define _AL_MEMORY_TILE_MASK  (_AL_MEMORY_TILE_SIZE - 1)
+
+#define _AL_TILED_PIXEL_OFFSET(x, y, pitch, pixel_size)                    \
+   (((y) >> _AL_MEMORY_TILE_SHIFT) * (pitch) +                              \
+    ((((x) >> _AL_MEMORY_TILE_SHIFT) << (2 * _AL_MEMORY_TILE_SHIFT)) +      \
+     (((y) & _AL_MEMORY_TILE_MASK) << _AL_MEMORY_TILE_SHIFT) +              \
+     ((x) & _AL_MEMORY_TILE_MASK)) * (pixel_size))
+
+#define _al_bitmap_is_tiled(bitmap)                                        \
+   (((bitmap)->_flags & (ALLEGRO_MEMORY_BITMAP | ALLEGRO_TILED_MEMORY_BITMAP)) \
+      == (ALLEGRO_MEMORY_BITMAP | ALLEGRO_TILED_MEMORY_BITMAP))
+
+/* Internal lock flag: the locked region is the tiled memory itself, see
+ * _al_lock_bitmap_for_sampling.
+ */
+#define _AL_LOCK_NATIVE_TILES 0x100
+
+struct ALLEGRO_ASYNC_LOCK
+{
+   /* Always the parent for sub-bitmaps; x/y are relative to it. */
+   ALLEGRO_BITMAP *bitmap;
+   int x, y, w, h;
+   int format;
+
+   /* Valid once ready is set. */
+   ALLEGRO_LOCKED_REGION region;
+   bool ready;
+
+   /* Copy of the pixels made by the synchronous fallback. */
+   unsigned char *buffer;
+
+   /* Driver specific data, if lock_region_async succeeded. */
+   void *extra;
+};
+
+struct ALLEGRO_CONCURRENT_LOCK
+{
+   /* Always the parent for sub-bitmaps; x/y are relative to it. */
+   ALLEGRO_BITMAP *bitmap;
+   int x, y, w, h;
+   int flags;
+
+   ALLEGRO_LOCKED_REGION region;
+
+   /* Private copy in the requested format, or NULL if region points
+    * straight into the bitmap memory.
+    */
+   unsigned char *buffer;
+
+   ALLEGRO_CONCURRENT_LOCK *next;
 };
 
 struct ALLEGRO_BITMAP_INTERFACE
@@ -127,6 +207,16 @@ struct ALLEGRO_BITMAP_INTERFACE
 
    void (*unlock_compressed_region)(ALLEGRO_BITMAP *bitmap);
 
+   /* Optional asynchronous read-only locking.  lock_region_async starts a
+    * transfer of the lock's rectangle and returns false if the driver cannot
+    * do it, in which case a synchronous copy is made instead.
+    * poll_async_lock fills in lock->region once the data has arrived,
+    * blocking first if wait is true.
+    */
+   bool (*lock_region_async)(ALLEGRO_BITMAP *bitmap, ALLEGRO_ASYNC_LOCK *lock);
+   bool (*poll_async_lock)(ALLEGRO_ASYNC_LOCK *lock, bool wait);
+   void (*release_async_lock)(ALLEGRO_ASYNC_LOCK *lock);
+
    /* Used to update any dangling pointers the bitmap driver might keep. */
    void (*bitmap_pointer_changed)(ALLEGRO_BITMAP *bitmap, ALLEGRO_BITMAP *old);
 };
@@ -147,15 +237,34 @@ void _al_convert_bitmap_data(
 	int sx, int sy, int dx, int dy,
 	int width, int height);
 
+void _al_convert_compressed_bitmap_data(
+   const void *src, int src_format, int src_pitch,
+   void *dst, int dst_format, int dst_pitch,
+   int sx, int sy, int dx, int dy,
+   int width, int height);
+
 void _al_copy_bitmap_data(
    const void *src, int src_pitch, void *dst, int dst_pitch,
    int sx, int sy, int dx, int dy, int width, int height,
    int format);
 
+/* Tiled memory bitmaps */
+void _al_tile_bitmap_data(const void *src, int src_pitch,
+   void *dst, int dst_pitch, int dx, int dy, int width, int height,
+   int pixel_size);
+void _al_untile_bitmap_data(const void *src, int src_pitch,
+   void *dst, int dst_pitch, int sx, int sy, int width, int height,
+   int pixel_size);
+AL_FUNC(ALLEGRO_LOCKED_REGION *, _al_lock_bitmap_for_sampling,
+   (ALLEGRO_BITMAP *bitmap));
+void _al_init_concurrent_locks(void);
+bool _al_unshare_bitmap_memory(ALLEGRO_BITMAP *bitmap, bool discard);
+
 /* Bitmap type conversion */ 
 void _al_init_convert_bitmap_list(void);
 void _al_register_convert_bitmap(ALLEGRO_BITMAP *bitmap);
 void _al_unregister_convert_bitmap(ALLEGRO_BITMAP *bitmap);
+void _al_swap_bitmaps(ALLEGRO_BITMAP *bitmap, ALLEGRO_BITMAP *other);
 void _al_convert_to_display_bitmap(ALLEGRO_BITMAP *bitmap);
 void _al_convert_to_memory_bitmap(ALLEGRO_BITMAP *bitmap);
 
@@ -168,6 +277,11 @@ void _al_init_iio_table(void);
 
 int _al_get_bitmap_memory_format(ALLEGRO_BITMAP *bitmap);
 
+/* Dirty region tracking */
+void _al_mark_bitmap_dirty(ALLEGRO_BITMAP *bitmap, int x, int y, int w, int h);
+void _al_mark_bitmap_clean(ALLEGRO_BITMAP *bitmap);
+bool _al_is_bitmap_tile_dirty(ALLEGRO_BITMAP *bitmap, int tx, int ty);
+
 #ifdef __cplusplus
 }
 #endif
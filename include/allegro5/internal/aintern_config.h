@@ -1,7 +1,7 @@
 #ifndef __al_included_allegro5_aintern_config_h
 #define __al_included_allegro5_aintern_config_h
 
-#include "allegro5/internal/aintern_aatree.h"
+#include "allegro5/internal/aintern_hash.h"
 
 struct ALLEGRO_CONFIG_ENTRY {
    bool is_comment;
@@ -14,16 +14,24 @@ struct ALLEGRO_CONFIG_SECTION {
    ALLEGRO_USTR *name;
    ALLEGRO_CONFIG_ENTRY *head;
    ALLEGRO_CONFIG_ENTRY *last;
-   _AL_AATREE *tree;
+   _AL_HASH entries;
    ALLEGRO_CONFIG_SECTION *prev, *next;
 };
 
 struct ALLEGRO_CONFIG {
    ALLEGRO_CONFIG_SECTION *head;
    ALLEGRO_CONFIG_SECTION *last;
-   _AL_AATREE *tree;
+   _AL_HASH sections;
+};
+
+struct ALLEGRO_CONFIG_KEY {
+   ALLEGRO_USTR *section;
+   ALLEGRO_USTR *key;
+   unsigned int section_hash;
+   unsigned int key_hash;
 };
 
 
 #endif
 
+/* vim: set sts=3 sw=3 et: */
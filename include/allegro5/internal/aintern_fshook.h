@@ -17,6 +17,7 @@
 #define __al_included_allegro5_aintern_fshook_h
 
 #include "allegro5/base.h"
+#include "allegro5/internal/aintern_vector.h"
 
 #ifdef __cplusplus
    extern "C" {
@@ -26,6 +27,22 @@
 extern struct ALLEGRO_FS_INTERFACE _al_fs_interface_stdio;
 
 
+/* One file of a directory listing made by al_scan_fs_tree. */
+typedef struct _AL_FS_SCAN_ENTRY
+{
+   char *name;
+   uint32_t mode;
+   off_t size;
+   time_t mtime;
+   bool is_link;        /* symbolic link, not to be descended into */
+} _AL_FS_SCAN_ENTRY;
+
+#ifndef ALLEGRO_WINDOWS
+bool _al_fs_stdio_list_directory(const char *path, bool stat_files,
+   _AL_VECTOR *entries);
+#endif
+
+
 #ifdef __cplusplus
    }
 #endif
@@ -0,0 +1,54 @@
+#ifndef __al_included_allegro5_aintern_hash_h
+#define __al_included_allegro5_aintern_hash_h
+
+#include "allegro5/utf8.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* A hash table mapping ALLEGRO_USTR keys to arbitrary values.  The table
+ * does not own the keys; they must stay alive (and unchanged) for as long as
+ * they are in the table, which usually means pointing them at a string owned
+ * by the value.  Hashes are passed in by the caller so they can be computed
+ * once and reused.
+ */
+typedef struct _AL_HASH_SLOT _AL_HASH_SLOT;
+typedef struct _AL_HASH _AL_HASH;
+
+struct _AL_HASH_SLOT
+{
+   unsigned int hash;
+   const ALLEGRO_USTR *key;   /* NULL for an empty slot */
+   void *value;
+};
+
+struct _AL_HASH
+{
+   /* private */
+   unsigned int _size;        /* number of slots, zero or a power of two */
+   unsigned int _count;
+   _AL_HASH_SLOT *_slots;
+};
+
+#define _AL_HASH_INITIALIZER  { 0, 0, NULL }
+
+AL_FUNC(unsigned int, _al_hash_ustr, (const ALLEGRO_USTR *us));
+AL_FUNC(unsigned int, _al_hash_buffer, (const char *s, size_t size));
+AL_FUNC(void, _al_hash_init, (_AL_HASH *h));
+AL_FUNC(void, _al_hash_free, (_AL_HASH *h));
+AL_FUNC(void *, _al_hash_find, (const _AL_HASH *h, unsigned int hash,
+   const ALLEGRO_USTR *key));
+AL_FUNC(void, _al_hash_insert, (_AL_HASH *h, unsigned int hash,
+   const ALLEGRO_USTR *key, void *value));
+AL_FUNC(void *, _al_hash_remove, (_AL_HASH *h, unsigned int hash,
+   const ALLEGRO_USTR *key));
+AL_FUNC(unsigned int, _al_hash_count, (const _AL_HASH *h));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+/* vim: set sts=3 sw=3 et: */
@@ -7,6 +7,8 @@
 
 
 void _al_clear_bitmap_by_locking(ALLEGRO_BITMAP *bitmap, ALLEGRO_COLOR *color);
+void _al_clear_rectangles_by_locking(ALLEGRO_BITMAP *bitmap,
+   ALLEGRO_COLOR *color, const int *rects, int num_rects);
 void _al_draw_pixel_memory(ALLEGRO_BITMAP *bmp, float x, float y, ALLEGRO_COLOR *color);
 
 
@@ -124,6 +124,16 @@ typedef struct ALLEGRO_OGL_EXTRAS
    /* For OpenGL 3.0+ we use a single vao and vbo. */
    GLuint vao, vbo;
 
+   /* Pixel buffer objects used in turn for uploads when unlocking. */
+   GLuint upload_pbo[2];
+   int upload_pbo_index;
+
+   /* Number of pixel bytes read back from and written to textures and the
+    * backbuffer, by locking and bitmap preservation.
+    */
+   uint64_t bytes_read;
+   uint64_t bytes_written;
+
 } ALLEGRO_OGL_EXTRAS;
 
 typedef struct ALLEGRO_OGL_BITMAP_VERTEX
@@ -151,6 +161,11 @@ void _al_ogl_upload_bitmap_memory(ALLEGRO_BITMAP *bitmap, int format, void *ptr)
    ALLEGRO_LOCKED_REGION *_al_ogl_lock_region_new(ALLEGRO_BITMAP *bitmap,
       int x, int y, int w, int h, int format, int flags);
    void _al_ogl_unlock_region_new(ALLEGRO_BITMAP *bitmap);
+   bool _al_ogl_lock_region_async(ALLEGRO_BITMAP *bitmap,
+      ALLEGRO_ASYNC_LOCK *lock);
+   bool _al_ogl_poll_async_lock(ALLEGRO_ASYNC_LOCK *lock, bool wait);
+   void _al_ogl_release_async_lock(ALLEGRO_ASYNC_LOCK *lock);
+   void _al_ogl_destroy_upload_buffers(ALLEGRO_DISPLAY *display);
 #else
    ALLEGRO_LOCKED_REGION *_al_ogl_lock_region_gles(ALLEGRO_BITMAP *bitmap,
       int x, int y, int w, int h, int format, int flags);
@@ -178,6 +193,8 @@ ALLEGRO_BITMAP* _al_ogl_create_backbuffer(ALLEGRO_DISPLAY *disp);
 void _al_ogl_destroy_backbuffer(ALLEGRO_BITMAP *b);
 bool _al_ogl_resize_backbuffer(ALLEGRO_BITMAP *b, int w, int h);
 void _al_opengl_backup_dirty_bitmaps(ALLEGRO_DISPLAY *d, bool flip);
+void _al_ogl_count_transfer(ALLEGRO_BITMAP *bitmap, int bytes_read,
+   int bytes_written);
 
 /* draw */
 struct ALLEGRO_DISPLAY_INTERFACE;
@@ -0,0 +1,69 @@
+#ifndef __al_included_allegro5_aintern_profile_h
+#define __al_included_allegro5_aintern_profile_h
+
+#ifdef __cplusplus
+   extern "C" {
+#endif
+
+/* Instrumentation points.  Zones and counters are declared at file scope,
+ * e.g.
+ *
+ *    _AL_PROFILE_ZONE(lock_zone, "bitmap/lock_region");
+ *
+ *    void f(void)
+ *    {
+ *       _AL_PROFILE_DECL(lock_zone);
+ *       ...
+ *       _AL_PROFILE_BEGIN(lock_zone);
+ *       ...
+ *       _AL_PROFILE_END(lock_zone);
+ *    }
+ *
+ * Without ALLEGRO_CFG_PROFILING every macro expands to a declaration or
+ * statement without effect, so they are safe to leave in hot paths.
+ */
+
+#ifdef ALLEGRO_CFG_PROFILING
+
+typedef struct _AL_PROFILE_ENTRY _AL_PROFILE_ENTRY;
+
+struct _AL_PROFILE_ENTRY {
+   const char *name;
+   bool is_counter;
+   int index;           /* position in the zone list, -1 until first use */
+};
+
+double _al_profile_begin(_AL_PROFILE_ENTRY *zone);
+void _al_profile_end(_AL_PROFILE_ENTRY *zone, double start);
+void _al_profile_add(_AL_PROFILE_ENTRY *zone, int64_t n);
+
+#define _AL_PROFILE_ZONE(var, name) \
+   static _AL_PROFILE_ENTRY var = { name, false, -1 }
+#define _AL_PROFILE_COUNTER(var, name) \
+   static _AL_PROFILE_ENTRY var = { name, true, -1 }
+#define _AL_PROFILE_DECL(var)       double var##_start
+#define _AL_PROFILE_BEGIN(var)      (var##_start = _al_profile_begin(&var))
+#define _AL_PROFILE_END(var)        _al_profile_end(&var, var##_start)
+#define _AL_PROFILE_ADD(var, n)     _al_profile_add(&var, (n))
+
+#else
+
+/* An incomplete struct declaration is valid anywhere a declaration is. */
+#define _AL_PROFILE_ZONE(var, name)       struct _al_profile_##var
+#define _AL_PROFILE_COUNTER(var, name)    struct _al_profile_##var
+#define _AL_PROFILE_DECL(var)             struct _al_profile_##var
+#define _AL_PROFILE_BEGIN(var)            ((void)0)
+#define _AL_PROFILE_END(var)              ((void)0)
+#define _AL_PROFILE_ADD(var, n)           ((void)0)
+
+#endif
+
+void _al_init_profiling(void);
+
+#ifdef __cplusplus
+   }
+#endif
+
+#endif
+
+/* vim: set sts=3 sw=3 et: */
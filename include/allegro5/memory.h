@@ -35,6 +35,32 @@ struct ALLEGRO_MEMORY_INTERFACE {
 AL_FUNC(void, al_set_memory_interface, (ALLEGRO_MEMORY_INTERFACE *iface));
 
 
+/* Enum: ALLEGRO_MEMORY_POOL_FLAGS
+ */
+enum {
+   ALLEGRO_MEMORY_POOL_TRACK_SITES = 1
+};
+
+
+/* Type: ALLEGRO_MEMORY_SITE_STATS
+ */
+typedef struct ALLEGRO_MEMORY_SITE_STATS ALLEGRO_MEMORY_SITE_STATS;
+
+struct ALLEGRO_MEMORY_SITE_STATS {
+   const char *file;
+   int line;
+   const char *func;
+   size_t live_bytes;
+   size_t peak_bytes;
+   size_t live_count;
+   size_t total_count;
+};
+
+AL_FUNC(ALLEGRO_MEMORY_INTERFACE *, al_get_memory_pool_interface, (int flags));
+AL_FUNC(int, al_get_num_memory_sites, (void));
+AL_FUNC(bool, al_get_memory_site_stats, (int index, ALLEGRO_MEMORY_SITE_STATS *stats));
+
+
 /* Function: al_malloc
  */
 #define al_malloc(n) \
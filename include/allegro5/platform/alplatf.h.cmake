@@ -11,6 +11,7 @@
 #cmakedefine ALLEGRO_CFG_DLL_TLS
 #cmakedefine ALLEGRO_CFG_PTHREADS_TLS
 #cmakedefine ALLEGRO_CFG_RELEASE_LOGGING
+#cmakedefine ALLEGRO_CFG_PROFILING
 
 #cmakedefine ALLEGRO_CFG_D3D
 #cmakedefine ALLEGRO_CFG_D3D9EX
@@ -48,6 +49,8 @@
 #cmakedefine ALLEGRO_HAVE_SYS_TYPES_H
 #cmakedefine ALLEGRO_HAVE_OSATOMIC_H
 #cmakedefine ALLEGRO_HAVE_SYS_INOTIFY_H
+#cmakedefine ALLEGRO_HAVE_SYS_EPOLL_H
+#cmakedefine ALLEGRO_HAVE_SYS_EVENTFD_H
 #cmakedefine ALLEGRO_HAVE_SAL_H
 
 /* Define to 1 if the corresponding functions are available. */
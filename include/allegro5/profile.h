@@ -0,0 +1,56 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Built-in profiling counters and zones.
+ *
+ *      See readme.txt for copyright information.
+ */
+
+#ifndef __al_included_allegro5_profile_h
+#define __al_included_allegro5_profile_h
+
+#include "allegro5/base.h"
+
+#ifdef __cplusplus
+   extern "C" {
+#endif
+
+/* Type: ALLEGRO_PROFILE_STATS
+ */
+typedef struct ALLEGRO_PROFILE_STATS ALLEGRO_PROFILE_STATS;
+
+struct ALLEGRO_PROFILE_STATS
+{
+   const char *name;
+   bool is_counter;
+   int64_t count;
+   double total_time;
+   double max_time;
+};
+
+AL_FUNC(bool, al_is_profiling_available, (void));
+AL_FUNC(int, al_get_num_profile_zones, (void));
+AL_FUNC(bool, al_get_profile_zone_stats, (int index, ALLEGRO_PROFILE_STATS *stats));
+AL_FUNC(void, al_reset_profile_stats, (void));
+AL_FUNC(bool, al_start_profile_trace, (const char *filename, double interval));
+AL_FUNC(void, al_stop_profile_trace, (void));
+
+#ifdef __cplusplus
+   }
+#endif
+
+#endif
+
+/*
+ * Local Variables:
+ * c-basic-offset: 3
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -52,6 +52,8 @@ AL_FUNC(size_t, al_ustr_length, (const ALLEGRO_USTR *us));
 AL_FUNC(int, al_ustr_offset, (const ALLEGRO_USTR *us, int index));
 AL_FUNC(bool, al_ustr_next, (const ALLEGRO_USTR *us, int *pos));
 AL_FUNC(bool, al_ustr_prev, (const ALLEGRO_USTR *us, int *pos));
+AL_FUNC(bool, al_ustr_enable_index, (ALLEGRO_USTR *us));
+AL_FUNC(void, al_ustr_disable_index, (ALLEGRO_USTR *us));
 
 /* Get codepoints */
 AL_FUNC(int32_t, al_ustr_get, (const ALLEGRO_USTR *us, int pos));
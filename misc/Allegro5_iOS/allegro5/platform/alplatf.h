@@ -48,6 +48,8 @@
 #define ALLEGRO_HAVE_SYS_TYPES_H
 #define ALLEGRO_HAVE_OSATOMIC_H
 /* #undef ALLEGRO_HAVE_SYS_INOTIFY_H */
+/* #undef ALLEGRO_HAVE_SYS_EPOLL_H */
+/* #undef ALLEGRO_HAVE_SYS_EVENTFD_H */
 /* #undef ALLEGRO_HAVE_SAL_H */
 
 /* Define to 1 if the corresponding functions are available. */
@@ -124,6 +124,7 @@ def make_drawer(name):
       ALLEGRO_BITMAP* texture = s->texture->parent ? s->texture->parent : s->texture;
       const int src_format = texture->locked_region.format;
       const int src_size = texture->locked_region.pixel_size;
+      const bool src_tiled = (texture->lock_flags & _AL_LOCK_NATIVE_TILES) != 0;
 
       /* Ensure u in [0, s->w) and v in [0, s->h). */
       while (u < 0) u += s->w;
@@ -331,7 +332,16 @@ def make_loop(
 
    print "}"
 
-def make_innermost_loop(
+def make_innermost_loop(**kwargs):
+   # Tiled memory bitmaps are sampled in place, so textured loops come in
+   # two versions which differ only in how a texel is addressed.
+   if texture:
+      print "if (src_tiled)"
+      make_innermost_loop_layout(tiled_layout=True, **kwargs)
+      print "else"
+   make_innermost_loop_layout(tiled_layout=False, **kwargs)
+
+def make_innermost_loop_layout(
       op='op',
       src_mode='src_mode',
       dst_mode='dst_mode',
@@ -344,7 +354,8 @@ def make_innermost_loop(
       src_size='src_size',
       copy_format=False,
       tiling=True,
-      alpha_only=True
+      alpha_only=True,
+      tiled_layout=False
       ):
 
    print "{"
@@ -376,7 +387,15 @@ def make_innermost_loop(
          ALLEGRO_COLOR src_color = cur_color;
          """
    else:
-      print interp("""\
+      if tiled_layout:
+         print interp("""\
+         const int src_x = (uu >> 16) + #{uu_ofs};
+         const int src_y = (vv >> 16) + #{vv_ofs};
+         uint8_t *src_data = lock_data
+            + _AL_TILED_PIXEL_OFFSET(src_x, src_y, src_pitch, #{src_size});
+         """)
+      else:
+         print interp("""\
          const int src_x = (uu >> 16) + #{uu_ofs};
          const int src_y = (vv >> 16) + #{vv_ofs};
          uint8_t *src_data = lock_data
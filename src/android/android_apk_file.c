@@ -291,7 +291,9 @@ static const ALLEGRO_FILE_INTERFACE file_apk_vtable =
    file_apk_ferrmsg,
    file_apk_fclearerr,
    NULL, /* default ungetc implementation */
-   file_apk_fsize
+   file_apk_fsize,
+   NULL,
+   NULL
 };
 
 
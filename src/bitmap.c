@@ -25,30 +25,23 @@
 #include "allegro5/internal/aintern_bitmap.h"
 #include "allegro5/internal/aintern_display.h"
 #include "allegro5/internal/aintern_pixels.h"
+#include "allegro5/internal/aintern_profile.h"
 #include "allegro5/internal/aintern_shader.h"
 #include "allegro5/internal/aintern_system.h"
+#include "allegro5/internal/aintern_thread.h"
 
 ALLEGRO_DEBUG_CHANNEL("bitmap")
 
 
-/* Creates a memory bitmap.
+/* Fills in the fields shared by all memory bitmaps.  The caller sets
+ * bitmap->memory.  Returns NULL if out of memory.
  */
-static ALLEGRO_BITMAP *create_memory_bitmap(ALLEGRO_DISPLAY *current_display,
-   int w, int h, int format, int flags)
+static ALLEGRO_BITMAP *init_memory_bitmap(int w, int h, int format,
+   int flags, int pitch)
 {
-   ALLEGRO_BITMAP *bitmap;
-   int pitch;
-
-   if (_al_pixel_format_is_video_only(format)) {
-      /* Can't have a video-only memory bitmap... */
+   ALLEGRO_BITMAP *bitmap = al_calloc(1, sizeof *bitmap);
+   if (!bitmap)
       return NULL;
-   }
-
-   format = _al_get_real_pixel_format(current_display, format);
-
-   bitmap = al_calloc(1, sizeof *bitmap);
-
-   pitch = w * al_get_pixel_size(format);
 
    bitmap->vt = NULL;
    bitmap->_format = format;
@@ -73,7 +66,117 @@ static ALLEGRO_BITMAP *create_memory_bitmap(ALLEGRO_DISPLAY *current_display,
    al_orthographic_transform(&bitmap->proj_transform, 0, 0, -1.0, w, h, 1.0);
    bitmap->parent = NULL;
    bitmap->xofs = bitmap->yofs = 0;
-   bitmap->memory = al_malloc(pitch * h);
+
+   return bitmap;
+}
+
+
+
+static void free_aligned_memory(void *memory, void *userdata)
+{
+   (void)memory;
+   al_free(userdata);
+}
+
+
+
+/* Allocates `size` bytes starting at a multiple of `align`.  The block to
+ * pass to free_aligned_memory is returned in `raw`.  Returns NULL if out of
+ * memory.
+ */
+static unsigned char *alloc_aligned_memory(size_t size, int align, void **raw)
+{
+   /* Over-allocate and round the start up. */
+   unsigned char *p = al_malloc(size + align - 1);
+   uintptr_t addr = ((uintptr_t)p + align - 1) & ~(uintptr_t)(align - 1);
+
+   *raw = p;
+   if (!p)
+      return NULL;
+   return (unsigned char *)addr;
+}
+
+
+
+static void keep_memory(void *memory, void *userdata)
+{
+   (void)memory;
+   (void)userdata;
+}
+
+
+
+/* Creates a memory bitmap.
+ */
+static ALLEGRO_BITMAP *create_memory_bitmap(ALLEGRO_DISPLAY *current_display,
+   int w, int h, int format, int flags)
+{
+   ALLEGRO_BITMAP *bitmap;
+   int pitch;
+   int align = 0;
+
+   if (_al_pixel_format_is_video_only(format)) {
+      /* Can't have a video-only memory bitmap... */
+      return NULL;
+   }
+
+   format = _al_get_real_pixel_format(current_display, format);
+
+   if (al_get_pixel_block_width(format) != 1 ||
+         al_get_pixel_block_height(format) != 1) {
+      flags &= ~ALLEGRO_TILED_MEMORY_BITMAP;
+   }
+
+   if (flags & ALLEGRO_TILED_MEMORY_BITMAP) {
+      /* One row of tiles; h is padded to match below.  Rows of tiles a
+       * multiple of 4 KiB apart would all map to the same cache sets when
+       * walking down a column, so add a spare tile in that case.
+       */
+      pitch = _al_get_least_multiple(w, _AL_MEMORY_TILE_SIZE)
+         * _AL_MEMORY_TILE_SIZE * al_get_pixel_size(format);
+      if (pitch % 4096 == 0) {
+         pitch += _AL_MEMORY_TILE_SIZE * _AL_MEMORY_TILE_SIZE
+            * al_get_pixel_size(format);
+      }
+   }
+   else if (_al_pixel_format_is_compressed(format)) {
+      /* One row of blocks, stored as in a DDS file. */
+      pitch = _al_get_least_multiple(w, al_get_pixel_block_width(format))
+         / al_get_pixel_block_width(format) * al_get_pixel_block_size(format);
+   }
+   else {
+      pitch = w * al_get_pixel_size(format);
+      align = al_get_new_bitmap_alignment();
+      if (align > 1)
+         pitch = _al_get_least_multiple(pitch, align);
+   }
+
+   bitmap = init_memory_bitmap(w, h, format, flags, pitch);
+   if (!bitmap)
+      return NULL;
+
+   if (flags & ALLEGRO_TILED_MEMORY_BITMAP) {
+      bitmap->memory = al_malloc(pitch *
+         (_al_get_least_multiple(h, _AL_MEMORY_TILE_SIZE) >>
+            _AL_MEMORY_TILE_SHIFT));
+   }
+   else if (_al_pixel_format_is_compressed(format)) {
+      bitmap->memory = al_calloc(1, pitch *
+         (_al_get_least_multiple(h, al_get_pixel_block_height(format)) /
+            al_get_pixel_block_height(format)));
+   }
+   else if (align > 1) {
+      bitmap->memory = alloc_aligned_memory((size_t)pitch * h, align,
+         &bitmap->free_memory_data);
+      bitmap->free_memory = free_aligned_memory;
+   }
+   else {
+      bitmap->memory = al_malloc(pitch * h);
+   }
+   if (!bitmap->memory && w > 0 && h > 0) {
+      al_free(bitmap);
+      return NULL;
+   }
    
    _al_register_convert_bitmap(bitmap);
    return bitmap;
@@ -85,13 +188,185 @@ static void destroy_memory_bitmap(ALLEGRO_BITMAP *bmp)
 {
    _al_unregister_convert_bitmap(bmp);
 
-   if (bmp->memory)
+   if (bmp->free_memory)
+      bmp->free_memory(bmp->memory, bmp->free_memory_data);
+   else if (bmp->memory)
       al_free(bmp->memory);
    al_free(bmp);
 }
 
 
 
+/* Pixel storage shared by copy-on-write clones.  Every bitmap using it
+ * holds one reference, through its free_memory hook.
+ */
+typedef struct SHARED_MEMORY {
+   _AL_MUTEX mutex;
+   int refcount;
+   unsigned char *memory;
+   void (*free_memory)(void *memory, void *userdata);
+   void *free_memory_data;
+   /* Layout of the bitmap the memory was allocated for. */
+   int w, h;
+   int align;
+} SHARED_MEMORY;
+
+
+
+static void release_shared_memory(void *memory, void *userdata)
+{
+   SHARED_MEMORY *shared = userdata;
+   int refcount;
+   (void)memory;
+
+   _al_mutex_lock(&shared->mutex);
+   refcount = --shared->refcount;
+   _al_mutex_unlock(&shared->mutex);
+   if (refcount > 0)
+      return;
+
+   if (shared->free_memory)
+      shared->free_memory(shared->memory, shared->free_memory_data);
+   else
+      al_free(shared->memory);
+   _al_mutex_destroy(&shared->mutex);
+   al_free(shared);
+}
+
+
+
+/* Adds a reference to the pixels of a memory bitmap, turning them into
+ * shared storage first if needed.  Returns NULL for memory we don't own.
+ */
+static SHARED_MEMORY *share_memory(ALLEGRO_BITMAP *bitmap)
+{
+   SHARED_MEMORY *shared;
+
+   if (bitmap->free_memory == release_shared_memory) {
+      shared = bitmap->free_memory_data;
+      _al_mutex_lock(&shared->mutex);
+      shared->refcount++;
+      _al_mutex_unlock(&shared->mutex);
+      return shared;
+   }
+
+   /* Wrapped user memory may change behind our back. */
+   if (bitmap->free_memory && bitmap->free_memory != free_aligned_memory)
+      return NULL;
+
+   shared = al_malloc(sizeof *shared);
+   if (!shared)
+      return NULL;
+   _al_mutex_init(&shared->mutex);
+   shared->refcount = 2;
+   shared->memory = bitmap->memory;
+   shared->free_memory = bitmap->free_memory;
+   shared->free_memory_data = bitmap->free_memory_data;
+   shared->w = bitmap->w;
+   shared->h = bitmap->h;
+   shared->align = 0;
+   if (bitmap->free_memory == free_aligned_memory) {
+      /* The requested alignment isn't recorded, but the lowest power of
+       * two dividing both the start and the pitch is at least as large.
+       */
+      uintptr_t bits = (uintptr_t)bitmap->memory | (uintptr_t)bitmap->pitch;
+      shared->align = (int)(bits & (~bits + 1));
+   }
+
+   bitmap->free_memory = release_shared_memory;
+   bitmap->free_memory_data = shared;
+   return shared;
+}
+
+
+
+/* _al_unshare_bitmap_memory:
+ *  Gives a memory bitmap which shares its pixels with copy-on-write
+ *  clones a private copy, before it is written to.  With `discard` the
+ *  old contents are about to be overwritten and aren't copied.
+ *  Returns false if out of memory.
+ */
+bool _al_unshare_bitmap_memory(ALLEGRO_BITMAP *bitmap, bool discard)
+{
+   SHARED_MEMORY *shared;
+   unsigned char *memory;
+   void *raw = NULL;
+   bool whole;
+   int align = 0;
+   int format;
+   int rows;
+   int row_size;
+   int pitch;
+   int y;
+
+   if (bitmap->free_memory != release_shared_memory)
+      return true;
+   shared = bitmap->free_memory_data;
+
+   /* The last user of the whole buffer simply takes it back. */
+   _al_mutex_lock(&shared->mutex);
+   if (shared->refcount == 1 && bitmap->memory == shared->memory) {
+      _al_mutex_unlock(&shared->mutex);
+      bitmap->free_memory = shared->free_memory;
+      bitmap->free_memory_data = shared->free_memory_data;
+      _al_mutex_destroy(&shared->mutex);
+      al_free(shared);
+      return true;
+   }
+   _al_mutex_unlock(&shared->mutex);
+
+   whole = (bitmap->memory == shared->memory && bitmap->w == shared->w &&
+      bitmap->h == shared->h);
+   format = al_get_bitmap_format(bitmap);
+   if (_al_bitmap_is_tiled(bitmap)) {
+      rows = _al_get_least_multiple(bitmap->h, _AL_MEMORY_TILE_SIZE) >>
+         _AL_MEMORY_TILE_SHIFT;
+      row_size = pitch = bitmap->pitch;
+   }
+   else if (_al_pixel_format_is_compressed(format)) {
+      rows = _al_get_least_multiple(bitmap->h,
+         al_get_pixel_block_height(format)) /
+         al_get_pixel_block_height(format);
+      row_size = pitch = bitmap->pitch;
+   }
+   else if (whole) {
+      /* Keep the layout the bitmap was created with, including any
+       * alignment.
+       */
+      rows = bitmap->h;
+      row_size = bitmap->w * al_get_pixel_size(format);
+      pitch = bitmap->pitch;
+      align = shared->align;
+   }
+   else {
+      /* Snapshots of sub-bitmaps use their parent's pitch; compact it. */
+      rows = bitmap->h;
+      row_size = pitch = bitmap->w * al_get_pixel_size(format);
+   }
+
+   if (align > 1)
+      memory = alloc_aligned_memory((size_t)pitch * rows, align, &raw);
+   else
+      memory = al_malloc((size_t)pitch * rows);
+   if (!memory)
+      return false;
+   if (!discard) {
+      for (y = 0; y < rows; y++) {
+         memcpy(memory + (size_t)y * pitch,
+            bitmap->memory + (ptrdiff_t)y * bitmap->pitch, row_size);
+      }
+   }
+
+   release_shared_memory(bitmap->memory, shared);
+   bitmap->memory = memory;
+   bitmap->pitch = pitch;
+   bitmap->free_memory = raw ? free_aligned_memory : NULL;
+   bitmap->free_memory_data = raw;
+   return true;
+}
+
+
+
 ALLEGRO_BITMAP *_al_create_bitmap_params(ALLEGRO_DISPLAY *current_display,
    int w, int h, int format, int flags)
 {
@@ -193,6 +468,55 @@ ALLEGRO_BITMAP *al_create_bitmap(int w, int h)
 }
 
 
+/* Function: al_create_bitmap_from_memory
+ */
+ALLEGRO_BITMAP *al_create_bitmap_from_memory(void *data, int w, int h,
+   int format, int pitch, void (*destroy)(void *data, void *userdata),
+   void *userdata)
+{
+   ALLEGRO_BITMAP *bitmap;
+   int64_t mul;
+   int row;
+
+   ASSERT(data);
+
+   if (w <= 0 || h <= 0)
+      return NULL;
+
+   mul = 4 * (int64_t) w * (int64_t) h;
+   if (mul > (int64_t) INT_MAX) {
+      ALLEGRO_WARN("Rejecting %dx%d bitmap\n", w, h);
+      return NULL;
+   }
+
+   if (!_al_pixel_format_is_real(format) ||
+         _al_pixel_format_is_video_only(format) ||
+         _al_pixel_format_is_compressed(format)) {
+      ALLEGRO_WARN("Cannot wrap memory of pixel format %d\n", format);
+      return NULL;
+   }
+
+   row = w * al_get_pixel_size(format);
+   if (pitch < row && -pitch < row) {
+      ALLEGRO_WARN("Pitch %d too small for %d pixels\n", pitch, w);
+      return NULL;
+   }
+
+   /* The memory can't be moved, so never convert or tile it. */
+   bitmap = init_memory_bitmap(w, h, format, ALLEGRO_MEMORY_BITMAP, pitch);
+   if (!bitmap)
+      return NULL;
+   bitmap->memory = data;
+   bitmap->free_memory = destroy ? destroy : keep_memory;
+   bitmap->free_memory_data = userdata;
+
+   _al_register_destructor(_al_dtor_list, bitmap,
+      (void (*)(void *))al_destroy_bitmap);
+
+   return bitmap;
+}
+
+
 /* Function: al_destroy_bitmap
  */
 void al_destroy_bitmap(ALLEGRO_BITMAP *bitmap)
@@ -236,12 +560,128 @@ void al_destroy_bitmap(ALLEGRO_BITMAP *bitmap)
 
       if (bitmap->memory)
          al_free(bitmap->memory);
+
+      al_free(bitmap->dirty_tiles);
    }
 
    al_free(bitmap);
 }
 
 
+static int dirty_tiles_across(ALLEGRO_BITMAP *bitmap)
+{
+   return (bitmap->w + _AL_DIRTY_TILE_SIZE - 1) / _AL_DIRTY_TILE_SIZE;
+}
+
+
+static int dirty_tiles_down(ALLEGRO_BITMAP *bitmap)
+{
+   return (bitmap->h + _AL_DIRTY_TILE_SIZE - 1) / _AL_DIRTY_TILE_SIZE;
+}
+
+
+/* _al_mark_bitmap_dirty:
+ *  Record that the given rectangle of a video bitmap has been modified on
+ *  the display side, so that it will be included in the next backup.
+ *  Sub-bitmaps mark only their own area of the parent.
+ */
+void _al_mark_bitmap_dirty(ALLEGRO_BITMAP *bitmap, int x, int y, int w, int h)
+{
+   int across, down;
+   int tx1, ty1, tx2, ty2;
+   int ty;
+
+   if (bitmap->parent) {
+      x += bitmap->xofs;
+      y += bitmap->yofs;
+      bitmap = bitmap->parent;
+   }
+
+   if (al_get_bitmap_flags(bitmap) & ALLEGRO_MEMORY_BITMAP)
+      return;
+
+   /* Already completely dirty. */
+   if (bitmap->dirty && !bitmap->dirty_tiles)
+      return;
+
+   if (x < 0) {
+      w += x;
+      x = 0;
+   }
+   if (y < 0) {
+      h += y;
+      y = 0;
+   }
+   if (x + w > bitmap->w)
+      w = bitmap->w - x;
+   if (y + h > bitmap->h)
+      h = bitmap->h - y;
+   if (w <= 0 || h <= 0)
+      return;
+
+   across = dirty_tiles_across(bitmap);
+   down = dirty_tiles_down(bitmap);
+
+   if (!bitmap->dirty) {
+      if (w == bitmap->w && h == bitmap->h) {
+         bitmap->dirty = true;
+         al_free(bitmap->dirty_tiles);
+         bitmap->dirty_tiles = NULL;
+         return;
+      }
+      if (!bitmap->dirty_tiles) {
+         bitmap->dirty_tiles = al_malloc(across * down);
+         if (!bitmap->dirty_tiles) {
+            /* Fall back to treating the whole bitmap as dirty. */
+            bitmap->dirty = true;
+            return;
+         }
+      }
+      memset(bitmap->dirty_tiles, 0, across * down);
+      bitmap->dirty = true;
+   }
+
+   tx1 = x / _AL_DIRTY_TILE_SIZE;
+   ty1 = y / _AL_DIRTY_TILE_SIZE;
+   tx2 = (x + w - 1) / _AL_DIRTY_TILE_SIZE;
+   ty2 = (y + h - 1) / _AL_DIRTY_TILE_SIZE;
+
+   for (ty = ty1; ty <= ty2; ty++) {
+      memset(bitmap->dirty_tiles + ty * across + tx1, 1, tx2 - tx1 + 1);
+   }
+}
+
+
+/* _al_mark_bitmap_clean:
+ *  Record that the memory copy of the bitmap is up to date.
+ */
+void _al_mark_bitmap_clean(ALLEGRO_BITMAP *bitmap)
+{
+   if (bitmap->parent)
+      bitmap = bitmap->parent;
+
+   bitmap->dirty = false;
+}
+
+
+/* _al_is_bitmap_tile_dirty:
+ *  Return whether the tile at column tx, row ty (counting in
+ *  _AL_DIRTY_TILE_SIZE units) needs to be backed up.
+ */
+bool _al_is_bitmap_tile_dirty(ALLEGRO_BITMAP *bitmap, int tx, int ty)
+{
+   ASSERT(bitmap->parent == NULL);
+   ASSERT(tx >= 0 && tx < dirty_tiles_across(bitmap));
+   ASSERT(ty >= 0 && ty < dirty_tiles_down(bitmap));
+
+   if (!bitmap->dirty)
+      return false;
+   if (!bitmap->dirty_tiles)
+      return true;
+   return bitmap->dirty_tiles[ty * dirty_tiles_across(bitmap) + tx];
+}
+
+
 /* Function: al_convert_mask_to_alpha
  */
 void al_convert_mask_to_alpha(ALLEGRO_BITMAP *bitmap, ALLEGRO_COLOR mask_color)
@@ -416,6 +856,8 @@ ALLEGRO_BITMAP *al_create_sub_bitmap(ALLEGRO_BITMAP *parent,
    }
    
    bitmap = al_calloc(1, sizeof *bitmap);
+   if (!bitmap)
+      return NULL;
    bitmap->vt = parent->vt;
 
    /* Sub-bitmap inherits these from the parent.
@@ -604,32 +1046,162 @@ void _al_copy_bitmap_data(
    }
 }
 
+/* Copy a linear rectangle into a tiled memory bitmap's storage at dx/dy.
+ * dst_pitch is the size of one row of tiles.
+ */
+void _al_tile_bitmap_data(const void *src, int src_pitch,
+   void *dst, int dst_pitch, int dx, int dy, int width, int height,
+   int pixel_size)
+{
+   const char *src_row = src;
+   char *dst_ptr = dst;
+   int x, y, run;
+
+   ASSERT(src);
+   ASSERT(dst);
+
+   for (y = 0; y < height; y++) {
+      /* Copy up to the end of each tile row in one go. */
+      for (x = 0; x < width; x += run) {
+         run = _AL_MEMORY_TILE_SIZE - ((dx + x) & _AL_MEMORY_TILE_MASK);
+         if (run > width - x)
+            run = width - x;
+         memcpy(dst_ptr + _AL_TILED_PIXEL_OFFSET(dx + x, dy + y, dst_pitch,
+               pixel_size),
+            src_row + x * pixel_size, run * pixel_size);
+      }
+      src_row += src_pitch;
+   }
+}
+
+
+/* The reverse of _al_tile_bitmap_data: copy the rectangle at sx/sy of a
+ * tiled memory bitmap's storage to a linear buffer.
+ */
+void _al_untile_bitmap_data(const void *src, int src_pitch,
+   void *dst, int dst_pitch, int sx, int sy, int width, int height,
+   int pixel_size)
+{
+   const char *src_ptr = src;
+   char *dst_row = dst;
+   int x, y, run;
+
+   ASSERT(src);
+   ASSERT(dst);
+
+   for (y = 0; y < height; y++) {
+      for (x = 0; x < width; x += run) {
+         run = _AL_MEMORY_TILE_SIZE - ((sx + x) & _AL_MEMORY_TILE_MASK);
+         if (run > width - x)
+            run = width - x;
+         memcpy(dst_row + x * pixel_size,
+            src_ptr + _AL_TILED_PIXEL_OFFSET(sx + x, sy + y, src_pitch,
+               pixel_size),
+            run * pixel_size);
+      }
+      dst_row += dst_pitch;
+   }
+}
+
+_AL_PROFILE_ZONE(convert_zone, "bitmap/convert_data");
+_AL_PROFILE_COUNTER(converted_pixels_counter, "bitmap/converted_pixels");
+
 void _al_convert_bitmap_data(
    const void *src, int src_format, int src_pitch,
    void *dst, int dst_format, int dst_pitch,
    int sx, int sy, int dx, int dy, int width, int height)
 {
+   _AL_PROFILE_DECL(convert_zone);
    ASSERT(src);
    ASSERT(dst);
    ASSERT(_al_pixel_format_is_real(dst_format));
 
+   _AL_PROFILE_BEGIN(convert_zone);
+   _AL_PROFILE_ADD(converted_pixels_counter, (int64_t)width * height);
+
    /* Use memcpy if no conversion is needed. */
    if (src_format == dst_format) {
       _al_copy_bitmap_data(src, src_pitch, dst, dst_pitch, sx, sy,
          dx, dy, width, height, src_format);
-      return;
    }
+   /* Compressed formats go through the software block codec. */
+   else if (_al_pixel_format_is_compressed(src_format) ||
+         _al_pixel_format_is_compressed(dst_format)) {
+      _al_convert_compressed_bitmap_data(src, src_format, src_pitch,
+         dst, dst_format, dst_pitch, sx, sy, dx, dy, width, height);
+   }
+   else {
+      /* Video-only formats don't have conversion functions, so they should
+       * have been taken care of before reaching this location. */
+      ASSERT(!_al_pixel_format_is_video_only(src_format));
+      ASSERT(!_al_pixel_format_is_video_only(dst_format));
 
-   /* Video-only formats don't have conversion functions, so they should have
-    * been taken care of before reaching this location. */
-   ASSERT(!_al_pixel_format_is_video_only(src_format));
-   ASSERT(!_al_pixel_format_is_video_only(dst_format));
+      (_al_convert_funcs[src_format][dst_format])(src, src_pitch,
+         dst, dst_pitch, sx, sy, dx, dy, width, height);
+   }
 
-   (_al_convert_funcs[src_format][dst_format])(src, src_pitch,
-      dst, dst_pitch, sx, sy, dx, dy, width, height);
+   _AL_PROFILE_END(convert_zone);
 }
 
 
+/* Clones a memory bitmap, or a rectangle of one, by sharing its pixels.
+ * Returns NULL if the new bitmap flags and format don't allow that.
+ */
+static ALLEGRO_BITMAP *clone_shared(ALLEGRO_BITMAP *bitmap)
+{
+   ALLEGRO_BITMAP *root = bitmap->parent ? bitmap->parent : bitmap;
+   ALLEGRO_BITMAP *clone;
+   SHARED_MEMORY *shared;
+   int flags = al_get_new_bitmap_flags();
+   int new_format = al_get_new_bitmap_format();
+   int format = al_get_bitmap_format(root);
+   ptrdiff_t offset = 0;
+
+   if (!(al_get_bitmap_flags(root) & ALLEGRO_MEMORY_BITMAP) || root->locked)
+      return NULL;
+   if (!(flags & ALLEGRO_MEMORY_BITMAP) &&
+         (al_get_current_display() || (flags & ALLEGRO_VIDEO_BITMAP)))
+      return NULL;
+   if (_al_get_real_pixel_format(al_get_current_display(), new_format) !=
+         format)
+      return NULL;
+   if (!(flags & ALLEGRO_TILED_MEMORY_BITMAP) != !_al_bitmap_is_tiled(root))
+      return NULL;
+
+   if (bitmap->parent) {
+      /* Only linear storage can be addressed from an offset. */
+      if (_al_bitmap_is_tiled(root) || _al_pixel_format_is_compressed(format))
+         return NULL;
+      if (bitmap->xofs < 0 || bitmap->yofs < 0 ||
+            bitmap->xofs + bitmap->w > root->w ||
+            bitmap->yofs + bitmap->h > root->h)
+         return NULL;
+      offset = (ptrdiff_t)bitmap->yofs * root->pitch +
+         bitmap->xofs * al_get_pixel_size(format);
+   }
+
+   shared = share_memory(root);
+   if (!shared)
+      return NULL;
+
+   clone = init_memory_bitmap(bitmap->w, bitmap->h, format, flags,
+      root->pitch);
+   if (!clone) {
+      release_shared_memory(root->memory, shared);
+      return NULL;
+   }
+   clone->memory = root->memory + offset;
+   clone->free_memory = release_shared_memory;
+   clone->free_memory_data = shared;
+
+   _al_register_convert_bitmap(clone);
+   _al_register_destructor(_al_dtor_list, clone,
+      (void (*)(void *))al_destroy_bitmap);
+   return clone;
+}
+
+
+
 /* Function: al_clone_bitmap
  */
 ALLEGRO_BITMAP *al_clone_bitmap(ALLEGRO_BITMAP *bitmap)
@@ -637,6 +1209,12 @@ ALLEGRO_BITMAP *al_clone_bitmap(ALLEGRO_BITMAP *bitmap)
    ALLEGRO_BITMAP *clone;
    ASSERT(bitmap);
 
+   if (al_get_new_bitmap_flags() & ALLEGRO_COPY_ON_WRITE) {
+      clone = clone_shared(bitmap);
+      if (clone)
+         return clone;
+   }
+
    clone = al_create_bitmap(bitmap->w, bitmap->h);
    if (!clone)
       return NULL;
@@ -0,0 +1,454 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Packing loose bitmaps into shared atlas pages.
+ *
+ *      See LICENSE.txt for copyright information.
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include "allegro5/allegro.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_bitmap.h"
+#include "allegro5/internal/aintern_vector.h"
+
+ALLEGRO_DEBUG_CHANNEL("bitmap")
+
+
+/* Gap left to the right of and below every packed bitmap, so filtered
+ * drawing doesn't pick up its neighbours.
+ */
+#define ATLAS_PADDING 1
+
+
+/* One segment of a page's skyline: the packed area below y is taken
+ * from x to x + w.
+ */
+typedef struct SKYLINE_NODE {
+   int x, y, w;
+} SKYLINE_NODE;
+
+
+typedef struct ATLAS_PAGE {
+   ALLEGRO_BITMAP *bitmap;
+   _AL_VECTOR skyline;
+} ATLAS_PAGE;
+
+
+struct ALLEGRO_BITMAP_ATLAS {
+   int page_w, page_h;
+   _AL_VECTOR pages;
+};
+
+
+
+/* Returns the lowest y at which a w wide rectangle starting at skyline
+ * node i fits under the page height h, or -1.
+ */
+static int fit_skyline(_AL_VECTOR *skyline, unsigned i, int w, int h,
+   int page_w, int page_h)
+{
+   SKYLINE_NODE *node = _al_vector_ref(skyline, i);
+   int x = node->x;
+   int y = 0;
+   int left = w;
+
+   if (x + w > page_w)
+      return -1;
+
+   while (left > 0) {
+      node = _al_vector_ref(skyline, i);
+      if (node->y > y)
+         y = node->y;
+      if (y + h > page_h)
+         return -1;
+      left -= node->w;
+      i++;
+   }
+   return y;
+}
+
+
+
+/* Finds room for a w by h rectangle in the page, bottom-left first.  The
+ * page is treated as one padding wider and higher, since no gap is needed
+ * at its far edges.  Returns the skyline node to pass to
+ * reserve_rectangle, or -1 if it doesn't fit.
+ */
+static int find_rectangle(ATLAS_PAGE *page, int page_w, int page_h,
+   int w, int h, int *out_x, int *out_y)
+{
+   _AL_VECTOR *skyline = &page->skyline;
+   SKYLINE_NODE *node;
+   int best_i = -1;
+   int best_bottom = 0;
+   int best_w = 0;
+   int best_y = 0;
+   unsigned i;
+
+   w += ATLAS_PADDING;
+   h += ATLAS_PADDING;
+   page_w += ATLAS_PADDING;
+   page_h += ATLAS_PADDING;
+
+   for (i = 0; i < _al_vector_size(skyline); i++) {
+      int y = fit_skyline(skyline, i, w, h, page_w, page_h);
+      node = _al_vector_ref(skyline, i);
+      if (y < 0)
+         continue;
+      if (best_i < 0 || y + h < best_bottom ||
+            (y + h == best_bottom && node->w < best_w)) {
+         best_i = i;
+         best_bottom = y + h;
+         best_w = node->w;
+         best_y = y;
+      }
+   }
+   if (best_i < 0)
+      return -1;
+
+   node = _al_vector_ref(skyline, best_i);
+   *out_x = node->x;
+   *out_y = best_y;
+   return best_i;
+}
+
+
+
+/* Takes the rectangle found by find_rectangle at skyline node best_i out
+ * of the free space of the page.
+ */
+static void reserve_rectangle(ATLAS_PAGE *page, int best_i, int x, int y,
+   int w, int h)
+{
+   _AL_VECTOR *skyline = &page->skyline;
+   SKYLINE_NODE *node;
+   SKYLINE_NODE *next;
+   unsigned i;
+
+   w += ATLAS_PADDING;
+   h += ATLAS_PADDING;
+
+   /* Put the new segment in front of node best_i and cut away what it
+    * covers of the following ones.
+    */
+   node = _al_vector_alloc_mid(skyline, best_i);
+   node->x = x;
+   node->y = y + h;
+   node->w = w;
+
+   i = best_i + 1;
+   while (i < _al_vector_size(skyline)) {
+      node = _al_vector_ref(skyline, i - 1);
+      next = _al_vector_ref(skyline, i);
+      if (next->x >= node->x + node->w)
+         break;
+      if (next->x + next->w <= node->x + node->w) {
+         _al_vector_delete_at(skyline, i);
+         continue;
+      }
+      next->w -= node->x + node->w - next->x;
+      next->x = node->x + node->w;
+      break;
+   }
+
+   /* Merge runs of equal height. */
+   for (i = 1; i < _al_vector_size(skyline); i++) {
+      node = _al_vector_ref(skyline, i - 1);
+      next = _al_vector_ref(skyline, i);
+      if (node->y == next->y) {
+         node->w += next->w;
+         _al_vector_delete_at(skyline, i);
+         i--;
+      }
+   }
+}
+
+
+
+static ATLAS_PAGE *add_page(ALLEGRO_BITMAP_ATLAS *atlas)
+{
+   ALLEGRO_BITMAP *bitmap;
+   ALLEGRO_STATE state;
+   ATLAS_PAGE *page;
+   SKYLINE_NODE *node;
+
+   bitmap = al_create_bitmap(atlas->page_w, atlas->page_h);
+   if (!bitmap)
+      return NULL;
+
+   al_store_state(&state, ALLEGRO_STATE_TARGET_BITMAP);
+   al_set_target_bitmap(bitmap);
+   al_clear_to_color(al_map_rgba(0, 0, 0, 0));
+   al_restore_state(&state);
+
+   page = _al_vector_alloc_back(&atlas->pages);
+   page->bitmap = bitmap;
+   _al_vector_init(&page->skyline, sizeof(SKYLINE_NODE));
+   node = _al_vector_alloc_back(&page->skyline);
+   node->x = 0;
+   node->y = 0;
+   node->w = atlas->page_w + ATLAS_PADDING;
+   ALLEGRO_DEBUG("Atlas page %d created\n",
+      (int)_al_vector_size(&atlas->pages) - 1);
+   return page;
+}
+
+
+
+static void remove_last_page(ALLEGRO_BITMAP_ATLAS *atlas)
+{
+   unsigned last = _al_vector_size(&atlas->pages) - 1;
+   ATLAS_PAGE *page = _al_vector_ref(&atlas->pages, last);
+
+   al_destroy_bitmap(page->bitmap);
+   _al_vector_free(&page->skyline);
+   _al_vector_delete_at(&atlas->pages, last);
+}
+
+
+
+static bool in_atlas(ALLEGRO_BITMAP_ATLAS *atlas, ALLEGRO_BITMAP *bitmap)
+{
+   unsigned i;
+
+   if (!bitmap->parent)
+      return false;
+   for (i = 0; i < _al_vector_size(&atlas->pages); i++) {
+      ATLAS_PAGE *page = _al_vector_ref(&atlas->pages, i);
+      if (page->bitmap == bitmap->parent)
+         return true;
+   }
+   return false;
+}
+
+
+
+/* Copies the pixels of bitmap into the page and makes it a sub-bitmap
+ * there, keeping its pointer and drawing state.  Returns false, leaving
+ * both untouched, if the sub-bitmap can't be created.
+ */
+static bool move_to_page(ALLEGRO_BITMAP *bitmap, ALLEGRO_BITMAP *page,
+   int x, int y)
+{
+   ALLEGRO_BITMAP *old = NULL;
+   ALLEGRO_STATE state;
+
+   if (!bitmap->parent) {
+      old = al_create_sub_bitmap(page, x, y, bitmap->w, bitmap->h);
+      if (!old)
+         return false;
+   }
+
+   al_store_state(&state, ALLEGRO_STATE_TARGET_BITMAP | ALLEGRO_STATE_BLENDER);
+   al_set_target_bitmap(page);
+   al_set_blender(ALLEGRO_ADD, ALLEGRO_ONE, ALLEGRO_ZERO);
+   al_draw_bitmap(bitmap, x, y, 0);
+
+   if (!old) {
+      al_reparent_bitmap(bitmap, page, x, y, bitmap->w, bitmap->h);
+   }
+   else {
+      _al_swap_bitmaps(bitmap, old);
+
+      bitmap->cl = old->cl;
+      bitmap->ct = old->ct;
+      bitmap->cr_excl = old->cr_excl;
+      bitmap->cb_excl = old->cb_excl;
+      bitmap->transform = old->transform;
+      bitmap->inverse_transform = old->inverse_transform;
+      bitmap->inverse_transform_dirty = old->inverse_transform_dirty;
+      bitmap->proj_transform = old->proj_transform;
+
+      al_destroy_bitmap(old);
+   }
+
+   /* Re-targets the bitmap if it was the target, as it moved. */
+   al_restore_state(&state);
+   return true;
+}
+
+
+
+static bool add_bitmap(ALLEGRO_BITMAP_ATLAS *atlas, ALLEGRO_BITMAP *bitmap)
+{
+   ATLAS_PAGE *page = NULL;
+   bool new_page = false;
+   unsigned i;
+   int node = -1;
+   int x, y;
+
+   if (in_atlas(atlas, bitmap))
+      return true;
+   if (bitmap->w <= 0 || bitmap->h <= 0 ||
+         bitmap->w > atlas->page_w || bitmap->h > atlas->page_h) {
+      ALLEGRO_WARN("%dx%d bitmap doesn't fit on a %dx%d atlas page\n",
+         bitmap->w, bitmap->h, atlas->page_w, atlas->page_h);
+      return false;
+   }
+   if (al_is_bitmap_locked(bitmap))
+      return false;
+
+   for (i = 0; i < _al_vector_size(&atlas->pages) && node < 0; i++) {
+      page = _al_vector_ref(&atlas->pages, i);
+      node = find_rectangle(page, atlas->page_w, atlas->page_h,
+         bitmap->w, bitmap->h, &x, &y);
+   }
+
+   if (node < 0) {
+      page = add_page(atlas);
+      if (!page)
+         return false;
+      new_page = true;
+      node = find_rectangle(page, atlas->page_w, atlas->page_h,
+         bitmap->w, bitmap->h, &x, &y);
+      ASSERT(node >= 0);
+   }
+
+   /* Only take the space once the bitmap is really there, so a failure
+    * leaves the page as it was.
+    */
+   if (node < 0 || !move_to_page(bitmap, page->bitmap, x, y)) {
+      if (new_page)
+         remove_last_page(atlas);
+      return false;
+   }
+   reserve_rectangle(page, node, x, y, bitmap->w, bitmap->h);
+   return true;
+}
+
+
+
+/* Tallest first, then widest, packs a skyline most tightly. */
+static int compare_bitmap_sizes(const void *a, const void *b)
+{
+   ALLEGRO_BITMAP *bitmap_a = *(ALLEGRO_BITMAP * const *)a;
+   ALLEGRO_BITMAP *bitmap_b = *(ALLEGRO_BITMAP * const *)b;
+
+   if (bitmap_a->h != bitmap_b->h)
+      return bitmap_b->h - bitmap_a->h;
+   return bitmap_b->w - bitmap_a->w;
+}
+
+
+
+/* Function: al_create_bitmap_atlas
+ */
+ALLEGRO_BITMAP_ATLAS *al_create_bitmap_atlas(int page_width,
+   int page_height)
+{
+   ALLEGRO_BITMAP_ATLAS *atlas;
+   ASSERT(page_width > 0);
+   ASSERT(page_height > 0);
+
+   atlas = al_calloc(1, sizeof *atlas);
+   if (!atlas)
+      return NULL;
+   atlas->page_w = page_width;
+   atlas->page_h = page_height;
+   _al_vector_init(&atlas->pages, sizeof(ATLAS_PAGE));
+   return atlas;
+}
+
+
+
+/* Function: al_destroy_bitmap_atlas
+ */
+void al_destroy_bitmap_atlas(ALLEGRO_BITMAP_ATLAS *atlas)
+{
+   unsigned i;
+
+   if (!atlas)
+      return;
+
+   for (i = 0; i < _al_vector_size(&atlas->pages); i++) {
+      ATLAS_PAGE *page = _al_vector_ref(&atlas->pages, i);
+      al_destroy_bitmap(page->bitmap);
+      _al_vector_free(&page->skyline);
+   }
+   _al_vector_free(&atlas->pages);
+   al_free(atlas);
+}
+
+
+
+/* Function: al_add_bitmap_to_atlas
+ */
+bool al_add_bitmap_to_atlas(ALLEGRO_BITMAP_ATLAS *atlas,
+   ALLEGRO_BITMAP *bitmap)
+{
+   ASSERT(atlas);
+   ASSERT(bitmap);
+
+   return add_bitmap(atlas, bitmap);
+}
+
+
+
+/* Function: al_add_bitmaps_to_atlas
+ */
+int al_add_bitmaps_to_atlas(ALLEGRO_BITMAP_ATLAS *atlas,
+   ALLEGRO_BITMAP **bitmaps, int count)
+{
+   ALLEGRO_BITMAP **sorted;
+   int added = 0;
+   int i;
+   ASSERT(atlas);
+   ASSERT(bitmaps || count == 0);
+
+   if (count <= 0)
+      return 0;
+
+   sorted = al_malloc(count * sizeof *sorted);
+   if (!sorted)
+      return 0;
+   memcpy(sorted, bitmaps, count * sizeof *sorted);
+   qsort(sorted, count, sizeof *sorted, compare_bitmap_sizes);
+
+   for (i = 0; i < count; i++) {
+      if (add_bitmap(atlas, sorted[i]))
+         added++;
+   }
+
+   al_free(sorted);
+   return added;
+}
+
+
+
+/* Function: al_get_bitmap_atlas_page_count
+ */
+int al_get_bitmap_atlas_page_count(ALLEGRO_BITMAP_ATLAS *atlas)
+{
+   ASSERT(atlas);
+
+   return _al_vector_size(&atlas->pages);
+}
+
+
+
+/* Function: al_get_bitmap_atlas_page
+ */
+ALLEGRO_BITMAP *al_get_bitmap_atlas_page(ALLEGRO_BITMAP_ATLAS *atlas,
+   int index)
+{
+   ATLAS_PAGE *page;
+   ASSERT(atlas);
+
+   if (index < 0 || index >= (int)_al_vector_size(&atlas->pages))
+      return NULL;
+   page = _al_vector_ref(&atlas->pages, index);
+   return page->bitmap;
+}
+
+
+/* vim: set ts=8 sts=3 sw=3 et: */
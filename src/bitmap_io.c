@@ -17,6 +17,7 @@
 #include "allegro5/internal/aintern.h"
 #include "allegro5/internal/aintern_bitmap.h"
 #include "allegro5/internal/aintern_exitfunc.h"
+#include "allegro5/internal/aintern_profile.h"
 #include "allegro5/internal/aintern_vector.h"
 
 #include <string.h>
@@ -185,6 +186,8 @@ ALLEGRO_BITMAP *al_load_bitmap(const char *filename)
 }
 
 
+_AL_PROFILE_ZONE(load_zone, "image/load");
+
 /* Function: al_load_bitmap_flags
  */
 ALLEGRO_BITMAP *al_load_bitmap_flags(const char *filename, int flags)
@@ -192,6 +195,7 @@ ALLEGRO_BITMAP *al_load_bitmap_flags(const char *filename, int flags)
    const char *ext;
    Handler *h;
    ALLEGRO_BITMAP *ret;
+   _AL_PROFILE_DECL(load_zone);
 
    ext = strrchr(filename, '.');
    if (!ext) {
@@ -206,7 +210,9 @@ ALLEGRO_BITMAP *al_load_bitmap_flags(const char *filename, int flags)
 
    h = find_handler(ext, false);
    if (h) {
+      _AL_PROFILE_BEGIN(load_zone);
       ret = h->loader(filename, flags);
+      _AL_PROFILE_END(load_zone);
       if (!ret)
          ALLEGRO_WARN("Failed loading %s with %s handler.\n", filename,
             ext);
@@ -265,14 +271,21 @@ ALLEGRO_BITMAP *al_load_bitmap_flags_f(ALLEGRO_FILE *fp,
    const char *ident, int flags)
 {
    Handler *h;
+   ALLEGRO_BITMAP *ret;
+   _AL_PROFILE_DECL(load_zone);
+
    if (ident)
       h = find_handler(ident, false);
    else
       h = find_handler_for_file(fp);
-   if (h)
-      return h->fs_loader(fp, flags);
-   else
+   if (!h)
       return NULL;
+
+   _AL_PROFILE_BEGIN(load_zone);
+   ret = h->fs_loader(fp, flags);
+   _AL_PROFILE_END(load_zone);
+
+   return ret;
 }
 
 
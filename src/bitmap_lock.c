@@ -14,15 +14,124 @@
  */
 
 
+#include <string.h>
 #include "allegro5/allegro.h"
 #include "allegro5/internal/aintern.h"
 #include "allegro5/internal/aintern_bitmap.h"
+#include "allegro5/internal/aintern_exitfunc.h"
 #include "allegro5/internal/aintern_pixels.h"
+#include "allegro5/internal/aintern_profile.h"
+#include "allegro5/internal/aintern_thread.h"
 
+ALLEGRO_DEBUG_CHANNEL("bitmap")
 
-/* Function: al_lock_bitmap_region
+
+/* Protects the concurrent_locks list and locked flag of every bitmap
+ * while concurrent locks are taken or released.
  */
-ALLEGRO_LOCKED_REGION *al_lock_bitmap_region(ALLEGRO_BITMAP *bitmap,
+static _AL_MUTEX concurrent_lock_mutex = _AL_MUTEX_UNINITED;
+
+
+/* Copy a rectangle of a tiled memory bitmap to a linear buffer in the
+ * given format.
+ */
+static bool untile_region(ALLEGRO_BITMAP *bitmap, int x, int y, int w, int h,
+   void *dst, int format, int pitch)
+{
+   int bitmap_format = al_get_bitmap_format(bitmap);
+   int pixel_size = al_get_pixel_size(bitmap_format);
+   int tmp_pitch;
+   void *tmp;
+
+   if (format == bitmap_format) {
+      _al_untile_bitmap_data(bitmap->memory, bitmap->pitch,
+         dst, pitch, x, y, w, h, pixel_size);
+      return true;
+   }
+
+   tmp_pitch = pixel_size * w;
+   tmp = al_malloc(tmp_pitch * h);
+   if (!tmp)
+      return false;
+   _al_untile_bitmap_data(bitmap->memory, bitmap->pitch,
+      tmp, tmp_pitch, x, y, w, h, pixel_size);
+   _al_convert_bitmap_data(tmp, bitmap_format, tmp_pitch,
+      dst, format, pitch, 0, 0, 0, 0, w, h);
+   al_free(tmp);
+   return true;
+}
+
+
+/* The reverse of untile_region. */
+static void retile_region(ALLEGRO_BITMAP *bitmap, int x, int y, int w, int h,
+   const void *src, int format, int pitch)
+{
+   int bitmap_format = al_get_bitmap_format(bitmap);
+   int pixel_size = al_get_pixel_size(bitmap_format);
+   int tmp_pitch;
+   void *tmp;
+
+   if (format == bitmap_format) {
+      _al_tile_bitmap_data(src, pitch,
+         bitmap->memory, bitmap->pitch, x, y, w, h, pixel_size);
+      return;
+   }
+
+   tmp_pitch = pixel_size * w;
+   tmp = al_malloc(tmp_pitch * h);
+   if (tmp) {
+      _al_convert_bitmap_data(src, format, pitch,
+         tmp, bitmap_format, tmp_pitch, 0, 0, 0, 0, w, h);
+      _al_tile_bitmap_data(tmp, tmp_pitch,
+         bitmap->memory, bitmap->pitch, x, y, w, h, pixel_size);
+      al_free(tmp);
+   }
+}
+
+
+/* Give the caller a linear copy of the locked part of a tiled memory
+ * bitmap.  The lock_* fields must already be set.
+ */
+static bool lock_tiled_region(ALLEGRO_BITMAP *bitmap, int format)
+{
+   ALLEGRO_LOCKED_REGION *lr = &bitmap->locked_region;
+
+   lr->format = format;
+   lr->pixel_size = al_get_pixel_size(format);
+   lr->pitch = lr->pixel_size * bitmap->lock_w;
+   lr->data = al_malloc(lr->pitch * bitmap->lock_h);
+   if (!lr->data)
+      return false;
+
+   if (bitmap->lock_flags & ALLEGRO_LOCK_WRITEONLY)
+      return true;
+
+   if (!untile_region(bitmap, bitmap->lock_x, bitmap->lock_y,
+         bitmap->lock_w, bitmap->lock_h, lr->data, format, lr->pitch)) {
+      al_free(lr->data);
+      return false;
+   }
+   return true;
+}
+
+
+static void unlock_tiled_region(ALLEGRO_BITMAP *bitmap)
+{
+   ALLEGRO_LOCKED_REGION *lr = &bitmap->locked_region;
+
+   if (bitmap->lock_flags & _AL_LOCK_NATIVE_TILES)
+      return;
+
+   if (!(bitmap->lock_flags & ALLEGRO_LOCK_READONLY)) {
+      retile_region(bitmap, bitmap->lock_x, bitmap->lock_y,
+         bitmap->lock_w, bitmap->lock_h, lr->data, lr->format, lr->pitch);
+   }
+
+   al_free(lr->data);
+}
+
+
+static ALLEGRO_LOCKED_REGION *lock_bitmap_region(ALLEGRO_BITMAP *bitmap,
    int x, int y, int width, int height, int format, int flags)
 {
    ALLEGRO_LOCKED_REGION *lr;
@@ -51,10 +160,6 @@ ALLEGRO_LOCKED_REGION *al_lock_bitmap_region(ALLEGRO_BITMAP *bitmap,
    if (bitmap->locked)
       return NULL;
 
-   if (!(bitmap_flags & ALLEGRO_MEMORY_BITMAP) &&
-         !(flags & ALLEGRO_LOCK_READONLY))
-      bitmap->dirty = true;
-
    ASSERT(x+width <= bitmap->w);
    ASSERT(y+height <= bitmap->h);
 
@@ -63,6 +168,10 @@ ALLEGRO_LOCKED_REGION *al_lock_bitmap_region(ALLEGRO_BITMAP *bitmap,
    wc = _al_get_least_multiple(x + width, block_width) - xc;
    hc = _al_get_least_multiple(y + height, block_height) - yc;
 
+   if (!(bitmap_flags & ALLEGRO_MEMORY_BITMAP) &&
+         !(flags & ALLEGRO_LOCK_READONLY))
+      _al_mark_bitmap_dirty(bitmap, xc, yc, wc, hc);
+
    bitmap->lock_x = xc;
    bitmap->lock_y = yc;
    bitmap->lock_w = wc;
@@ -83,7 +192,38 @@ ALLEGRO_LOCKED_REGION *al_lock_bitmap_region(ALLEGRO_BITMAP *bitmap,
          return NULL;
       }
       ASSERT(bitmap->memory);
-      if (format == ALLEGRO_PIXEL_FORMAT_ANY || bitmap_format == format || bitmap_format == f) {
+      if (!(flags & ALLEGRO_LOCK_READONLY) &&
+            !_al_unshare_bitmap_memory(bitmap,
+               flags == ALLEGRO_LOCK_WRITEONLY && xc == 0 && yc == 0 &&
+               wc >= bitmap->w && hc >= bitmap->h)) {
+         return NULL;
+      }
+      if (_al_bitmap_is_tiled(bitmap)) {
+         if (format == ALLEGRO_PIXEL_FORMAT_ANY || bitmap_format == f)
+            f = bitmap_format;
+         if (!lock_tiled_region(bitmap, f))
+            return NULL;
+      }
+      else if (_al_pixel_format_is_compressed(bitmap_format)) {
+         /* Decode the blocks into a temporary buffer, in the codec's own
+          * format unless asked for another.
+          */
+         if (format == ALLEGRO_PIXEL_FORMAT_ANY)
+            f = ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE;
+         bitmap->locked_region.pitch = al_get_pixel_size(f) * wc;
+         bitmap->locked_region.data = al_malloc(bitmap->locked_region.pitch*hc);
+         if (!bitmap->locked_region.data)
+            return NULL;
+         bitmap->locked_region.format = f;
+         bitmap->locked_region.pixel_size = al_get_pixel_size(f);
+         if (!(flags & ALLEGRO_LOCK_WRITEONLY)) {
+            _al_convert_bitmap_data(
+               bitmap->memory, bitmap_format, bitmap->pitch,
+               bitmap->locked_region.data, f, bitmap->locked_region.pitch,
+               xc, yc, 0, 0, wc, hc);
+         }
+      }
+      else if (format == ALLEGRO_PIXEL_FORMAT_ANY || bitmap_format == format || bitmap_format == f) {
          bitmap->locked_region.data = bitmap->memory
             + bitmap->pitch * yc + xc * al_get_pixel_size(bitmap_format);
          bitmap->locked_region.format = bitmap_format;
@@ -93,6 +233,8 @@ ALLEGRO_LOCKED_REGION *al_lock_bitmap_region(ALLEGRO_BITMAP *bitmap,
       else {
          bitmap->locked_region.pitch = al_get_pixel_size(f) * wc;
          bitmap->locked_region.data = al_malloc(bitmap->locked_region.pitch*hc);
+         if (!bitmap->locked_region.data)
+            return NULL;
          bitmap->locked_region.format = f;
          bitmap->locked_region.pixel_size = al_get_pixel_size(f);
          if (!(bitmap->lock_flags & ALLEGRO_LOCK_WRITEONLY)) {
@@ -121,6 +263,24 @@ ALLEGRO_LOCKED_REGION *al_lock_bitmap_region(ALLEGRO_BITMAP *bitmap,
 }
 
 
+_AL_PROFILE_ZONE(lock_zone, "bitmap/lock_region");
+
+/* Function: al_lock_bitmap_region
+ */
+ALLEGRO_LOCKED_REGION *al_lock_bitmap_region(ALLEGRO_BITMAP *bitmap,
+   int x, int y, int width, int height, int format, int flags)
+{
+   ALLEGRO_LOCKED_REGION *lr;
+   _AL_PROFILE_DECL(lock_zone);
+
+   _AL_PROFILE_BEGIN(lock_zone);
+   lr = lock_bitmap_region(bitmap, x, y, width, height, format, flags);
+   _AL_PROFILE_END(lock_zone);
+
+   return lr;
+}
+
+
 /* Function: al_lock_bitmap
  */
 ALLEGRO_LOCKED_REGION *al_lock_bitmap(ALLEGRO_BITMAP *bitmap,
@@ -146,15 +306,21 @@ void al_unlock_bitmap(ALLEGRO_BITMAP *bitmap)
       else
          bitmap->vt->unlock_region(bitmap);
    }
+   else if (_al_bitmap_is_tiled(bitmap)) {
+      unlock_tiled_region(bitmap);
+   }
    else {
+      /* Use lock_data, as the locked region's data is offset to the first
+       * requested pixel when a compressed bitmap's lock covers whole blocks.
+       */
       if (bitmap->locked_region.format != 0 && bitmap->locked_region.format != bitmap_format) {
          if (!(bitmap->lock_flags & ALLEGRO_LOCK_READONLY)) {
             _al_convert_bitmap_data(
-               bitmap->locked_region.data, bitmap->locked_region.format, bitmap->locked_region.pitch,
+               bitmap->lock_data, bitmap->locked_region.format, bitmap->locked_region.pitch,
                bitmap->memory, bitmap_format, bitmap->pitch,
                0, 0, bitmap->lock_x, bitmap->lock_y, bitmap->lock_w, bitmap->lock_h);
          }
-         al_free(bitmap->locked_region.data);
+         al_free(bitmap->lock_data);
       }
    }
 
@@ -162,6 +328,41 @@ void al_unlock_bitmap(ALLEGRO_BITMAP *bitmap)
 }
 
 
+/* Lock a whole bitmap read-only for the software texture samplers.  For
+ * tiled memory bitmaps this hands out the tiled storage itself (marked with
+ * _AL_LOCK_NATIVE_TILES, and with pitch the size of a row of tiles) instead
+ * of making a linear copy.  Unlock with al_unlock_bitmap as usual.
+ */
+ALLEGRO_LOCKED_REGION *_al_lock_bitmap_for_sampling(ALLEGRO_BITMAP *bitmap)
+{
+   ALLEGRO_BITMAP *parent = bitmap->parent ? bitmap->parent : bitmap;
+   int bitmap_format;
+
+   if (!_al_bitmap_is_tiled(parent)) {
+      return al_lock_bitmap(bitmap, ALLEGRO_PIXEL_FORMAT_ANY,
+         ALLEGRO_LOCK_READONLY);
+   }
+
+   if (parent->locked)
+      return NULL;
+
+   bitmap_format = al_get_bitmap_format(parent);
+   parent->lock_x = 0;
+   parent->lock_y = 0;
+   parent->lock_w = parent->w;
+   parent->lock_h = parent->h;
+   parent->lock_flags = ALLEGRO_LOCK_READONLY | _AL_LOCK_NATIVE_TILES;
+   parent->locked_region.data = parent->memory;
+   parent->locked_region.format = bitmap_format;
+   parent->locked_region.pitch = parent->pitch;
+   parent->locked_region.pixel_size = al_get_pixel_size(bitmap_format);
+   parent->lock_data = parent->memory;
+   parent->locked = true;
+
+   return &parent->locked_region;
+}
+
+
 /* Function: al_is_bitmap_locked
  */
 bool al_is_bitmap_locked(ALLEGRO_BITMAP *bitmap)
@@ -169,6 +370,326 @@ bool al_is_bitmap_locked(ALLEGRO_BITMAP *bitmap)
    return bitmap->locked;
 }
 
+/* Make a plain copy of the region with an ordinary lock, for bitmaps whose
+ * driver has no asynchronous path.
+ */
+static bool copy_region_sync(ALLEGRO_ASYNC_LOCK *lock)
+{
+   ALLEGRO_LOCKED_REGION *lr;
+   int row_size;
+   int pitch;
+   int y;
+
+   lr = al_lock_bitmap_region(lock->bitmap, lock->x, lock->y, lock->w,
+      lock->h, lock->format, ALLEGRO_LOCK_READONLY);
+   if (!lr) {
+      return false;
+   }
+
+   row_size = lock->w * lr->pixel_size;
+   pitch = _al_get_least_multiple(row_size, 4);
+   lock->buffer = al_malloc(pitch * lock->h);
+   if (!lock->buffer) {
+      al_unlock_bitmap(lock->bitmap);
+      return false;
+   }
+
+   for (y = 0; y < lock->h; y++) {
+      memcpy(lock->buffer + y * pitch, (char *)lr->data + y * lr->pitch,
+         row_size);
+   }
+
+   lock->region.data = lock->buffer;
+   lock->region.format = lr->format;
+   lock->region.pitch = pitch;
+   lock->region.pixel_size = lr->pixel_size;
+   lock->ready = true;
+
+   al_unlock_bitmap(lock->bitmap);
+   return true;
+}
+
+
+/* Function: al_lock_bitmap_region_async
+ */
+ALLEGRO_ASYNC_LOCK *al_lock_bitmap_region_async(ALLEGRO_BITMAP *bitmap,
+   int x, int y, int width, int height, int format)
+{
+   ALLEGRO_ASYNC_LOCK *lock;
+   ASSERT(x >= 0);
+   ASSERT(y >= 0);
+   ASSERT(width >= 0);
+   ASSERT(height >= 0);
+   ASSERT(!_al_pixel_format_is_video_only(format));
+
+   /* For sub-bitmaps */
+   if (bitmap->parent) {
+      x += bitmap->xofs;
+      y += bitmap->yofs;
+      bitmap = bitmap->parent;
+   }
+
+   if (bitmap->locked)
+      return NULL;
+
+   ASSERT(x+width <= bitmap->w);
+   ASSERT(y+height <= bitmap->h);
+
+   lock = al_calloc(1, sizeof *lock);
+   if (!lock)
+      return NULL;
+
+   lock->bitmap = bitmap;
+   lock->x = x;
+   lock->y = y;
+   lock->w = width;
+   lock->h = height;
+   lock->format = format;
+
+   if (!(al_get_bitmap_flags(bitmap) & ALLEGRO_MEMORY_BITMAP) &&
+         bitmap->vt->lock_region_async &&
+         bitmap->vt->lock_region_async(bitmap, lock)) {
+      return lock;
+   }
+
+   if (!copy_region_sync(lock)) {
+      al_free(lock);
+      return NULL;
+   }
+
+   return lock;
+}
+
+
+/* Function: al_is_async_lock_ready
+ */
+bool al_is_async_lock_ready(ALLEGRO_ASYNC_LOCK *lock)
+{
+   ASSERT(lock);
+
+   if (!lock->ready) {
+      lock->ready = lock->bitmap->vt->poll_async_lock(lock, false);
+   }
+   return lock->ready;
+}
+
+
+/* Function: al_wait_for_async_lock
+ */
+ALLEGRO_LOCKED_REGION *al_wait_for_async_lock(ALLEGRO_ASYNC_LOCK *lock)
+{
+   ASSERT(lock);
+
+   if (!lock->ready) {
+      lock->ready = lock->bitmap->vt->poll_async_lock(lock, true);
+   }
+   return lock->ready ? &lock->region : NULL;
+}
+
+
+/* Function: al_release_async_lock
+ */
+void al_release_async_lock(ALLEGRO_ASYNC_LOCK *lock)
+{
+   if (!lock)
+      return;
+
+   if (lock->extra) {
+      lock->bitmap->vt->release_async_lock(lock);
+   }
+   al_free(lock->buffer);
+   al_free(lock);
+}
+
+static void shutdown_concurrent_locks(void)
+{
+   _al_mutex_destroy(&concurrent_lock_mutex);
+}
+
+
+/* This is called in al_install_system. */
+void _al_init_concurrent_locks(void)
+{
+   _al_mutex_init(&concurrent_lock_mutex);
+   _al_add_exit_func(shutdown_concurrent_locks, "shutdown_concurrent_locks");
+}
+
+
+static bool overlaps_concurrent_lock(ALLEGRO_BITMAP *bitmap,
+   int x, int y, int w, int h)
+{
+   ALLEGRO_CONCURRENT_LOCK *lock;
+
+   for (lock = bitmap->concurrent_locks; lock; lock = lock->next) {
+      if (x < lock->x + lock->w && lock->x < x + w &&
+            y < lock->y + lock->h && lock->y < y + h)
+         return true;
+   }
+   return false;
+}
+
+
+/* Function: al_lock_bitmap_region_concurrent
+ */
+ALLEGRO_CONCURRENT_LOCK *al_lock_bitmap_region_concurrent(
+   ALLEGRO_BITMAP *bitmap, int x, int y, int width, int height,
+   int format, int flags)
+{
+   ALLEGRO_CONCURRENT_LOCK *lock;
+   ALLEGRO_LOCKED_REGION *lr;
+   int bitmap_format;
+   int f;
+   ASSERT(x >= 0);
+   ASSERT(y >= 0);
+   ASSERT(width >= 0);
+   ASSERT(height >= 0);
+   ASSERT(!_al_pixel_format_is_video_only(format));
+
+   /* For sub-bitmaps */
+   if (bitmap->parent) {
+      x += bitmap->xofs;
+      y += bitmap->yofs;
+      bitmap = bitmap->parent;
+   }
+
+   ASSERT(x+width <= bitmap->w);
+   ASSERT(y+height <= bitmap->h);
+
+   bitmap_format = al_get_bitmap_format(bitmap);
+   if (!(al_get_bitmap_flags(bitmap) & ALLEGRO_MEMORY_BITMAP) ||
+         _al_pixel_format_is_compressed(bitmap_format)) {
+      ALLEGRO_WARN("Concurrent locks need an uncompressed memory bitmap\n");
+      return NULL;
+   }
+
+   f = _al_get_real_pixel_format(al_get_current_display(), format);
+   if (f < 0)
+      return NULL;
+   if (format == ALLEGRO_PIXEL_FORMAT_ANY)
+      f = bitmap_format;
+
+   lock = al_calloc(1, sizeof *lock);
+   if (!lock)
+      return NULL;
+   lock->bitmap = bitmap;
+   lock->x = x;
+   lock->y = y;
+   lock->w = width;
+   lock->h = height;
+   lock->flags = flags;
+
+   _al_mutex_lock(&concurrent_lock_mutex);
+   if ((bitmap->locked && !bitmap->concurrent_locks) ||
+         overlaps_concurrent_lock(bitmap, x, y, width, height)) {
+      _al_mutex_unlock(&concurrent_lock_mutex);
+      al_free(lock);
+      return NULL;
+   }
+   /* Later locks keep using whatever memory the first one found. */
+   if (!bitmap->concurrent_locks && !_al_unshare_bitmap_memory(bitmap, false)) {
+      _al_mutex_unlock(&concurrent_lock_mutex);
+      al_free(lock);
+      return NULL;
+   }
+   lock->next = bitmap->concurrent_locks;
+   bitmap->concurrent_locks = lock;
+   bitmap->locked = true;
+   _al_mutex_unlock(&concurrent_lock_mutex);
+
+   /* The rectangle is ours now, so the copy needs no lock. */
+   lr = &lock->region;
+   if (!_al_bitmap_is_tiled(bitmap) && f == bitmap_format) {
+      lr->data = bitmap->memory + bitmap->pitch * y
+         + x * al_get_pixel_size(bitmap_format);
+      lr->format = bitmap_format;
+      lr->pitch = bitmap->pitch;
+      lr->pixel_size = al_get_pixel_size(bitmap_format);
+      return lock;
+   }
+
+   lr->format = f;
+   lr->pixel_size = al_get_pixel_size(f);
+   lr->pitch = lr->pixel_size * width;
+   lock->buffer = al_malloc(lr->pitch * height);
+   lr->data = lock->buffer;
+   if (!lock->buffer) {
+      lock->flags = ALLEGRO_LOCK_READONLY;
+      al_unlock_concurrent_lock(lock);
+      return NULL;
+   }
+
+   if (!(flags & ALLEGRO_LOCK_WRITEONLY)) {
+      if (_al_bitmap_is_tiled(bitmap)) {
+         if (!untile_region(bitmap, x, y, width, height, lr->data, f,
+               lr->pitch)) {
+            lock->flags = ALLEGRO_LOCK_READONLY;
+            al_unlock_concurrent_lock(lock);
+            return NULL;
+         }
+      }
+      else {
+         _al_convert_bitmap_data(
+            bitmap->memory, bitmap_format, bitmap->pitch,
+            lr->data, f, lr->pitch,
+            x, y, 0, 0, width, height);
+      }
+   }
+
+   return lock;
+}
+
+
+/* Function: al_get_concurrent_lock_region
+ */
+ALLEGRO_LOCKED_REGION *al_get_concurrent_lock_region(
+   ALLEGRO_CONCURRENT_LOCK *lock)
+{
+   ASSERT(lock);
+
+   return &lock->region;
+}
+
+
+/* Function: al_unlock_concurrent_lock
+ */
+void al_unlock_concurrent_lock(ALLEGRO_CONCURRENT_LOCK *lock)
+{
+   ALLEGRO_BITMAP *bitmap;
+   ALLEGRO_CONCURRENT_LOCK **prev;
+
+   if (!lock)
+      return;
+
+   bitmap = lock->bitmap;
+
+   if (lock->buffer && !(lock->flags & ALLEGRO_LOCK_READONLY)) {
+      if (_al_bitmap_is_tiled(bitmap)) {
+         retile_region(bitmap, lock->x, lock->y, lock->w, lock->h,
+            lock->buffer, lock->region.format, lock->region.pitch);
+      }
+      else {
+         _al_convert_bitmap_data(
+            lock->buffer, lock->region.format, lock->region.pitch,
+            bitmap->memory, al_get_bitmap_format(bitmap), bitmap->pitch,
+            0, 0, lock->x, lock->y, lock->w, lock->h);
+      }
+   }
+
+   _al_mutex_lock(&concurrent_lock_mutex);
+   for (prev = &bitmap->concurrent_locks; *prev; prev = &(*prev)->next) {
+      if (*prev == lock) {
+         *prev = lock->next;
+         break;
+      }
+   }
+   if (!bitmap->concurrent_locks)
+      bitmap->locked = false;
+   _al_mutex_unlock(&concurrent_lock_mutex);
+
+   al_free(lock->buffer);
+   al_free(lock);
+}
+
 /* Function: al_lock_bitmap_blocked
  */
 ALLEGRO_LOCKED_REGION *al_lock_bitmap_blocked(ALLEGRO_BITMAP *bitmap,
@@ -206,7 +727,6 @@ ALLEGRO_LOCKED_REGION *al_lock_bitmap_region_blocked(ALLEGRO_BITMAP *bitmap,
 
    /* Currently, this is the only format that gets to this point */
    ASSERT(_al_pixel_format_is_compressed(bitmap_format));
-   ASSERT(!(bitmap_flags & ALLEGRO_MEMORY_BITMAP));
 
    /* For sub-bitmaps */
    if (bitmap->parent) {
@@ -222,24 +742,45 @@ ALLEGRO_LOCKED_REGION *al_lock_bitmap_region_blocked(ALLEGRO_BITMAP *bitmap,
    if (bitmap->locked)
       return NULL;
 
-   if (!(flags & ALLEGRO_LOCK_READONLY))
-      bitmap->dirty = true;
-
    ASSERT(x_block + width_block
       <= _al_get_least_multiple(bitmap->w, block_width) / block_width);
    ASSERT(y_block + height_block
       <= _al_get_least_multiple(bitmap->h, block_height) / block_height);
 
+   /* Copy-on-write clones must not see writes through this lock. */
+   if ((bitmap_flags & ALLEGRO_MEMORY_BITMAP) &&
+         !(flags & ALLEGRO_LOCK_READONLY) &&
+         !_al_unshare_bitmap_memory(bitmap, false)) {
+      return NULL;
+   }
+
+   if (!(flags & ALLEGRO_LOCK_READONLY))
+      _al_mark_bitmap_dirty(bitmap, x_block * block_width,
+         y_block * block_height, width_block * block_width,
+         height_block * block_height);
+
    bitmap->lock_x = x_block * block_width;
    bitmap->lock_y = y_block * block_height;
    bitmap->lock_w = width_block * block_width;
    bitmap->lock_h = height_block * block_height;
    bitmap->lock_flags = flags;
 
-   lr = bitmap->vt->lock_compressed_region(bitmap, bitmap->lock_x,
-      bitmap->lock_y, bitmap->lock_w, bitmap->lock_h, flags);
-   if (!lr) {
-      return NULL;
+   if (bitmap_flags & ALLEGRO_MEMORY_BITMAP) {
+      /* Memory bitmaps keep the blocks in the locked layout already. */
+      lr = &bitmap->locked_region;
+      lr->data = bitmap->memory + bitmap->pitch * y_block
+         + x_block * al_get_pixel_block_size(bitmap_format);
+      lr->format = bitmap_format;
+      lr->pitch = bitmap->pitch;
+      lr->pixel_size = al_get_pixel_block_size(bitmap_format);
+      bitmap->lock_data = lr->data;
+   }
+   else {
+      lr = bitmap->vt->lock_compressed_region(bitmap, bitmap->lock_x,
+         bitmap->lock_y, bitmap->lock_w, bitmap->lock_h, flags);
+      if (!lr) {
+         return NULL;
+      }
    }
 
    bitmap->locked = true;
@@ -37,7 +37,7 @@ ALLEGRO_COLOR al_get_pixel(ALLEGRO_BITMAP *bitmap, int x, int y)
    }
 
    if (bitmap->locked) {
-      if (_al_pixel_format_is_video_only(bitmap->locked_region.format)) {
+      if (_al_pixel_format_is_compressed(bitmap->locked_region.format)) {
          ALLEGRO_ERROR("Invalid lock format.");
          return color;
       }
@@ -49,8 +49,14 @@ ALLEGRO_COLOR al_get_pixel(ALLEGRO_BITMAP *bitmap, int x, int y)
       }
 
       data = bitmap->locked_region.data;
-      data += y * bitmap->locked_region.pitch;
-      data += x * al_get_pixel_size(bitmap->locked_region.format);
+      if (bitmap->lock_flags & _AL_LOCK_NATIVE_TILES) {
+         data += _AL_TILED_PIXEL_OFFSET(x, y, bitmap->locked_region.pitch,
+            bitmap->locked_region.pixel_size);
+      }
+      else {
+         data += y * bitmap->locked_region.pitch;
+         data += x * al_get_pixel_size(bitmap->locked_region.format);
+      }
 
       _AL_INLINE_GET_PIXEL(bitmap->locked_region.format, data, color, false);
    }
@@ -60,6 +66,15 @@ ALLEGRO_COLOR al_get_pixel(ALLEGRO_BITMAP *bitmap, int x, int y)
          return color;
       }
 
+      /* Locking a tiled bitmap makes a copy, so read the pixel directly. */
+      if (_al_bitmap_is_tiled(bitmap)) {
+         int format = al_get_bitmap_format(bitmap);
+         data = (char *)bitmap->memory + _AL_TILED_PIXEL_OFFSET(x, y,
+            bitmap->pitch, al_get_pixel_size(format));
+         _AL_INLINE_GET_PIXEL(format, data, color, false);
+         return color;
+      }
+
       if (!(lr = al_lock_bitmap_region(bitmap, x, y, 1, 1,
             ALLEGRO_PIXEL_FORMAT_ANY, ALLEGRO_LOCK_READONLY))) {
          return color;
@@ -94,7 +109,7 @@ void _al_put_pixel(ALLEGRO_BITMAP *bitmap, int x, int y, ALLEGRO_COLOR color)
    }
 
    if (bitmap->locked) {
-      if (_al_pixel_format_is_video_only(bitmap->locked_region.format)) {
+      if (_al_pixel_format_is_compressed(bitmap->locked_region.format)) {
          ALLEGRO_ERROR("Invalid lock format.");
          return;
       }
@@ -110,6 +125,14 @@ void _al_put_pixel(ALLEGRO_BITMAP *bitmap, int x, int y, ALLEGRO_COLOR color)
 
       _AL_INLINE_PUT_PIXEL(bitmap->locked_region.format, data, color, false);
    }
+   else if (_al_bitmap_is_tiled(bitmap)) {
+      int format = al_get_bitmap_format(bitmap);
+      if (!_al_unshare_bitmap_memory(bitmap, false))
+         return;
+      data = (char *)bitmap->memory + _AL_TILED_PIXEL_OFFSET(x, y,
+         bitmap->pitch, al_get_pixel_size(format));
+      _AL_INLINE_PUT_PIXEL(format, data, color, false);
+   }
    else {
       lr = al_lock_bitmap_region(bitmap, x, y, 1, 1,
          ALLEGRO_PIXEL_FORMAT_ANY, ALLEGRO_LOCK_WRITEONLY);
@@ -82,10 +82,15 @@ void _al_unregister_convert_bitmap(ALLEGRO_BITMAP *bitmap)
 }
 
 
-static void swap_bitmaps(ALLEGRO_BITMAP *bitmap, ALLEGRO_BITMAP *other)
+/* _al_swap_bitmaps:
+ *  Exchanges the contents of two bitmaps, updating everything that refers
+ *  to them by pointer.
+ */
+void _al_swap_bitmaps(ALLEGRO_BITMAP *bitmap, ALLEGRO_BITMAP *other)
 {
    ALLEGRO_BITMAP temp;
    ALLEGRO_DISPLAY *bitmap_display, *other_display;
+   bool bitmap_listed, other_listed;
 
    _al_unregister_convert_bitmap(bitmap);
    _al_unregister_convert_bitmap(other);
@@ -104,25 +109,30 @@ static void swap_bitmaps(ALLEGRO_BITMAP *bitmap, ALLEGRO_BITMAP *other)
 
    /* We are basically done already. Except we now have to update everything
     * possibly referencing any of the two bitmaps.
+    *
+    * A display's list holds its video bitmaps, but not their sub-bitmaps
+    * (which still report the display of their parent).  Each list entry
+    * still points to the struct the bitmap was in before the swap.
     */
+   bitmap_listed = bitmap_display && !bitmap->parent;
+   other_listed = other_display && !other->parent;
+
+   if (!(bitmap_listed && other_listed && bitmap_display == other_display)) {
+      if (bitmap_listed) {
+         ALLEGRO_BITMAP **back;
+         int pos = _al_vector_find(&bitmap_display->bitmaps, &other);
+         ASSERT(pos >= 0);
+         back = _al_vector_ref(&bitmap_display->bitmaps, pos);
+         *back = bitmap;
+      }
 
-   if (bitmap_display && !other_display) {
-      /* This means before the swap, other was the display bitmap, and we
-       * now should replace it with the swapped pointer.
-       */
-      ALLEGRO_BITMAP **back;
-      int pos = _al_vector_find(&bitmap_display->bitmaps, &other);
-      ASSERT(pos >= 0);
-      back = _al_vector_ref(&bitmap_display->bitmaps, pos);
-      *back = bitmap;
-   }
-
-   if (other_display && !bitmap_display) {
-      ALLEGRO_BITMAP **back;
-      int pos = _al_vector_find(&other_display->bitmaps, &bitmap);
-      ASSERT(pos >= 0);
-      back = _al_vector_ref(&other_display->bitmaps, pos);
-      *back = other;
+      if (other_listed) {
+         ALLEGRO_BITMAP **back;
+         int pos = _al_vector_find(&other_display->bitmaps, &bitmap);
+         ASSERT(pos >= 0);
+         back = _al_vector_ref(&other_display->bitmaps, pos);
+         *back = other;
+      }
    }
 
    if (other->shader)
@@ -181,7 +191,7 @@ void al_convert_bitmap(ALLEGRO_BITMAP *bitmap)
       return;
    }
 
-   swap_bitmaps(bitmap, clone);
+   _al_swap_bitmaps(bitmap, clone);
 
    /* Preserve bitmap state. */
    bitmap->cl = clone->cl;
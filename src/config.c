@@ -18,20 +18,15 @@
 
 
 #include <stdio.h>
+#include <string.h>
 #include <ctype.h>
 #include "allegro5/allegro.h"
 #include "allegro5/internal/aintern.h"
-#include "allegro5/internal/aintern_aatree.h"
 #include "allegro5/internal/aintern_config.h"
+#include "allegro5/internal/aintern_hash.h"
 
 
 
-static int cmp_ustr(void const *a, void const *b)
-{
-   return al_ustr_compare(a, b);
-}
-
-
 /* Function: al_create_config
  */
 ALLEGRO_CONFIG *al_create_config(void)
@@ -39,40 +34,23 @@ ALLEGRO_CONFIG *al_create_config(void)
    ALLEGRO_CONFIG *config = al_calloc(1, sizeof(ALLEGRO_CONFIG));
    ASSERT(config);
 
+   _al_hash_init(&config->sections);
+
    return config;
 }
 
 
 static ALLEGRO_CONFIG_SECTION *find_section(const ALLEGRO_CONFIG *config,
-   const ALLEGRO_USTR *section)
+   const ALLEGRO_USTR *section, unsigned int hash)
 {
-   return _al_aa_search(config->tree, section, cmp_ustr);
+   return _al_hash_find(&config->sections, hash, section);
 }
 
 
 static ALLEGRO_CONFIG_ENTRY *find_entry(const ALLEGRO_CONFIG_SECTION *section,
-   const ALLEGRO_USTR *key)
+   const ALLEGRO_USTR *key, unsigned int hash)
 {
-   return _al_aa_search(section->tree, key, cmp_ustr);
-}
-
-
-static void get_key_and_value(const ALLEGRO_USTR *buf,
-   ALLEGRO_USTR *key, ALLEGRO_USTR *value)
-{
-   int eq = al_ustr_find_chr(buf, 0, '=');
-
-   if (eq == -1) {
-      al_ustr_assign(key, buf);
-      al_ustr_assign_cstr(value, "");
-   }
-   else {
-      al_ustr_assign_substr(key, buf, 0, eq);
-      al_ustr_assign_substr(value, buf, eq + 1, al_ustr_size(buf));
-   }
-
-   al_ustr_trim_ws(key);
-   al_ustr_trim_ws(value);
+   return _al_hash_find(&section->entries, hash, key);
 }
 
 
@@ -81,12 +59,14 @@ static ALLEGRO_CONFIG_SECTION *config_add_section(ALLEGRO_CONFIG *config,
 {
    ALLEGRO_CONFIG_SECTION *sec = config->head;
    ALLEGRO_CONFIG_SECTION *section;
+   unsigned int hash = _al_hash_ustr(name);
 
-   if ((section = find_section(config, name)))
+   if ((section = find_section(config, name, hash)))
       return section;
 
    section = al_calloc(1, sizeof(ALLEGRO_CONFIG_SECTION));
    section->name = al_ustr_dup(name);
+   _al_hash_init(&section->entries);
 
    if (sec == NULL) {
       config->head = section;
@@ -99,7 +79,7 @@ static ALLEGRO_CONFIG_SECTION *config_add_section(ALLEGRO_CONFIG *config,
       config->last = section;
    }
 
-   config->tree = _al_aa_insert(config->tree, section->name, section, cmp_ustr);
+   _al_hash_insert(&config->sections, hash, section->name, section);
 
    return section;
 }
@@ -117,21 +97,33 @@ void al_add_config_section(ALLEGRO_CONFIG *config, const char *name)
 }
 
 
-static void config_set_value(ALLEGRO_CONFIG *config,
-   const ALLEGRO_USTR *section, const ALLEGRO_USTR *key,
-   const ALLEGRO_USTR *value)
+static void section_append_entry(ALLEGRO_CONFIG_SECTION *s,
+   ALLEGRO_CONFIG_ENTRY *entry)
+{
+   if (s->head == NULL) {
+      s->head = entry;
+      s->last = entry;
+   }
+   else {
+      ASSERT(s->last->next == NULL);
+      s->last->next = entry;
+      entry->prev = s->last;
+      s->last = entry;
+   }
+}
+
+
+static void section_set_value(ALLEGRO_CONFIG_SECTION *s,
+   const ALLEGRO_USTR *key, const ALLEGRO_USTR *value)
 {
-   ALLEGRO_CONFIG_SECTION *s;
    ALLEGRO_CONFIG_ENTRY *entry;
+   unsigned int hash = _al_hash_ustr(key);
 
-   s = find_section(config, section);
-   if (s) {
-      entry = find_entry(s, key);
-      if (entry) {
-         al_ustr_assign(entry->value, value);
-         al_ustr_trim_ws(entry->value);
-         return;
-      }
+   entry = find_entry(s, key, hash);
+   if (entry) {
+      al_ustr_assign(entry->value, value);
+      al_ustr_trim_ws(entry->value);
+      return;
    }
 
    entry = al_calloc(1, sizeof(ALLEGRO_CONFIG_ENTRY));
@@ -140,22 +132,16 @@ static void config_set_value(ALLEGRO_CONFIG *config,
    entry->value = al_ustr_dup(value);
    al_ustr_trim_ws(entry->value);
 
-   if (!s) {
-      s = config_add_section(config, section);
-   }
+   section_append_entry(s, entry);
+   _al_hash_insert(&s->entries, hash, entry->key, entry);
+}
 
-   if (s->head == NULL) {
-      s->head = entry;
-      s->last = entry;
-   }
-   else {
-      ASSERT(s->last->next == NULL);
-      s->last->next = entry;
-      entry->prev = s->last;
-      s->last = entry;
-   }
 
-   s->tree = _al_aa_insert(s->tree, entry->key, entry, cmp_ustr);
+static void config_set_value(ALLEGRO_CONFIG *config,
+   const ALLEGRO_USTR *section, const ALLEGRO_USTR *key,
+   const ALLEGRO_USTR *value)
+{
+   section_set_value(config_add_section(config, section), key, value);
 }
 
 
@@ -186,14 +172,11 @@ void al_set_config_value(ALLEGRO_CONFIG *config,
 }
 
 
-static void config_add_comment(ALLEGRO_CONFIG *config,
-   const ALLEGRO_USTR *section, const ALLEGRO_USTR *comment)
+static void section_add_comment(ALLEGRO_CONFIG_SECTION *s,
+   const ALLEGRO_USTR *comment)
 {
-   ALLEGRO_CONFIG_SECTION *s;
    ALLEGRO_CONFIG_ENTRY *entry;
 
-   s = find_section(config, section);
-
    entry = al_calloc(1, sizeof(ALLEGRO_CONFIG_ENTRY));
    entry->is_comment = true;
    entry->key = al_ustr_dup(comment);
@@ -203,20 +186,14 @@ static void config_add_comment(ALLEGRO_CONFIG *config,
     */
    al_ustr_find_replace_cstr(entry->key, 0, "\n", " ");
 
-   if (!s) {
-      s = config_add_section(config, section);
-   }
+   section_append_entry(s, entry);
+}
 
-   if (s->head == NULL) {
-      s->head = entry;
-      s->last = entry;
-   }
-   else {
-      ASSERT(s->last->next == NULL);
-      s->last->next = entry;
-      entry->prev = s->last;
-      s->last = entry;
-   }
+
+static void config_add_comment(ALLEGRO_CONFIG *config,
+   const ALLEGRO_USTR *section, const ALLEGRO_USTR *comment)
+{
+   section_add_comment(config_add_section(config, section), comment);
 }
 
 
@@ -244,17 +221,18 @@ void al_add_config_comment(ALLEGRO_CONFIG *config,
 
 
 static bool config_get_value(const ALLEGRO_CONFIG *config,
-   const ALLEGRO_USTR *section, const ALLEGRO_USTR *key,
+   const ALLEGRO_USTR *section, unsigned int section_hash,
+   const ALLEGRO_USTR *key, unsigned int key_hash,
    const ALLEGRO_USTR **ret_value)
 {
    ALLEGRO_CONFIG_SECTION *s;
    ALLEGRO_CONFIG_ENTRY *e;
 
-   s = find_section(config, section);
+   s = find_section(config, section, section_hash);
    if (!s)
       return false;
 
-   e = find_entry(s, key);
+   e = find_entry(s, key, key_hash);
    if (!e)
       return false;
 
@@ -281,28 +259,125 @@ const char *al_get_config_value(const ALLEGRO_CONFIG *config,
    usection = al_ref_cstr(&section_info, section);
    ukey = al_ref_cstr(&key_info, key);
 
-   if (config_get_value(config, usection, ukey, &value))
+   if (config_get_value(config, usection, _al_hash_ustr(usection),
+         ukey, _al_hash_ustr(ukey), &value))
       return al_cstr(value);
    else
       return NULL;
 }
 
 
-static bool readline(ALLEGRO_FILE *file, ALLEGRO_USTR *line)
+/* Function: al_create_config_key
+ */
+ALLEGRO_CONFIG_KEY *al_create_config_key(const char *section, const char *key)
 {
-   char buf[128];
+   ALLEGRO_CONFIG_KEY *ckey;
 
-   if (!al_fgets(file, buf, sizeof(buf))) {
-      return false;
+   if (section == NULL) {
+      section = "";
    }
 
-   do {
-      al_ustr_append_cstr(line, buf);
-      if (al_ustr_has_suffix_cstr(line, "\n"))
+   ASSERT(key);
+
+   ckey = al_malloc(sizeof(ALLEGRO_CONFIG_KEY));
+   if (!ckey)
+      return NULL;
+
+   ckey->section = al_ustr_new(section);
+   ckey->key = al_ustr_new(key);
+   ckey->section_hash = _al_hash_ustr(ckey->section);
+   ckey->key_hash = _al_hash_ustr(ckey->key);
+
+   return ckey;
+}
+
+
+/* Function: al_destroy_config_key
+ */
+void al_destroy_config_key(ALLEGRO_CONFIG_KEY *key)
+{
+   if (!key)
+      return;
+
+   al_ustr_free(key->section);
+   al_ustr_free(key->key);
+   al_free(key);
+}
+
+
+/* Function: al_get_config_value_by_key
+ */
+const char *al_get_config_value_by_key(const ALLEGRO_CONFIG *config,
+   const ALLEGRO_CONFIG_KEY *key)
+{
+   const ALLEGRO_USTR *value;
+   ASSERT(key);
+
+   if (config_get_value(config, key->section, key->section_hash,
+         key->key, key->key_hash, &value))
+      return al_cstr(value);
+   else
+      return NULL;
+}
+
+
+/* read_whole_file:
+ *  Read the rest of the file into a single buffer, so that the parser does
+ *  not need to go through the file interface (or allocate) for every line.
+ */
+static char *read_whole_file(ALLEGRO_FILE *file, size_t *ret_size)
+{
+   int64_t fsize = al_fsize(file);
+   int64_t fpos = al_ftell(file);
+   size_t capacity;
+   size_t size = 0;
+   char *buf;
+
+   if (fsize > 0 && fpos >= 0 && fsize > fpos)
+      capacity = (size_t)(fsize - fpos) + 1;
+   else
+      capacity = 4096;
+
+   buf = al_malloc(capacity);
+   if (!buf)
+      return NULL;
+
+   for (;;) {
+      size_t n = al_fread(file, buf + size, capacity - size);
+      size += n;
+      if (size < capacity)
          break;
-   } while (al_fgets(file, buf, sizeof(buf)));
 
-   return true;
+      /* The size was unknown or wrong; keep going. */
+      {
+         char *new_buf = al_realloc(buf, capacity * 2);
+         if (!new_buf) {
+            al_free(buf);
+            return NULL;
+         }
+         buf = new_buf;
+         capacity *= 2;
+      }
+   }
+
+   *ret_size = size;
+   return buf;
+}
+
+
+static const char *skip_ws(const char *s, const char *end)
+{
+   while (s < end && isspace((unsigned char)*s))
+      s++;
+   return s;
+}
+
+
+static const char *rskip_ws(const char *start, const char *s)
+{
+   while (s > start && isspace((unsigned char)s[-1]))
+      s--;
+   return s;
 }
 
 
@@ -328,58 +403,96 @@ ALLEGRO_CONFIG *al_load_config_file(const char *filename)
 ALLEGRO_CONFIG *al_load_config_file_f(ALLEGRO_FILE *file)
 {
    ALLEGRO_CONFIG *config;
-   ALLEGRO_CONFIG_SECTION *current_section = NULL;
-   ALLEGRO_USTR *line;
-   ALLEGRO_USTR *section;
-   ALLEGRO_USTR *key;
-   ALLEGRO_USTR *value;
+   ALLEGRO_CONFIG_SECTION *current_section;
+   char *buf;
+   size_t size;
+   const char *p;
+   const char *end;
    ASSERT(file);
 
+   buf = read_whole_file(file, &size);
+   if (!buf) {
+      return NULL;
+   }
+
    config = al_create_config();
    if (!config) {
+      al_free(buf);
       return NULL;
    }
 
-   line = al_ustr_new("");
-   section = al_ustr_new("");
-   key = al_ustr_new("");
-   value = al_ustr_new("");
+   current_section = NULL;
 
-   while (1) {
-      al_ustr_assign_cstr(line, "");
-      if (!readline(file, line))
-         break;
-      al_ustr_trim_ws(line);
+   /* Lines are parsed in place; only the strings which end up in the
+    * config are copied.
+    */
+   p = buf;
+   end = buf + size;
+   while (p < end) {
+      const char *eol = memchr(p, '\n', end - p);
+      const char *next;
+      const char *s;
+      const char *e;
+      ALLEGRO_USTR_INFO line_info;
+
+      if (!eol)
+         eol = end;
+      next = (eol < end) ? eol + 1 : end;
+
+      s = skip_ws(p, eol);
+      e = rskip_ws(s, eol);
+
+      if (!current_section && (s == e || *s != '[')) {
+         /* Lines before the first section header belong to the global
+          * section, which is only created if there are any.
+          */
+         current_section = config_add_section(config, al_ustr_empty_string());
+      }
 
-      if (al_ustr_has_prefix_cstr(line, "#") || al_ustr_size(line) == 0) {
+      if (s == e || *s == '#') {
          /* Preserve comments and blank lines */
-         const ALLEGRO_USTR *name;
-         if (current_section)
-            name = current_section->name;
-         else
-            name = al_ustr_empty_string();
-         config_add_comment(config, name, line);
+         section_add_comment(current_section,
+            al_ref_buffer(&line_info, s, e - s));
       }
-      else if (al_ustr_has_prefix_cstr(line, "[")) {
-         int rbracket = al_ustr_rfind_chr(line, al_ustr_size(line), ']');
-         if (rbracket == -1)
-            rbracket = al_ustr_size(line);
-         al_ustr_assign_substr(section, line, 1, rbracket);
-         current_section = config_add_section(config, section);
+      else if (*s == '[') {
+         const char *rbracket = e;
+         ALLEGRO_USTR_INFO section_info;
+
+         while (rbracket > s && *(rbracket - 1) != ']')
+            rbracket--;
+         if (rbracket == s)
+            rbracket = e;
+         else
+            rbracket--;
+
+         current_section = config_add_section(config,
+            al_ref_buffer(&section_info, s + 1, rbracket - (s + 1)));
       }
       else {
-         get_key_and_value(line, key, value);
-         if (current_section == NULL)
-            config_set_value(config, al_ustr_empty_string(), key, value);
-         else
-            config_set_value(config, current_section->name, key, value);
+         const char *eq = memchr(s, '=', e - s);
+         const char *kend;
+         const char *vstart;
+         ALLEGRO_USTR_INFO key_info;
+         ALLEGRO_USTR_INFO value_info;
+
+         if (eq) {
+            kend = rskip_ws(s, eq);
+            vstart = skip_ws(eq + 1, e);
+         }
+         else {
+            kend = e;
+            vstart = e;
+         }
+
+         section_set_value(current_section,
+            al_ref_buffer(&key_info, s, kend - s),
+            al_ref_buffer(&value_info, vstart, e - vstart));
       }
+
+      p = next;
    }
 
-   al_ustr_free(line);
-   al_ustr_free(section);
-   al_ustr_free(key);
-   al_ustr_free(value);
+   al_free(buf);
 
    return config;
 }
@@ -556,7 +669,7 @@ static void destroy_section(ALLEGRO_CONFIG_SECTION *s)
       e = tmp;
    }
    al_ustr_free(s->name);
-   _al_aa_free(s->tree);
+   _al_hash_free(&s->entries);
    al_free(s);
 }
 
@@ -578,7 +691,7 @@ void al_destroy_config(ALLEGRO_CONFIG *config)
       s = tmp;
    }
 
-   _al_aa_free(config->tree);
+   _al_hash_free(&config->sections);
    al_free(config);
 }
 
@@ -631,7 +744,7 @@ char const *al_get_first_config_entry(ALLEGRO_CONFIG const *config,
       section = "";
 
    usection = al_ref_cstr(&section_info, section);
-   s = find_section(config, usection);
+   s = find_section(config, usection, _al_hash_ustr(usection));
    if (!s)
       return NULL;
    e = s->head;
@@ -669,8 +782,8 @@ bool al_remove_config_section(ALLEGRO_CONFIG *config, char const *section)
    void *value;
    ALLEGRO_CONFIG_SECTION *s;
    
-   value = NULL;
-   config->tree = _al_aa_delete(config->tree, usection, cmp_ustr, &value);
+   value = _al_hash_remove(&config->sections, _al_hash_ustr(usection),
+      usection);
    if (!value)
       return false;
    
@@ -709,12 +822,12 @@ bool al_remove_config_key(ALLEGRO_CONFIG *config, char const *section,
    void *value;
    ALLEGRO_CONFIG_ENTRY * e;
 
-   ALLEGRO_CONFIG_SECTION *s = find_section(config, usection);
+   ALLEGRO_CONFIG_SECTION *s = find_section(config, usection,
+      _al_hash_ustr(usection));
    if (!s)
       return false;
 
-   value = NULL;
-   s->tree = _al_aa_delete(s->tree, ukey, cmp_ustr, &value);
+   value = _al_hash_remove(&s->entries, _al_hash_ustr(ukey), ukey);
    if (!value)
       return false;
    
@@ -15,6 +15,7 @@
 
 
 #include "allegro5/allegro.h"
+#include "allegro5/internal/aintern.h"
 #include "allegro5/internal/aintern_bitmap.h"
 #include "allegro5/internal/aintern_display.h"
 #include "allegro5/internal/aintern_memdraw.h"
@@ -41,6 +42,44 @@ void al_clear_to_color(ALLEGRO_COLOR color)
 }
 
 
+/* Function: al_clear_rectangles
+ */
+void al_clear_rectangles(const int *rects, int num_rects, ALLEGRO_COLOR color)
+{
+   ALLEGRO_BITMAP *target = al_get_target_bitmap();
+   ALLEGRO_DISPLAY *display;
+   int cx, cy, cw, ch;
+   int i;
+   ASSERT(target);
+   ASSERT(rects || num_rects == 0);
+
+   if (al_get_bitmap_flags(target) & ALLEGRO_MEMORY_BITMAP ||
+       _al_pixel_format_is_compressed(al_get_bitmap_format(target))) {
+      _al_clear_rectangles_by_locking(target, &color, rects, num_rects);
+      return;
+   }
+
+   /* Let the driver clear each rectangle through the clipping rectangle. */
+   display = _al_get_bitmap_display(target);
+   ASSERT(display);
+   ASSERT(display->vt);
+   al_get_clipping_rectangle(&cx, &cy, &cw, &ch);
+   for (i = 0; i < num_rects; i++) {
+      const int *r = rects + i * 4;
+      int x1 = _ALLEGRO_MAX(r[0], cx);
+      int y1 = _ALLEGRO_MAX(r[1], cy);
+      int x2 = _ALLEGRO_MIN(r[0] + r[2], cx + cw);
+      int y2 = _ALLEGRO_MIN(r[1] + r[3], cy + ch);
+
+      if (x2 > x1 && y2 > y1) {
+         al_set_clipping_rectangle(x1, y1, x2 - x1, y2 - y1);
+         display->vt->clear(display, &color);
+      }
+   }
+   al_set_clipping_rectangle(cx, cy, cw, ch);
+}
+
+
 /* Function: al_clear_depth_buffer
  */
 void al_clear_depth_buffer(float z)
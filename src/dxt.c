@@ -0,0 +1,617 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Software DXT1/DXT3/DXT5 block codec.
+ *
+ *      See LICENSE.txt for copyright information.
+ */
+
+
+#include <string.h>
+#include "allegro5/allegro.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_bitmap.h"
+#include "allegro5/internal/aintern_pixels.h"
+
+ALLEGRO_DEBUG_CHANNEL("bitmap")
+
+
+/* Blocks are decoded to and encoded from ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE,
+ * i.e. R, G, B, A bytes, 4 pixels wide and 4 rows high.
+ */
+#define BLOCK_PIXEL_FORMAT    ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE
+
+
+static void unpack_565(unsigned c, unsigned char *rgb)
+{
+   int r = (c >> 11) & 0x1F;
+   int g = (c >> 5) & 0x3F;
+   int b = c & 0x1F;
+
+   rgb[0] = (r << 3) | (r >> 2);
+   rgb[1] = (g << 2) | (g >> 4);
+   rgb[2] = (b << 3) | (b >> 2);
+}
+
+
+static int clamp_255(float x)
+{
+   if (x < 0.0f)
+      return 0;
+   if (x > 255.0f)
+      return 255;
+   return (int)(x + 0.5f);
+}
+
+
+static unsigned pack_565(const float *rgb)
+{
+   return ((clamp_255(rgb[0]) * 31 + 127) / 255) << 11
+      | ((clamp_255(rgb[1]) * 63 + 127) / 255) << 5
+      | ((clamp_255(rgb[2]) * 31 + 127) / 255);
+}
+
+
+/* Build the palette of a color block.  With four == false entry 2 is the
+ * midpoint and entry 3 is transparent black (DXT1 only).
+ */
+static void make_color_palette(unsigned c0, unsigned c1, bool four,
+   unsigned char pal[4][4])
+{
+   int i;
+
+   unpack_565(c0, pal[0]);
+   unpack_565(c1, pal[1]);
+   for (i = 0; i < 3; i++) {
+      if (four) {
+         pal[2][i] = (2 * pal[0][i] + pal[1][i]) / 3;
+         pal[3][i] = (pal[0][i] + 2 * pal[1][i]) / 3;
+      }
+      else {
+         pal[2][i] = (pal[0][i] + pal[1][i]) / 2;
+         pal[3][i] = 0;
+      }
+   }
+   pal[0][3] = pal[1][3] = pal[2][3] = 255;
+   pal[3][3] = four ? 255 : 0;
+}
+
+
+/* Build the palette of a DXT5 alpha block. */
+static void make_alpha_palette(int a0, int a1, int pal[8])
+{
+   int i;
+
+   pal[0] = a0;
+   pal[1] = a1;
+   if (a0 > a1) {
+      for (i = 1; i < 7; i++)
+         pal[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+   }
+   else {
+      for (i = 1; i < 5; i++)
+         pal[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+      pal[6] = 0;
+      pal[7] = 255;
+   }
+}
+
+
+static void decode_color_block(const unsigned char *src, bool dxt1,
+   unsigned char *dst, int dst_pitch)
+{
+   unsigned char pal[4][4];
+   unsigned c0 = src[0] | (src[1] << 8);
+   unsigned c1 = src[2] | (src[3] << 8);
+   uint32_t bits = src[4] | (src[5] << 8) | (src[6] << 16)
+      | ((uint32_t)src[7] << 24);
+   int x, y;
+
+   /* DXT3 and DXT5 always use the four color mode. */
+   make_color_palette(c0, c1, !dxt1 || c0 > c1, pal);
+
+   for (y = 0; y < 4; y++) {
+      unsigned char *row = dst + y * dst_pitch;
+      for (x = 0; x < 4; x++) {
+         memcpy(row + x * 4, pal[bits & 3], 4);
+         bits >>= 2;
+      }
+   }
+}
+
+
+static void decode_block(int format, const unsigned char *src,
+   unsigned char *dst, int dst_pitch)
+{
+   int x, y;
+
+   switch (format) {
+      case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT1:
+         decode_color_block(src, true, dst, dst_pitch);
+         break;
+
+      case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT3:
+         decode_color_block(src + 8, false, dst, dst_pitch);
+         for (y = 0; y < 4; y++) {
+            unsigned char *row = dst + y * dst_pitch;
+            int bits = src[y * 2] | (src[y * 2 + 1] << 8);
+            for (x = 0; x < 4; x++) {
+               row[x * 4 + 3] = (bits & 0xF) * 17;
+               bits >>= 4;
+            }
+         }
+         break;
+
+      case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT5: {
+         int pal[8];
+         uint64_t bits = 0;
+         int i;
+
+         decode_color_block(src + 8, false, dst, dst_pitch);
+         make_alpha_palette(src[0], src[1], pal);
+         for (i = 7; i >= 2; i--)
+            bits = (bits << 8) | src[i];
+         for (y = 0; y < 4; y++) {
+            unsigned char *row = dst + y * dst_pitch;
+            for (x = 0; x < 4; x++) {
+               row[x * 4 + 3] = pal[bits & 7];
+               bits >>= 3;
+            }
+         }
+         break;
+      }
+
+      default:
+         ASSERT(false);
+   }
+}
+
+
+/* Pick the nearest palette entry for each used pixel and return the total
+ * squared error.  Pixels not in the mask get index 3.
+ */
+static int fit_color_indices(unsigned char px[16][4], int mask,
+   unsigned char pal[4][4], int num_entries, int indices[16])
+{
+   int total = 0;
+   int i, j;
+
+   for (i = 0; i < 16; i++) {
+      int best = 0;
+      int best_err = 0x7FFFFFFF;
+      if (!(mask & (1 << i))) {
+         indices[i] = 3;
+         continue;
+      }
+      for (j = 0; j < num_entries; j++) {
+         int dr = px[i][0] - pal[j][0];
+         int dg = px[i][1] - pal[j][1];
+         int db = px[i][2] - pal[j][2];
+         int err = dr * dr + dg * dg + db * db;
+         if (err < best_err) {
+            best_err = err;
+            best = j;
+         }
+      }
+      indices[i] = best;
+      total += best_err;
+   }
+
+   return total;
+}
+
+
+/* Find the endpoints along the principal axis of the used pixels. */
+static void find_color_endpoints(unsigned char px[16][4], int mask,
+   float e0[3], float e1[3])
+{
+   float mean[3] = {0, 0, 0};
+   float cov[6] = {0, 0, 0, 0, 0, 0};
+   float axis[3];
+   float min_t = 1e9f, max_t = -1e9f;
+   int min_i = 0, max_i = 0;
+   int n = 0;
+   int i, k;
+
+   for (i = 0; i < 16; i++) {
+      if (!(mask & (1 << i)))
+         continue;
+      for (k = 0; k < 3; k++)
+         mean[k] += px[i][k];
+      n++;
+   }
+   for (k = 0; k < 3; k++)
+      mean[k] /= n;
+
+   for (i = 0; i < 16; i++) {
+      float r, g, b;
+      if (!(mask & (1 << i)))
+         continue;
+      r = px[i][0] - mean[0];
+      g = px[i][1] - mean[1];
+      b = px[i][2] - mean[2];
+      cov[0] += r * r;
+      cov[1] += r * g;
+      cov[2] += r * b;
+      cov[3] += g * g;
+      cov[4] += g * b;
+      cov[5] += b * b;
+   }
+
+   /* A few rounds of power iteration are plenty for a 3x3 matrix. */
+   axis[0] = axis[1] = axis[2] = 1.0f;
+   for (k = 0; k < 8; k++) {
+      float x = axis[0] * cov[0] + axis[1] * cov[1] + axis[2] * cov[2];
+      float y = axis[0] * cov[1] + axis[1] * cov[3] + axis[2] * cov[4];
+      float z = axis[0] * cov[2] + axis[1] * cov[4] + axis[2] * cov[5];
+      float m = x;
+      if (y * y > m * m)
+         m = y;
+      if (z * z > m * m)
+         m = z;
+      if (m == 0.0f)
+         break;
+      axis[0] = x / m;
+      axis[1] = y / m;
+      axis[2] = z / m;
+   }
+
+   for (i = 0; i < 16; i++) {
+      float t;
+      if (!(mask & (1 << i)))
+         continue;
+      t = px[i][0] * axis[0] + px[i][1] * axis[1] + px[i][2] * axis[2];
+      if (t < min_t) {
+         min_t = t;
+         min_i = i;
+      }
+      if (t > max_t) {
+         max_t = t;
+         max_i = i;
+      }
+   }
+
+   for (k = 0; k < 3; k++) {
+      e0[k] = px[max_i][k];
+      e1[k] = px[min_i][k];
+   }
+}
+
+
+/* Least squares endpoints for the given indices.  Returns false if the
+ * system is singular, e.g. when every pixel uses the same index.
+ */
+static bool refine_color_endpoints(unsigned char px[16][4], int mask,
+   const int indices[16], bool four, float e0[3], float e1[3])
+{
+   static const float weights4[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+   static const float weights3[4] = {1.0f, 0.0f, 0.5f, 0.0f};
+   const float *weights = four ? weights4 : weights3;
+   float aa = 0, bb = 0, ab = 0;
+   float ax[3] = {0, 0, 0};
+   float bx[3] = {0, 0, 0};
+   float det;
+   int i, k;
+
+   for (i = 0; i < 16; i++) {
+      float a, b;
+      if (!(mask & (1 << i)))
+         continue;
+      a = weights[indices[i]];
+      b = 1.0f - a;
+      aa += a * a;
+      bb += b * b;
+      ab += a * b;
+      for (k = 0; k < 3; k++) {
+         ax[k] += a * px[i][k];
+         bx[k] += b * px[i][k];
+      }
+   }
+
+   det = aa * bb - ab * ab;
+   if (det < 1e-6f && det > -1e-6f)
+      return false;
+
+   for (k = 0; k < 3; k++) {
+      e0[k] = (ax[k] * bb - bx[k] * ab) / det;
+      e1[k] = (bx[k] * aa - ax[k] * ab) / det;
+   }
+   return true;
+}
+
+
+/* Order the endpoints for the wanted mode and fit the indices. */
+static int fit_color_block(unsigned char px[16][4], int mask, bool four,
+   unsigned c0, unsigned c1, unsigned *out_c0, unsigned *out_c1,
+   int indices[16])
+{
+   unsigned char pal[4][4];
+
+   if ((four && c0 < c1) || (!four && c0 > c1)) {
+      unsigned t = c0;
+      c0 = c1;
+      c1 = t;
+   }
+   *out_c0 = c0;
+   *out_c1 = c1;
+
+   if (c0 == c1) {
+      /* Either mode would do; only entry 0 is reliable. */
+      unpack_565(c0, pal[0]);
+      return fit_color_indices(px, mask, pal, 1, indices);
+   }
+
+   make_color_palette(c0, c1, four, pal);
+   return fit_color_indices(px, mask, pal, four ? 4 : 3, indices);
+}
+
+
+static void encode_color_block(unsigned char px[16][4], bool dxt1,
+   unsigned char *dst)
+{
+   int indices[16], try_indices[16];
+   float e0[3], e1[3];
+   unsigned c0, c1, t0, t1;
+   uint32_t bits = 0;
+   int mask = 0xFFFF;
+   bool four = true;
+   int err, try_err;
+   int i;
+
+   if (dxt1) {
+      for (i = 0; i < 16; i++) {
+         if (px[i][3] < 128)
+            mask &= ~(1 << i);
+      }
+      four = (mask == 0xFFFF);
+   }
+
+   if (mask == 0) {
+      /* Fully transparent: c0 <= c1 selects the mode with index 3. */
+      memset(dst, 0, 4);
+      memset(dst + 4, 0xFF, 4);
+      return;
+   }
+
+   find_color_endpoints(px, mask, e0, e1);
+   err = fit_color_block(px, mask, four, pack_565(e0), pack_565(e1),
+      &c0, &c1, indices);
+
+   if (err > 0 && c0 != c1 &&
+         refine_color_endpoints(px, mask, indices, four, e0, e1)) {
+      try_err = fit_color_block(px, mask, four, pack_565(e0), pack_565(e1),
+         &t0, &t1, try_indices);
+      if (try_err < err) {
+         c0 = t0;
+         c1 = t1;
+         memcpy(indices, try_indices, sizeof(indices));
+      }
+   }
+
+   for (i = 15; i >= 0; i--)
+      bits = (bits << 2) | indices[i];
+
+   dst[0] = c0 & 0xFF;
+   dst[1] = c0 >> 8;
+   dst[2] = c1 & 0xFF;
+   dst[3] = c1 >> 8;
+   dst[4] = bits & 0xFF;
+   dst[5] = (bits >> 8) & 0xFF;
+   dst[6] = (bits >> 16) & 0xFF;
+   dst[7] = bits >> 24;
+}
+
+
+static int fit_alpha_indices(unsigned char px[16][4], int a0, int a1,
+   int indices[16])
+{
+   int pal[8];
+   int total = 0;
+   int i, j;
+
+   make_alpha_palette(a0, a1, pal);
+   for (i = 0; i < 16; i++) {
+      int best = 0;
+      int best_err = 0x7FFFFFFF;
+      for (j = 0; j < 8; j++) {
+         int d = px[i][3] - pal[j];
+         if (d * d < best_err) {
+            best_err = d * d;
+            best = j;
+         }
+      }
+      indices[i] = best;
+      total += best_err;
+   }
+   return total;
+}
+
+
+/* Try both the eight value mode spanning the whole range and the six value
+ * mode spanning everything but 0 and 255, and keep the better one.
+ */
+static void encode_dxt5_alpha(unsigned char px[16][4], unsigned char *dst)
+{
+   int indices[16], try_indices[16];
+   int min_a = 255, max_a = 0;
+   int min_mid = 255, max_mid = 0;
+   int a0, a1, err;
+   uint64_t bits = 0;
+   int i;
+
+   for (i = 0; i < 16; i++) {
+      int a = px[i][3];
+      if (a < min_a)
+         min_a = a;
+      if (a > max_a)
+         max_a = a;
+      if (a != 0 && a != 255) {
+         if (a < min_mid)
+            min_mid = a;
+         if (a > max_mid)
+            max_mid = a;
+      }
+   }
+   if (min_mid > max_mid)
+      min_mid = max_mid = 0;
+
+   a0 = max_a;
+   a1 = min_a;
+   err = fit_alpha_indices(px, a0, a1, indices);
+   if (err > 0 && fit_alpha_indices(px, min_mid, max_mid, try_indices) < err) {
+      a0 = min_mid;
+      a1 = max_mid;
+      memcpy(indices, try_indices, sizeof(indices));
+   }
+
+   for (i = 15; i >= 0; i--)
+      bits = (bits << 3) | indices[i];
+
+   dst[0] = a0;
+   dst[1] = a1;
+   for (i = 2; i < 8; i++) {
+      dst[i] = bits & 0xFF;
+      bits >>= 8;
+   }
+}
+
+
+static void encode_block(int format, const unsigned char *src, int src_pitch,
+   unsigned char *dst)
+{
+   unsigned char px[16][4];
+   int x, y;
+
+   for (y = 0; y < 4; y++)
+      memcpy(px[y * 4], src + y * src_pitch, 16);
+
+   switch (format) {
+      case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT1:
+         encode_color_block(px, true, dst);
+         break;
+
+      case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT3:
+         for (y = 0; y < 4; y++) {
+            int bits = 0;
+            for (x = 3; x >= 0; x--)
+               bits = (bits << 4) | ((px[y * 4 + x][3] * 15 + 127) / 255);
+            dst[y * 2] = bits & 0xFF;
+            dst[y * 2 + 1] = bits >> 8;
+         }
+         encode_color_block(px, false, dst + 8);
+         break;
+
+      case ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT5:
+         encode_dxt5_alpha(px, dst);
+         encode_color_block(px, false, dst + 8);
+         break;
+
+      default:
+         ASSERT(false);
+   }
+}
+
+
+/* Fill the part of a row of blocks past width x rows by repeating the last
+ * column and row, so edge blocks don't waste palette entries on padding.
+ */
+static void pad_block_row(unsigned char *buf, int pitch, int width, int rows,
+   int padded_width)
+{
+   int x, y;
+
+   for (y = 0; y < rows; y++) {
+      unsigned char *row = buf + y * pitch;
+      for (x = width; x < padded_width; x++)
+         memcpy(row + x * 4, row + (width - 1) * 4, 4);
+   }
+   for (y = rows; y < 4; y++)
+      memcpy(buf + y * pitch, buf + (rows - 1) * pitch, padded_width * 4);
+}
+
+
+/* Convert between a compressed and any other format, one row of blocks at a
+ * time.  The coordinates on the compressed side must be block aligned; the
+ * width and height need not be.
+ */
+void _al_convert_compressed_bitmap_data(
+   const void *src, int src_format, int src_pitch,
+   void *dst, int dst_format, int dst_pitch,
+   int sx, int sy, int dx, int dy, int width, int height)
+{
+   bool src_compressed = _al_pixel_format_is_compressed(src_format);
+   bool dst_compressed = _al_pixel_format_is_compressed(dst_format);
+   int blocks_w = (width + 3) / 4;
+   int tmp_pitch = blocks_w * 16;
+   unsigned char *tmp;
+   int src_block_size = 0;
+   int dst_block_size = 0;
+   int x, y;
+
+   ASSERT(src_compressed || dst_compressed);
+   ASSERT(!src_compressed || (sx % 4 == 0 && sy % 4 == 0));
+   ASSERT(!dst_compressed || (dx % 4 == 0 && dy % 4 == 0));
+
+   if (width <= 0 || height <= 0)
+      return;
+
+   tmp = al_malloc(tmp_pitch * 4);
+   if (!tmp) {
+      ALLEGRO_ERROR("Out of memory converting compressed bitmap data.\n");
+      return;
+   }
+
+   if (src_compressed) {
+      src_block_size = al_get_pixel_block_size(src_format);
+      src = (const char *)src + (sy / 4) * src_pitch
+         + (sx / 4) * src_block_size;
+   }
+   if (dst_compressed) {
+      dst_block_size = al_get_pixel_block_size(dst_format);
+      dst = (char *)dst + (dy / 4) * dst_pitch + (dx / 4) * dst_block_size;
+   }
+
+   for (y = 0; y < height; y += 4) {
+      int rows = _ALLEGRO_MIN(4, height - y);
+
+      if (src_compressed) {
+         const unsigned char *block = src;
+         for (x = 0; x < blocks_w; x++) {
+            decode_block(src_format, block, tmp + x * 16, tmp_pitch);
+            block += src_block_size;
+         }
+         src = (const char *)src + src_pitch;
+      }
+      else {
+         _al_convert_bitmap_data(src, src_format, src_pitch,
+            tmp, BLOCK_PIXEL_FORMAT, tmp_pitch,
+            sx, sy + y, 0, 0, width, rows);
+         pad_block_row(tmp, tmp_pitch, width, rows, blocks_w * 4);
+      }
+
+      if (dst_compressed) {
+         unsigned char *block = dst;
+         for (x = 0; x < blocks_w; x++) {
+            encode_block(dst_format, tmp + x * 16, tmp_pitch, block);
+            block += dst_block_size;
+         }
+         dst = (char *)dst + dst_pitch;
+      }
+      else {
+         _al_convert_bitmap_data(tmp, BLOCK_PIXEL_FORMAT, tmp_pitch,
+            dst, dst_format, dst_pitch,
+            0, 0, dx, dy + y, width, rows);
+      }
+   }
+
+   al_free(tmp);
+}
+
+/* vim: set ts=8 sts=3 sw=3 et: */
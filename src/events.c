@@ -29,6 +29,7 @@
 #include "allegro5/internal/aintern_dtor.h"
 #include "allegro5/internal/aintern_exitfunc.h"
 #include "allegro5/internal/aintern_events.h"
+#include "allegro5/internal/aintern_profile.h"
 #include "allegro5/internal/aintern_system.h"
 
 
@@ -566,6 +567,8 @@ static void unref_if_user_event(ALLEGRO_EVENT *event)
 
 
 
+_AL_PROFILE_COUNTER(pushed_events_counter, "events/pushed");
+
 /* Internal function: _al_event_queue_push_event
  *  Event sources call this function when they have something to add to
  *  the queue.  If a queue cannot accept the event, the event's
@@ -596,6 +599,8 @@ void _al_event_queue_push_event(ALLEGRO_EVENT_QUEUE *queue,
       _al_cond_broadcast(&queue->cond);
    }
    _al_mutex_unlock(&queue->mutex);
+
+   _AL_PROFILE_ADD(pushed_events_counter, 1);
 }
 
 
@@ -528,6 +528,34 @@ int64_t al_fsize(ALLEGRO_FILE *f)
 }
 
 
+/* Function: al_fread_span
+ */
+const void *al_fread_span(ALLEGRO_FILE *f, size_t size, size_t *ret_size)
+{
+   ASSERT(f != NULL);
+   ASSERT(ret_size != NULL);
+
+   *ret_size = 0;
+
+   /* Pushed back bytes aren't part of any buffer we could lend. */
+   if (f->ungetc_len || !f->vtable->fi_fread_span)
+      return NULL;
+
+   return f->vtable->fi_fread_span(f, size, ret_size);
+}
+
+
+/* Function: al_fprefetch
+ */
+void al_fprefetch(ALLEGRO_FILE *f, size_t size)
+{
+   ASSERT(f != NULL);
+
+   if (f->vtable->fi_fprefetch)
+      f->vtable->fi_fprefetch(f, size);
+}
+
+
 /* Function: al_get_file_userdata
  */
 void *al_get_file_userdata(ALLEGRO_FILE *f)
@@ -15,6 +15,7 @@
  */
 
 #include "allegro5/allegro.h"
+#include "allegro5/internal/aintern_file.h"
 
 typedef struct SLICE_DATA SLICE_DATA;
 
@@ -31,8 +32,62 @@ struct SLICE_DATA
    size_t pos;       /* position relative to anchor */
    size_t size;      /* size of slice relative to anchor */
    int mode;
+   /* Prefetched bytes from buffer_pos on, relative to anchor. */
+   unsigned char *buffer;
+   size_t buffer_pos;
+   size_t buffer_len;
+   size_t buffer_cap;
+   bool parent_moved; /* parent isn't at anchor + pos */
 };
 
+/* Puts the parent back where an unbuffered slice would have left it. */
+static bool sync_parent(SLICE_DATA *slice)
+{
+   if (slice->parent_moved) {
+      if (!al_fseek(slice->fp, slice->anchor + slice->pos, ALLEGRO_SEEK_SET))
+         return false;
+      slice->parent_moved = false;
+   }
+   return true;
+}
+
+/* Reads up to size bytes from the current position into the buffer with
+ * a single read from the parent.
+ */
+static bool fill_buffer(SLICE_DATA *slice, size_t size)
+{
+   if (slice->pos + size > slice->size)
+      size = slice->size - slice->pos;
+   if (size == 0) {
+      slice->buffer_len = 0;
+      return true;
+   }
+
+   if (size > slice->buffer_cap) {
+      unsigned char *buffer = al_realloc(slice->buffer, size);
+      if (!buffer)
+         return false;
+      slice->buffer = buffer;
+      slice->buffer_cap = size;
+   }
+
+   if (!sync_parent(slice))
+      return false;
+   slice->buffer_pos = slice->pos;
+   slice->buffer_len = al_fread(slice->fp, slice->buffer, size);
+   slice->parent_moved = slice->buffer_len > 0;
+   return true;
+}
+
+/* Returns how many bytes at the current position are in the buffer. */
+static size_t buffered(SLICE_DATA *slice)
+{
+   if (slice->pos < slice->buffer_pos ||
+         slice->pos >= slice->buffer_pos + slice->buffer_len)
+      return 0;
+   return slice->buffer_pos + slice->buffer_len - slice->pos;
+}
+
 static bool slice_fclose(ALLEGRO_FILE *f)
 {
    SLICE_DATA *slice = al_get_file_userdata(f);
@@ -41,6 +96,7 @@ static bool slice_fclose(ALLEGRO_FILE *f)
    /* seek to end of slice */
    ret = al_fseek(slice->fp, slice->anchor + slice->size, ALLEGRO_SEEK_SET);
 
+   al_free(slice->buffer);
    al_free(slice);
 
    return ret;
@@ -49,6 +105,7 @@ static bool slice_fclose(ALLEGRO_FILE *f)
 static size_t slice_fread(ALLEGRO_FILE *f, void *ptr, size_t size)
 {
    SLICE_DATA *slice = al_get_file_userdata(f);
+   size_t n;
    
    if (!(slice->mode & SLICE_READ)) {
       /* no read permissions */
@@ -59,19 +116,31 @@ static size_t slice_fread(ALLEGRO_FILE *f, void *ptr, size_t size)
       /* don't read past the buffer size if not expandable */
       size = slice->size - slice->pos;
    }
+
+   /* serve what was prefetched first */
+   n = buffered(slice);
+   if (n > size)
+      n = size;
+   if (n > 0) {
+      memcpy(ptr, slice->buffer + (slice->pos - slice->buffer_pos), n);
+      slice->pos += n;
+      slice->parent_moved = true;
+      ptr = (char *)ptr + n;
+      size -= n;
+   }
    
-   if (!size) {
-      return 0;
+   if (!size || !sync_parent(slice)) {
+      return n;
    }
    else {
-      /* unbuffered, read directly from parent file */
+      /* read the rest directly from parent file */
       size_t b = al_fread(slice->fp, ptr, size);
       slice->pos += b;
    
       if (slice->pos > slice->size)
          slice->size = slice->pos;
       
-      return b;
+      return n + b;
    }
 }
 
@@ -88,8 +157,11 @@ static size_t slice_fwrite(ALLEGRO_FILE *f, const void *ptr, size_t size)
       /* don't write past the buffer size if not expandable */
       size = slice->size - slice->pos;
    }
+
+   /* prefetched data would be stale */
+   slice->buffer_len = 0;
    
-   if (!size) {
+   if (!size || !sync_parent(slice)) {
       return 0;
    }
    else {
@@ -107,6 +179,9 @@ static size_t slice_fwrite(ALLEGRO_FILE *f, const void *ptr, size_t size)
 static bool slice_fflush(ALLEGRO_FILE *f)
 {
    SLICE_DATA *slice = al_get_file_userdata(f);
+
+   if (!sync_parent(slice))
+      return false;
    
    return al_fflush(slice->fp);
 }
@@ -144,6 +219,7 @@ static bool slice_fseek(ALLEGRO_FILE *f, int64_t offset, int whence)
    }
    
    if (al_fseek(slice->fp, offset, ALLEGRO_SEEK_SET)) {
+      slice->parent_moved = false;
       slice->pos = offset - slice->anchor;
       if (slice->pos > slice->size)
          slice->size = slice->pos;
@@ -183,6 +259,64 @@ static off_t slice_fsize(ALLEGRO_FILE *f)
    return slice->size;
 }
 
+static const void *slice_fread_span(ALLEGRO_FILE *f, size_t size,
+   size_t *ret_size)
+{
+   SLICE_DATA *slice = al_get_file_userdata(f);
+   const void *span;
+   size_t n;
+
+   /* Writes would change the data under a lent pointer. */
+   if (slice->mode != SLICE_READ)
+      return NULL;
+
+   if (slice->pos + size > slice->size)
+      size = slice->size - slice->pos;
+   if (size == 0) {
+      /* nothing left, but the call still succeeds */
+      *ret_size = 0;
+      return "";
+   }
+
+   if (buffered(slice) < size) {
+      /* lend from the parent if it can, else read it all in one go */
+      if (slice->fp->vtable->fi_fread_span && !slice->fp->ungetc_len) {
+         if (!sync_parent(slice))
+            return NULL;
+         span = al_fread_span(slice->fp, size, &n);
+         if (span) {
+            slice->pos += n;
+            *ret_size = n;
+            return span;
+         }
+      }
+      if (!fill_buffer(slice, size))
+         return NULL;
+   }
+
+   n = buffered(slice);
+   if (n > size)
+      n = size;
+   span = slice->buffer + (slice->pos - slice->buffer_pos);
+   slice->pos += n;
+   slice->parent_moved = true;
+   *ret_size = n;
+   return span;
+}
+
+static void slice_fprefetch(ALLEGRO_FILE *f, size_t size)
+{
+   SLICE_DATA *slice = al_get_file_userdata(f);
+
+   /* Only worth it when the parent can't lend its data anyway. */
+   if (slice->mode != SLICE_READ || slice->fp->vtable->fi_fread_span)
+      return;
+   if (slice->pos + size > slice->size)
+      size = slice->size - slice->pos;
+   if (buffered(slice) < size)
+      fill_buffer(slice, size);
+}
+
 static const ALLEGRO_FILE_INTERFACE fi =
 {
    NULL,
@@ -197,7 +331,9 @@ static const ALLEGRO_FILE_INTERFACE fi =
    slice_ferrmsg,
    slice_fclearerr,
    NULL,
-   slice_fsize
+   slice_fsize,
+   slice_fread_span,
+   slice_fprefetch
 };
 
 /* Function: al_fopen_slice
@@ -367,7 +367,9 @@ const struct ALLEGRO_FILE_INTERFACE _al_file_interface_stdio =
    file_stdio_ferrmsg,
    file_stdio_fclearerr,
    file_stdio_fungetc,
-   file_stdio_fsize
+   file_stdio_fsize,
+   NULL,
+   NULL
 };
 
 
@@ -0,0 +1,882 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Parallel scanning of directory trees.
+ *
+ *      See readme.txt for copyright information.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "allegro5/allegro.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_file.h"
+#include "allegro5/internal/aintern_fshook.h"
+#include "allegro5/internal/aintern_thread.h"
+#include "allegro5/internal/aintern_vector.h"
+
+ALLEGRO_DEBUG_CHANNEL("fshook")
+
+#define MAX_SCAN_THREADS   16
+#define BATCH_RECORDS      256
+#define BATCH_STRINGS      (16 * 1024)
+
+#define CACHE_MAGIC        0x43533541  /* "A5SC" */
+#define CACHE_VERSION      1
+#define MAX_CACHE_STRING   (64 * 1024)
+#define MAX_CACHE_ENTRIES  (1 << 24)
+
+
+/* The listing of one directory, either freshly read or loaded from the
+ * cache file.
+ */
+typedef struct SCAN_DIR SCAN_DIR;
+
+struct SCAN_DIR {
+   char *path;
+   time_t mtime;
+   _AL_VECTOR entries;        /* _AL_FS_SCAN_ENTRY */
+   bool reused;               /* moved from the old cache to the new one */
+   SCAN_DIR *next;            /* hash chain of the old cache */
+};
+
+/* Records are handed to the callback in batches.  The paths are kept in one
+ * string buffer per batch, which may move while the batch is filled, so the
+ * record pointers are only set up just before delivery.
+ */
+typedef struct SCAN_BATCH SCAN_BATCH;
+
+struct SCAN_BATCH {
+   ALLEGRO_FS_SCAN_RECORD records[BATCH_RECORDS];
+   size_t offsets[BATCH_RECORDS];
+   int num_records;
+   char *strings;
+   size_t strings_used;
+   size_t strings_size;
+   SCAN_BATCH *next;
+};
+
+typedef struct SCAN_WORK {
+   char *path;
+   time_t mtime;
+} SCAN_WORK;
+
+typedef struct SCANNER {
+   const ALLEGRO_FS_INTERFACE *fs;
+   bool stat_files;
+   char sep;
+
+   _AL_MUTEX mutex;
+   _AL_COND cond;
+   _AL_VECTOR work;           /* SCAN_WORK, used as a stack */
+   int busy;                  /* directories being read */
+   SCAN_BATCH *first_batch;   /* full batches awaiting delivery */
+   SCAN_BATCH *last_batch;
+   bool stop;
+
+   /* The cache file loaded at the start, read-only while scanning. */
+   SCAN_DIR **old_dirs;
+   unsigned int old_mask;
+   time_t old_scan_time;      /* when the loaded cache was scanned */
+   /* Listings for the cache file written at the end, or NULL if not
+    * caching.
+    */
+   _AL_VECTOR *new_dirs;      /* SCAN_DIR * */
+} SCANNER;
+
+
+static int get_scan_threads(void)
+{
+   ALLEGRO_CONFIG *config = al_get_system_config();
+   const char *value = NULL;
+   int threads = 0;
+
+   if (config)
+      value = al_get_config_value(config, "filesystem", "scan_threads");
+   if (value)
+      threads = atoi(value);
+   if (threads <= 0)
+      threads = al_get_cpu_count();
+   if (threads > MAX_SCAN_THREADS)
+      threads = MAX_SCAN_THREADS;
+
+   return _ALLEGRO_MAX(threads, 1);
+}
+
+
+static char *dup_string(const char *s, size_t len)
+{
+   char *d = al_malloc(len + 1);
+   if (d) {
+      memcpy(d, s, len);
+      d[len] = '\0';
+   }
+   return d;
+}
+
+
+static bool is_separator(char c)
+{
+   return c == '/' || c == ALLEGRO_NATIVE_PATH_SEP;
+}
+
+
+static unsigned int hash_path(const char *path)
+{
+   unsigned int h = 2166136261u;
+
+   while (*path) {
+      h ^= (unsigned char)*path++;
+      h *= 16777619u;
+   }
+   return h;
+}
+
+
+static SCAN_DIR *create_dir(const char *path, time_t mtime)
+{
+   SCAN_DIR *dir = al_calloc(1, sizeof(*dir));
+
+   if (!dir)
+      return NULL;
+   dir->path = dup_string(path, strlen(path));
+   if (!dir->path) {
+      al_free(dir);
+      return NULL;
+   }
+   dir->mtime = mtime;
+   _al_vector_init(&dir->entries, sizeof(_AL_FS_SCAN_ENTRY));
+   return dir;
+}
+
+
+static void destroy_dir(SCAN_DIR *dir)
+{
+   unsigned int i;
+
+   for (i = 0; i < _al_vector_size(&dir->entries); i++) {
+      _AL_FS_SCAN_ENTRY *e = _al_vector_ref(&dir->entries, i);
+      al_free(e->name);
+   }
+   _al_vector_free(&dir->entries);
+   al_free(dir->path);
+   al_free(dir);
+}
+
+
+/* List a directory through the fs interface functions, for interfaces other
+ * than the standard one.
+ */
+static bool list_directory_generic(const char *path, _AL_VECTOR *entries)
+{
+   ALLEGRO_FS_ENTRY *dir;
+   ALLEGRO_FS_ENTRY *ent;
+   _AL_FS_SCAN_ENTRY *e;
+   const char *name;
+   const char *p;
+
+   dir = al_create_fs_entry(path);
+   if (!dir || !al_open_directory(dir)) {
+      al_destroy_fs_entry(dir);
+      return false;
+   }
+
+   while ((ent = al_read_directory(dir))) {
+      /* Entry names are full paths; keep the last component. */
+      name = al_get_fs_entry_name(ent);
+      for (p = name; *p; p++) {
+         if (is_separator(*p) && p[1])
+            name = p + 1;
+      }
+
+      e = _al_vector_alloc_back(entries);
+      e->name = dup_string(name, strcspn(name, "/\\"));
+      e->mode = al_get_fs_entry_mode(ent);
+      e->size = al_get_fs_entry_size(ent);
+      e->mtime = al_get_fs_entry_mtime(ent);
+      e->is_link = false;
+      al_destroy_fs_entry(ent);
+
+      if (!e->name) {
+         _al_vector_delete_at(entries, _al_vector_size(entries) - 1);
+         break;
+      }
+   }
+
+   al_close_directory(dir);
+   al_destroy_fs_entry(dir);
+   return true;
+}
+
+
+static SCAN_DIR *read_dir(SCANNER *s, const SCAN_WORK *w)
+{
+   SCAN_DIR *dir = create_dir(w->path, w->mtime);
+   bool ok;
+
+   if (!dir)
+      return NULL;
+
+#ifndef ALLEGRO_WINDOWS
+   if (s->fs == &_al_fs_interface_stdio)
+      ok = _al_fs_stdio_list_directory(w->path, s->stat_files, &dir->entries);
+   else
+#endif
+      ok = list_directory_generic(w->path, &dir->entries);
+
+   if (!ok) {
+      ALLEGRO_DEBUG("Unable to read directory %s\n", w->path);
+      destroy_dir(dir);
+      return NULL;
+   }
+   return dir;
+}
+
+
+/* Refresh the stat information of a subdirectory in a cached listing.  The
+ * listing of the parent is unchanged, but the subdirectory's own
+ * modification time, which decides whether its listing can be reused, may
+ * not be.
+ */
+static void refresh_entry(const char *path, _AL_FS_SCAN_ENTRY *e)
+{
+   ALLEGRO_FS_ENTRY *ent = al_create_fs_entry(path);
+
+   if (ent) {
+      e->mode = al_get_fs_entry_mode(ent) |
+         (e->mode & ALLEGRO_FILEMODE_HIDDEN);
+      e->size = al_get_fs_entry_size(ent);
+      e->mtime = al_get_fs_entry_mtime(ent);
+      al_destroy_fs_entry(ent);
+   }
+}
+
+
+static SCAN_DIR *find_cached_dir(SCANNER *s, const SCAN_WORK *w)
+{
+   SCAN_DIR *dir;
+
+   if (!s->old_dirs)
+      return NULL;
+
+   for (dir = s->old_dirs[hash_path(w->path) & s->old_mask]; dir;
+         dir = dir->next) {
+      if (strcmp(dir->path, w->path) != 0)
+         continue;
+      /* Timestamps are coarse: a directory changed during the second the
+       * old scan started may have changed again after it was read.
+       */
+      if (w->mtime == 0 || dir->mtime != w->mtime ||
+            dir->mtime >= s->old_scan_time)
+         return NULL;
+      return dir;
+   }
+   return NULL;
+}
+
+
+static SCAN_BATCH *create_batch(void)
+{
+   SCAN_BATCH *b = al_calloc(1, sizeof(*b));
+
+   if (!b)
+      return NULL;
+   b->strings = al_malloc(BATCH_STRINGS);
+   if (!b->strings) {
+      al_free(b);
+      return NULL;
+   }
+   b->strings_size = BATCH_STRINGS;
+   return b;
+}
+
+
+static void destroy_batch(SCAN_BATCH *b)
+{
+   if (b) {
+      al_free(b->strings);
+      al_free(b);
+   }
+}
+
+
+/* Append the record for one entry of a directory.  Returns its path inside
+ * the batch, or NULL if out of memory.
+ */
+static const char *add_record(SCAN_BATCH *b, const char *dir_path, char sep,
+   const _AL_FS_SCAN_ENTRY *e)
+{
+   size_t dir_len = strlen(dir_path);
+   size_t name_len = strlen(e->name);
+   bool need_sep = dir_len > 0 && !is_separator(dir_path[dir_len - 1]);
+   size_t need = dir_len + need_sep + name_len + 1;
+   ALLEGRO_FS_SCAN_RECORD *rec;
+   char *p;
+
+   ASSERT(b->num_records < BATCH_RECORDS);
+
+   if (b->strings_used + need > b->strings_size) {
+      size_t new_size = _ALLEGRO_MAX(b->strings_size * 2,
+         b->strings_used + need);
+      char *strings = al_realloc(b->strings, new_size);
+      if (!strings)
+         return NULL;
+      b->strings = strings;
+      b->strings_size = new_size;
+   }
+
+   p = b->strings + b->strings_used;
+   memcpy(p, dir_path, dir_len);
+   if (need_sep)
+      p[dir_len] = sep;
+   memcpy(p + dir_len + need_sep, e->name, name_len + 1);
+
+   rec = &b->records[b->num_records];
+   rec->path = NULL;
+   rec->mode = e->mode;
+   rec->size = e->size;
+   rec->mtime = e->mtime;
+   b->offsets[b->num_records++] = b->strings_used;
+   b->strings_used += need;
+
+   return p;
+}
+
+
+/* Must be called with the scanner mutex held. */
+static void queue_batch(SCANNER *s, SCAN_BATCH *b)
+{
+   b->next = NULL;
+   if (s->last_batch)
+      s->last_batch->next = b;
+   else
+      s->first_batch = b;
+   s->last_batch = b;
+   _al_cond_broadcast(&s->cond);
+}
+
+
+/* Must be called with the scanner mutex held. */
+static bool take_work(SCANNER *s, SCAN_WORK *w)
+{
+   unsigned int n = _al_vector_size(&s->work);
+
+   if (n == 0 || s->stop)
+      return false;
+   *w = *(SCAN_WORK *)_al_vector_ref_back(&s->work);
+   _al_vector_delete_at(&s->work, n - 1);
+   s->busy++;
+   return true;
+}
+
+
+/* Must be called with the scanner mutex held. */
+static void finish_work(SCANNER *s)
+{
+   s->busy--;
+   if (s->busy == 0)
+      _al_cond_broadcast(&s->cond);
+}
+
+
+/* Read one directory, turning its entries into records in *batch and its
+ * subdirectories into new work.
+ */
+static void scan_directory(SCANNER *s, SCAN_WORK *w, SCAN_BATCH **batch)
+{
+   _AL_VECTOR subdirs;
+   SCAN_DIR *dir;
+   bool cached;
+   unsigned int i;
+
+   dir = find_cached_dir(s, w);
+   cached = (dir != NULL);
+   if (cached)
+      dir->reused = true;
+   else
+      dir = read_dir(s, w);
+
+   al_free(w->path);
+   if (!dir)
+      return;
+
+   _al_vector_init(&subdirs, sizeof(SCAN_WORK));
+
+   for (i = 0; i < _al_vector_size(&dir->entries); i++) {
+      _AL_FS_SCAN_ENTRY *e = _al_vector_ref(&dir->entries, i);
+      const char *path;
+
+      if (!*batch && !(*batch = create_batch()))
+         break;
+
+      path = add_record(*batch, dir->path, s->sep, e);
+      if (!path)
+         break;
+
+      if (cached && (e->mode & ALLEGRO_FILEMODE_ISDIR) && !e->is_link) {
+         ALLEGRO_FS_SCAN_RECORD *rec =
+            &(*batch)->records[(*batch)->num_records - 1];
+         refresh_entry(path, e);
+         rec->mode = e->mode;
+         rec->size = e->size;
+         rec->mtime = e->mtime;
+      }
+
+      /* Symbolic links to directories are reported but not followed, so
+       * that loops cannot make the scan run forever.
+       */
+      if ((e->mode & ALLEGRO_FILEMODE_ISDIR) && !e->is_link) {
+         SCAN_WORK *sub = _al_vector_alloc_back(&subdirs);
+         sub->path = dup_string(path, strlen(path));
+         sub->mtime = e->mtime;
+         if (!sub->path)
+            _al_vector_delete_at(&subdirs, _al_vector_size(&subdirs) - 1);
+      }
+
+      if ((*batch)->num_records == BATCH_RECORDS) {
+         _al_mutex_lock(&s->mutex);
+         queue_batch(s, *batch);
+         _al_mutex_unlock(&s->mutex);
+         *batch = NULL;
+      }
+   }
+
+   _al_mutex_lock(&s->mutex);
+   if (_al_vector_is_nonempty(&subdirs)) {
+      _al_vector_append_array(&s->work, _al_vector_size(&subdirs),
+         _al_vector_ref_front(&subdirs));
+      _al_cond_broadcast(&s->cond);
+   }
+   if (s->new_dirs) {
+      SCAN_DIR **slot = _al_vector_alloc_back(s->new_dirs);
+      *slot = dir;
+      dir = NULL;
+   }
+   _al_mutex_unlock(&s->mutex);
+
+   if (dir)
+      destroy_dir(dir);
+   _al_vector_free(&subdirs);
+}
+
+
+static void *scan_thread(ALLEGRO_THREAD *thread, void *arg)
+{
+   SCANNER *s = arg;
+   SCAN_BATCH *batch = NULL;
+   SCAN_WORK w;
+   (void)thread;
+
+   /* The fs interface is thread local. */
+   al_set_fs_interface(s->fs);
+
+   _al_mutex_lock(&s->mutex);
+   while (!s->stop) {
+      if (take_work(s, &w)) {
+         _al_mutex_unlock(&s->mutex);
+         scan_directory(s, &w, &batch);
+         _al_mutex_lock(&s->mutex);
+         finish_work(s);
+         continue;
+      }
+      /* Out of work: hand over what we have before waiting. */
+      if (batch) {
+         queue_batch(s, batch);
+         batch = NULL;
+         continue;
+      }
+      if (s->busy == 0)
+         break;
+      _al_cond_wait(&s->cond, &s->mutex);
+   }
+   _al_mutex_unlock(&s->mutex);
+
+   destroy_batch(batch);
+   return NULL;
+}
+
+
+static int deliver_batch(SCAN_BATCH *b,
+   int (*callback)(const ALLEGRO_FS_SCAN_RECORD *, int, void *), void *extra)
+{
+   int i;
+   int result;
+
+   for (i = 0; i < b->num_records; i++)
+      b->records[i].path = b->strings + b->offsets[i];
+   result = callback(b->records, b->num_records, extra);
+   destroy_batch(b);
+   return result;
+}
+
+
+/* Runs on the calling thread: read directories like the workers do, but
+ * give priority to delivering batches, so that the callback is only ever
+ * called from here.
+ */
+static int run_scanner(SCANNER *s,
+   int (*callback)(const ALLEGRO_FS_SCAN_RECORD *, int, void *), void *extra)
+{
+   SCAN_BATCH *batch = NULL;
+   SCAN_BATCH *b;
+   SCAN_WORK w;
+   int result = ALLEGRO_FOR_EACH_FS_ENTRY_OK;
+
+   _al_mutex_lock(&s->mutex);
+   for (;;) {
+      if ((b = s->first_batch)) {
+         s->first_batch = b->next;
+         if (!s->first_batch)
+            s->last_batch = NULL;
+         _al_mutex_unlock(&s->mutex);
+         result = deliver_batch(b, callback, extra);
+         _al_mutex_lock(&s->mutex);
+         if (result == ALLEGRO_FOR_EACH_FS_ENTRY_STOP ||
+               result == ALLEGRO_FOR_EACH_FS_ENTRY_ERROR) {
+            s->stop = true;
+            _al_cond_broadcast(&s->cond);
+            break;
+         }
+         result = ALLEGRO_FOR_EACH_FS_ENTRY_OK;
+         continue;
+      }
+      if (take_work(s, &w)) {
+         _al_mutex_unlock(&s->mutex);
+         scan_directory(s, &w, &batch);
+         _al_mutex_lock(&s->mutex);
+         finish_work(s);
+         continue;
+      }
+      if (batch) {
+         queue_batch(s, batch);
+         batch = NULL;
+         continue;
+      }
+      if (s->busy == 0)
+         break;
+      _al_cond_wait(&s->cond, &s->mutex);
+   }
+   _al_mutex_unlock(&s->mutex);
+
+   destroy_batch(batch);
+   return result;
+}
+
+
+static void put64(ALLEGRO_FILE *f, int64_t v)
+{
+   al_fwrite32le(f, (int32_t)(v & 0xFFFFFFFF));
+   al_fwrite32le(f, (int32_t)(v >> 32));
+}
+
+
+static int64_t get64(ALLEGRO_FILE *f)
+{
+   uint32_t lo = (uint32_t)al_fread32le(f);
+   uint32_t hi = (uint32_t)al_fread32le(f);
+   return (int64_t)(((uint64_t)hi << 32) | lo);
+}
+
+
+static void put_string(ALLEGRO_FILE *f, const char *s)
+{
+   size_t len = strlen(s);
+   al_fwrite32le(f, (int32_t)len);
+   al_fwrite(f, s, len);
+}
+
+
+static char *get_string(ALLEGRO_FILE *f)
+{
+   int32_t len = al_fread32le(f);
+   char *s;
+
+   if (len < 0 || len > MAX_CACHE_STRING)
+      return NULL;
+   s = al_malloc(len + 1);
+   if (!s)
+      return NULL;
+   if (al_fread(f, s, len) != (size_t)len) {
+      al_free(s);
+      return NULL;
+   }
+   s[len] = '\0';
+   return s;
+}
+
+
+static bool read_cache_header(SCANNER *s, ALLEGRO_FILE *f, const char *root,
+   int flags)
+{
+   char *cache_root;
+   bool ok;
+
+   if (al_fread32le(f) != CACHE_MAGIC || al_fread32le(f) != CACHE_VERSION)
+      return false;
+   if (al_fread32le(f) != flags)
+      return false;
+   cache_root = get_string(f);
+   ok = cache_root && strcmp(cache_root, root) == 0;
+   al_free(cache_root);
+   s->old_scan_time = (time_t)get64(f);
+   return ok;
+}
+
+
+static SCAN_DIR *read_cache_dir(ALLEGRO_FILE *f)
+{
+   SCAN_DIR *dir;
+   _AL_FS_SCAN_ENTRY *e;
+   char *path;
+   int32_t n;
+
+   path = get_string(f);
+   if (!path)
+      return NULL;
+   dir = create_dir(path, 0);
+   al_free(path);
+   if (!dir)
+      return NULL;
+
+   dir->mtime = (time_t)get64(f);
+   n = al_fread32le(f);
+   if (n < 0 || n > MAX_CACHE_ENTRIES)
+      goto Error;
+
+   while (n-- > 0) {
+      char *name = get_string(f);
+      if (!name)
+         goto Error;
+      e = _al_vector_alloc_back(&dir->entries);
+      e->name = name;
+      e->mode = (uint32_t)al_fread32le(f);
+      e->size = (off_t)get64(f);
+      e->mtime = (time_t)get64(f);
+      e->is_link = al_fgetc(f) == 1;
+   }
+
+   if (al_feof(f) || al_ferror(f))
+      goto Error;
+   return dir;
+
+Error:
+   destroy_dir(dir);
+   return NULL;
+}
+
+
+static void free_old_cache(SCANNER *s)
+{
+   unsigned int i;
+   SCAN_DIR *dir;
+   SCAN_DIR *next;
+
+   if (!s->old_dirs)
+      return;
+
+   for (i = 0; i <= s->old_mask; i++) {
+      for (dir = s->old_dirs[i]; dir; dir = next) {
+         next = dir->next;
+         /* Reused listings belong to the new cache. */
+         if (!dir->reused)
+            destroy_dir(dir);
+      }
+   }
+   al_free(s->old_dirs);
+   s->old_dirs = NULL;
+}
+
+
+static void load_cache(SCANNER *s, const char *filename, const char *root,
+   int flags)
+{
+   ALLEGRO_FILE *f;
+   SCAN_DIR *dir;
+   int32_t num_dirs;
+   unsigned int size;
+   unsigned int h;
+
+   /* The cache always lives in the real file system, whatever fs
+    * interface is being scanned.
+    */
+   f = al_fopen_interface(&_al_file_interface_stdio, filename, "rb");
+   if (!f)
+      return;
+
+   if (!read_cache_header(s, f, root, flags))
+      goto Error;
+   num_dirs = al_fread32le(f);
+   if (num_dirs < 0 || num_dirs > MAX_CACHE_ENTRIES)
+      goto Error;
+
+   for (size = 16; size < (unsigned int)num_dirs * 2; size *= 2)
+      ;
+   s->old_dirs = al_calloc(size, sizeof(SCAN_DIR *));
+   if (!s->old_dirs)
+      goto Error;
+   s->old_mask = size - 1;
+
+   while (num_dirs-- > 0) {
+      dir = read_cache_dir(f);
+      if (!dir)
+         goto Error;
+      h = hash_path(dir->path) & s->old_mask;
+      dir->next = s->old_dirs[h];
+      s->old_dirs[h] = dir;
+   }
+
+   al_fclose(f);
+   return;
+
+Error:
+   ALLEGRO_WARN("Ignoring invalid scan cache %s\n", filename);
+   free_old_cache(s);
+   al_fclose(f);
+}
+
+
+static void save_cache(SCANNER *s, const char *filename, const char *root,
+   int flags, time_t scan_time)
+{
+   ALLEGRO_FILE *f;
+   unsigned int i;
+   unsigned int j;
+
+   f = al_fopen_interface(&_al_file_interface_stdio, filename, "wb");
+   if (!f) {
+      ALLEGRO_WARN("Unable to write scan cache %s\n", filename);
+      return;
+   }
+
+   al_fwrite32le(f, CACHE_MAGIC);
+   al_fwrite32le(f, CACHE_VERSION);
+   al_fwrite32le(f, flags);
+   put_string(f, root);
+   put64(f, scan_time);
+   al_fwrite32le(f, (int32_t)_al_vector_size(s->new_dirs));
+
+   for (i = 0; i < _al_vector_size(s->new_dirs); i++) {
+      SCAN_DIR *dir = *(SCAN_DIR **)_al_vector_ref(s->new_dirs, i);
+
+      put_string(f, dir->path);
+      put64(f, dir->mtime);
+      al_fwrite32le(f, (int32_t)_al_vector_size(&dir->entries));
+      for (j = 0; j < _al_vector_size(&dir->entries); j++) {
+         const _AL_FS_SCAN_ENTRY *e = _al_vector_ref(&dir->entries, j);
+         put_string(f, e->name);
+         al_fwrite32le(f, (int32_t)e->mode);
+         put64(f, e->size);
+         put64(f, e->mtime);
+         al_fputc(f, e->is_link ? 1 : 0);
+      }
+   }
+
+   if (al_ferror(f))
+      ALLEGRO_WARN("Error writing scan cache %s\n", filename);
+   al_fclose(f);
+}
+
+
+/* Function: al_scan_fs_tree
+ */
+int al_scan_fs_tree(const char *path, int flags, const char *cache_filename,
+   int (*callback)(const ALLEGRO_FS_SCAN_RECORD *records, int num_records,
+      void *extra),
+   void *extra)
+{
+   SCANNER s;
+   _AL_VECTOR new_dirs;
+   ALLEGRO_FS_ENTRY *root;
+   ALLEGRO_THREAD *threads[MAX_SCAN_THREADS];
+   SCAN_WORK *w;
+   SCAN_BATCH *b;
+   time_t scan_time = time(NULL);
+   int num_threads;
+   int result;
+   unsigned int i;
+   int t;
+
+   ASSERT(path);
+   ASSERT(callback);
+
+   memset(&s, 0, sizeof(s));
+   s.fs = al_get_fs_interface();
+   s.stat_files = !(flags & ALLEGRO_FS_SCAN_NO_STAT);
+   s.sep = (s.fs == &_al_fs_interface_stdio) ? ALLEGRO_NATIVE_PATH_SEP : '/';
+
+   root = al_create_fs_entry(path);
+   if (!root || !(al_get_fs_entry_mode(root) & ALLEGRO_FILEMODE_ISDIR)) {
+      al_destroy_fs_entry(root);
+      al_set_errno(ENOENT);
+      return ALLEGRO_FOR_EACH_FS_ENTRY_ERROR;
+   }
+
+   _al_vector_init(&s.work, sizeof(SCAN_WORK));
+   w = _al_vector_alloc_back(&s.work);
+   w->path = dup_string(path, strlen(path));
+   w->mtime = al_get_fs_entry_mtime(root);
+   al_destroy_fs_entry(root);
+   if (!w->path) {
+      _al_vector_free(&s.work);
+      al_set_errno(ENOMEM);
+      return ALLEGRO_FOR_EACH_FS_ENTRY_ERROR;
+   }
+
+   if (cache_filename) {
+      _al_vector_init(&new_dirs, sizeof(SCAN_DIR *));
+      s.new_dirs = &new_dirs;
+      load_cache(&s, cache_filename, path, flags);
+   }
+
+   _al_mutex_init(&s.mutex);
+   _al_cond_init(&s.cond);
+
+   num_threads = get_scan_threads();
+   for (t = 0; t < num_threads - 1; t++) {
+      threads[t] = al_create_thread(scan_thread, &s);
+      if (!threads[t])
+         break;
+      al_start_thread(threads[t]);
+   }
+   num_threads = t;
+
+   result = run_scanner(&s, callback, extra);
+
+   for (t = 0; t < num_threads; t++)
+      al_destroy_thread(threads[t]);
+
+   /* Anything left over was abandoned by a stop. */
+   while ((b = s.first_batch)) {
+      s.first_batch = b->next;
+      destroy_batch(b);
+   }
+   for (i = 0; i < _al_vector_size(&s.work); i++) {
+      w = _al_vector_ref(&s.work, i);
+      al_free(w->path);
+   }
+   _al_vector_free(&s.work);
+
+   if (s.new_dirs) {
+      if (result == ALLEGRO_FOR_EACH_FS_ENTRY_OK)
+         save_cache(&s, cache_filename, path, flags, scan_time);
+      free_old_cache(&s);
+      for (i = 0; i < _al_vector_size(&new_dirs); i++)
+         destroy_dir(*(SCAN_DIR **)_al_vector_ref(&new_dirs, i));
+      _al_vector_free(&new_dirs);
+   }
+
+   _al_cond_destroy(&s.cond);
+   _al_mutex_destroy(&s.mutex);
+
+   return result;
+}
+
+/* vim: set sts=3 sw=3 et: */
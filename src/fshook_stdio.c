@@ -289,28 +289,45 @@ static bool unix_hidden_file(const char *path)
 #endif
 
 
-static void fs_update_stat_mode(ALLEGRO_FS_ENTRY_STDIO *fp_stdio)
+static uint32_t mode_from_stat(const WRAP_STAT_TYPE *st)
 {
-   fp_stdio->stat_mode = 0;
+   uint32_t mode = 0;
 
-   if (S_ISDIR(fp_stdio->st.st_mode))
-      fp_stdio->stat_mode |= ALLEGRO_FILEMODE_ISDIR;
+   if (S_ISDIR(st->st_mode))
+      mode |= ALLEGRO_FILEMODE_ISDIR;
    else /* marks special unix files as files... might want to add enum items for symlink, CHAR, BLOCK and SOCKET files. */
-      fp_stdio->stat_mode |= ALLEGRO_FILEMODE_ISFILE;
+      mode |= ALLEGRO_FILEMODE_ISFILE;
 
    /*
    if (S_ISREG(fh->st.st_mode))
       fh->stat_mode |= ALLEGRO_FILEMODE_ISFILE;
    */
 
-   if (fp_stdio->st.st_mode & (S_IRUSR | S_IRGRP))
-      fp_stdio->stat_mode |= ALLEGRO_FILEMODE_READ;
+   if (st->st_mode & (S_IRUSR | S_IRGRP))
+      mode |= ALLEGRO_FILEMODE_READ;
+
+   if (st->st_mode & (S_IWUSR | S_IWGRP))
+      mode |= ALLEGRO_FILEMODE_WRITE;
+
+   if (st->st_mode & (S_IXUSR | S_IXGRP))
+      mode |= ALLEGRO_FILEMODE_EXECUTE;
 
-   if (fp_stdio->st.st_mode & (S_IWUSR | S_IWGRP))
-      fp_stdio->stat_mode |= ALLEGRO_FILEMODE_WRITE;
+#if defined(ALLEGRO_MACOSX) && defined(UF_HIDDEN)
+   /* OSX hidden files can both start with the dot as well as having this flag
+    * set...  Note that this flag does not exist on all versions of OS X
+    * (Tiger doesn't seem to have it) so we need to test for it.
+    */
+   if (st->st_flags & UF_HIDDEN)
+      mode |= ALLEGRO_FILEMODE_HIDDEN;
+#endif
 
-   if (fp_stdio->st.st_mode & (S_IXUSR | S_IXGRP))
-      fp_stdio->stat_mode |= ALLEGRO_FILEMODE_EXECUTE;
+   return mode;
+}
+
+
+static void fs_update_stat_mode(ALLEGRO_FS_ENTRY_STDIO *fp_stdio)
+{
+   fp_stdio->stat_mode = mode_from_stat(&fp_stdio->st);
 
 #if defined(ALLEGRO_WINDOWS)
    {
@@ -319,16 +336,6 @@ static void fs_update_stat_mode(ALLEGRO_FS_ENTRY_STDIO *fp_stdio)
          fp_stdio->stat_mode |= ALLEGRO_FILEMODE_HIDDEN;
    }
 #endif
-#if defined(ALLEGRO_MACOSX) && defined(UF_HIDDEN)
-   {
-      /* OSX hidden files can both start with the dot as well as having this flag set...
-       * Note that this flag does not exist on all versions of OS X (Tiger
-       * doesn't seem to have it) so we need to test for it.
-       */
-      if (fp_stdio->st.st_flags & UF_HIDDEN)
-         fp_stdio->stat_mode |= ALLEGRO_FILEMODE_HIDDEN;
-   }
-#endif
 #if defined(ALLEGRO_UNIX) || defined(ALLEGRO_MACOSX)
    if (0 == (fp_stdio->stat_mode & ALLEGRO_FILEMODE_HIDDEN)) {
       if (unix_hidden_file(fp_stdio->abs_path)) {
@@ -448,6 +455,96 @@ static ALLEGRO_FS_ENTRY *fs_stdio_read_directory(ALLEGRO_FS_ENTRY *fp)
 }
 
 
+#ifndef ALLEGRO_WINDOWS
+/* Read a whole directory for al_scan_fs_tree, appending an _AL_FS_SCAN_ENTRY
+ * for each file to `entries`.  Unlike fs_stdio_read_directory this does not
+ * build an absolute path for every file: the file type comes from d_type
+ * where the system provides it, and stat information is looked up relative
+ * to the open directory.  Files are only stat'ed if `stat_files` is set;
+ * directories always are, as the caller needs their modification times.
+ */
+bool _al_fs_stdio_list_directory(const char *path, bool stat_files,
+   _AL_VECTOR *entries)
+{
+   DIR *dir;
+   struct dirent *ent;
+   struct stat st;
+   _AL_FS_SCAN_ENTRY *e;
+   bool need_stat;
+   bool know_link;
+   bool have_stat;
+   size_t len;
+
+   dir = opendir(path);
+   if (!dir) {
+      al_set_errno(errno);
+      return false;
+   }
+
+   while ((ent = readdir(dir))) {
+      if (0 == strcmp(ent->d_name, ".") || 0 == strcmp(ent->d_name, ".."))
+         continue;
+
+      e = _al_vector_alloc_back(entries);
+      len = NAMLEN(ent);
+      e->name = al_malloc(len + 1);
+      if (!e->name) {
+         _al_vector_delete_at(entries, _al_vector_size(entries) - 1);
+         closedir(dir);
+         al_set_errno(ENOMEM);
+         return false;
+      }
+      memcpy(e->name, ent->d_name, len + 1);
+      e->mode = 0;
+      e->size = 0;
+      e->mtime = 0;
+      e->is_link = false;
+
+      need_stat = true;
+      know_link = false;
+#ifdef DT_DIR
+      if (ent->d_type != DT_UNKNOWN) {
+         e->is_link = (ent->d_type == DT_LNK);
+         know_link = true;
+      }
+      if (!stat_files && ent->d_type != DT_DIR && ent->d_type != DT_LNK &&
+            ent->d_type != DT_UNKNOWN) {
+         e->mode = ALLEGRO_FILEMODE_ISFILE;
+         need_stat = false;
+      }
+#else
+      (void)stat_files;
+#endif
+
+      /* Without a usable d_type, look at the entry itself first so that
+       * links are still recognised, and only follow it if it is one.
+       * A failed stat (e.g. a dangling link) leaves the mode at 0, as
+       * create_abs_path_entry does.
+       */
+      have_stat = false;
+      if (need_stat && !know_link &&
+            fstatat(dirfd(dir), ent->d_name, &st, AT_SYMLINK_NOFOLLOW) == 0) {
+         e->is_link = S_ISLNK(st.st_mode);
+         have_stat = !e->is_link;
+      }
+      if (need_stat && !have_stat)
+         have_stat = (fstatat(dirfd(dir), ent->d_name, &st, 0) == 0);
+      if (have_stat) {
+         e->mode = mode_from_stat(&st);
+         e->size = st.st_size;
+         e->mtime = st.st_mtime;
+      }
+
+      if (ent->d_name[0] == '.')
+         e->mode |= ALLEGRO_FILEMODE_HIDDEN;
+   }
+
+   closedir(dir);
+   return true;
+}
+#endif
+
+
 static void fs_stdio_destroy_entry(ALLEGRO_FS_ENTRY *fh_)
 {
    ALLEGRO_FS_ENTRY_STDIO *fh = (ALLEGRO_FS_ENTRY_STDIO *) fh_;
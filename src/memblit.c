@@ -235,7 +235,7 @@ static void _al_draw_transformed_bitmap_memory(ALLEGRO_BITMAP *src,
    v[bl].v = sy + sh;
    v[bl].color = tint;
 
-   al_lock_bitmap(src, ALLEGRO_PIXEL_FORMAT_ANY, ALLEGRO_LOCK_READONLY);
+   _al_lock_bitmap_for_sampling(src);
 
    _al_triangle_2d(src, &v[tl], &v[tr], &v[br]);
    _al_triangle_2d(src, &v[tl], &v[br], &v[bl]);
@@ -280,6 +280,21 @@ static void _al_draw_bitmap_region_memory_fast(ALLEGRO_BITMAP *bitmap,
 
    CLIPPER(bitmap, sx, sy, sw, sh, dest, dx, dy, dw, dh, 1, 1, flags)
 
+   /* Read tiled bitmaps straight into the destination, avoiding the
+    * intermediate copy a lock would make.
+    */
+   if (_al_bitmap_is_tiled(bitmap) && !bitmap->locked) {
+      if (!(dst_region = al_lock_bitmap_region(dest, dx, dy, sw, sh,
+            al_get_bitmap_format(bitmap), ALLEGRO_LOCK_WRITEONLY))) {
+         return;
+      }
+      _al_untile_bitmap_data(bitmap->memory, bitmap->pitch,
+         dst_region->data, dst_region->pitch, sx, sy, sw, sh,
+         dst_region->pixel_size);
+      al_unlock_bitmap(dest);
+      return;
+   }
+
    if (!(src_region = al_lock_bitmap_region(bitmap, sx, sy, sw, sh,
          ALLEGRO_PIXEL_FORMAT_ANY, ALLEGRO_LOCK_READONLY))) {
       return;
@@ -16,12 +16,22 @@
  */
 
 
+#include <string.h>
 #include "allegro5/allegro.h"
+#include "allegro5/internal/aintern.h"
 #include "allegro5/internal/aintern_bitmap.h"
 #include "allegro5/internal/aintern_blend.h"
 #include "allegro5/internal/aintern_memdraw.h"
 #include "allegro5/internal/aintern_pixels.h"
 
+ALLEGRO_DEBUG_CHANNEL("bitmap")
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+   (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+   #include <emmintrin.h>
+   #define ALLEGRO_CLEAR_USE_SSE2
+#endif
+
 
 typedef struct {
    float x[4];
@@ -44,12 +54,234 @@ void _al_draw_pixel_memory(ALLEGRO_BITMAP *bitmap, float x, float y,
 }
 
 
-void _al_clear_bitmap_by_locking(ALLEGRO_BITMAP *bitmap, ALLEGRO_COLOR *color)
+/* Clears larger than this are split between threads, and clears of rows
+ * larger than STREAM_BYTES in total bypass the cache, as they would only
+ * evict everything else from it.
+ */
+#define PARALLEL_BYTES     (4 << 20)
+#define MIN_BAND_BYTES     (1 << 20)
+#define MAX_CLEAR_THREADS  16
+#define STREAM_BYTES       (32 << 20)
+
+
+typedef struct CLEAR_BAND {
+   unsigned char *data;
+   int pitch;
+   int row_size;
+   int rows;
+   /* One pixel, repeated over the whole buffer. */
+   union {
+      unsigned char bytes[32];
+      float4 align;
+   } pattern;
+   int pixel_size;
+   bool stream;
+} CLEAR_BAND;
+
+
+#ifdef ALLEGRO_CLEAR_USE_SSE2
+/* Fill one row with non-temporal stores.  The pattern period must divide
+ * 16, so the pattern seen from any 16 byte aligned address is the one at
+ * the same offset into the 32 byte repeated pattern.
+ */
+static void stream_row(unsigned char *dst, int size, const unsigned char *pattern)
+{
+   int head = (int)((16 - ((uintptr_t)dst & 15)) & 15);
+   __m128i v;
+
+   if (head > size)
+      head = size;
+   memcpy(dst, pattern, head);
+   v = _mm_loadu_si128((const __m128i *)(pattern + head));
+   dst += head;
+   size -= head;
+
+   for (; size >= 64; size -= 64, dst += 64) {
+      _mm_stream_si128((__m128i *)dst, v);
+      _mm_stream_si128((__m128i *)(dst + 16), v);
+      _mm_stream_si128((__m128i *)(dst + 32), v);
+      _mm_stream_si128((__m128i *)(dst + 48), v);
+   }
+   for (; size >= 16; size -= 16, dst += 16)
+      _mm_stream_si128((__m128i *)dst, v);
+   memcpy(dst, pattern + head, size);
+}
+#endif
+
+
+/* Fill the first row by copying ever larger parts of itself, then copy it
+ * to the others.  memcpy and memset use the widest stores the CPU has.
+ */
+static void clear_band(CLEAR_BAND *band)
+{
+   unsigned char *row = band->data;
+   int size = band->row_size;
+   int ps = band->pixel_size;
+   bool same_bytes = true;
+   int i, n;
+
+   for (i = 1; i < ps; i++) {
+      if (band->pattern.bytes[i] != band->pattern.bytes[0]) {
+         same_bytes = false;
+         break;
+      }
+   }
+
+   if (same_bytes) {
+      for (i = 0; i < band->rows; i++, row += band->pitch)
+         memset(row, band->pattern.bytes[0], size);
+      return;
+   }
+
+#ifdef ALLEGRO_CLEAR_USE_SSE2
+   if (band->stream && 16 % ps == 0) {
+      for (i = 0; i < band->rows; i++, row += band->pitch)
+         stream_row(row, size, band->pattern.bytes);
+      _mm_sfence();
+      return;
+   }
+#endif
+
+   memcpy(row, band->pattern.bytes, ps);
+   for (n = ps; n < size; n += i) {
+      i = _ALLEGRO_MIN(n, size - n);
+      memcpy(row + n, row, i);
+   }
+   for (i = 1; i < band->rows; i++)
+      memcpy(row + i * band->pitch, row, size);
+}
+
+
+static void *clear_band_thread(ALLEGRO_THREAD *thread, void *arg)
+{
+   (void)thread;
+   clear_band(arg);
+   return NULL;
+}
+
+
+static int get_clear_threads(int64_t bytes)
+{
+   const char *value;
+   int threads = 0;
+
+   value = al_get_config_value(al_get_system_config(), "graphics",
+      "memory_clear_threads");
+   if (value)
+      threads = atoi(value);
+   if (threads <= 0)
+      threads = al_get_cpu_count();
+   if (threads > MAX_CLEAR_THREADS)
+      threads = MAX_CLEAR_THREADS;
+   if (threads > bytes / MIN_BAND_BYTES)
+      threads = (int)(bytes / MIN_BAND_BYTES);
+
+   return _ALLEGRO_MAX(threads, 1);
+}
+
+
+static bool get_clear_streaming(void)
+{
+   const char *value = al_get_config_value(al_get_system_config(),
+      "graphics", "memory_clear_streaming");
+   return !value || strcmp(value, "false") != 0;
+}
+
+
+/* Fill a locked region with the raw pixel value in band->pattern.  Big
+ * regions are split into bands of rows, each cleared on its own thread,
+ * the last one on the calling thread.
+ */
+static void fill_region(CLEAR_BAND *band)
+{
+   CLEAR_BAND bands[MAX_CLEAR_THREADS];
+   ALLEGRO_THREAD *threads[MAX_CLEAR_THREADS];
+   int64_t bytes = (int64_t)band->row_size * band->rows;
+   int num_threads = 1;
+   int i;
+
+   if (bytes >= STREAM_BYTES)
+      band->stream = get_clear_streaming();
+   if (bytes >= PARALLEL_BYTES)
+      num_threads = get_clear_threads(bytes);
+
+   if (num_threads == 1) {
+      clear_band(band);
+      return;
+   }
+
+   for (i = 0; i < num_threads; i++) {
+      int y1 = band->rows * i / num_threads;
+      int y2 = band->rows * (i + 1) / num_threads;
+      bands[i] = *band;
+      bands[i].data = band->data + (intptr_t)y1 * band->pitch;
+      bands[i].rows = y2 - y1;
+   }
+
+   for (i = 0; i < num_threads - 1; i++) {
+      threads[i] = al_create_thread(clear_band_thread, &bands[i]);
+      if (threads[i])
+         al_start_thread(threads[i]);
+   }
+
+   clear_band(&bands[num_threads - 1]);
+
+   for (i = 0; i < num_threads - 1; i++) {
+      if (threads[i]) {
+         al_join_thread(threads[i], NULL);
+         al_destroy_thread(threads[i]);
+      }
+      else {
+         /* Could not start a thread, so clear the band here. */
+         clear_band(&bands[i]);
+      }
+   }
+}
+
+
+/* Clear a rectangle, already clipped, of the bitmap.  The raw pixel value
+ * is computed on the first call for a given lock format and kept in
+ * *band for later rectangles.
+ */
+static void clear_region_by_locking(ALLEGRO_BITMAP *bitmap, CLEAR_BAND *band,
+   int *format, ALLEGRO_COLOR *color, int x, int y, int w, int h)
 {
    ALLEGRO_LOCKED_REGION *lr;
+   int i;
+
+   /* XXX what about pre-locked bitmaps? */
+   lr = al_lock_bitmap_region(bitmap, x, y, w, h, ALLEGRO_PIXEL_FORMAT_ANY,
+      ALLEGRO_LOCK_WRITEONLY);
+   if (!lr)
+      return;
+
+   if (lr->format != *format) {
+      unsigned char *p = band->pattern.bytes;
+      ALLEGRO_COLOR col = *color;
+      ASSERT(lr->pixel_size <= 16);
+      _AL_INLINE_PUT_PIXEL(lr->format, p, col, false);
+      for (i = lr->pixel_size; i < 32; i++)
+         band->pattern.bytes[i] = band->pattern.bytes[i % lr->pixel_size];
+      band->pixel_size = lr->pixel_size;
+      *format = lr->format;
+   }
+
+   band->data = lr->data;
+   band->pitch = lr->pitch;
+   band->row_size = w * lr->pixel_size;
+   band->rows = h;
+   band->stream = false;
+   fill_region(band);
+
+   al_unlock_bitmap(bitmap);
+}
+
+
+void _al_clear_bitmap_by_locking(ALLEGRO_BITMAP *bitmap, ALLEGRO_COLOR *color)
+{
+   CLEAR_BAND band;
+   int format = -1;
    int x1, y1, w, h;
-   int x, y;
-   unsigned char *line_ptr;
 
    /* This function is not just used on memory bitmaps, but also on OpenGL
     * video bitmaps which are not the current target, or when locked.
@@ -66,90 +298,34 @@ void _al_clear_bitmap_by_locking(ALLEGRO_BITMAP *bitmap, ALLEGRO_COLOR *color)
    if (w <= 0 || h <= 0)
       return;
 
-   /* XXX what about pre-locked bitmaps? */
-   lr = al_lock_bitmap_region(bitmap, x1, y1, w, h, ALLEGRO_PIXEL_FORMAT_ANY, 0);
-   if (!lr)
-      return;
+   clear_region_by_locking(bitmap, &band, &format, color, x1, y1, w, h);
+}
 
-   /* Write a single pixel so we can get the raw value. */
-   _al_put_pixel(bitmap, x1, y1, *color);
-
-   /* Fill in the region. */
-   line_ptr = lr->data;
-   switch (lr->pixel_size) {
-      case 2: {
-         int pixel_value = bmp_read16(line_ptr);
-         for (y = y1; y < y1 + h; y++) {
-            if (pixel_value == 0) {    /* fast path */
-               memset(line_ptr, 0, 2 * w);
-            }
-            else {
-               uint16_t *data = (uint16_t *)line_ptr;
-               for (x = 0; x < w; x++) {
-                  bmp_write16(data, pixel_value);
-                  data++;
-               }
-            }
-            line_ptr += lr->pitch;
-         }
-         break;
-      }
 
-      case 3: {
-         int pixel_value = READ3BYTES(line_ptr);
-         for (y = y1; y < y1 + h; y++) {
-            unsigned char *data = (unsigned char *)line_ptr;
-            if (pixel_value == 0) {    /* fast path */
-               memset(data, 0, 3 * w);
-            }
-            else {
-               for (x = 0; x < w; x++) {
-                  WRITE3BYTES(data, pixel_value);
-                  data += 3;
-               }
-            }
-            line_ptr += lr->pitch;
-         }
-         break;
-      }
+/* Clear each of num_rects rectangles, given as x, y, w, h, clipped to the
+ * clipping rectangle of the bitmap.
+ */
+void _al_clear_rectangles_by_locking(ALLEGRO_BITMAP *bitmap,
+   ALLEGRO_COLOR *color, const int *rects, int num_rects)
+{
+   CLEAR_BAND band;
+   int format = -1;
+   int i;
 
-      case 4: {
-         int pixel_value = bmp_read32(line_ptr);
-         for (y = y1; y < y1 + h; y++) {
-            uint32_t *data = (uint32_t *)line_ptr;
-            /* Special casing pixel_value == 0 doesn't seem to make any
-             * difference to speed, so don't bother.
-             */
-            for (x = 0; x < w; x++) {
-               bmp_write32(data, pixel_value);
-               data++;
-            }
-            line_ptr += lr->pitch;
-         }
-         break;
-      }
+   ASSERT(bitmap);
 
-      case sizeof(float4): {
-         float4 *data = (float4 *)line_ptr;
-         float4 pixel_value = *data;
-
-         for (y = y1; y < y1 + h; y++) {
-            data = (float4 *)line_ptr;
-            for (x = 0; x < w; x++) {
-               *data = pixel_value;
-               data++;
-            }
-            line_ptr += lr->pitch;
-         }
-         break;
-      }
+   for (i = 0; i < num_rects; i++) {
+      const int *r = rects + i * 4;
+      int x1 = _ALLEGRO_MAX(r[0], bitmap->cl);
+      int y1 = _ALLEGRO_MAX(r[1], bitmap->ct);
+      int x2 = _ALLEGRO_MIN(r[0] + r[2], bitmap->cr_excl);
+      int y2 = _ALLEGRO_MIN(r[1] + r[3], bitmap->cb_excl);
 
-      default:
-        ASSERT(false);
-        break;
+      if (x2 > x1 && y2 > y1) {
+         clear_region_by_locking(bitmap, &band, &format, color,
+            x1, y1, x2 - x1, y2 - y1);
+      }
    }
-
-   al_unlock_bitmap(bitmap);
 }
 
 /* vim: set sts=3 sw=3 et: */
@@ -0,0 +1,646 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Pooled memory interface for small allocations.
+ *
+ *      See readme.txt for copyright information.
+ */
+
+/* Title: Memory pool
+ */
+
+
+#include <string.h>
+#include "allegro5/allegro.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_thread.h"
+
+
+/* Requests up to the largest class are served from fixed size blocks
+ * carved out of CHUNK_SIZE chunks, anything bigger goes to malloc.  Freed
+ * blocks go to a per-thread list first and are handed back to the shared
+ * list in batches, so most allocations take no lock at all.
+ */
+#define NUM_CLASSES     12
+#define LARGE_CLASS     0xffff
+#define CHUNK_SIZE      (64 * 1024)
+#define CACHE_MAX       64
+#define CACHE_BATCH     32
+#define POOL_MAGIC      0xa110
+
+/* Call sites are kept in an open addressing hash table which never grows;
+ * once it is three quarters full new sites are not tracked.
+ */
+#define MAX_SITES       4096
+#define NUM_STRIPES     32
+
+static const size_t class_sizes[NUM_CLASSES] = {
+   16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024
+};
+
+
+/* Precedes every block handed out; 16 bytes to keep the alignment malloc
+ * gives.
+ */
+typedef union BLOCK_HEADER {
+   struct {
+      size_t size;
+      int32_t site;
+      uint16_t cls;
+      uint16_t magic;
+   } h;
+   double align[2];
+} BLOCK_HEADER;
+
+typedef struct FREE_BLOCK {
+   struct FREE_BLOCK *next;
+} FREE_BLOCK;
+
+typedef struct SITE {
+   const char *file;
+   const char *func;
+   int line;
+   size_t live_bytes;
+   size_t peak_bytes;
+   size_t live_count;
+   size_t total_count;
+} SITE;
+
+
+static struct {
+   bool inited;
+   bool track_sites;
+   _AL_MUTEX mutex;              /* protects free, carve and carve_left */
+   FREE_BLOCK *free[NUM_CLASSES];
+   char *carve;
+   size_t carve_left;
+} pool;
+
+static struct {
+   _AL_MUTEX insert_mutex;
+   _AL_MUTEX stripes[NUM_STRIPES];
+   SITE table[MAX_SITES];
+   int order[MAX_SITES];         /* table slots in order of first use */
+   int num;
+} sites;
+
+
+/* The per-thread lists use the same kind of thread local storage as
+ * tls.c picks for the platform.
+ */
+#if defined(ALLEGRO_MINGW32) && !defined(ALLEGRO_CFG_DLL_TLS)
+   /* MinGW < 4.2.1 doesn't have builtin thread local storage. */
+   #if __GNUC__ < 4
+      #define ALLEGRO_CFG_DLL_TLS
+   #elif __GNUC__ == 4 && __GNUC_MINOR__ < 2
+      #define ALLEGRO_CFG_DLL_TLS
+   #elif __GNUC__ == 4 && __GNUC_MINOR__ == 2 && __GNUC_PATCHLEVEL__ < 1
+      #define ALLEGRO_CFG_DLL_TLS
+   #endif
+#endif
+
+#ifdef ALLEGRO_STATICLINK
+   #undef ALLEGRO_CFG_DLL_TLS
+#endif
+
+#if defined(ALLEGRO_CFG_DLL_TLS)
+   /* Without compiler support for thread locals every block goes straight
+    * to the shared lists.
+    */
+#elif defined(ALLEGRO_MACOSX) || defined(ALLEGRO_IPHONE) || defined(ALLEGRO_ANDROID) || defined(ALLEGRO_RASPBERRYPI)
+   #define POOL_PTHREAD_KEY
+   #define POOL_THREAD_CACHE
+#elif defined(ALLEGRO_MSVC) || defined(ALLEGRO_BCC32)
+   #define POOL_THREAD_LOCAL __declspec(thread)
+   #define POOL_THREAD_CACHE
+#else
+   #define POOL_THREAD_LOCAL __thread
+   #define POOL_THREAD_CACHE
+#endif
+
+#ifdef POOL_THREAD_CACHE
+typedef struct THREAD_CACHE {
+   FREE_BLOCK *free[NUM_CLASSES];
+   int count[NUM_CLASSES];
+} THREAD_CACHE;
+#endif
+
+#if defined(POOL_PTHREAD_KEY)
+static pthread_key_t thread_cache_key;
+#elif defined(POOL_THREAD_LOCAL)
+static POOL_THREAD_LOCAL THREAD_CACHE thread_cache;
+#endif
+
+
+/* Size class for each multiple of 16 bytes, filled in on init. */
+static unsigned char class_lookup[1024 / 16 + 1];
+
+
+static int size_class(size_t n)
+{
+   if (n > class_sizes[NUM_CLASSES - 1])
+      return LARGE_CLASS;
+   return class_lookup[(n + 15) >> 4];
+}
+
+
+static int find_site(int line, const char *file, const char *func)
+{
+   unsigned int h = ((unsigned int)(uintptr_t)file >> 4) ^
+      ((unsigned int)line * 2654435761u);
+   int i, n;
+
+   /* Entries are only ever added, with file written last, so a lookup
+    * that races with an insertion at worst misses and retries below.
+    */
+   for (n = 0; n < MAX_SITES; n++) {
+      i = (h + n) & (MAX_SITES - 1);
+      if (sites.table[i].file == file && sites.table[i].line == line)
+         return i;
+      if (sites.table[i].file == NULL)
+         break;
+   }
+
+   _al_mutex_lock(&sites.insert_mutex);
+   for (n = 0; n < MAX_SITES; n++) {
+      i = (h + n) & (MAX_SITES - 1);
+      if (sites.table[i].file == file && sites.table[i].line == line)
+         break;
+      if (sites.table[i].file == NULL) {
+         if (sites.num >= MAX_SITES * 3 / 4) {
+            i = -1;
+            break;
+         }
+         sites.table[i].func = func;
+         sites.table[i].line = line;
+         sites.table[i].file = file;
+         sites.order[sites.num++] = i;
+         break;
+      }
+   }
+   _al_mutex_unlock(&sites.insert_mutex);
+
+   return i;
+}
+
+
+static void site_add(int site, size_t size)
+{
+   SITE *s = &sites.table[site];
+   _AL_MUTEX *stripe = &sites.stripes[site % NUM_STRIPES];
+
+   _al_mutex_lock(stripe);
+   s->live_bytes += size;
+   s->live_count++;
+   s->total_count++;
+   if (s->live_bytes > s->peak_bytes)
+      s->peak_bytes = s->live_bytes;
+   _al_mutex_unlock(stripe);
+}
+
+
+static void site_remove(int site, size_t size)
+{
+   SITE *s = &sites.table[site];
+   _AL_MUTEX *stripe = &sites.stripes[site % NUM_STRIPES];
+
+   _al_mutex_lock(stripe);
+   s->live_bytes -= size;
+   s->live_count--;
+   _al_mutex_unlock(stripe);
+}
+
+
+static void site_resize(int site, size_t old_size, size_t new_size)
+{
+   SITE *s = &sites.table[site];
+   _AL_MUTEX *stripe = &sites.stripes[site % NUM_STRIPES];
+
+   _al_mutex_lock(stripe);
+   s->live_bytes += new_size - old_size;
+   if (s->live_bytes > s->peak_bytes)
+      s->peak_bytes = s->live_bytes;
+   _al_mutex_unlock(stripe);
+}
+
+
+/* Take up to CACHE_BATCH blocks of a class from the shared list, carving
+ * new ones if it runs dry.  Returns a NULL terminated list.
+ */
+static FREE_BLOCK *take_blocks(int cls, int max)
+{
+   size_t block_size = sizeof(BLOCK_HEADER) + class_sizes[cls];
+   FREE_BLOCK *list = NULL;
+   int n = 0;
+
+   _al_mutex_lock(&pool.mutex);
+
+   while (n < max && pool.free[cls]) {
+      FREE_BLOCK *b = pool.free[cls];
+      pool.free[cls] = b->next;
+      b->next = list;
+      list = b;
+      n++;
+   }
+
+   while (n < max) {
+      BLOCK_HEADER *hdr;
+      FREE_BLOCK *b;
+
+      if (pool.carve_left < block_size) {
+         /* The rest of the old chunk is too small for this class and is
+          * left unused.
+          */
+         pool.carve = malloc(CHUNK_SIZE);
+         if (!pool.carve) {
+            pool.carve_left = 0;
+            break;
+         }
+         pool.carve_left = CHUNK_SIZE;
+      }
+
+      hdr = (BLOCK_HEADER *)pool.carve;
+      hdr->h.cls = cls;
+      hdr->h.magic = POOL_MAGIC;
+      pool.carve += block_size;
+      pool.carve_left -= block_size;
+
+      b = (FREE_BLOCK *)(hdr + 1);
+      b->next = list;
+      list = b;
+      n++;
+   }
+
+   _al_mutex_unlock(&pool.mutex);
+
+   return list;
+}
+
+
+static void give_blocks(int cls, FREE_BLOCK *first, FREE_BLOCK *last)
+{
+   _al_mutex_lock(&pool.mutex);
+   last->next = pool.free[cls];
+   pool.free[cls] = first;
+   _al_mutex_unlock(&pool.mutex);
+}
+
+
+#ifdef POOL_THREAD_CACHE
+static void flush_thread_cache(THREAD_CACHE *tc)
+{
+   int cls;
+
+   for (cls = 0; cls < NUM_CLASSES; cls++) {
+      FREE_BLOCK *last = tc->free[cls];
+      if (!last)
+         continue;
+      while (last->next)
+         last = last->next;
+      give_blocks(cls, tc->free[cls], last);
+      tc->free[cls] = NULL;
+      tc->count[cls] = 0;
+   }
+}
+#endif
+
+
+#ifdef POOL_PTHREAD_KEY
+static void thread_cache_dtor(void *ptr)
+{
+   flush_thread_cache(ptr);
+   free(ptr);
+}
+
+
+/* The cache can't come from al_malloc, which may be this pool.  If it
+ * can't be allocated the thread uses the shared lists.
+ */
+static THREAD_CACHE *get_thread_cache(void)
+{
+   THREAD_CACHE *tc = pthread_getspecific(thread_cache_key);
+
+   if (!tc) {
+      tc = calloc(1, sizeof(THREAD_CACHE));
+      if (tc && pthread_setspecific(thread_cache_key, tc) != 0) {
+         free(tc);
+         tc = NULL;
+      }
+   }
+   return tc;
+}
+#elif defined(POOL_THREAD_LOCAL)
+static THREAD_CACHE *get_thread_cache(void)
+{
+   return &thread_cache;
+}
+#else
+#define get_thread_cache() NULL
+#endif
+
+
+static BLOCK_HEADER *alloc_block(size_t n)
+{
+   int cls = size_class(n);
+   BLOCK_HEADER *hdr;
+   FREE_BLOCK *b;
+#ifdef POOL_THREAD_CACHE
+   THREAD_CACHE *tc;
+#endif
+
+   if (cls == LARGE_CLASS) {
+      if (n > (size_t)-1 - sizeof(BLOCK_HEADER))
+         return NULL;
+      hdr = malloc(sizeof(BLOCK_HEADER) + n);
+      if (!hdr)
+         return NULL;
+      hdr->h.cls = LARGE_CLASS;
+      hdr->h.magic = POOL_MAGIC;
+      return hdr;
+   }
+
+#ifdef POOL_THREAD_CACHE
+   tc = get_thread_cache();
+   if (tc) {
+      if (!tc->free[cls]) {
+         FREE_BLOCK *list = take_blocks(cls, CACHE_BATCH);
+         for (; list; list = b) {
+            b = list->next;
+            list->next = tc->free[cls];
+            tc->free[cls] = list;
+            tc->count[cls]++;
+         }
+         if (!tc->free[cls])
+            return NULL;
+      }
+      b = tc->free[cls];
+      tc->free[cls] = b->next;
+      tc->count[cls]--;
+      return (BLOCK_HEADER *)b - 1;
+   }
+#endif
+
+   b = take_blocks(cls, 1);
+   if (!b)
+      return NULL;
+   return (BLOCK_HEADER *)b - 1;
+}
+
+
+static void free_block(BLOCK_HEADER *hdr)
+{
+   int cls = hdr->h.cls;
+   FREE_BLOCK *b;
+#ifdef POOL_THREAD_CACHE
+   THREAD_CACHE *tc;
+#endif
+
+   if (cls == LARGE_CLASS) {
+      free(hdr);
+      return;
+   }
+
+   b = (FREE_BLOCK *)(hdr + 1);
+
+#ifdef POOL_THREAD_CACHE
+   tc = get_thread_cache();
+   if (tc) {
+      b->next = tc->free[cls];
+      tc->free[cls] = b;
+      if (++tc->count[cls] > CACHE_MAX) {
+         /* Keep the most recently freed blocks, which are likely still in
+          * the cache, and hand the older ones back.
+          */
+         FREE_BLOCK *keep = b;
+         FREE_BLOCK *first, *last;
+         int i;
+         for (i = 1; i < CACHE_MAX - CACHE_BATCH; i++)
+            keep = keep->next;
+         first = last = keep->next;
+         while (last->next)
+            last = last->next;
+         keep->next = NULL;
+         tc->count[cls] = CACHE_MAX - CACHE_BATCH;
+         give_blocks(cls, first, last);
+      }
+      return;
+   }
+#endif
+
+   b->next = NULL;
+   give_blocks(cls, b, b);
+}
+
+
+static void *pool_malloc(size_t n, int line, const char *file,
+   const char *func)
+{
+   BLOCK_HEADER *hdr = alloc_block(n);
+
+   if (!hdr)
+      return NULL;
+
+   hdr->h.size = n;
+   hdr->h.site = -1;
+   if (pool.track_sites && file) {
+      hdr->h.site = find_site(line, file, func);
+      if (hdr->h.site >= 0)
+         site_add(hdr->h.site, n);
+   }
+
+   return hdr + 1;
+}
+
+
+static void pool_free(void *ptr, int line, const char *file,
+   const char *func)
+{
+   BLOCK_HEADER *hdr;
+   (void)line;
+   (void)file;
+   (void)func;
+
+   if (!ptr)
+      return;
+
+   hdr = (BLOCK_HEADER *)ptr - 1;
+   ASSERT(hdr->h.magic == POOL_MAGIC);
+
+   if (hdr->h.site >= 0)
+      site_remove(hdr->h.site, hdr->h.size);
+
+   free_block(hdr);
+}
+
+
+static void *pool_realloc(void *ptr, size_t n, int line, const char *file,
+   const char *func)
+{
+   BLOCK_HEADER *hdr;
+   BLOCK_HEADER *new_hdr;
+
+   if (!ptr)
+      return pool_malloc(n, line, file, func);
+
+   if (n == 0) {
+      pool_free(ptr, line, file, func);
+      return NULL;
+   }
+
+   hdr = (BLOCK_HEADER *)ptr - 1;
+   ASSERT(hdr->h.magic == POOL_MAGIC);
+
+   /* The block stays with the site that first allocated it. */
+   if (hdr->h.cls != LARGE_CLASS && n <= class_sizes[hdr->h.cls]) {
+      if (hdr->h.site >= 0)
+         site_resize(hdr->h.site, hdr->h.size, n);
+      hdr->h.size = n;
+      return ptr;
+   }
+
+   if (hdr->h.cls == LARGE_CLASS && size_class(n) == LARGE_CLASS) {
+      size_t old_size = hdr->h.size;
+      if (n > (size_t)-1 - sizeof(BLOCK_HEADER))
+         return NULL;
+      new_hdr = realloc(hdr, sizeof(BLOCK_HEADER) + n);
+      if (!new_hdr)
+         return NULL;
+      new_hdr->h.size = n;
+      if (new_hdr->h.site >= 0)
+         site_resize(new_hdr->h.site, old_size, n);
+      return new_hdr + 1;
+   }
+
+   new_hdr = alloc_block(n);
+   if (!new_hdr)
+      return NULL;
+   memcpy(new_hdr + 1, ptr, _ALLEGRO_MIN(n, hdr->h.size));
+   new_hdr->h.size = n;
+   new_hdr->h.site = hdr->h.site;
+   if (hdr->h.site >= 0)
+      site_resize(hdr->h.site, hdr->h.size, n);
+   free_block(hdr);
+   return new_hdr + 1;
+}
+
+
+static void *pool_calloc(size_t count, size_t n, int line, const char *file,
+   const char *func)
+{
+   void *ptr;
+
+   if (n != 0 && count > (size_t)-1 / n)
+      return NULL;
+
+   ptr = pool_malloc(count * n, line, file, func);
+   if (ptr)
+      memset(ptr, 0, count * n);
+   return ptr;
+}
+
+
+static ALLEGRO_MEMORY_INTERFACE pool_interface = {
+   pool_malloc,
+   pool_free,
+   pool_realloc,
+   pool_calloc
+};
+
+
+/* Function: al_get_memory_pool_interface
+ */
+ALLEGRO_MEMORY_INTERFACE *al_get_memory_pool_interface(int flags)
+{
+   int i;
+
+   if (!pool.inited) {
+      int cls = 0;
+      for (i = 0; i <= 1024 / 16; i++) {
+         while (class_sizes[cls] < (size_t)i * 16)
+            cls++;
+         class_lookup[i] = cls;
+      }
+      _al_mutex_init(&pool.mutex);
+      _al_mutex_init(&sites.insert_mutex);
+      for (i = 0; i < NUM_STRIPES; i++)
+         _al_mutex_init(&sites.stripes[i]);
+#ifdef POOL_PTHREAD_KEY
+      pthread_key_create(&thread_cache_key, thread_cache_dtor);
+#endif
+      pool.inited = true;
+   }
+
+   pool.track_sites = (flags & ALLEGRO_MEMORY_POOL_TRACK_SITES) != 0;
+
+   return &pool_interface;
+}
+
+
+/* _al_flush_memory_pool_cache:
+ *  Hand the blocks cached by the calling thread back to the shared lists.
+ *  Called when an Allegro thread exits.
+ */
+void _al_flush_memory_pool_cache(void)
+{
+#if defined(POOL_PTHREAD_KEY)
+   THREAD_CACHE *tc;
+
+   /* Don't give a thread which never used the pool a cache just to
+    * flush it.
+    */
+   if (!pool.inited)
+      return;
+   tc = pthread_getspecific(thread_cache_key);
+   if (tc)
+      flush_thread_cache(tc);
+#elif defined(POOL_THREAD_LOCAL)
+   flush_thread_cache(&thread_cache);
+#endif
+}
+
+
+/* Function: al_get_num_memory_sites
+ */
+int al_get_num_memory_sites(void)
+{
+   return sites.num;
+}
+
+
+/* Function: al_get_memory_site_stats
+ */
+bool al_get_memory_site_stats(int index, ALLEGRO_MEMORY_SITE_STATS *stats)
+{
+   SITE *s;
+   _AL_MUTEX *stripe;
+
+   ASSERT(stats);
+
+   if (index < 0 || index >= sites.num)
+      return false;
+
+   s = &sites.table[sites.order[index]];
+   stripe = &sites.stripes[sites.order[index] % NUM_STRIPES];
+
+   _al_mutex_lock(stripe);
+   stats->file = s->file;
+   stats->line = s->line;
+   stats->func = s->func;
+   stats->live_bytes = s->live_bytes;
+   stats->peak_bytes = s->peak_bytes;
+   stats->live_count = s->live_count;
+   stats->total_count = s->total_count;
+   _al_mutex_unlock(stripe);
+
+   return true;
+}
+
+
+/* vim: set ts=8 sts=3 sw=3 et: */
@@ -0,0 +1,210 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Open addressing hash table with string keys.
+ *
+ *      See readme.txt for copyright information.
+ */
+
+#include <string.h>
+
+#include "allegro5/allegro.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_hash.h"
+
+#define MIN_SIZE  16
+
+
+/* Internal function: _al_hash_buffer
+ *  FNV-1a hash of a byte buffer.
+ */
+unsigned int _al_hash_buffer(const char *s, size_t size)
+{
+   unsigned int h = 2166136261u;
+   size_t i;
+
+   for (i = 0; i < size; i++) {
+      h ^= (unsigned char)s[i];
+      h *= 16777619u;
+   }
+
+   return h;
+}
+
+
+/* Internal function: _al_hash_ustr
+ */
+unsigned int _al_hash_ustr(const ALLEGRO_USTR *us)
+{
+   return _al_hash_buffer(al_cstr(us), al_ustr_size(us));
+}
+
+
+static bool keys_equal(const ALLEGRO_USTR *a, const ALLEGRO_USTR *b)
+{
+   size_t size = al_ustr_size(a);
+
+   return size == al_ustr_size(b)
+      && memcmp(al_cstr(a), al_cstr(b), size) == 0;
+}
+
+
+/* Internal function: _al_hash_init
+ */
+void _al_hash_init(_AL_HASH *h)
+{
+   h->_size = 0;
+   h->_count = 0;
+   h->_slots = NULL;
+}
+
+
+/* Internal function: _al_hash_free
+ *  Free the table itself.  Keys and values are not touched.
+ */
+void _al_hash_free(_AL_HASH *h)
+{
+   al_free(h->_slots);
+   _al_hash_init(h);
+}
+
+
+/* Internal function: _al_hash_count
+ */
+unsigned int _al_hash_count(const _AL_HASH *h)
+{
+   return h->_count;
+}
+
+
+static _AL_HASH_SLOT *lookup_slot(const _AL_HASH *h, unsigned int hash,
+   const ALLEGRO_USTR *key)
+{
+   unsigned int mask = h->_size - 1;
+   unsigned int i = hash & mask;
+
+   for (;;) {
+      _AL_HASH_SLOT *slot = &h->_slots[i];
+      if (!slot->key)
+         return slot;
+      if (slot->hash == hash && keys_equal(slot->key, key))
+         return slot;
+      i = (i + 1) & mask;
+   }
+}
+
+
+static void resize(_AL_HASH *h, unsigned int new_size)
+{
+   _AL_HASH_SLOT *old_slots = h->_slots;
+   unsigned int old_size = h->_size;
+   unsigned int i;
+
+   h->_slots = al_calloc(new_size, sizeof(_AL_HASH_SLOT));
+   h->_size = new_size;
+
+   for (i = 0; i < old_size; i++) {
+      _AL_HASH_SLOT *old = &old_slots[i];
+      if (old->key) {
+         *lookup_slot(h, old->hash, old->key) = *old;
+      }
+   }
+
+   al_free(old_slots);
+}
+
+
+/* Internal function: _al_hash_find
+ *  Return the value stored under the key, or NULL.
+ */
+void *_al_hash_find(const _AL_HASH *h, unsigned int hash,
+   const ALLEGRO_USTR *key)
+{
+   if (h->_count == 0)
+      return NULL;
+   return lookup_slot(h, hash, key)->value;
+}
+
+
+/* Internal function: _al_hash_insert
+ *  Store a value under the key, replacing any previous value.
+ */
+void _al_hash_insert(_AL_HASH *h, unsigned int hash,
+   const ALLEGRO_USTR *key, void *value)
+{
+   _AL_HASH_SLOT *slot;
+
+   ASSERT(key);
+
+   /* Keep the load factor under 3/4. */
+   if ((h->_count + 1) * 4 > h->_size * 3) {
+      resize(h, h->_size ? h->_size * 2 : MIN_SIZE);
+   }
+
+   slot = lookup_slot(h, hash, key);
+   if (!slot->key)
+      h->_count++;
+   slot->hash = hash;
+   slot->key = key;
+   slot->value = value;
+}
+
+
+/* Internal function: _al_hash_remove
+ *  Remove the key from the table, returning the value it had, or NULL.
+ */
+void *_al_hash_remove(_AL_HASH *h, unsigned int hash,
+   const ALLEGRO_USTR *key)
+{
+   unsigned int mask;
+   unsigned int i, j;
+   void *value;
+   _AL_HASH_SLOT *slot;
+
+   if (h->_count == 0)
+      return NULL;
+
+   slot = lookup_slot(h, hash, key);
+   if (!slot->key)
+      return NULL;
+
+   value = slot->value;
+   h->_count--;
+
+   /* Shift back any following entries which would no longer be reachable
+    * through the hole, so no tombstones are needed.
+    */
+   mask = h->_size - 1;
+   i = slot - h->_slots;
+   j = i;
+   for (;;) {
+      unsigned int home;
+
+      h->_slots[i].key = NULL;
+      h->_slots[i].value = NULL;
+
+      for (;;) {
+         j = (j + 1) & mask;
+         if (!h->_slots[j].key)
+            return value;
+         home = h->_slots[j].hash & mask;
+         /* Can the entry at j move to i?  Only if its home slot does not
+          * lie cyclically in (i, j].
+          */
+         if (i <= j ? (home <= i || home > j) : (home <= i && home > j))
+            break;
+      }
+
+      h->_slots[i] = h->_slots[j];
+      i = j;
+   }
+}
+
+/* vim: set sts=3 sw=3 et: */
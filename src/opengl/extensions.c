@@ -947,6 +947,10 @@ ALLEGRO_OGL_EXT_LIST *al_get_opengl_extension_list(void)
 
 void _al_ogl_unmanage_extensions(ALLEGRO_DISPLAY *gl_disp)
 {
+#ifndef ALLEGRO_CFG_OPENGLES
+   _al_ogl_destroy_upload_buffers(gl_disp);
+#endif
+
    destroy_extension_api_table(gl_disp->ogl_extras->extension_api);
    destroy_extension_list(gl_disp->ogl_extras->extension_list);
    gl_disp->ogl_extras->extension_api = NULL;
@@ -954,6 +954,9 @@ static ALLEGRO_BITMAP_INTERFACE *ogl_bitmap_driver(void)
 #else
    glbmp_vt.lock_region = _al_ogl_lock_region_new;
    glbmp_vt.unlock_region = _al_ogl_unlock_region_new;
+   glbmp_vt.lock_region_async = _al_ogl_lock_region_async;
+   glbmp_vt.poll_async_lock = _al_ogl_poll_async_lock;
+   glbmp_vt.release_async_lock = _al_ogl_release_async_lock;
 #endif
    glbmp_vt.lock_compressed_region = ogl_lock_compressed_region;
    glbmp_vt.unlock_compressed_region = ogl_unlock_compressed_region;
@@ -1193,16 +1196,79 @@ void al_get_opengl_texture_position(ALLEGRO_BITMAP *bitmap, int *u, int *v)
    *v = bitmap->yofs;
 }
 
+/* _al_ogl_count_transfer:
+ *  Account for pixel data moved between a bitmap's texture and system
+ *  memory.
+ */
+void _al_ogl_count_transfer(ALLEGRO_BITMAP *bitmap, int bytes_read,
+   int bytes_written)
+{
+   ALLEGRO_DISPLAY *disp = _al_get_bitmap_display(bitmap);
+
+   if (disp && disp->ogl_extras) {
+      disp->ogl_extras->bytes_read += bytes_read;
+      disp->ogl_extras->bytes_written += bytes_written;
+   }
+}
+
+/* Function: al_get_opengl_transfer_counters
+ */
+void al_get_opengl_transfer_counters(ALLEGRO_DISPLAY *display,
+   uint64_t *bytes_read, uint64_t *bytes_written)
+{
+   ASSERT(display);
+
+   if (bytes_read)
+      *bytes_read = display->ogl_extras ? display->ogl_extras->bytes_read : 0;
+   if (bytes_written)
+      *bytes_written = display->ogl_extras ? display->ogl_extras->bytes_written : 0;
+}
+
+/* backup_region:
+ *  Copy a region of a video bitmap back into its memory copy.
+ */
+static bool backup_region(ALLEGRO_BITMAP *b, int x, int y, int w, int h,
+   bool flip)
+{
+   ALLEGRO_LOCKED_REGION *lr;
+   int line_size;
+   int pixel_size;
+   int i;
+
+   lr = al_lock_bitmap_region(b, x, y, w, h,
+      _al_get_bitmap_memory_format(b), ALLEGRO_LOCK_READONLY);
+   if (!lr)
+      return false;
+
+   pixel_size = al_get_pixel_size(lr->format);
+   line_size = pixel_size * b->w;
+   for (i = 0; i < h; i++) {
+      unsigned char *p = ((unsigned char *)lr->data) + lr->pitch * i;
+      unsigned char *p2;
+      if (flip) {
+         p2 = ((unsigned char *)b->memory) + line_size * (b->h-1-(y+i));
+      }
+      else {
+         p2 = ((unsigned char *)b->memory) + line_size * (y+i);
+      }
+      memcpy(p2 + pixel_size * x, p, pixel_size * w);
+   }
+   al_unlock_bitmap(b);
+   return true;
+}
+
 void _al_opengl_backup_dirty_bitmaps(ALLEGRO_DISPLAY *d, bool flip)
 {
-   int i, y;
+   int i;
 
    for (i = 0; i < (int)d->bitmaps._size; i++) {
       ALLEGRO_BITMAP **bptr = (ALLEGRO_BITMAP **)_al_vector_ref(&d->bitmaps, i);
       ALLEGRO_BITMAP *b = *bptr;
       ALLEGRO_BITMAP_EXTRA_OPENGL *ogl_bitmap = b->extra;
-      ALLEGRO_LOCKED_REGION *lr;
       int bitmap_flags = al_get_bitmap_flags(b);
+      bool ok = true;
+      int tx, ty;
+      int across, down;
       if (b->parent)
          continue;
       if ((bitmap_flags & ALLEGRO_MEMORY_BITMAP) ||
@@ -1211,26 +1277,38 @@ void _al_opengl_backup_dirty_bitmaps(ALLEGRO_DISPLAY *d, bool flip)
          ogl_bitmap->is_backbuffer)
          continue;
       ALLEGRO_DEBUG("Backing up dirty bitmap %p\n", b);
-      lr = al_lock_bitmap(
-         b,
-         _al_get_bitmap_memory_format(b),
-         ALLEGRO_LOCK_READONLY
-      );
-      if (lr) {
-         int line_size = al_get_pixel_size(lr->format) * b->w;
-         for (y = 0; y < b->h; y++) {
-            unsigned char *p = ((unsigned char *)lr->data) + lr->pitch * y;
-            unsigned char *p2;
-            if (flip) {
-               p2 = ((unsigned char *)b->memory) + line_size * (b->h-1-y);
-            }
-            else {
-               p2 = ((unsigned char *)b->memory) + line_size * y;
+
+      if (!b->dirty_tiles) {
+         ok = backup_region(b, 0, 0, b->w, b->h, flip);
+      }
+      else {
+         /* Only read back the dirty tiles, merging horizontal runs of
+          * them into a single lock.
+          */
+         across = (b->w + _AL_DIRTY_TILE_SIZE - 1) / _AL_DIRTY_TILE_SIZE;
+         down = (b->h + _AL_DIRTY_TILE_SIZE - 1) / _AL_DIRTY_TILE_SIZE;
+         for (ty = 0; ty < down && ok; ty++) {
+            int y = ty * _AL_DIRTY_TILE_SIZE;
+            int h = _ALLEGRO_MIN(_AL_DIRTY_TILE_SIZE, b->h - y);
+            tx = 0;
+            while (tx < across && ok) {
+               int start, x, w;
+               if (!_al_is_bitmap_tile_dirty(b, tx, ty)) {
+                  tx++;
+                  continue;
+               }
+               start = tx;
+               while (tx < across && _al_is_bitmap_tile_dirty(b, tx, ty))
+                  tx++;
+               x = start * _AL_DIRTY_TILE_SIZE;
+               w = _ALLEGRO_MIN(tx * _AL_DIRTY_TILE_SIZE, b->w) - x;
+               ok = backup_region(b, x, y, w, h, flip);
             }
-            memcpy(p2, p, line_size);
          }
-         al_unlock_bitmap(b);
-         b->dirty = false;
+      }
+
+      if (ok) {
+         _al_mark_bitmap_clean(b);
       }
       else {
          ALLEGRO_WARN("Failed to lock dirty bitmap %p\n", b);
@@ -18,6 +18,7 @@
 #include "allegro5/internal/aintern_display.h"
 #include "allegro5/internal/aintern_memdraw.h"
 #include "allegro5/internal/aintern_opengl.h"
+#include "allegro5/internal/aintern_profile.h"
 
 #ifdef ALLEGRO_ANDROID
 #include "allegro5/internal/aintern_android.h"
@@ -352,10 +353,14 @@ static void* ogl_prepare_vertex_cache(ALLEGRO_DISPLAY* disp,
          (disp->num_cache_vertices - num_new_vertices);
 }
 
+_AL_PROFILE_ZONE(flush_zone, "opengl/flush_vertex_cache");
+_AL_PROFILE_COUNTER(flushed_vertices_counter, "opengl/flushed_vertices");
+
 static void ogl_flush_vertex_cache(ALLEGRO_DISPLAY *disp)
 {
    GLuint current_texture;
    ALLEGRO_OGL_EXTRAS *o = disp->ogl_extras;
+   _AL_PROFILE_DECL(flush_zone);
    (void)o; /* not used in all ports */
    
    if (!disp->vertex_cache)
@@ -363,6 +368,9 @@ static void ogl_flush_vertex_cache(ALLEGRO_DISPLAY *disp)
    if (disp->num_cache_vertices == 0)
       return;
 
+   _AL_PROFILE_BEGIN(flush_zone);
+   _AL_PROFILE_ADD(flushed_vertices_counter, disp->num_cache_vertices);
+
    if (disp->flags & ALLEGRO_PROGRAMMABLE_PIPELINE) {
 #ifdef ALLEGRO_CFG_OPENGL_PROGRAMMABLE_PIPELINE
       if (disp->ogl_extras->varlocs.use_tex_loc >= 0) {
@@ -488,6 +496,8 @@ static void ogl_flush_vertex_cache(ALLEGRO_DISPLAY *disp)
    else {
       glDisable(GL_TEXTURE_2D);
    }
+
+   _AL_PROFILE_END(flush_zone);
 }
 
 static void ogl_update_transformation(ALLEGRO_DISPLAY* disp,
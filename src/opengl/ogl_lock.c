@@ -89,6 +89,8 @@ static bool ogl_lock_region_nonbb_readwrite_fbo(
 static bool ogl_lock_region_nonbb_readwrite_nonfbo(
    ALLEGRO_BITMAP *bitmap, ALLEGRO_BITMAP_EXTRA_OPENGL *ogl_bitmap,
    int x, int gl_y, int w, int h, int format);
+static void ogl_restore_fbo(ALLEGRO_BITMAP *bitmap, ALLEGRO_BITMAP *old_target,
+   bool fbo_was_set);
 
 
 ALLEGRO_LOCKED_REGION *_al_ogl_lock_region_new(ALLEGRO_BITMAP *bitmap,
@@ -171,6 +173,10 @@ ALLEGRO_LOCKED_REGION *_al_ogl_lock_region_new(ALLEGRO_BITMAP *bitmap,
    }
 
    if (ok) {
+      if (!(flags & ALLEGRO_LOCK_WRITEONLY)) {
+         _al_ogl_count_transfer(bitmap,
+            w * h * bitmap->locked_region.pixel_size, 0);
+      }
       return &bitmap->locked_region;
    }
 
@@ -266,7 +272,16 @@ static bool ogl_lock_region_nonbb_readwrite(
          x, gl_y, w, h, format);
    }
 
-   /* Restore state after switching FBO. */
+   ogl_restore_fbo(bitmap, old_target, fbo_was_set);
+
+   return ok;
+}
+
+
+/* Restore state after switching FBO. */
+static void ogl_restore_fbo(ALLEGRO_BITMAP *bitmap, ALLEGRO_BITMAP *old_target,
+   bool fbo_was_set)
+{
    if (fbo_was_set) {
       if (!old_target) {
          /* Old target was NULL; release the context. */
@@ -282,8 +297,6 @@ static bool ogl_lock_region_nonbb_readwrite(
    }
 
    ASSERT(al_get_target_bitmap() == old_target);
-
-   return ok;
 }
 
 
@@ -396,6 +409,216 @@ static bool ogl_lock_region_nonbb_readwrite_nonfbo(
 
 
 
+/*
+ * Asynchronous locking
+ *
+ * The pixels are read into a pixel buffer object and a fence is inserted
+ * after the read, so the caller can carry on until the fence has passed and
+ * only then map the buffer.
+ */
+
+typedef struct OGL_ASYNC_LOCK
+{
+   GLuint pbo;
+   GLsync fence;
+   void *mapped;
+} OGL_ASYNC_LOCK;
+
+
+/* Change OpenGL context if necessary, returning the display to restore. */
+static ALLEGRO_DISPLAY *ogl_enter_bitmap_context(ALLEGRO_BITMAP *bitmap)
+{
+   ALLEGRO_DISPLAY *disp = al_get_current_display();
+
+   if (!disp ||
+      (_al_get_bitmap_display(bitmap)->ogl_extras->is_shared == false &&
+       _al_get_bitmap_display(bitmap) != disp))
+   {
+      _al_set_current_display_only(_al_get_bitmap_display(bitmap));
+      return disp;
+   }
+   return NULL;
+}
+
+
+static bool ogl_read_pixels_to_pbo(OGL_ASYNC_LOCK *ogl_lock,
+   int x, int gl_y, int w, int h, int format)
+{
+   const int pixel_size = al_get_pixel_size(format);
+   const int pitch = ogl_pitch(w, pixel_size);
+   GLenum e;
+
+   glGenBuffers(1, &ogl_lock->pbo);
+   glBindBuffer(GL_PIXEL_PACK_BUFFER, ogl_lock->pbo);
+   glBufferData(GL_PIXEL_PACK_BUFFER, pitch * h, NULL, GL_STREAM_READ);
+   glReadPixels(x, gl_y, w, h,
+      get_glformat(format, 2),
+      get_glformat(format, 1),
+      NULL);
+   glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+   e = glGetError();
+   if (e) {
+      ALLEGRO_ERROR("glReadPixels into PBO for format %s failed (%s).\n",
+         _al_pixel_format_name(format), _al_gl_error_string(e));
+      glDeleteBuffers(1, &ogl_lock->pbo);
+      return false;
+   }
+
+   ogl_lock->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+   glFlush();
+   return true;
+}
+
+
+bool _al_ogl_lock_region_async(ALLEGRO_BITMAP *bitmap,
+   ALLEGRO_ASYNC_LOCK *lock)
+{
+   ALLEGRO_BITMAP_EXTRA_OPENGL * const ogl_bitmap = bitmap->extra;
+   ALLEGRO_DISPLAY *display = _al_get_bitmap_display(bitmap);
+   ALLEGRO_OGL_EXT_LIST *ext = display->ogl_extras->extension_list;
+   const GLint gl_y = bitmap->h - lock->y - lock->h;
+   int bitmap_format = al_get_bitmap_format(bitmap);
+   int format = lock->format;
+   OGL_ASYNC_LOCK *ogl_lock;
+   ALLEGRO_DISPLAY *old_disp;
+   bool ok;
+
+   if (!ext->ALLEGRO_GL_ARB_pixel_buffer_object || !ext->ALLEGRO_GL_ARB_sync)
+      return false;
+   if (_al_pixel_format_is_compressed(bitmap_format))
+      return false;
+   if (lock->w == 0 || lock->h == 0)
+      return false;
+
+   if (format == ALLEGRO_PIXEL_FORMAT_ANY)
+      format = bitmap_format;
+   format = _al_get_real_pixel_format(display, format);
+
+   ogl_lock = al_calloc(1, sizeof *ogl_lock);
+   if (!ogl_lock)
+      return false;
+
+   old_disp = ogl_enter_bitmap_context(bitmap);
+
+   glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
+   glPixelStorei(GL_PACK_ALIGNMENT,
+      ogl_pixel_alignment(al_get_pixel_size(format)));
+
+   if (ogl_bitmap->is_backbuffer) {
+      ALLEGRO_DEBUG("Async locking backbuffer\n");
+      ok = ogl_read_pixels_to_pbo(ogl_lock, lock->x, gl_y, lock->w, lock->h,
+         format);
+   }
+   else {
+      ALLEGRO_BITMAP *old_target = al_get_target_bitmap();
+      bool fbo_was_set = _al_ogl_setup_fbo_non_backbuffer(display, bitmap);
+      GLint old_fbo;
+
+      if (ogl_bitmap->fbo_info) {
+         ALLEGRO_DEBUG("Async locking non-backbuffer with fbo\n");
+         glGetIntegerv(GL_FRAMEBUFFER_BINDING_EXT, &old_fbo);
+         glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, ogl_bitmap->fbo_info->fbo);
+         ok = ogl_read_pixels_to_pbo(ogl_lock, lock->x, gl_y, lock->w,
+            lock->h, format);
+         glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, old_fbo);
+      }
+      else {
+         ok = false;
+      }
+
+      ogl_restore_fbo(bitmap, old_target, fbo_was_set);
+   }
+
+   glPopClientAttrib();
+
+   if (old_disp != NULL) {
+      _al_set_current_display_only(old_disp);
+   }
+
+   if (!ok) {
+      al_free(ogl_lock);
+      return false;
+   }
+
+   _al_ogl_count_transfer(bitmap,
+      lock->w * lock->h * al_get_pixel_size(format), 0);
+
+   lock->format = format;
+   lock->extra = ogl_lock;
+   return true;
+}
+
+
+bool _al_ogl_poll_async_lock(ALLEGRO_ASYNC_LOCK *lock, bool wait)
+{
+   OGL_ASYNC_LOCK *ogl_lock = lock->extra;
+   const int pixel_size = al_get_pixel_size(lock->format);
+   const int pitch = ogl_pitch(lock->w, pixel_size);
+   ALLEGRO_DISPLAY *old_disp;
+   GLenum status;
+   bool ok = false;
+
+   old_disp = ogl_enter_bitmap_context(lock->bitmap);
+
+   do {
+      status = glClientWaitSync(ogl_lock->fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+         wait ? 1000000000 : 0);
+   } while (wait && status == GL_TIMEOUT_EXPIRED);
+
+   if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) {
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, ogl_lock->pbo);
+      ogl_lock->mapped = glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+      if (ogl_lock->mapped) {
+         lock->region.data = (char *)ogl_lock->mapped + pitch * (lock->h - 1);
+         lock->region.format = lock->format;
+         lock->region.pitch = -pitch;
+         lock->region.pixel_size = pixel_size;
+         ok = true;
+      }
+      else {
+         ALLEGRO_ERROR("glMapBuffer failed (%s).\n",
+            _al_gl_error_string(glGetError()));
+      }
+   }
+   else if (status == GL_WAIT_FAILED) {
+      ALLEGRO_ERROR("glClientWaitSync failed (%s).\n",
+         _al_gl_error_string(glGetError()));
+   }
+
+   if (old_disp != NULL) {
+      _al_set_current_display_only(old_disp);
+   }
+
+   return ok;
+}
+
+
+void _al_ogl_release_async_lock(ALLEGRO_ASYNC_LOCK *lock)
+{
+   OGL_ASYNC_LOCK *ogl_lock = lock->extra;
+   ALLEGRO_DISPLAY *old_disp;
+
+   old_disp = ogl_enter_bitmap_context(lock->bitmap);
+
+   if (ogl_lock->mapped) {
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, ogl_lock->pbo);
+      glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+   }
+   glDeleteBuffers(1, &ogl_lock->pbo);
+   glDeleteSync(ogl_lock->fence);
+
+   if (old_disp != NULL) {
+      _al_set_current_display_only(old_disp);
+   }
+
+   al_free(ogl_lock);
+   lock->extra = NULL;
+}
+
+
+
 /*
  * Unlocking
  */
@@ -423,6 +646,8 @@ void _al_ogl_unlock_region_new(ALLEGRO_BITMAP *bitmap)
    }
    else {
       ogl_unlock_region_non_readonly(bitmap, ogl_bitmap);
+      _al_ogl_count_transfer(bitmap, 0,
+         bitmap->lock_w * bitmap->lock_h * bitmap->locked_region.pixel_size);
    }
 
    al_free(ogl_bitmap->lock_buffer);
@@ -574,6 +799,68 @@ static void ogl_unlock_region_backbuffer(ALLEGRO_BITMAP *bitmap,
 }
 
 
+/* Map the next of the display's two upload buffers for writing, leaving it
+ * bound to GL_PIXEL_UNPACK_BUFFER.  Alternating between two buffers (and
+ * orphaning the old storage) means an upload never has to wait for the
+ * previous one to be consumed.  Returns NULL if PBOs are not available.
+ */
+static unsigned char *ogl_map_upload_buffer(ALLEGRO_DISPLAY *display,
+   int size)
+{
+   ALLEGRO_OGL_EXTRAS *ogl = display->ogl_extras;
+   GLuint *pbo;
+   void *ptr;
+
+   if (!ogl->extension_list->ALLEGRO_GL_ARB_pixel_buffer_object)
+      return NULL;
+
+   pbo = &ogl->upload_pbo[ogl->upload_pbo_index];
+   ogl->upload_pbo_index ^= 1;
+
+   if (*pbo == 0) {
+      glGenBuffers(1, pbo);
+   }
+   glBindBuffer(GL_PIXEL_UNPACK_BUFFER, *pbo);
+   glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+   ptr = glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+   if (!ptr) {
+      ALLEGRO_WARN("glMapBuffer for upload failed (%s).\n",
+         _al_gl_error_string(glGetError()));
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+   }
+   return ptr;
+}
+
+
+/* Delete the display's upload buffers, if any were created.  This is
+ * called while the display is being destroyed, when its context is no
+ * longer current.
+ */
+void _al_ogl_destroy_upload_buffers(ALLEGRO_DISPLAY *display)
+{
+   ALLEGRO_OGL_EXTRAS *ogl = display->ogl_extras;
+   ALLEGRO_DISPLAY *old_disp;
+   int i;
+
+   if (ogl->upload_pbo[0] == 0 && ogl->upload_pbo[1] == 0)
+      return;
+
+   old_disp = al_get_current_display();
+   if (old_disp != display)
+      _al_set_current_display_only(display);
+
+   for (i = 0; i < 2; i++) {
+      if (ogl->upload_pbo[i] != 0) {
+         glDeleteBuffers(1, &ogl->upload_pbo[i]);
+         ogl->upload_pbo[i] = 0;
+      }
+   }
+
+   if (old_disp != display)
+      _al_set_current_display_only(old_disp);
+}
+
+
 static void ogl_unlock_region_nonbb_fbo(ALLEGRO_BITMAP *bitmap,
    ALLEGRO_BITMAP_EXTRA_OPENGL *ogl_bitmap, int gl_y, int orig_format)
 {
@@ -595,19 +882,34 @@ static void ogl_unlock_region_nonbb_fbo_writeonly(ALLEGRO_BITMAP *bitmap,
    const int lock_format = bitmap->locked_region.format;
    const int orig_pixel_size = al_get_pixel_size(orig_format);
    const int dst_pitch = bitmap->lock_w * orig_pixel_size;
-   unsigned char * const tmpbuf = al_malloc(dst_pitch * bitmap->lock_h);
+   unsigned char *upload;
+   unsigned char *tmpbuf = NULL;
    GLenum e;
 
+   /* Convert straight into a pixel buffer object when we can, so
+    * glTexSubImage2D returns without waiting for the copy.
+    */
+   upload = ogl_map_upload_buffer(_al_get_bitmap_display(bitmap),
+      dst_pitch * bitmap->lock_h);
+   if (!upload) {
+      tmpbuf = al_malloc(dst_pitch * bitmap->lock_h);
+      upload = tmpbuf;
+   }
+
    _al_convert_bitmap_data(
       ogl_bitmap->lock_buffer,
       bitmap->locked_region.format,
       -bitmap->locked_region.pitch,
-      tmpbuf,
+      upload,
       orig_format,
       dst_pitch,
       0, 0, 0, 0,
       bitmap->lock_w, bitmap->lock_h);
 
+   if (!tmpbuf) {
+      glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+   }
+
    glTexSubImage2D(GL_TEXTURE_2D, 0,
       bitmap->lock_x, gl_y,
       bitmap->lock_w, bitmap->lock_h,
@@ -620,6 +922,9 @@ static void ogl_unlock_region_nonbb_fbo_writeonly(ALLEGRO_BITMAP *bitmap,
          lock_format, _al_gl_error_string(e));
    }
 
+   if (!tmpbuf) {
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+   }
    al_free(tmpbuf);
 }
 
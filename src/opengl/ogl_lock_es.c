@@ -93,6 +93,7 @@ ALLEGRO_LOCKED_REGION *_al_ogl_lock_region_gles(ALLEGRO_BITMAP *bitmap,
 {
    ALLEGRO_BITMAP_EXTRA_OPENGL * const ogl_bitmap = bitmap->extra;
    ALLEGRO_DISPLAY *disp;
+   ALLEGRO_LOCKED_REGION *lr;
    int real_format;
 
    if (format == ALLEGRO_PIXEL_FORMAT_ANY) {
@@ -113,16 +114,22 @@ ALLEGRO_LOCKED_REGION *_al_ogl_lock_region_gles(ALLEGRO_BITMAP *bitmap,
 
    if (ogl_bitmap->is_backbuffer) {
       if (flags & ALLEGRO_LOCK_READONLY) {
-         return ogl_lock_region_bb_readonly(bitmap, x, y, w, h, real_format);
+         lr = ogl_lock_region_bb_readonly(bitmap, x, y, w, h, real_format);
       }
       else {
-         return ogl_lock_region_bb_proxy(bitmap, x, y, w, h, real_format,
+         lr = ogl_lock_region_bb_proxy(bitmap, x, y, w, h, real_format,
             flags);
       }
    }
    else {
-      return ogl_lock_region_nonbb(bitmap, x, y, w, h, real_format, flags);
+      lr = ogl_lock_region_nonbb(bitmap, x, y, w, h, real_format, flags);
+   }
+
+   if (lr && !(flags & ALLEGRO_LOCK_WRITEONLY)) {
+      _al_ogl_count_transfer(bitmap, w * h * lr->pixel_size, 0);
    }
+
+   return lr;
 }
 
 
@@ -462,9 +469,12 @@ void _al_ogl_unlock_region_gles(ALLEGRO_BITMAP *bitmap)
       ASSERT(ogl_bitmap->lock_proxy == NULL);
    }
    else if (ogl_bitmap->lock_proxy != NULL) {
+      /* The upload is counted when unlocking the proxy. */
       ogl_unlock_region_bb_proxy(bitmap, ogl_bitmap);
    }
    else {
+      _al_ogl_count_transfer(bitmap, 0,
+         bitmap->lock_w * bitmap->lock_h * bitmap->locked_region.pixel_size);
       ogl_unlock_region_nonbb(bitmap, ogl_bitmap);
    }
 
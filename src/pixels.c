@@ -332,9 +332,9 @@ static bool format_is_video_only[ALLEGRO_NUM_PIXEL_FORMATS] =
    false, /* ALLEGRO_PIXEL_FORMAT_ABGR_LE */
    false, /* ALLEGRO_PIXEL_FORMAT_RGBA_4444 */
    false, /* ALLEGRO_PIXEL_FORMAT_SINGLE_CHANNEL_8 */
-   true,
-   true,
-   true,
+   false, /* ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT1 */
+   false, /* ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT3 */
+   false, /* ALLEGRO_PIXEL_FORMAT_COMPRESSED_RGBA_DXT5 */
 };
 
 static bool format_is_compressed[ALLEGRO_NUM_PIXEL_FORMATS] =
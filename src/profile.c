@@ -0,0 +1,641 @@
+/*         ______   ___    ___
+ *        /\  _  \ /\_ \  /\_ \
+ *        \ \ \L\ \\//\ \ \//\ \      __     __   _ __   ___
+ *         \ \  __ \ \ \ \  \ \ \   /'__`\ /'_ `\/\`'__\/ __`\
+ *          \ \ \/\ \ \_\ \_ \_\ \_/\  __//\ \L\ \ \ \//\ \L\ \
+ *           \ \_\ \_\/\____\/\____\ \____\ \____ \ \_\\ \____/
+ *            \/_/\/_/\/____/\/____/\/____/\/___L\ \/_/ \/___/
+ *                                           /\____/
+ *                                           \_/__/
+ *
+ *      Built-in profiling counters and zones.
+ *
+ *      See readme.txt for copyright information.
+ */
+
+/* Title: Profiling
+ */
+
+
+#include "allegro5/allegro.h"
+#include "allegro5/profile.h"
+#include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_exitfunc.h"
+#include "allegro5/internal/aintern_profile.h"
+#include "allegro5/internal/aintern_system.h"
+#include "allegro5/internal/aintern_thread.h"
+#include "allegro5/internal/aintern_tls.h"
+#include "allegro5/internal/aintern_vector.h"
+
+ALLEGRO_DEBUG_CHANNEL("profile")
+
+
+#ifdef ALLEGRO_CFG_PROFILING
+
+/* Zone exits a thread may record between two flushes of the trace file.
+ * Any more are dropped rather than stalling the instrumented thread.
+ */
+#define MAX_TRACE_EVENTS   8192
+
+typedef struct TRACE_EVENT {
+   _AL_PROFILE_ENTRY *zone;
+   double start;
+   double duration;
+} TRACE_EVENT;
+
+typedef struct ZONE_STATS {
+   int64_t count;
+   double total_time;
+   double max_time;
+} ZONE_STATS;
+
+/* Statistics and trace events are gathered per thread, so instrumented
+ * threads only take their own mutex, which is contended just while the
+ * statistics are read or the trace is flushed.  The buffers of a thread are
+ * kept until the profiler is shut down, since its statistics still count
+ * after it exits.
+ */
+typedef struct PROFILE_THREAD {
+   _AL_MUTEX mutex;
+   int id;
+   _AL_VECTOR stats;       /* ZONE_STATS, by zone index */
+   TRACE_EVENT *block;     /* events and spare, allocated while tracing */
+   TRACE_EVENT *events;    /* being filled by the thread */
+   TRACE_EVENT *spare;     /* being written by the trace thread */
+   int num_events;
+   int num_dropped;
+} PROFILE_THREAD;
+
+/* profile_mutex protects the lists of zones and threads, and the trace
+ * state other than the per-thread buffers.
+ */
+static bool profile_inited = false;
+static int profile_generation = 0;
+static _AL_MUTEX profile_mutex = _AL_MUTEX_UNINITED;
+static _AL_VECTOR profile_zones = _AL_VECTOR_INITIALIZER(_AL_PROFILE_ENTRY *);
+static _AL_VECTOR profile_threads = _AL_VECTOR_INITIALIZER(PROFILE_THREAD *);
+static volatile bool trace_active = false;
+
+static struct {
+   ALLEGRO_FILE *file;
+   double interval;
+   bool first;
+   _AL_THREAD thread;
+   _AL_COND cond;
+} trace;
+
+
+static void register_zone(_AL_PROFILE_ENTRY *zone)
+{
+   _al_mutex_lock(&profile_mutex);
+   if (zone->index < 0) {
+      _AL_PROFILE_ENTRY **slot = _al_vector_alloc_back(&profile_zones);
+      *slot = zone;
+      zone->index = _al_vector_size(&profile_zones) - 1;
+   }
+   _al_mutex_unlock(&profile_mutex);
+}
+
+
+/* Returns the buffers of the calling thread, creating them on first use,
+ * or NULL if there is no thread local storage.
+ */
+static PROFILE_THREAD *get_profile_thread(void)
+{
+   void **slot = _al_tls_get_profile_thread(profile_generation);
+   PROFILE_THREAD *t;
+
+   if (!slot)
+      return NULL;
+   if (*slot)
+      return *slot;
+
+   t = al_calloc(1, sizeof *t);
+   if (!t)
+      return NULL;
+   _al_mutex_init(&t->mutex);
+   _al_vector_init(&t->stats, sizeof(ZONE_STATS));
+
+   _al_mutex_lock(&profile_mutex);
+   {
+      PROFILE_THREAD **tp = _al_vector_alloc_back(&profile_threads);
+      *tp = t;
+      t->id = _al_vector_size(&profile_threads);
+   }
+   _al_mutex_unlock(&profile_mutex);
+
+   *slot = t;
+   return t;
+}
+
+
+/* Must be called with t->mutex held. */
+static ZONE_STATS *get_zone_stats(PROFILE_THREAD *t, int index)
+{
+   while ((int)_al_vector_size(&t->stats) <= index) {
+      ZONE_STATS *st = _al_vector_alloc_back(&t->stats);
+      st->count = 0;
+      st->total_time = 0.0;
+      st->max_time = 0.0;
+   }
+   return _al_vector_ref(&t->stats, index);
+}
+
+
+/* Must be called with t->mutex held. */
+static void record_event(PROFILE_THREAD *t, _AL_PROFILE_ENTRY *zone,
+   double start, double duration)
+{
+   TRACE_EVENT *ev;
+
+   if (!t->block) {
+      t->block = al_malloc(2 * MAX_TRACE_EVENTS * sizeof(TRACE_EVENT));
+      if (!t->block) {
+         t->num_dropped++;
+         return;
+      }
+      t->events = t->block;
+      t->spare = t->block + MAX_TRACE_EVENTS;
+      t->num_events = 0;
+   }
+   if (t->num_events == MAX_TRACE_EVENTS) {
+      t->num_dropped++;
+      return;
+   }
+
+   ev = &t->events[t->num_events++];
+   ev->zone = zone;
+   ev->start = start;
+   ev->duration = duration;
+}
+
+
+/* _al_profile_begin:
+ *  Return the start time to pass to _al_profile_end.
+ */
+double _al_profile_begin(_AL_PROFILE_ENTRY *zone)
+{
+   (void)zone;
+   return al_get_time();
+}
+
+
+/* _al_profile_end:
+ *  Account the time since start to the zone, and record it in the trace.
+ */
+void _al_profile_end(_AL_PROFILE_ENTRY *zone, double start)
+{
+   double duration = al_get_time() - start;
+   PROFILE_THREAD *t;
+   ZONE_STATS *st;
+
+   if (!profile_inited)
+      return;
+
+   if (zone->index < 0)
+      register_zone(zone);
+   t = get_profile_thread();
+   if (!t)
+      return;
+
+   _al_mutex_lock(&t->mutex);
+
+   st = get_zone_stats(t, zone->index);
+   st->count++;
+   st->total_time += duration;
+   if (duration > st->max_time)
+      st->max_time = duration;
+
+   if (trace_active)
+      record_event(t, zone, start, duration);
+
+   _al_mutex_unlock(&t->mutex);
+}
+
+
+/* _al_profile_add:
+ *  Add n to a counter.
+ */
+void _al_profile_add(_AL_PROFILE_ENTRY *zone, int64_t n)
+{
+   PROFILE_THREAD *t;
+
+   if (!profile_inited)
+      return;
+
+   if (zone->index < 0)
+      register_zone(zone);
+   t = get_profile_thread();
+   if (!t)
+      return;
+
+   _al_mutex_lock(&t->mutex);
+   get_zone_stats(t, zone->index)->count += n;
+   _al_mutex_unlock(&t->mutex);
+}
+
+
+/* Threads and zones are only ever appended until shutdown, so the entries
+ * stay valid once the lock is released.
+ */
+static PROFILE_THREAD *get_thread_at(unsigned int i)
+{
+   PROFILE_THREAD *t = NULL;
+
+   _al_mutex_lock(&profile_mutex);
+   if (i < _al_vector_size(&profile_threads))
+      t = *(PROFILE_THREAD **)_al_vector_ref(&profile_threads, i);
+   _al_mutex_unlock(&profile_mutex);
+
+   return t;
+}
+
+
+static _AL_PROFILE_ENTRY *get_zone_at(unsigned int i)
+{
+   _AL_PROFILE_ENTRY *zone = NULL;
+
+   _al_mutex_lock(&profile_mutex);
+   if (i < _al_vector_size(&profile_zones))
+      zone = *(_AL_PROFILE_ENTRY **)_al_vector_ref(&profile_zones, i);
+   _al_mutex_unlock(&profile_mutex);
+
+   return zone;
+}
+
+
+/* Add up the statistics of a zone over all threads. */
+static void sum_zone_stats(_AL_PROFILE_ENTRY *zone, ALLEGRO_PROFILE_STATS *stats)
+{
+   PROFILE_THREAD *t;
+   unsigned int i;
+
+   stats->name = zone->name;
+   stats->is_counter = zone->is_counter;
+   stats->count = 0;
+   stats->total_time = 0.0;
+   stats->max_time = 0.0;
+
+   for (i = 0; (t = get_thread_at(i)) != NULL; i++) {
+      _al_mutex_lock(&t->mutex);
+      if (zone->index < (int)_al_vector_size(&t->stats)) {
+         ZONE_STATS *st = _al_vector_ref(&t->stats, zone->index);
+         stats->count += st->count;
+         stats->total_time += st->total_time;
+         if (st->max_time > stats->max_time)
+            stats->max_time = st->max_time;
+      }
+      _al_mutex_unlock(&t->mutex);
+   }
+}
+
+
+static void write_separator(void)
+{
+   if (trace.first)
+      trace.first = false;
+   else
+      al_fputs(trace.file, ",\n");
+}
+
+
+/* Write out the buffered zone events of every thread, followed by the
+ * current value of every counter.  Called only from the trace thread, or
+ * after it has stopped.  No lock is held while writing, so instrumented
+ * threads are not held up by the file.
+ */
+static int flush_trace(void)
+{
+   double now = al_get_time();
+   int num_dropped = 0;
+   PROFILE_THREAD *t;
+   _AL_PROFILE_ENTRY *zone;
+   unsigned int i;
+   int j;
+
+   for (i = 0; (t = get_thread_at(i)) != NULL; i++) {
+      TRACE_EVENT *events;
+      int num_events;
+
+      /* The thread carries on in the spare buffer while we write this one;
+       * it is not touched again until the next flush.  Buffers of threads
+       * which have gone quiet are released.
+       */
+      _al_mutex_lock(&t->mutex);
+      events = t->events;
+      num_events = t->num_events;
+      t->events = t->spare;
+      t->spare = events;
+      t->num_events = 0;
+      num_dropped += t->num_dropped;
+      t->num_dropped = 0;
+      if (num_events == 0 && t->block) {
+         al_free(t->block);
+         t->block = t->events = t->spare = NULL;
+      }
+      _al_mutex_unlock(&t->mutex);
+
+      for (j = 0; j < num_events; j++) {
+         write_separator();
+         al_fprintf(trace.file, "{\"name\":\"%s\",\"cat\":\"allegro\","
+            "\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+            events[j].zone->name, t->id,
+            events[j].start * 1e6, events[j].duration * 1e6);
+      }
+   }
+
+   for (i = 0; (zone = get_zone_at(i)) != NULL; i++) {
+      ALLEGRO_PROFILE_STATS stats;
+      if (!zone->is_counter)
+         continue;
+      sum_zone_stats(zone, &stats);
+      write_separator();
+      al_fprintf(trace.file, "{\"name\":\"%s\",\"cat\":\"allegro\","
+         "\"ph\":\"C\",\"pid\":1,\"tid\":0,\"ts\":%.3f,"
+         "\"args\":{\"value\":%lld}}",
+         zone->name, now * 1e6, (long long)stats.count);
+   }
+
+   al_fflush(trace.file);
+
+   return num_dropped;
+}
+
+
+static void trace_thread_proc(_AL_THREAD *thread, void *arg)
+{
+   ALLEGRO_TIMEOUT timeout;
+   int num_dropped = 0;
+   (void)arg;
+
+   _al_mutex_lock(&profile_mutex);
+   while (!_al_get_thread_should_stop(thread)) {
+      al_init_timeout(&timeout, trace.interval);
+      _al_cond_timedwait(&trace.cond, &profile_mutex, &timeout);
+      _al_mutex_unlock(&profile_mutex);
+      num_dropped += flush_trace();
+      _al_mutex_lock(&profile_mutex);
+   }
+   _al_mutex_unlock(&profile_mutex);
+
+   if (num_dropped > 0)
+      ALLEGRO_WARN("%d profile trace events were dropped\n", num_dropped);
+}
+
+
+static void shutdown_profiling(void)
+{
+   unsigned int i;
+
+   al_stop_profile_trace();
+
+   _al_mutex_lock(&profile_mutex);
+   profile_inited = false;
+   /* The zones are static, so they may be used again after reinstalling. */
+   for (i = 0; i < _al_vector_size(&profile_zones); i++) {
+      _AL_PROFILE_ENTRY **slot = _al_vector_ref(&profile_zones, i);
+      (*slot)->index = -1;
+   }
+   _al_vector_free(&profile_zones);
+   for (i = 0; i < _al_vector_size(&profile_threads); i++) {
+      PROFILE_THREAD **slot = _al_vector_ref(&profile_threads, i);
+      PROFILE_THREAD *t = *slot;
+      _al_vector_free(&t->stats);
+      al_free(t->block);
+      _al_mutex_destroy(&t->mutex);
+      al_free(t);
+   }
+   _al_vector_free(&profile_threads);
+   /* Forget the buffers still referenced by thread local storage. */
+   profile_generation++;
+   _al_mutex_unlock(&profile_mutex);
+
+   _al_mutex_destroy(&profile_mutex);
+}
+
+
+/* _al_init_profiling:
+ *  Initialise the profiler, and start tracing if requested in the system
+ *  configuration.
+ */
+void _al_init_profiling(void)
+{
+   ALLEGRO_CONFIG *config = al_get_system_config();
+   const char *filename;
+   const char *interval;
+
+   _al_mutex_init(&profile_mutex);
+   profile_inited = true;
+
+   _al_add_exit_func(shutdown_profiling, "shutdown_profiling");
+
+   filename = al_get_config_value(config, "profile", "trace_file");
+   if (filename && filename[0]) {
+      interval = al_get_config_value(config, "profile", "trace_interval");
+      if (!al_start_profile_trace(filename, interval ? atof(interval) : 0.0))
+         ALLEGRO_WARN("Could not start profile trace %s\n", filename);
+   }
+}
+
+
+/* Function: al_is_profiling_available
+ */
+bool al_is_profiling_available(void)
+{
+   return true;
+}
+
+
+/* Function: al_get_num_profile_zones
+ */
+int al_get_num_profile_zones(void)
+{
+   int n;
+
+   _al_mutex_lock(&profile_mutex);
+   n = _al_vector_size(&profile_zones);
+   _al_mutex_unlock(&profile_mutex);
+
+   return n;
+}
+
+
+/* Function: al_get_profile_zone_stats
+ */
+bool al_get_profile_zone_stats(int index, ALLEGRO_PROFILE_STATS *stats)
+{
+   _AL_PROFILE_ENTRY *zone;
+
+   ASSERT(stats);
+
+   if (index < 0)
+      return false;
+   zone = get_zone_at(index);
+   if (!zone)
+      return false;
+
+   sum_zone_stats(zone, stats);
+   return true;
+}
+
+
+/* Function: al_reset_profile_stats
+ */
+void al_reset_profile_stats(void)
+{
+   PROFILE_THREAD *t;
+   unsigned int i;
+   unsigned int j;
+
+   for (i = 0; (t = get_thread_at(i)) != NULL; i++) {
+      _al_mutex_lock(&t->mutex);
+      for (j = 0; j < _al_vector_size(&t->stats); j++) {
+         ZONE_STATS *st = _al_vector_ref(&t->stats, j);
+         st->count = 0;
+         st->total_time = 0.0;
+         st->max_time = 0.0;
+      }
+      _al_mutex_unlock(&t->mutex);
+   }
+}
+
+
+/* Function: al_start_profile_trace
+ */
+bool al_start_profile_trace(const char *filename, double interval)
+{
+   ALLEGRO_FILE *file;
+
+   ASSERT(filename);
+
+   if (!profile_inited)
+      return false;
+
+   _al_mutex_lock(&profile_mutex);
+
+   if (trace.file) {
+      ALLEGRO_WARN("A profile trace is already being written\n");
+      _al_mutex_unlock(&profile_mutex);
+      return false;
+   }
+
+   file = al_fopen(filename, "w");
+   if (!file) {
+      ALLEGRO_ERROR("Could not open %s\n", filename);
+      _al_mutex_unlock(&profile_mutex);
+      return false;
+   }
+
+   /* The JSON array format of the Chrome trace viewer may be left
+    * unterminated, so a trace stays usable if the program crashes.
+    */
+   al_fputs(file, "[\n");
+
+   trace.file = file;
+   trace.interval = (interval > 0.0) ? interval : 1.0;
+   trace.first = true;
+   _al_cond_init(&trace.cond);
+   _al_thread_create(&trace.thread, trace_thread_proc, NULL);
+   trace_active = true;
+
+   _al_mutex_unlock(&profile_mutex);
+
+   ALLEGRO_INFO("Writing profile trace to %s every %g seconds\n", filename,
+      trace.interval);
+
+   return true;
+}
+
+
+/* Function: al_stop_profile_trace
+ */
+void al_stop_profile_trace(void)
+{
+   PROFILE_THREAD *t;
+   unsigned int i;
+   int num_dropped;
+
+   _al_mutex_lock(&profile_mutex);
+   if (!trace.file || !trace_active) {
+      _al_mutex_unlock(&profile_mutex);
+      return;
+   }
+   trace_active = false;
+   _al_thread_set_should_stop(&trace.thread);
+   _al_cond_broadcast(&trace.cond);
+   _al_mutex_unlock(&profile_mutex);
+
+   _al_thread_join(&trace.thread);
+
+   num_dropped = flush_trace();
+   if (num_dropped > 0)
+      ALLEGRO_WARN("%d profile trace events were dropped\n", num_dropped);
+   al_fputs(trace.file, "\n]\n");
+   al_fclose(trace.file);
+
+   for (i = 0; (t = get_thread_at(i)) != NULL; i++) {
+      _al_mutex_lock(&t->mutex);
+      al_free(t->block);
+      t->block = t->events = t->spare = NULL;
+      t->num_events = 0;
+      t->num_dropped = 0;
+      _al_mutex_unlock(&t->mutex);
+   }
+
+   _al_mutex_lock(&profile_mutex);
+   _al_cond_destroy(&trace.cond);
+   trace.file = NULL;
+   _al_mutex_unlock(&profile_mutex);
+}
+
+
+#else /* !ALLEGRO_CFG_PROFILING */
+
+
+void _al_init_profiling(void)
+{
+}
+
+
+bool al_is_profiling_available(void)
+{
+   return false;
+}
+
+
+int al_get_num_profile_zones(void)
+{
+   return 0;
+}
+
+
+bool al_get_profile_zone_stats(int index, ALLEGRO_PROFILE_STATS *stats)
+{
+   (void)index;
+   (void)stats;
+   return false;
+}
+
+
+void al_reset_profile_stats(void)
+{
+}
+
+
+bool al_start_profile_trace(const char *filename, double interval)
+{
+   (void)filename;
+   (void)interval;
+   return false;
+}
+
+
+void al_stop_profile_trace(void)
+{
+}
+
+
+#endif /* ALLEGRO_CFG_PROFILING */
+
+
+/* vim: set sts=3 sw=3 et: */
@@ -30,6 +30,7 @@
 #include "allegro5/internal/aintern_dtor.h"
 #include "allegro5/internal/aintern_exitfunc.h"
 #include "allegro5/internal/aintern_pixels.h"
+#include "allegro5/internal/aintern_profile.h"
 #include "allegro5/internal/aintern_system.h"
 #include "allegro5/internal/aintern_thread.h"
 #include "allegro5/internal/aintern_timer.h"
@@ -260,8 +261,14 @@ bool al_install_system(int version, int (*atexit_ptr)(void (*)(void)))
    
    _al_init_convert_bitmap_list();
 
+   _al_init_concurrent_locks();
+
+   _al_init_ustr_index();
+
    _al_init_timers();
 
+   _al_init_profiling();
+
 #ifdef ALLEGRO_CFG_SHADER_GLSL
    _al_glsl_init_shaders();
 #endif
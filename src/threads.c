@@ -83,6 +83,8 @@ static void thread_func_trampoline(_AL_THREAD *inner, void *_outer)
    if (system && system->vt && system->vt->thread_exit) {
       system->vt->thread_exit(outer);
    }
+
+   _al_flush_memory_pool_cache();
 }
 
 
@@ -93,6 +95,7 @@ static void detached_thread_func_trampoline(_AL_THREAD *inner, void *_outer)
 
    ((void *(*)(void *))outer->proc)(outer->arg);
    al_free(outer);
+   _al_flush_memory_pool_cache();
 }
 
 
@@ -86,6 +86,7 @@ typedef struct thread_local_state {
    /* Bitmap parameters */
    int new_bitmap_format;
    int new_bitmap_flags;
+   int new_bitmap_alignment;
 
    /* Files */
    const ALLEGRO_FILE_INTERFACE *new_file_interface;
@@ -105,6 +106,10 @@ typedef struct thread_local_state {
 
    /* Destructor ownership count */
    int dtor_owner_count;
+
+   /* Profiling buffers of this thread, created on first use */
+   void *profile_thread;
+   int profile_generation;
 } thread_local_state;
 
 
@@ -403,12 +408,8 @@ void al_set_target_bitmap(ALLEGRO_BITMAP *bitmap)
    ASSERT(!al_is_bitmap_drawing_held());
 
    if (bitmap) {
-      if (bitmap->parent) {
-         bitmap->parent->dirty = true;
-      }
-      else {
-         bitmap->dirty = true;
-      }
+      /* Drawing can only touch the area of a sub-bitmap. */
+      _al_mark_bitmap_dirty(bitmap, 0, 0, bitmap->w, bitmap->h);
    }
 
    if ((tls = tls_get()) == NULL)
@@ -655,6 +656,36 @@ void al_add_new_bitmap_flag(int flag)
 
 
 
+/* Function: al_set_new_bitmap_alignment
+ */
+void al_set_new_bitmap_alignment(int alignment)
+{
+   thread_local_state *tls;
+
+   /* Zero or a power of two. */
+   if (alignment < 0 || (alignment & (alignment - 1)) != 0)
+      return;
+
+   if ((tls = tls_get()) == NULL)
+      return;
+   tls->new_bitmap_alignment = alignment;
+}
+
+
+
+/* Function: al_get_new_bitmap_alignment
+ */
+int al_get_new_bitmap_alignment(void)
+{
+   thread_local_state *tls;
+
+   if ((tls = tls_get()) == NULL)
+      return 0;
+   return tls->new_bitmap_alignment;
+}
+
+
+
 /* Function: al_get_new_bitmap_format
  */
 int al_get_new_bitmap_format(void)
@@ -710,6 +741,7 @@ void al_store_state(ALLEGRO_STATE *state, int flags)
    if (flags & ALLEGRO_STATE_NEW_BITMAP_PARAMETERS) {
       _STORE(new_bitmap_format);
       _STORE(new_bitmap_flags);
+      _STORE(new_bitmap_alignment);
    }
 
    if (flags & ALLEGRO_STATE_DISPLAY) {
@@ -779,6 +811,7 @@ void al_restore_state(ALLEGRO_STATE const *state)
    if (flags & ALLEGRO_STATE_NEW_BITMAP_PARAMETERS) {
       _RESTORE(new_bitmap_format);
       _RESTORE(new_bitmap_flags);
+      _RESTORE(new_bitmap_alignment);
    }
 
    if (flags & ALLEGRO_STATE_DISPLAY) {
@@ -955,4 +988,22 @@ int *_al_tls_get_dtor_owner_count(void)
 }
 
 
+/* Returns the slot for the profiling buffers of this thread.  The slot is
+ * cleared if it was filled in by another installation of the profiler, as
+ * given by `generation`.
+ */
+void **_al_tls_get_profile_thread(int generation)
+{
+   thread_local_state *tls;
+
+   if ((tls = tls_get()) == NULL)
+      return NULL;
+   if (tls->profile_generation != generation) {
+      tls->profile_thread = NULL;
+      tls->profile_generation = generation;
+   }
+   return &tls->profile_thread;
+}
+
+
 /* vim: set sts=3 sw=3 et: */
@@ -20,10 +20,11 @@
  */
 
 
+#include <errno.h>
+#include <fcntl.h>
 #include <pthread.h>
 #include <stdlib.h>
 #include <sys/types.h>
-#include <sys/select.h>
 #include <unistd.h>
 
 #include "allegro5/allegro.h"
@@ -32,45 +33,248 @@
 #include "allegro5/internal/aintern_vector.h"
 #include "allegro5/platform/aintunix.h"
 
+#if defined(ALLEGRO_HAVE_SYS_EPOLL_H) && defined(ALLEGRO_HAVE_SYS_EVENTFD_H)
+   #define USE_EPOLL
+   #include <stdint.h>
+   #include <sys/epoll.h>
+   #include <sys/eventfd.h>
+#endif
+#include <sys/select.h>
+
+ALLEGRO_DEBUG_CHANNEL("fdwatch")
 
 
+/* Each watched fd gets its own heap allocated item so that the epoll
+ * backend can hand the item straight back to us, without searching the
+ * watch list.  Items are never freed while the background thread may
+ * still hold a pointer to them; removed items are parked on
+ * fd_watch_dead until the thread has finished its current batch.
+ */
 typedef struct WATCH_ITEM
 {
    int fd;
    void (*callback)(void *);
    void *cb_data;
+   bool removed;
 } WATCH_ITEM;
 
 
 static _AL_THREAD fd_watch_thread;
 static _AL_MUTEX fd_watch_mutex = _AL_MUTEX_UNINITED;
-static _AL_VECTOR fd_watch_list = _AL_VECTOR_INITIALIZER(WATCH_ITEM);
+static _AL_COND fd_watch_cond;
+static _AL_VECTOR fd_watch_list = _AL_VECTOR_INITIALIZER(WATCH_ITEM *);
+static _AL_VECTOR fd_watch_dead = _AL_VECTOR_INITIALIZER(WATCH_ITEM *);
+static WATCH_ITEM *fd_watch_current = NULL;
+
+/* The wakeup fds are used to kick the background thread out of its wait
+ * when the watch list changes or the thread should stop.  With eventfd
+ * both ends are the same descriptor, otherwise they are a pipe.
+ */
+static int wakeup_fd[2] = { -1, -1 };
+
+#ifdef USE_EPOLL
+static int epoll_fd = -1;
+#define MAX_EPOLL_EVENTS   16
+#endif
+
+
+
+/* using_epoll:
+ *  Return true if the epoll backend is in use.  If the epoll set could not
+ *  be created we fall back to select.
+ */
+static bool using_epoll(void)
+{
+#ifdef USE_EPOLL
+   return epoll_fd != -1;
+#else
+   return false;
+#endif
+}
+
+
+
+/* wakeup_init: [primary thread]
+ *  Create the descriptors used to wake up the background thread.
+ */
+static bool wakeup_init(void)
+{
+#ifdef USE_EPOLL
+   wakeup_fd[0] = wakeup_fd[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+   return wakeup_fd[0] != -1;
+#else
+   if (pipe(wakeup_fd) != 0) {
+      wakeup_fd[0] = wakeup_fd[1] = -1;
+      return false;
+   }
+   fcntl(wakeup_fd[0], F_SETFL, O_NONBLOCK);
+   fcntl(wakeup_fd[1], F_SETFL, O_NONBLOCK);
+   return true;
+#endif
+}
+
+
+
+/* wakeup_close: [primary thread]
+ */
+static void wakeup_close(void)
+{
+   if (wakeup_fd[0] != -1)
+      close(wakeup_fd[0]);
+   if (wakeup_fd[1] != -1 && wakeup_fd[1] != wakeup_fd[0])
+      close(wakeup_fd[1]);
+   wakeup_fd[0] = wakeup_fd[1] = -1;
+}
+
+
+
+/* wakeup_signal: [any thread]
+ *  Make the background thread return from its wait as soon as possible.
+ */
+static void wakeup_signal(void)
+{
+#ifdef USE_EPOLL
+   uint64_t one = 1;
+   ssize_t r = write(wakeup_fd[1], &one, sizeof(one));
+#else
+   char c = 0;
+   ssize_t r = write(wakeup_fd[1], &c, 1);
+#endif
+   /* EAGAIN means a wakeup is already pending, which is just as good. */
+   (void)r;
+}
+
+
+
+/* wakeup_drain: [fdwatch thread]
+ */
+static void wakeup_drain(void)
+{
+#ifdef USE_EPOLL
+   uint64_t count;
+   ssize_t r = read(wakeup_fd[0], &count, sizeof(count));
+   (void)r;
+#else
+   char buf[64];
+   while (read(wakeup_fd[0], buf, sizeof(buf)) > 0) {
+   }
+#endif
+}
+
+
+
+/* free_dead_items:
+ *  Free watch items which have been removed from the watch list.  Must
+ *  only be called when the background thread cannot be holding a pointer
+ *  to any of them, i.e. from the thread between batches, or after it has
+ *  been joined.
+ */
+static void free_dead_items(void)
+{
+   unsigned int i;
+
+   for (i = 0; i < _al_vector_size(&fd_watch_dead); i++) {
+      WATCH_ITEM **wip = _al_vector_ref(&fd_watch_dead, i);
+      al_free(*wip);
+   }
+   _al_vector_free(&fd_watch_dead);
+}
+
+
+
+/* dispatch: [fdwatch thread]
+ *  Run the callback for a watch item which has data waiting.  The
+ *  callback is called without holding fd_watch_mutex, so it may take as
+ *  long as it likes and may start or stop watching other fds.
+ */
+static void dispatch(WATCH_ITEM *wi)
+{
+   _al_mutex_lock(&fd_watch_mutex);
+   if (wi->removed) {
+      _al_mutex_unlock(&fd_watch_mutex);
+      return;
+   }
+   fd_watch_current = wi;
+   _al_mutex_unlock(&fd_watch_mutex);
+
+   wi->callback(wi->cb_data);
+
+   _al_mutex_lock(&fd_watch_mutex);
+   fd_watch_current = NULL;
+   _al_cond_broadcast(&fd_watch_cond);
+   _al_mutex_unlock(&fd_watch_mutex);
+}
+
+
+
+#ifdef USE_EPOLL
 
+/* epoll_thread_func: [fdwatch thread]
+ *  The thread loop function for the epoll backend.
+ */
+static void epoll_thread_func(_AL_THREAD *self, void *unused)
+{
+   (void)unused;
+
+   while (!_al_get_thread_should_stop(self)) {
+      struct epoll_event events[MAX_EPOLL_EVENTS];
+      int n, i;
+
+      /* Changes to the watch list are applied directly to the epoll set, so
+       * there is no need for a timeout.  We are woken up through the wakeup
+       * fd when we should stop.
+       */
+      n = epoll_wait(epoll_fd, events, MAX_EPOLL_EVENTS, -1);
+      if (n < 0) {
+         if (errno != EINTR) {
+            ALLEGRO_ERROR("epoll_wait failed: %d\n", errno);
+         }
+         continue;
+      }
+
+      for (i = 0; i < n; i++) {
+         WATCH_ITEM *wi = events[i].data.ptr;
+         if (wi)
+            dispatch(wi);
+         else
+            wakeup_drain();
+      }
+
+      _al_mutex_lock(&fd_watch_mutex);
+      free_dead_items();
+      _al_mutex_unlock(&fd_watch_mutex);
+   }
+}
 
+#endif /* USE_EPOLL */
 
-/* fd_watch_thread_func: [fdwatch thread]
- *  The thread loop function.
+
+
+/* select_thread_func: [fdwatch thread]
+ *  The thread loop function for the select backend.
  */
-static void fd_watch_thread_func(_AL_THREAD *self, void *unused)
+static void select_thread_func(_AL_THREAD *self, void *unused)
 {
+   _AL_VECTOR ready = _AL_VECTOR_INITIALIZER(WATCH_ITEM *);
    (void)unused;
 
    while (!_al_get_thread_should_stop(self)) {
 
       fd_set rfds;
       int max_fd;
+      int retval;
+      unsigned int i;
 
       /* set up max_fd and rfds */
       _al_mutex_lock(&fd_watch_mutex);
       {
-         WATCH_ITEM *wi;
-         unsigned int i;
-
          FD_ZERO(&rfds);
-         max_fd = -1;
+         max_fd = wakeup_fd[0];
+         if (wakeup_fd[0] != -1)
+            FD_SET(wakeup_fd[0], &rfds);
 
          for (i = 0; i < _al_vector_size(&fd_watch_list); i++) {
-            wi = _al_vector_ref(&fd_watch_list, i);
+            WATCH_ITEM *wi = *(WATCH_ITEM **)_al_vector_ref(&fd_watch_list, i);
             FD_SET(wi->fd, &rfds);
             if (wi->fd > max_fd)
                max_fd = wi->fd;
@@ -78,37 +282,59 @@ static void fd_watch_thread_func(_AL_THREAD *self, void *unused)
       }
       _al_mutex_unlock(&fd_watch_mutex);
 
-      /* wait for something to happen on one of the fds */
-      {
+      /* Wait for something to happen on one of the fds.  Changes to the
+       * watch list write to the wakeup fd so we never wait on a stale set.
+       * Without a wakeup fd, fall back to polling for changes.
+       */
+      if (wakeup_fd[0] != -1) {
+         retval = select(max_fd+1, &rfds, NULL, NULL, NULL);
+      }
+      else {
          struct timeval tv;
-         int retval;
-
          tv.tv_sec = 0;
          tv.tv_usec = 250000;
-
          retval = select(max_fd+1, &rfds, NULL, NULL, &tv);
-         if (retval < 1)
-            continue;
       }
+      if (retval < 1)
+         continue;
 
-      /* one or more of the fds has activity */
-      _al_mutex_lock(&fd_watch_mutex);
-      {
-         WATCH_ITEM *wi;
-         unsigned int i;
+      if (wakeup_fd[0] != -1 && FD_ISSET(wakeup_fd[0], &rfds))
+         wakeup_drain();
 
-         for (i = 0; i < _al_vector_size(&fd_watch_list); i++) {
-            wi = _al_vector_ref(&fd_watch_list, i);
-            if (FD_ISSET(wi->fd, &rfds)) {
-               /* The callback is allowed to modify the watch list so the mutex
-                * must be recursive.
-                */
-               wi->callback(wi->cb_data);
-            }
+      /* Collect the items with activity first, as the watch list may change
+       * while the callbacks run.
+       */
+      _al_mutex_lock(&fd_watch_mutex);
+      for (i = 0; i < _al_vector_size(&fd_watch_list); i++) {
+         WATCH_ITEM *wi = *(WATCH_ITEM **)_al_vector_ref(&fd_watch_list, i);
+         if (FD_ISSET(wi->fd, &rfds)) {
+            WATCH_ITEM **slot = _al_vector_alloc_back(&ready);
+            *slot = wi;
          }
       }
       _al_mutex_unlock(&fd_watch_mutex);
+
+      for (i = 0; i < _al_vector_size(&ready); i++) {
+         dispatch(*(WATCH_ITEM **)_al_vector_ref(&ready, i));
+      }
+      _al_vector_free(&ready);
+
+      _al_mutex_lock(&fd_watch_mutex);
+      free_dead_items();
+      _al_mutex_unlock(&fd_watch_mutex);
    }
+
+   _al_vector_free(&ready);
+}
+
+
+
+/* on_fd_watch_thread:
+ *  Return true if called from one of our own callbacks.
+ */
+static bool on_fd_watch_thread(void)
+{
+   return pthread_equal(pthread_self(), fd_watch_thread.thread);
 }
 
 
@@ -122,32 +348,79 @@ static void fd_watch_thread_func(_AL_THREAD *self, void *unused)
  *
  *  Note: the callback is run from the background thread.  You can
  *  assume there is only one callback being called from the fdwatch
- *  module at a time.
+ *  module at a time.  Callbacks are not run with any fdwatch lock
+ *  held.
  */
 void _al_unix_start_watching_fd(int fd, void (*callback)(void *), void *cb_data)
 {
+   WATCH_ITEM *wi;
+
    ASSERT(fd >= 0);
    ASSERT(callback);
 
    /* start the background thread if necessary */
    if (_al_vector_size(&fd_watch_list) == 0) {
-      /* We need a recursive mutex to allow callbacks to modify the fd watch
-       * list.
+      _al_mutex_init(&fd_watch_mutex);
+      _al_cond_init(&fd_watch_cond);
+      if (!wakeup_init()) {
+         ALLEGRO_ERROR("Unable to create wakeup fd: %d\n", errno);
+      }
+#ifdef USE_EPOLL
+      /* Without an epoll set, or without a wakeup fd to stop the thread
+       * with, use the select loop instead.
        */
-      _al_mutex_init_recursive(&fd_watch_mutex);
-      _al_thread_create(&fd_watch_thread, fd_watch_thread_func, NULL);
+      epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+      if (epoll_fd == -1) {
+         ALLEGRO_WARN("epoll_create1 failed: %d, using select\n", errno);
+      }
+      else {
+         struct epoll_event ev;
+         ev.events = EPOLLIN;
+         ev.data.ptr = NULL;
+         if (wakeup_fd[0] == -1
+               || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wakeup_fd[0], &ev) != 0) {
+            ALLEGRO_WARN("Unable to watch the wakeup fd, using select\n");
+            close(epoll_fd);
+            epoll_fd = -1;
+         }
+      }
+      if (using_epoll()) {
+         _al_thread_create(&fd_watch_thread, epoll_thread_func, NULL);
+      }
+      else
+#endif
+      {
+         _al_thread_create(&fd_watch_thread, select_thread_func, NULL);
+      }
    }
 
+   wi = al_malloc(sizeof *wi);
+   wi->fd = fd;
+   wi->callback = callback;
+   wi->cb_data = cb_data;
+   wi->removed = false;
+
    /* now add the watch item to the list */
    _al_mutex_lock(&fd_watch_mutex);
    {
-      WATCH_ITEM *wi = _al_vector_alloc_back(&fd_watch_list);
-
-      wi->fd = fd;
-      wi->callback = callback;
-      wi->cb_data = cb_data;
+      WATCH_ITEM **slot = _al_vector_alloc_back(&fd_watch_list);
+      *slot = wi;
+
+#ifdef USE_EPOLL
+      if (using_epoll()) {
+         struct epoll_event ev;
+         ev.events = EPOLLIN;
+         ev.data.ptr = wi;
+         if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            ALLEGRO_ERROR("Unable to watch fd %d: %d\n", fd, errno);
+         }
+      }
+#endif
    }
    _al_mutex_unlock(&fd_watch_mutex);
+
+   if (!using_epoll())
+      wakeup_signal();
 }
 
 
@@ -157,11 +430,13 @@ void _al_unix_start_watching_fd(int fd, void (*callback)(void *), void *cb_data)
  *  Stop watching for data on `fd'.  Once there are no more file
  *  descriptors to watch, the background thread will be stopped.  This
  *  function is synchronised with the background thread, so you don't
- *  have to do any locking before calling it.
+ *  have to do any locking before calling it.  When it returns, the
+ *  callback for `fd' is not running and will not be called again.
  */
 void _al_unix_stop_watching_fd(int fd)
 {
    bool list_empty = false;
+   bool found = false;
 
    /* find the fd in the watch list and remove it */
    _al_mutex_lock(&fd_watch_mutex);
@@ -170,22 +445,60 @@ void _al_unix_stop_watching_fd(int fd)
       unsigned int i;
 
       for (i = 0; i < _al_vector_size(&fd_watch_list); i++) {
-         wi = _al_vector_ref(&fd_watch_list, i);
+         wi = *(WATCH_ITEM **)_al_vector_ref(&fd_watch_list, i);
          if (wi->fd == fd) {
+            WATCH_ITEM **slot;
+
+#ifdef USE_EPOLL
+            if (using_epoll())
+               epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+#endif
+            wi->removed = true;
             _al_vector_delete_at(&fd_watch_list, i);
             list_empty = _al_vector_is_empty(&fd_watch_list);
+            found = true;
+
+            /* The callback may be running right now; the caller is allowed
+             * to free cb_data as soon as we return, so wait for it.  A
+             * callback which stops watching its own fd does not wait.
+             */
+            if (!on_fd_watch_thread()) {
+               while (fd_watch_current == wi)
+                  _al_cond_wait(&fd_watch_cond, &fd_watch_mutex);
+            }
+
+            slot = _al_vector_alloc_back(&fd_watch_dead);
+            *slot = wi;
             break;
          }
       }
    }
    _al_mutex_unlock(&fd_watch_mutex);
 
+   if (!found)
+      return;
+
    /* if no more fd's are being watched, stop the background thread */
    if (list_empty) {
+      _al_thread_set_should_stop(&fd_watch_thread);
+      wakeup_signal();
       _al_thread_join(&fd_watch_thread);
+      free_dead_items();
+#ifdef USE_EPOLL
+      if (using_epoll()) {
+         close(epoll_fd);
+         epoll_fd = -1;
+      }
+#endif
+      wakeup_close();
+      _al_cond_destroy(&fd_watch_cond);
       _al_mutex_destroy(&fd_watch_mutex);
       _al_vector_free(&fd_watch_list);
    }
+   else {
+      /* Let the background thread release the item. */
+      wakeup_signal();
+   }
 }
 
 
@@ -17,10 +17,13 @@
 
 
 #include <stdarg.h>
+#include <string.h>
 #include "allegro5/allegro.h"
 #include "allegro5/utf8.h"
 #include "allegro5/internal/bstrlib.h"
 #include "allegro5/internal/aintern.h"
+#include "allegro5/internal/aintern_exitfunc.h"
+#include "allegro5/internal/aintern_thread.h"
 
 ALLEGRO_STATIC_ASSERT(utf8,
    sizeof(ALLEGRO_USTR_INFO) >= sizeof(struct _al_tagbstring));
@@ -37,16 +40,177 @@ ALLEGRO_STATIC_ASSERT(utf8,
 #endif
 
 
+#if defined(__SSE2__) || defined(_M_X64) || \
+   (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+   #include <emmintrin.h>
+   #define ALLEGRO_UTF8_USE_SSE2
+#endif
+
+
 #define IS_SINGLE_BYTE(c)  (((unsigned)(c) & 0x80) == 0)
 #define IS_LEAD_BYTE(c)    (((unsigned)(c) - 0xC0) < 0x3E)
 #define IS_TRAIL_BYTE(c)   (((unsigned)(c) & 0xC0) == 0x80)
 
+/* The bytes at which al_ustr_next and al_ustr_prev stop. */
+#define IS_START_BYTE(c)   (IS_SINGLE_BYTE(c) || IS_LEAD_BYTE(c))
+
+#define ONES_64         UINT64_C(0x0101010101010101)
+#define LOW_BITS_64     UINT64_C(0x7F7F7F7F7F7F7F7F)
+#define HIGH_BITS_64    UINT64_C(0x8080808080808080)
+
+/* Number of code points between two checkpoints of a string index. */
+#define INDEX_STRIDE    256
+#define INDEX_BUCKETS   64
+
+
+/* An index caches the length of a string and the byte offsets of every
+ * INDEX_STRIDE'th code point, so that al_ustr_length and al_ustr_offset need
+ * only scan a short distance.  Indexes live in a side table because
+ * ALLEGRO_USTR is a plain bstring whose layout is part of the API.
+ */
+typedef struct USTR_INDEX USTR_INDEX;
+
+struct USTR_INDEX {
+   const ALLEGRO_USTR *us;
+   const unsigned char *data;    /* contents the index was built for */
+   int size;
+   int length;                   /* -1 if not known */
+   int *checkpoints;             /* offset of code point i * INDEX_STRIDE */
+   int num_checkpoints;
+   int max_checkpoints;
+   USTR_INDEX *next;
+};
+
+static _AL_MUTEX index_mutex = _AL_MUTEX_UNINITED;
+static USTR_INDEX *index_buckets[INDEX_BUCKETS];
+static int num_indexes = 0;
+
+
+static inline uint64_t load_word(const unsigned char *p)
+{
+   uint64_t w;
+   memcpy(&w, p, sizeof(w));
+   return w;
+}
+
+
+/* Returns the number of start bytes in the word. */
+static inline int count_word_starts(uint64_t w)
+{
+   /* A trailing byte has bit 7 set and bit 6 clear. */
+   uint64_t trail = w & ~(w << 1) & HIGH_BITS_64;
+   /* 0xFE and 0xFF are the bytes with all of bits 1-7 set. */
+   uint64_t y = ~(w | ONES_64);
+   uint64_t ff = ~(((y & LOW_BITS_64) + LOW_BITS_64) | y) & HIGH_BITS_64;
+   uint64_t skip = trail | ff;
+   return 8 - (int)(((skip >> 7) * ONES_64) >> 56);
+}
+
+
+/* Count the start bytes in data[0..n).  Runs of ASCII and well-formed
+ * multi-byte text are handled a block at a time.
+ */
+static int count_starts(const unsigned char *data, int n)
+{
+   int count = 0;
+
+#ifdef ALLEGRO_UTF8_USE_SSE2
+   /* Signed, trailing bytes are exactly the range [-128, -65]. */
+   const __m128i limit = _mm_set1_epi8(-65);
+   const __m128i ones = _mm_set1_epi8(1);
+   const __m128i all = _mm_set1_epi8(-1);
+   const __m128i zero = _mm_setzero_si128();
+
+   while (n >= 16) {
+      int blocks = n / 16;
+      __m128i acc = zero;
+      __m128i sum;
+
+      /* Byte lanes of the accumulator must not overflow. */
+      if (blocks > 255)
+         blocks = 255;
+      n -= blocks * 16;
+
+      while (blocks-- > 0) {
+         __m128i v = _mm_loadu_si128((const __m128i *)data);
+         __m128i ff = _mm_cmpeq_epi8(_mm_or_si128(v, ones), all);
+         acc = _mm_sub_epi8(acc,
+            _mm_andnot_si128(ff, _mm_cmpgt_epi8(v, limit)));
+         data += 16;
+      }
+
+      sum = _mm_sad_epu8(acc, zero);
+      count += _mm_cvtsi128_si32(sum) +
+         _mm_cvtsi128_si32(_mm_srli_si128(sum, 8));
+   }
+#endif
+
+   while (n >= 8) {
+      count += count_word_starts(load_word(data));
+      data += 8;
+      n -= 8;
+   }
+
+   while (n-- > 0) {
+      if (IS_START_BYTE(*data))
+         count++;
+      data++;
+   }
+
+   return count;
+}
+
+
+/* Returns the number of code points from pos to the end of the string, as
+ * counted by repeated calls to al_ustr_next.
+ */
+static int count_code_points(const unsigned char *data, int size, int pos)
+{
+   if (pos >= size)
+      return 0;
+   return 1 + count_starts(data + pos + 1, size - pos - 1);
+}
+
+
+/* Returns the offset reached by calling al_ustr_next n times from pos. */
+static int skip_code_points(const unsigned char *data, int size, int pos,
+   int n)
+{
+   if (n <= 0 || pos >= size)
+      return pos;
+
+   pos++;
+
+   /* Skip whole words while they cannot contain the target. */
+   while (size - pos >= 8) {
+      int starts = count_word_starts(load_word(data + pos));
+      if (starts >= n)
+         break;
+      n -= starts;
+      pos += 8;
+   }
+
+   for (; pos < size; pos++) {
+      if (IS_START_BYTE(data[pos]) && --n == 0)
+         return pos;
+   }
+
+   return size;
+}
+
 
 static bool all_ascii(const ALLEGRO_USTR *us)
 {
    const unsigned char *data = (const unsigned char *) _al_bdata(us);
    int size = _al_blength(us);
 
+   while (size >= 8) {
+      if (load_word(data) & HIGH_BITS_64)
+         return false;
+      data += 8;
+      size -= 8;
+   }
+
    while (size-- > 0) {
       if (*data > 127)
          return false;
@@ -57,6 +221,158 @@ static bool all_ascii(const ALLEGRO_USTR *us)
 }
 
 
+static void shutdown_ustr_index(void)
+{
+   _al_mutex_destroy(&index_mutex);
+}
+
+
+/* This is called in al_install_system. */
+void _al_init_ustr_index(void)
+{
+   _al_mutex_init(&index_mutex);
+   _al_add_exit_func(shutdown_ustr_index, "shutdown_ustr_index");
+}
+
+
+static USTR_INDEX **index_slot(const ALLEGRO_USTR *us)
+{
+   USTR_INDEX **slot = &index_buckets[((uintptr_t)us >> 4) % INDEX_BUCKETS];
+
+   while (*slot && (*slot)->us != us)
+      slot = &(*slot)->next;
+   return slot;
+}
+
+
+/* Forget everything about the string past byte offset pos.  Checkpoints
+ * before pos depend only on the unchanged prefix so they are kept.
+ */
+static void truncate_index(USTR_INDEX *idx, const ALLEGRO_USTR *us, int pos)
+{
+   while (idx->num_checkpoints > 1 &&
+         idx->checkpoints[idx->num_checkpoints - 1] >= pos) {
+      idx->num_checkpoints--;
+   }
+   idx->length = -1;
+   idx->data = (const unsigned char *) _al_bdata(us);
+   idx->size = _al_blength(us);
+}
+
+
+/* Look up the index of a string, discarding it if the string was changed
+ * behind our back.  Must be called with index_mutex held.
+ */
+static USTR_INDEX *get_index(const ALLEGRO_USTR *us)
+{
+   USTR_INDEX *idx = *index_slot(us);
+
+   if (idx && (idx->data != (const unsigned char *) _al_bdata(us) ||
+         idx->size != _al_blength(us))) {
+      truncate_index(idx, us, 0);
+   }
+   return idx;
+}
+
+
+/* Called after every mutation of a string, pos being the first byte offset
+ * which may have changed.
+ */
+static void invalidate_index(const ALLEGRO_USTR *us, int pos)
+{
+   USTR_INDEX *idx;
+
+   if (num_indexes == 0)
+      return;
+
+   _al_mutex_lock(&index_mutex);
+   idx = *index_slot(us);
+   if (idx)
+      truncate_index(idx, us, pos);
+   _al_mutex_unlock(&index_mutex);
+}
+
+
+/* Add checkpoints until code point (i * INDEX_STRIDE) is covered or the end
+ * of the string is reached.
+ */
+static void extend_index(USTR_INDEX *idx, int i)
+{
+   while (i >= idx->num_checkpoints) {
+      int last = idx->checkpoints[idx->num_checkpoints - 1];
+      int next;
+
+      if (idx->length >= 0 &&
+            idx->num_checkpoints * INDEX_STRIDE >= idx->length)
+         return;
+
+      next = skip_code_points(idx->data, idx->size, last, INDEX_STRIDE);
+      if (next >= idx->size) {
+         idx->length = (idx->num_checkpoints - 1) * INDEX_STRIDE +
+            count_code_points(idx->data, idx->size, last);
+         return;
+      }
+
+      if (idx->num_checkpoints == idx->max_checkpoints) {
+         int new_max = idx->max_checkpoints * 2;
+         int *cp = al_realloc(idx->checkpoints, new_max * sizeof(int));
+         if (!cp)
+            return;
+         idx->checkpoints = cp;
+         idx->max_checkpoints = new_max;
+      }
+      idx->checkpoints[idx->num_checkpoints++] = next;
+   }
+}
+
+
+/* Returns the length of an indexed string, or -1 if it has no index. */
+static int indexed_length(const ALLEGRO_USTR *us)
+{
+   USTR_INDEX *idx;
+   int length = -1;
+
+   _al_mutex_lock(&index_mutex);
+   idx = get_index(us);
+   if (idx) {
+      if (idx->length < 0) {
+         int n = idx->num_checkpoints - 1;
+         idx->length = n * INDEX_STRIDE +
+            count_code_points(idx->data, idx->size, idx->checkpoints[n]);
+      }
+      length = idx->length;
+   }
+   _al_mutex_unlock(&index_mutex);
+
+   return length;
+}
+
+
+/* Returns the offset of code point `index` (>= 0) of an indexed string, or
+ * -1 if it has no index.
+ */
+static int indexed_offset(const ALLEGRO_USTR *us, int index)
+{
+   USTR_INDEX *idx;
+   int pos = -1;
+   int i;
+
+   _al_mutex_lock(&index_mutex);
+   idx = get_index(us);
+   if (idx) {
+      i = index / INDEX_STRIDE;
+      extend_index(idx, i);
+      if (i >= idx->num_checkpoints)
+         i = idx->num_checkpoints - 1;
+      pos = skip_code_points(idx->data, idx->size, idx->checkpoints[i],
+         index - i * INDEX_STRIDE);
+   }
+   _al_mutex_unlock(&index_mutex);
+
+   return pos;
+}
+
+
 /* Function: al_ustr_new
  */
 ALLEGRO_USTR *al_ustr_new(const char *s)
@@ -92,6 +408,8 @@ ALLEGRO_USTR *al_ustr_newf(const char *fmt, ...)
  */
 void al_ustr_free(ALLEGRO_USTR *us)
 {
+   if (num_indexes > 0)
+      al_ustr_disable_index(us);
    _al_bdestroy(us);
 }
 
@@ -204,13 +522,14 @@ size_t al_ustr_size(const ALLEGRO_USTR *us)
  */
 size_t al_ustr_length(const ALLEGRO_USTR *us)
 {
-   int pos = 0;
-   int c = 0;
-
-   while (al_ustr_next(us, &pos))
-      c++;
+   if (num_indexes > 0) {
+      int length = indexed_length(us);
+      if (length >= 0)
+         return length;
+   }
 
-   return c;
+   return count_code_points((const unsigned char *) _al_bdata(us),
+      _al_blength(us), 0);
 }
 
 
@@ -218,17 +537,75 @@ size_t al_ustr_length(const ALLEGRO_USTR *us)
  */
 int al_ustr_offset(const ALLEGRO_USTR *us, int index)
 {
-   int pos = 0;
-
    if (index < 0)
       index += al_ustr_length(us);
+   if (index <= 0)
+      return 0;
 
-   while (index-- > 0) {
-      if (!al_ustr_next(us, &pos))
+   if (num_indexes > 0) {
+      int pos = indexed_offset(us, index);
+      if (pos >= 0)
          return pos;
    }
 
-   return pos;
+   return skip_code_points((const unsigned char *) _al_bdata(us),
+      _al_blength(us), 0, index);
+}
+
+
+/* Function: al_ustr_enable_index
+ */
+bool al_ustr_enable_index(ALLEGRO_USTR *us)
+{
+   USTR_INDEX **slot;
+   USTR_INDEX *idx;
+   bool ret = true;
+
+   ASSERT(us);
+
+   _al_mutex_lock(&index_mutex);
+   slot = index_slot(us);
+   if (!*slot) {
+      idx = al_calloc(1, sizeof(*idx));
+      if (idx)
+         idx->checkpoints = al_malloc(16 * sizeof(int));
+      if (!idx || !idx->checkpoints) {
+         al_free(idx);
+         ret = false;
+      }
+      else {
+         idx->us = us;
+         idx->checkpoints[0] = 0;
+         idx->num_checkpoints = 1;
+         idx->max_checkpoints = 16;
+         truncate_index(idx, us, 0);
+         *slot = idx;
+         num_indexes++;
+      }
+   }
+   _al_mutex_unlock(&index_mutex);
+
+   return ret;
+}
+
+
+/* Function: al_ustr_disable_index
+ */
+void al_ustr_disable_index(ALLEGRO_USTR *us)
+{
+   USTR_INDEX **slot;
+   USTR_INDEX *idx;
+
+   _al_mutex_lock(&index_mutex);
+   slot = index_slot(us);
+   idx = *slot;
+   if (idx) {
+      *slot = idx->next;
+      num_indexes--;
+      al_free(idx->checkpoints);
+      al_free(idx);
+   }
+   _al_mutex_unlock(&index_mutex);
 }
 
 
@@ -246,7 +623,7 @@ bool al_ustr_next(const ALLEGRO_USTR *us, int *pos)
 
    while (++(*pos) < size) {
       c = data[*pos];
-      if (IS_SINGLE_BYTE(c) || IS_LEAD_BYTE(c))
+      if (IS_START_BYTE(c))
          break;
    }
 
@@ -267,7 +644,7 @@ bool al_ustr_prev(const ALLEGRO_USTR *us, int *pos)
    while (*pos > 0) {
       (*pos)--;
       c = data[*pos];
-      if (IS_SINGLE_BYTE(c) || IS_LEAD_BYTE(c))
+      if (IS_START_BYTE(c))
          break;
    }
 
@@ -399,7 +776,9 @@ int32_t al_ustr_prev_get(const ALLEGRO_USTR *us, int *pos)
  */
 bool al_ustr_insert(ALLEGRO_USTR *us1, int pos, const ALLEGRO_USTR *us2)
 {
-   return _al_binsert(us1, pos, us2, '\0') == _AL_BSTR_OK;
+   bool rc = _al_binsert(us1, pos, us2, '\0') == _AL_BSTR_OK;
+   invalidate_index(us1, pos);
+   return rc;
 }
 
 
@@ -421,12 +800,16 @@ size_t al_ustr_insert_chr(ALLEGRO_USTR *us, int pos, int32_t c)
    size_t sz;
 
    if (uc < 128) {
-      return (_al_binsertch(us, pos, 1, uc) == _AL_BSTR_OK) ? 1 : 0;
+      sz = (_al_binsertch(us, pos, 1, uc) == _AL_BSTR_OK) ? 1 : 0;
+      invalidate_index(us, pos);
+      return sz;
    }
 
    sz = al_utf8_width(c);
    if (_al_binsertch(us, pos, sz, '\0') == _AL_BSTR_OK) {
-      return al_utf8_encode(_al_bdataofs(us, pos), c);
+      sz = al_utf8_encode(_al_bdataofs(us, pos), c);
+      invalidate_index(us, pos);
+      return sz;
    }
 
    return 0;
@@ -437,7 +820,10 @@ size_t al_ustr_insert_chr(ALLEGRO_USTR *us, int pos, int32_t c)
  */
 bool al_ustr_append(ALLEGRO_USTR *us1, const ALLEGRO_USTR *us2)
 {
-   return _al_bconcat(us1, us2) == _AL_BSTR_OK;
+   int pos = _al_blength(us1);
+   bool rc = _al_bconcat(us1, us2) == _AL_BSTR_OK;
+   invalidate_index(us1, pos);
+   return rc;
 }
 
 
@@ -445,7 +831,10 @@ bool al_ustr_append(ALLEGRO_USTR *us1, const ALLEGRO_USTR *us2)
  */
 bool al_ustr_append_cstr(ALLEGRO_USTR *us, const char *s)
 {
-   return _al_bcatcstr(us, s) == _AL_BSTR_OK;
+   int pos = _al_blength(us);
+   bool rc = _al_bcatcstr(us, s) == _AL_BSTR_OK;
+   invalidate_index(us, pos);
+   return rc;
 }
 
 
@@ -456,7 +845,10 @@ size_t al_ustr_append_chr(ALLEGRO_USTR *us, int32_t c)
    uint32_t uc = c;
 
    if (uc < 128) {
-      return (_al_bconchar(us, uc) == _AL_BSTR_OK) ? 1 : 0;
+      int pos = _al_blength(us);
+      size_t sz = (_al_bconchar(us, uc) == _AL_BSTR_OK) ? 1 : 0;
+      invalidate_index(us, pos);
+      return sz;
    }
 
    return al_ustr_insert_chr(us, al_ustr_size(us), c);
@@ -482,6 +874,7 @@ bool al_ustr_appendf(ALLEGRO_USTR *us, const char *fmt, ...)
 bool al_ustr_vappendf(ALLEGRO_USTR *us, const char *fmt, va_list ap)
 {
    va_list arglist;
+   int pos = _al_blength(us);
    int sz;
    int rc;
 
@@ -499,11 +892,13 @@ bool al_ustr_vappendf(ALLEGRO_USTR *us, const char *fmt, va_list ap)
       va_end(arglist);
 
       if (rc >= 0) {
+         invalidate_index(us, pos);
          return true;
       }
 
       if (rc == _AL_BSTR_ERR) {
          /* A real error? */
+         invalidate_index(us, pos);
          return false;
       }
 
@@ -525,7 +920,7 @@ bool al_ustr_remove_chr(ALLEGRO_USTR *us, int pos)
       return false;
 
    w = al_utf8_width(c);
-   return _al_bdelete(us, pos, w) == _AL_BSTR_OK;
+   return al_ustr_remove_range(us, pos, pos + w);
 }
 
 
@@ -533,7 +928,9 @@ bool al_ustr_remove_chr(ALLEGRO_USTR *us, int pos)
  */
 bool al_ustr_remove_range(ALLEGRO_USTR *us, int start_pos, int end_pos)
 {
-   return _al_bdelete(us, start_pos, end_pos - start_pos) == _AL_BSTR_OK;
+   bool rc = _al_bdelete(us, start_pos, end_pos - start_pos) == _AL_BSTR_OK;
+   invalidate_index(us, start_pos);
+   return rc;
 }
 
 
@@ -541,7 +938,9 @@ bool al_ustr_remove_range(ALLEGRO_USTR *us, int start_pos, int end_pos)
  */
 bool al_ustr_truncate(ALLEGRO_USTR *us, int start_pos)
 {
-   return _al_btrunc(us, start_pos) == _AL_BSTR_OK;
+   bool rc = _al_btrunc(us, start_pos) == _AL_BSTR_OK;
+   invalidate_index(us, start_pos);
+   return rc;
 }
 
 
@@ -549,7 +948,9 @@ bool al_ustr_truncate(ALLEGRO_USTR *us, int start_pos)
  */
 bool al_ustr_ltrim_ws(ALLEGRO_USTR *us)
 {
-   return _al_bltrimws(us) == _AL_BSTR_OK;
+   bool rc = _al_bltrimws(us) == _AL_BSTR_OK;
+   invalidate_index(us, 0);
+   return rc;
 }
 
 
@@ -557,7 +958,9 @@ bool al_ustr_ltrim_ws(ALLEGRO_USTR *us)
  */
 bool al_ustr_rtrim_ws(ALLEGRO_USTR *us)
 {
-   return _al_brtrimws(us) == _AL_BSTR_OK;
+   bool rc = _al_brtrimws(us) == _AL_BSTR_OK;
+   invalidate_index(us, _al_blength(us));
+   return rc;
 }
 
 
@@ -565,7 +968,9 @@ bool al_ustr_rtrim_ws(ALLEGRO_USTR *us)
  */
 bool al_ustr_trim_ws(ALLEGRO_USTR *us)
 {
-   return _al_btrimws(us) == _AL_BSTR_OK;
+   bool rc = _al_btrimws(us) == _AL_BSTR_OK;
+   invalidate_index(us, 0);
+   return rc;
 }
 
 
@@ -573,7 +978,9 @@ bool al_ustr_trim_ws(ALLEGRO_USTR *us)
  */
 bool al_ustr_assign(ALLEGRO_USTR *us1, const ALLEGRO_USTR *us2)
 {
-   return _al_bassign(us1, us2) == _AL_BSTR_OK;
+   bool rc = _al_bassign(us1, us2) == _AL_BSTR_OK;
+   invalidate_index(us1, 0);
+   return rc;
 }
 
 
@@ -583,6 +990,7 @@ bool al_ustr_assign_substr(ALLEGRO_USTR *us1, const ALLEGRO_USTR *us2,
    int start_pos, int end_pos)
 {
    int rc = _al_bassignmidstr(us1, us2, start_pos, end_pos - start_pos);
+   invalidate_index(us1, 0);
    return rc == _AL_BSTR_OK;
 }
 
@@ -591,7 +999,9 @@ bool al_ustr_assign_substr(ALLEGRO_USTR *us1, const ALLEGRO_USTR *us2,
  */
 bool al_ustr_assign_cstr(ALLEGRO_USTR *us1, const char *s)
 {
-   return _al_bassigncstr(us1, s) == _AL_BSTR_OK;
+   bool rc = _al_bassigncstr(us1, s) == _AL_BSTR_OK;
+   invalidate_index(us1, 0);
+   return rc;
 }
 
 
@@ -620,10 +1030,12 @@ size_t al_ustr_set_chr(ALLEGRO_USTR *us, int start_pos, int32_t c)
    else
       rc = _AL_BSTR_OK;
 
-   if (rc == _AL_BSTR_OK)
-      return al_utf8_encode(_al_bdataofs(us, start_pos), c);
-   else
+   if (rc != _AL_BSTR_OK)
       return 0;
+
+   neww = al_utf8_encode(_al_bdataofs(us, start_pos), c);
+   invalidate_index(us, start_pos);
+   return neww;
 }
 
 
@@ -632,8 +1044,10 @@ size_t al_ustr_set_chr(ALLEGRO_USTR *us, int start_pos, int32_t c)
 bool al_ustr_replace_range(ALLEGRO_USTR *us1, int start_pos1, int end_pos1,
    const ALLEGRO_USTR *us2)
 {
-   return _al_breplace(us1, start_pos1, end_pos1 - start_pos1, us2, '\0')
+   bool rc = _al_breplace(us1, start_pos1, end_pos1 - start_pos1, us2, '\0')
       == _AL_BSTR_OK;
+   invalidate_index(us1, start_pos1);
+   return rc;
 }
 
 
@@ -852,7 +1266,9 @@ int al_ustr_rfind_cstr(const ALLEGRO_USTR *haystack, int end_pos,
 bool al_ustr_find_replace(ALLEGRO_USTR *us, int start_pos,
    const ALLEGRO_USTR *find, const ALLEGRO_USTR *replace)
 {
-   return _al_bfindreplace(us, find, replace, start_pos) == _AL_BSTR_OK;
+   bool rc = _al_bfindreplace(us, find, replace, start_pos) == _AL_BSTR_OK;
+   invalidate_index(us, start_pos);
+   return rc;
 }
 
 
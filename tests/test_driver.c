@@ -18,8 +18,12 @@
 #define MAX_BITMAPS  128
 #define MAX_TRANS    8
 #define MAX_FONTS    16
+#define MAX_LOCKS    8
 #define MAX_VERTICES 100
 #define MAX_POLYGONS 8
+#define MAX_RECTS    16
+#define MAX_ARGS     14
+#define MAX_TOKEN    81
 
 typedef struct {
    ALLEGRO_USTR   *name;
@@ -36,6 +40,13 @@ typedef struct {
    ALLEGRO_TRANSFORM transform;
 } Transform;
 
+typedef struct {
+   ALLEGRO_USTR   *name;
+   ALLEGRO_CONCURRENT_LOCK *lock;
+   int            w;
+   int            h;
+} NamedLock;
+
 typedef struct {
    int            x;
    int            y;
@@ -49,18 +60,41 @@ typedef struct {
    ALLEGRO_FONT   *font;
 } NamedFont;
 
+/* A statement of the form [lval =] fn(arg, ...), split up once so that it
+ * can be executed repeatedly without scanning the text again.
+ */
+typedef struct {
+   char const     *text;
+   char           fn[MAX_TOKEN];
+   char           lval[MAX_TOKEN];
+   char           arg[MAX_ARGS][MAX_TOKEN];
+   int            arity;
+   /* Resolved arguments, valid while config_generation is unchanged. */
+   char const     *value[MAX_ARGS];
+   int            generation;
+} Stmt;
+
+typedef struct {
+   Stmt           *stmts;
+   int            num_stmts;
+} OpList;
+
 int               argc;
 char              **argv;
 ALLEGRO_DISPLAY   *display;
 ALLEGRO_BITMAP    *membuf;
 Bitmap            bitmaps[MAX_BITMAPS];
+ALLEGRO_BITMAP_ATLAS *atlas;
 LockRegion        lock_region;
+NamedLock         concurrent_locks[MAX_LOCKS];
 Transform         transforms[MAX_TRANS];
 NamedFont         fonts[MAX_FONTS];
 ALLEGRO_VERTEX    vertices[MAX_VERTICES];
 float             simple_vertices[2 * MAX_VERTICES];
 int               num_simple_vertices;
 int               vertex_counts[MAX_POLYGONS];
+int               rectangles[4 * MAX_RECTS];
+int               num_rectangles;
 int               num_global_bitmaps;
 float             delay = 0.0;
 bool              save_outputs = false;
@@ -70,51 +104,27 @@ int               verbose = 0;
 int               total_tests = 0;
 int               passed_tests = 0;
 int               failed_tests = 0;
+int               config_generation = 0;
+bool              bench = false;
+int               bench_iterations = 20;
+double            bench_threshold = 10.0;
+ALLEGRO_CONFIG    *bench_results;
+ALLEGRO_CONFIG    *bench_baseline;
 
 #define streq(a, b)  (0 == strcmp((a), (b)))
 
-/* Helper macros for scanning statements. */
-#define PAT       " %80[A-Za-z0-9_.$|#-] "
-#define PAT1      PAT
-#define PAT2      PAT1 "," PAT1
-#define PAT3      PAT2 "," PAT1
-#define PAT4      PAT3 "," PAT1
-#define PAT5      PAT4 "," PAT1
-#define PAT6      PAT5 "," PAT1
-#define PAT7      PAT6 "," PAT1
-#define PAT8      PAT7 "," PAT1
-#define PAT9      PAT8 "," PAT1
-#define PAT10     PAT9 "," PAT1
-#define PAT11     PAT10 "," PAT1
-#define PAT12     PAT11 "," PAT1
-#define PAT13     PAT12 "," PAT1
-#define PAT14     PAT13 "," PAT1
-#define ARGS1     arg[0]
-#define ARGS2     ARGS1, arg[1]
-#define ARGS3     ARGS2, arg[2]
-#define ARGS4     ARGS3, arg[3]
-#define ARGS5     ARGS4, arg[4]
-#define ARGS6     ARGS5, arg[5]
-#define ARGS7     ARGS6, arg[6]
-#define ARGS8     ARGS7, arg[7]
-#define ARGS9     ARGS8, arg[8]
-#define ARGS10    ARGS9, arg[9]
-#define ARGS11    ARGS10, arg[10]
-#define ARGS12    ARGS11, arg[11]
-#define ARGS13    ARGS12, arg[12]
-#define ARGS14    ARGS13, arg[13]
-#define V(a)      resolve_var(cfg, section, arg[(a)])
+/* Helper macros for matching parsed statements. */
+#define V(a)      stmt_arg(cfg, section, st, (a))
 #define I(a)      atoi(V(a))
 #define F(a)      atof(V(a))
 #define C(a)      get_color(V(a))
 #define B(a)      get_bitmap(V(a), bmp_type, target)
 #define SCAN0(fn) \
-      (sscanf(stmt, fn " (" " )") == 0)
+      stmt_is(st, fn, 0, false)
 #define SCAN(fn, arity) \
-      (sscanf(stmt, fn " (" PAT##arity " )", ARGS##arity) == arity)
+      stmt_is(st, fn, arity, false)
 #define SCANLVAL(fn, arity) \
-      (sscanf(stmt, PAT " = " fn " (" PAT##arity " )", lval, ARGS##arity) \
-         == 1 + arity)
+      stmt_is(st, fn, arity, true)
 
 static void fatal_error(char const *msg, ...)
 {
@@ -252,6 +262,143 @@ static char const *resolve_var(ALLEGRO_CONFIG const *cfg, char const *section,
    return (vv) ? vv : v;
 }
 
+static bool is_token_char(int c)
+{
+   return isalnum(c) || c == '_' || c == '.' || c == '$' || c == '|'
+      || c == '#' || c == '-';
+}
+
+/* Scan a token surrounded by optional whitespace.  Returns a pointer past
+ * the trailing whitespace, or NULL if there was no token or it was too long.
+ */
+static char const *scan_token(char const *s, char buf[MAX_TOKEN])
+{
+   int n = 0;
+
+   while (isspace(*s))
+      s++;
+   while (is_token_char(*s)) {
+      if (n == MAX_TOKEN - 1)
+         return NULL;
+      buf[n++] = *s++;
+   }
+   buf[n] = '\0';
+   while (isspace(*s))
+      s++;
+   return (n > 0) ? s : NULL;
+}
+
+static bool parse_stmt_text(Stmt *st, char const *text)
+{
+   char const *s;
+
+   memset(st, 0, sizeof(*st));
+   st->text = text;
+   st->generation = -1;
+
+   s = scan_token(text, st->fn);
+   if (s && *s == '=') {
+      strcpy(st->lval, st->fn);
+      s = scan_token(s + 1, st->fn);
+   }
+   if (!s || *s != '(')
+      return false;
+
+   s++;
+   while (isspace(*s))
+      s++;
+   if (*s == ')')
+      return true;
+
+   for (;;) {
+      if (st->arity == MAX_ARGS)
+         return false;
+      s = scan_token(s, st->arg[st->arity]);
+      if (!s)
+         return false;
+      st->arity++;
+      if (*s == ')')
+         return true;
+      if (*s != ',')
+         return false;
+      s++;
+   }
+}
+
+/* A statement which fails to parse matches nothing. */
+static bool parse_stmt(Stmt *st, char const *text)
+{
+   if (parse_stmt_text(st, text))
+      return true;
+   st->fn[0] = '\0';
+   return false;
+}
+
+static bool stmt_is(Stmt const *st, char const *fn, int arity, bool has_lval)
+{
+   return st->arity == arity
+      && (st->lval[0] != '\0') == has_lval
+      && streq(st->fn, fn);
+}
+
+/* Variables are looked up once and the results reused until the test
+ * assigns to a variable, which bumps config_generation.
+ */
+static char const *stmt_arg(ALLEGRO_CONFIG const *cfg, char const *section,
+   Stmt *st, int a)
+{
+   int i;
+
+   if (st->generation != config_generation) {
+      for (i = 0; i < st->arity; i++)
+         st->value[i] = resolve_var(cfg, section, st->arg[i]);
+      st->generation = config_generation;
+   }
+   return st->value[a];
+}
+
+static void parse_ops(ALLEGRO_CONFIG const *cfg, char const *testname,
+   OpList *ops)
+{
+   char buf[32];
+   char const *stmt;
+   int op;
+
+   ops->stmts = NULL;
+   ops->num_stmts = 0;
+
+   for (op = 0; ; op++) {
+      sprintf(buf, "op%d", op);
+      stmt = al_get_config_value(cfg, testname, buf);
+      if (!stmt) {
+         /* Check for a common mistake. */
+         sprintf(buf, "op%d", op+1);
+         stmt = al_get_config_value(cfg, testname, buf);
+         if (!stmt)
+            break;
+         printf("WARNING: op%d skipped, continuing at op%d\n", op, op+1);
+         op++;
+      }
+
+      if (streq(stmt, ""))
+         continue;
+
+      ops->stmts = realloc(ops->stmts, (ops->num_stmts + 1) * sizeof(Stmt));
+      if (!ops->stmts)
+         fatal_error("out of memory");
+      if (!parse_stmt(&ops->stmts[ops->num_stmts], stmt))
+         fatal_error("statement didn't scan: %s", stmt);
+      ops->num_stmts++;
+   }
+}
+
+static void free_ops(OpList *ops)
+{
+   free(ops->stmts);
+   ops->stmts = NULL;
+   ops->num_stmts = 0;
+}
+
 static bool get_bool(char const *value)
 {
    return streq(value, "true") ? true
@@ -354,6 +501,24 @@ static ALLEGRO_TRANSFORM *get_transform(const char *name)
    return NULL;
 }
 
+static NamedLock *get_concurrent_lock(const char *name)
+{
+   int i;
+
+   for (i = 0; i < MAX_LOCKS; i++) {
+      if (!concurrent_locks[i].name) {
+         concurrent_locks[i].name = al_ustr_new(name);
+         return &concurrent_locks[i];
+      }
+
+      if (streq(al_cstr(concurrent_locks[i].name), name))
+         return &concurrent_locks[i];
+   }
+
+   fatal_error("concurrent locks limit reached");
+   return NULL;
+}
+
 static int get_pixel_format(char const *v)
 {
    int format = streq(v, "ALLEGRO_PIXEL_FORMAT_ANY") ? ALLEGRO_PIXEL_FORMAT_ANY
@@ -400,13 +565,30 @@ static int get_lock_bitmap_flags(char const *v)
       : atoi(v);
 }
 
-static int get_bitmap_flags(char const *v)
+static int get_bitmap_flag(char const *v)
 {
    return streq(v, "ALLEGRO_MEMORY_BITMAP") ? ALLEGRO_MEMORY_BITMAP
       : streq(v, "ALLEGRO_VIDEO_BITMAP") ? ALLEGRO_VIDEO_BITMAP
+      : streq(v, "ALLEGRO_COPY_ON_WRITE") ? ALLEGRO_COPY_ON_WRITE
+      : streq(v, "ALLEGRO_TILED_MEMORY_BITMAP") ? ALLEGRO_TILED_MEMORY_BITMAP
       : atoi(v);
 }
 
+/* Flags may be combined with |, e.g. ALLEGRO_MEMORY_BITMAP|ALLEGRO_COPY_ON_WRITE */
+static int get_bitmap_flags(char const *v)
+{
+   char buf[MAX_TOKEN];
+   char *tok;
+   int flags = 0;
+
+   if (strlen(v) >= sizeof(buf))
+      fatal_error("bitmap flags too long: %s", v);
+   strcpy(buf, v);
+   for (tok = strtok(buf, "|"); tok; tok = strtok(NULL, "|"))
+      flags |= get_bitmap_flag(tok);
+   return flags;
+}
+
 static void fill_lock_region(LockRegion *lr, float alphafactor, bool blended)
 {
    int x, y;
@@ -432,6 +614,50 @@ static void fill_lock_region(LockRegion *lr, float alphafactor, bool blended)
    }
 }
 
+/* Sets every block of a blocked lock to zero bits, which decode to black in
+ * the DXT formats.
+ */
+static void zero_locked_blocks(LockRegion *lr)
+{
+   int y;
+
+   for (y = 0; y < lr->h; y++) {
+      memset((char *)lr->lr->data + y * lr->lr->pitch, 0,
+         lr->w * lr->lr->pixel_size);
+   }
+}
+
+/* Like fill_lock_region, but writes straight into the region of a
+ * concurrent lock, which al_put_pixel can't reach.  The lock must be in
+ * ABGR_8888_LE format.
+ */
+static void fill_concurrent_lock(NamedLock *nl, float alphafactor)
+{
+   ALLEGRO_LOCKED_REGION *lr;
+   int x, y;
+   float r, g, b;
+   unsigned char *p;
+
+   if (!nl->lock)
+      fatal_error("concurrent lock %s was not taken", al_cstr(nl->name));
+   lr = al_get_concurrent_lock_region(nl->lock);
+   if (lr->format != ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE)
+      fatal_error("concurrent lock %s must use ABGR_8888_LE",
+         al_cstr(nl->name));
+
+   for (y = 0; y < nl->h; y++) {
+      p = (unsigned char *)lr->data + y * lr->pitch;
+      for (x = 0; x < nl->w; x++) {
+         r = (float)x / (nl->w - 1);
+         b = (float)y / (nl->h - 1);
+         g = r*b;
+         al_unmap_rgba(al_map_rgba_f(r, g, b, r * alphafactor),
+            p, p + 1, p + 2, p + 3);
+         p += 4;
+      }
+   }
+}
+
 static int get_load_font_flags(char const *v)
 {
    return streq(v, "ALLEGRO_NO_PREMULTIPLIED_ALPHA") ? ALLEGRO_NO_PREMULTIPLIED_ALPHA
@@ -442,12 +668,11 @@ static int get_load_font_flags(char const *v)
 
 static void load_fonts(ALLEGRO_CONFIG const *cfg, const char *section)
 {
-#define MAXBUF    80
-
    int i = 0;
    ALLEGRO_CONFIG_ENTRY *iter;
    char const *key;
-   char arg[14][MAXBUF];
+   Stmt stmt_buf;
+   Stmt *st = &stmt_buf;
 
    key = al_get_first_config_entry(cfg, section, &iter);
    while (key && i < MAX_FONTS) {
@@ -455,6 +680,8 @@ static void load_fonts(ALLEGRO_CONFIG const *cfg, const char *section)
       ALLEGRO_FONT *font = NULL;
       bool load_stmt = false;
 
+      parse_stmt(st, stmt);
+
       if (SCAN("al_load_font", 3)) {
          font = al_load_font(V(0), I(1), get_load_font_flags(V(2)));
          load_stmt = true;
@@ -487,8 +714,6 @@ static void load_fonts(ALLEGRO_CONFIG const *cfg, const char *section)
 
    if (i == MAX_FONTS)
       fatal_error("font limit reached");
-
-#undef MAXBUF
 }
 
 static ALLEGRO_FONT *get_font(char const *name)
@@ -528,6 +753,7 @@ static void set_config_int(ALLEGRO_CONFIG *cfg, char const *section,
    char buf[40];
    sprintf(buf, "%d", value);
    al_set_config_value(cfg, section, var, buf);
+   config_generation++;
 }
 
 static void set_config_float(ALLEGRO_CONFIG *cfg, char const *section,
@@ -536,6 +762,7 @@ static void set_config_float(ALLEGRO_CONFIG *cfg, char const *section,
    char buf[40];
    sprintf(buf, "%f", value);
    al_set_config_value(cfg, section, var, buf);
+   config_generation++;
 }
 
 static void fill_vertices(ALLEGRO_CONFIG const *cfg, char const *name)
@@ -623,6 +850,33 @@ static void fill_vertex_counts(ALLEGRO_CONFIG const *cfg, char const *name)
 #undef MAXBUF
 }
 
+static void fill_rectangles(ALLEGRO_CONFIG const *cfg, char const *name)
+{
+#define MAXBUF    80
+
+   char const *value;
+   char buf[MAXBUF];
+   int *r;
+   int i;
+
+   memset(rectangles, 0, sizeof(rectangles));
+
+   for (i = 0; i < MAX_RECTS; i++) {
+      sprintf(buf, "r%d", i);
+      value = al_get_config_value(cfg, name, buf);
+      if (!value)
+         break;
+
+      r = rectangles + 4 * i;
+      if (sscanf(value, " %d , %d , %d , %d", r, r+1, r+2, r+3) != 4)
+         fatal_error("invalid rectangle: %s", value);
+   }
+
+   num_rectangles = i;
+
+#undef MAXBUF
+}
+
 static int get_prim_type(char const *value)
 {
    return streq(value, "ALLEGRO_PRIM_POINT_LIST") ? ALLEGRO_PRIM_POINT_LIST
@@ -931,46 +1185,21 @@ static void check_similarity(ALLEGRO_CONFIG const *cfg,
    }
 }
 
-static void do_test(ALLEGRO_CONFIG *cfg, char const *testname,
-   ALLEGRO_BITMAP *target, int bmp_type, bool reliable)
+static void run_ops(ALLEGRO_CONFIG *cfg, char const *testname,
+   OpList *ops, ALLEGRO_BITMAP *target, int bmp_type)
 {
-#define MAXBUF    80
-
    const char *section = testname;
-   int op;
    char const *stmt;
-   char buf[MAXBUF];
-   char arg[14][MAXBUF];
-   char lval[MAXBUF];
-   int i;
-
-   if (verbose) {
-      /* So in case it segfaults, we know which test to re-run. */
-      printf("\nRunning %s [%s].\n", testname, bmp_type_to_string(bmp_type));
-      fflush(stdout);
-   }
+   Stmt *st;
+   int op;
 
-   set_target_reset(target);
-
-   for (op = 0; ; op++) {
-      sprintf(buf, "op%d", op);
-      stmt = al_get_config_value(cfg, testname, buf);
-      if (!stmt) {
-         /* Check for a common mistake. */
-         sprintf(buf, "op%d", op+1);
-         stmt = al_get_config_value(cfg, testname, buf);
-         if (!stmt)
-            break;
-         printf("WARNING: op%d skipped, continuing at op%d\n", op, op+1);
-         op++;
-      }
+   for (op = 0; op < ops->num_stmts; op++) {
+      st = &ops->stmts[op];
+      stmt = st->text;
 
       if (verbose > 1)
          printf("# %s\n", stmt);
 
-      if (streq(stmt, ""))
-         continue;
-
       if (SCAN("al_set_target_bitmap", 1)) {
          al_set_target_bitmap(B(0));
          continue;
@@ -1015,8 +1244,20 @@ static void do_test(ALLEGRO_CONFIG *cfg, char const *testname,
          continue;
       }
 
+      if (SCAN("al_clear_rectangles", 2)) {
+         fill_rectangles(cfg, V(0));
+         al_clear_rectangles(rectangles, num_rectangles, C(1));
+         continue;
+      }
+
+      /* For settings read at the time of the call, e.g. memory_clear_threads. */
+      if (SCAN("set_system_config", 3)) {
+         al_set_config_value(al_get_system_config(), V(0), V(1), V(2));
+         continue;
+      }
+
       if (SCANLVAL("al_clone_bitmap", 1)) {
-         ALLEGRO_BITMAP **bmp = reserve_local_bitmap(lval, bmp_type);
+         ALLEGRO_BITMAP **bmp = reserve_local_bitmap(st->lval, bmp_type);
          (*bmp) = al_clone_bitmap(B(0));
          continue;
       }
@@ -1112,24 +1353,24 @@ static void do_test(ALLEGRO_CONFIG *cfg, char const *testname,
       }
 
       if (SCANLVAL("al_create_bitmap", 2)) {
-         ALLEGRO_BITMAP **bmp = reserve_local_bitmap(lval, bmp_type);
+         ALLEGRO_BITMAP **bmp = reserve_local_bitmap(st->lval, bmp_type);
          (*bmp) = al_create_bitmap(I(0), I(1));
          continue;
       }
 
       if (SCANLVAL("al_create_sub_bitmap", 5)) {
-         ALLEGRO_BITMAP **bmp = reserve_local_bitmap(lval, bmp_type);
+         ALLEGRO_BITMAP **bmp = reserve_local_bitmap(st->lval, bmp_type);
          (*bmp) = al_create_sub_bitmap(B(0), I(1), I(2), I(3), I(4));
          continue;
       }
 
       if (SCANLVAL("al_load_bitmap", 1)) {
-         ALLEGRO_BITMAP **bmp = reserve_local_bitmap(lval, bmp_type);
+         ALLEGRO_BITMAP **bmp = reserve_local_bitmap(st->lval, bmp_type);
          (*bmp) = load_relative_bitmap(V(0), 0);
          continue;
       }
       if (SCANLVAL("al_load_bitmap_flags", 2)) {
-         ALLEGRO_BITMAP **bmp = reserve_local_bitmap(lval, bmp_type);
+         ALLEGRO_BITMAP **bmp = reserve_local_bitmap(st->lval, bmp_type);
          (*bmp) = load_relative_bitmap(V(0), get_load_bitmap_flag(V(1)));
          continue;
       }
@@ -1143,7 +1384,8 @@ static void do_test(ALLEGRO_CONFIG *cfg, char const *testname,
          char const *ext = al_identify_bitmap(V(0));
          if (!ext)
             ext = "NULL";
-         al_set_config_value(cfg, testname, lval, ext);
+         al_set_config_value(cfg, testname, st->lval, ext);
+         config_generation++;
          continue;
       }
 
@@ -1182,6 +1424,18 @@ static void do_test(ALLEGRO_CONFIG *cfg, char const *testname,
          continue;
       }
 
+      /* Atlases; one per test */
+      if (SCAN("al_create_bitmap_atlas", 2)) {
+         al_destroy_bitmap_atlas(atlas);
+         atlas = al_create_bitmap_atlas(I(0), I(1));
+         continue;
+      }
+      if (SCAN("al_add_bitmap_to_atlas", 1)) {
+         if (!atlas || !al_add_bitmap_to_atlas(atlas, B(0)))
+            fatal_error("failed to add %s to atlas", V(0));
+         continue;
+      }
+
       /* Conversion */
       if (SCAN("al_convert_bitmap", 1)) {
          ALLEGRO_BITMAP *bmp = B(0);
@@ -1214,6 +1468,18 @@ static void do_test(ALLEGRO_CONFIG *cfg, char const *testname,
             get_lock_bitmap_flags(V(6)));
          continue;
       }
+      if (SCAN("al_lock_bitmap_region_blocked", 6)) {
+         ALLEGRO_BITMAP *bmp = B(0);
+         lock_region.x = I(1);
+         lock_region.y = I(2);
+         lock_region.w = I(3);
+         lock_region.h = I(4);
+         lock_region.lr = al_lock_bitmap_region_blocked(bmp,
+            lock_region.x, lock_region.y,
+            lock_region.w, lock_region.h,
+            get_lock_bitmap_flags(V(5)));
+         continue;
+      }
       if (SCAN("al_unlock_bitmap", 1)) {
          al_unlock_bitmap(B(0));
          lock_region.lr = NULL;
@@ -1223,6 +1489,30 @@ static void do_test(ALLEGRO_CONFIG *cfg, char const *testname,
          fill_lock_region(&lock_region, F(0), get_bool(V(1)));
          continue;
       }
+      if (SCAN0("zero_locked_blocks")) {
+         zero_locked_blocks(&lock_region);
+         continue;
+      }
+      if (SCANLVAL("al_lock_bitmap_region_concurrent", 7)) {
+         NamedLock *nl = get_concurrent_lock(st->lval);
+         al_unlock_concurrent_lock(nl->lock);
+         nl->w = I(3);
+         nl->h = I(4);
+         nl->lock = al_lock_bitmap_region_concurrent(B(0), I(1), I(2),
+            nl->w, nl->h, get_pixel_format(V(5)),
+            get_lock_bitmap_flags(V(6)));
+         continue;
+      }
+      if (SCAN("al_unlock_concurrent_lock", 1)) {
+         NamedLock *nl = get_concurrent_lock(V(0));
+         al_unlock_concurrent_lock(nl->lock);
+         nl->lock = NULL;
+         continue;
+      }
+      if (SCAN("fill_concurrent_lock", 2)) {
+         fill_concurrent_lock(get_concurrent_lock(V(0)), F(1));
+         continue;
+      }
 
       /* Fonts */
       if (SCAN("al_draw_text", 6)) {
@@ -1237,22 +1527,22 @@ static void do_test(ALLEGRO_CONFIG *cfg, char const *testname,
       }
       if (SCANLVAL("al_get_text_width", 2)) {
          int w = al_get_text_width(get_font(V(0)), V(1));
-         set_config_int(cfg, testname, lval, w);
+         set_config_int(cfg, testname, st->lval, w);
          continue;
       }
       if (SCANLVAL("al_get_font_line_height", 1)) {
          int h = al_get_font_line_height(get_font(V(0)));
-         set_config_int(cfg, testname, lval, h);
+         set_config_int(cfg, testname, st->lval, h);
          continue;
       }
       if (SCANLVAL("al_get_font_ascent", 1)) {
          int as = al_get_font_ascent(get_font(V(0)));
-         set_config_int(cfg, testname, lval, as);
+         set_config_int(cfg, testname, st->lval, as);
          continue;
       }
       if (SCANLVAL("al_get_font_descent", 1)) {
          int de = al_get_font_descent(get_font(V(0)));
-         set_config_int(cfg, testname, lval, de);
+         set_config_int(cfg, testname, st->lval, de);
          continue;
       }
       if (SCAN("al_get_text_dimensions", 6)) {
@@ -1401,42 +1691,42 @@ static void do_test(ALLEGRO_CONFIG *cfg, char const *testname,
       /* Simple arithmetic, generally useful. (5.1) */
       if (SCANLVAL("isum", 2)) {
          int result  = I(0) + I(1);
-         set_config_int(cfg, testname, lval, result);
+         set_config_int(cfg, testname, st->lval, result);
          continue;
       }
       if (SCANLVAL("idif", 2)) {
          int result  = I(0) - I(1);
-         set_config_int(cfg, testname, lval, result);
+         set_config_int(cfg, testname, st->lval, result);
          continue;
       }
       if (SCANLVAL("imul", 2)) {
          int result  = I(0) * I(1);
-         set_config_int(cfg, testname, lval, result);
+         set_config_int(cfg, testname, st->lval, result);
          continue;
       }
       if (SCANLVAL("idiv", 2)) {
          int result  = I(0) / I(1);
-         set_config_int(cfg, testname, lval, result);
+         set_config_int(cfg, testname, st->lval, result);
          continue;
       }
       if (SCANLVAL("fsum", 2)) {
          float result  = F(0) + F(1);
-         set_config_float(cfg, testname, lval, result);
+         set_config_float(cfg, testname, st->lval, result);
          continue;
       }
       if (SCANLVAL("fdif", 2)) {
          float result  = F(0) - F(1);
-         set_config_float(cfg, testname, lval, result);
+         set_config_float(cfg, testname, st->lval, result);
          continue;
       }
       if (SCANLVAL("fmul", 2)) {
          float result  = F(0) * F(1);
-         set_config_float(cfg, testname, lval, result);
+         set_config_float(cfg, testname, st->lval, result);
          continue;
       }
       if (SCANLVAL("fdiv", 2)) {
          float result  = F(0) / F(1);
-         set_config_float(cfg, testname, lval, result);
+         set_config_float(cfg, testname, st->lval, result);
          continue;
       }
 
@@ -1444,12 +1734,12 @@ static void do_test(ALLEGRO_CONFIG *cfg, char const *testname,
        * variables (5.1)*/
       if (SCANLVAL("int", 1)) {
          float result  = F(0);
-         set_config_float(cfg, testname, lval, result);
+         set_config_float(cfg, testname, st->lval, result);
          continue;
       }
       if (SCANLVAL("float", 1)) {
          float result  = F(0);
-         set_config_float(cfg, testname, lval, result);
+         set_config_float(cfg, testname, st->lval, result);
          continue;
       }
        
@@ -1460,12 +1750,12 @@ static void do_test(ALLEGRO_CONFIG *cfg, char const *testname,
       }
       if (SCANLVAL("al_get_glyph_advance", 3)) {
          int kerning = al_get_glyph_advance(get_font(V(0)), I(1), I(2));
-         set_config_int(cfg, testname, lval, kerning);
+         set_config_int(cfg, testname, st->lval, kerning);
          continue;
       }
       if (SCANLVAL("al_get_glyph_width", 2)) {
          int w = al_get_glyph_width(get_font(V(0)), I(1));
-         set_config_int(cfg, testname, lval, w);
+         set_config_int(cfg, testname, st->lval, w);
          continue;
       }
       if (SCANLVAL("al_get_glyph_dimensions", 6)) {
@@ -1475,12 +1765,66 @@ static void do_test(ALLEGRO_CONFIG *cfg, char const *testname,
          set_config_int(cfg, testname, V(3), bby);
          set_config_int(cfg, testname, V(4), bbw);
          set_config_int(cfg, testname, V(5), bbh);
-         set_config_int(cfg, testname, lval, ok);
+         set_config_int(cfg, testname, st->lval, ok);
          continue;
       }
 
       fatal_error("statement didn't scan: %s", stmt);
    }
+}
+
+/* Destroy the bitmaps and transformations created by a test. */
+static void end_test(int bmp_type)
+{
+   int i;
+
+   /* Ensure we don't target a bitmap which is about to be destroyed. */
+   al_set_target_bitmap(display ? al_get_backbuffer(display) : NULL);
+
+   /* Release concurrent locks before the bitmaps they belong to. */
+   for (i = 0; i < MAX_LOCKS; i++) {
+      al_unlock_concurrent_lock(concurrent_locks[i].lock);
+      concurrent_locks[i].lock = NULL;
+      al_ustr_free(concurrent_locks[i].name);
+      concurrent_locks[i].name = NULL;
+   }
+
+   /* Destroy local bitmaps. */
+   for (i = num_global_bitmaps; i < MAX_BITMAPS; i++) {
+      if (bitmaps[i].name) {
+         al_ustr_free(bitmaps[i].name);
+         bitmaps[i].name = NULL;
+         al_destroy_bitmap(bitmaps[i].bitmap[bmp_type]);
+         bitmaps[i].bitmap[bmp_type] = NULL;
+      }
+   }
+
+   /* Destroy the atlas pages after the bitmaps placed on them. */
+   al_destroy_bitmap_atlas(atlas);
+   atlas = NULL;
+
+   /* Free transform names. */
+   for (i = 0; i < MAX_TRANS; i++) {
+      al_ustr_free(transforms[i].name);
+      transforms[i].name = NULL;
+   }
+}
+
+static void do_test(ALLEGRO_CONFIG *cfg, char const *testname,
+   ALLEGRO_BITMAP *target, int bmp_type, bool reliable)
+{
+   OpList ops;
+
+   if (verbose) {
+      /* So in case it segfaults, we know which test to re-run. */
+      printf("\nRunning %s [%s].\n", testname, bmp_type_to_string(bmp_type));
+      fflush(stdout);
+   }
+
+   parse_ops(cfg, testname, &ops);
+   set_target_reset(target);
+   run_ops(cfg, testname, &ops, target, bmp_type);
+   free_ops(&ops);
 
    al_set_new_bitmap_format(ALLEGRO_PIXEL_FORMAT_ANY_WITH_ALPHA);
 
@@ -1512,26 +1856,126 @@ static void do_test(ALLEGRO_CONFIG *cfg, char const *testname,
       al_rest(delay);
    }
 
-   /* Ensure we don't target a bitmap which is about to be destroyed. */
-   al_set_target_bitmap(display ? al_get_backbuffer(display) : NULL);
+   end_test(bmp_type);
+}
 
-   /* Destroy local bitmaps. */
-   for (i = num_global_bitmaps; i < MAX_BITMAPS; i++) {
-      if (bitmaps[i].name) {
-         al_ustr_free(bitmaps[i].name);
-         bitmaps[i].name = NULL;
-         al_destroy_bitmap(bitmaps[i].bitmap[bmp_type]);
-         bitmaps[i].bitmap[bmp_type] = NULL;
-      }
+/* Wait for the GPU to finish drawing to the target. */
+static void finish_drawing(ALLEGRO_BITMAP *target)
+{
+   if (al_lock_bitmap_region(target, 0, 0, 1, 1, ALLEGRO_PIXEL_FORMAT_ANY,
+         ALLEGRO_LOCK_READONLY)) {
+      al_unlock_bitmap(target);
    }
+}
 
-   /* Free transform names. */
-   for (i = 0; i < MAX_TRANS; i++) {
-      al_ustr_free(transforms[i].name);
-      transforms[i].name = NULL;
+static void set_bench_value(char const *testname, char const *bt,
+   char const *var, double value)
+{
+   char key[40];
+   char buf[40];
+
+   sprintf(key, "%s_%s", bt, var);
+   sprintf(buf, "%.3f", value);
+   al_set_config_value(bench_results, testname, key, buf);
+}
+
+static void report_bench(char const *testname, ALLEGRO_BITMAP *target,
+   BmpType bmp_type, int num_ops, double secs)
+{
+   char const *bt = bmp_type_to_string(bmp_type);
+   double pixels = al_get_bitmap_width(target) * al_get_bitmap_height(target);
+   double ns_per_op = secs * 1e9 / num_ops;
+   double mpixels = pixels / secs / 1e6;
+   char key[40];
+   char const *base;
+   double change;
+
+   set_bench_value(testname, bt, "ns_per_op", ns_per_op);
+   set_bench_value(testname, bt, "mpixels_per_s", mpixels);
+   sprintf(key, "%s_ops", bt);
+   set_config_int(bench_results, testname, key, num_ops);
+
+   total_tests++;
+
+   if (!bench_baseline) {
+      printf("TIME %s [%s] - %.0f ns/op, %.2f MPixels/s\n",
+         testname, bt, ns_per_op, mpixels);
+      passed_tests++;
+      return;
    }
 
-#undef MAXBUF
+   sprintf(key, "%s_ns_per_op", bt);
+   base = al_get_config_value(bench_baseline, testname, key);
+   if (!base || atof(base) <= 0.0) {
+      printf("NEW  %s [%s] - %.0f ns/op, %.2f MPixels/s\n",
+         testname, bt, ns_per_op, mpixels);
+      return;
+   }
+
+   change = 100.0 * (ns_per_op / atof(base) - 1.0);
+   if (change > bench_threshold) {
+      printf("SLOW %s [%s] - %.0f ns/op, %+.1f%% vs baseline\n",
+         testname, bt, ns_per_op, change);
+      failed_tests++;
+   }
+   else {
+      printf("OK   %s [%s] - %.0f ns/op, %+.1f%% vs baseline\n",
+         testname, bt, ns_per_op, change);
+      passed_tests++;
+   }
+}
+
+static void bench_test(ALLEGRO_CONFIG *cfg, char const *testname,
+   ALLEGRO_BITMAP *target, BmpType bmp_type)
+{
+   int flags = (bmp_type == SW) ? ALLEGRO_MEMORY_BITMAP : ALLEGRO_VIDEO_BITMAP;
+   OpList ops;
+   double best = 0.0;
+   double t;
+   int i;
+
+   if (verbose) {
+      printf("\nTiming %s [%s].\n", testname, bmp_type_to_string(bmp_type));
+      fflush(stdout);
+   }
+
+   /* The statements are parsed once and reused for every iteration. */
+   parse_ops(cfg, testname, &ops);
+
+   /* The first run is not timed as it warms up caches and lazily created
+    * driver state.  We keep the fastest of the remaining runs, being the
+    * least disturbed by whatever else the machine is doing.
+    */
+   for (i = -1; i < bench_iterations; i++) {
+      al_set_new_bitmap_format(ALLEGRO_PIXEL_FORMAT_ANY_WITH_ALPHA);
+      al_set_new_bitmap_flags(flags);
+      set_target_reset(target);
+      if (bmp_type == HW)
+         finish_drawing(target);
+
+      t = al_get_time();
+      run_ops(cfg, testname, &ops, target, bmp_type);
+      if (bmp_type == HW)
+         finish_drawing(target);
+      t = al_get_time() - t;
+
+      if (i == 0 || (i > 0 && t < best))
+         best = t;
+
+      end_test(bmp_type);
+   }
+
+   al_set_new_bitmap_format(ALLEGRO_PIXEL_FORMAT_ANY_WITH_ALPHA);
+   al_set_new_bitmap_flags(flags);
+
+   if (ops.num_stmts > 0) {
+      /* Don't divide by zero on a coarse timer. */
+      if (best < 1e-9)
+         best = 1e-9;
+      report_bench(testname, target, bmp_type, ops.num_stmts, best);
+   }
+
+   free_ops(&ops);
 }
 
 static void sw_hw_test(ALLEGRO_CONFIG *cfg, char const *testname)
@@ -1539,6 +1983,17 @@ static void sw_hw_test(ALLEGRO_CONFIG *cfg, char const *testname)
    int old_failed_tests = failed_tests;
    bool reliable;
 
+   if (bench) {
+      al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP);
+      bench_test(cfg, testname, membuf, SW);
+
+      if (display) {
+         al_set_new_bitmap_flags(ALLEGRO_VIDEO_BITMAP);
+         bench_test(cfg, testname, al_get_backbuffer(display), HW);
+      }
+      return;
+   }
+
    al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP);
    do_test(cfg, testname, membuf, SW, true);
 
@@ -1706,6 +2161,15 @@ const char* help_str =
 "file, but individual TEST_NAMEs can be specified after each CONFIG_FILE.\n"
 "\n"
 "Options:\n"
+" --bench            time each test instead of checking its output\n"
+" --bench-baseline FILE\n"
+"                    compare timings against FILE, failing on regressions\n"
+" --bench-iterations N\n"
+"                    number of timed runs of each test (default 20)\n"
+" --bench-output FILE\n"
+"                    save timings to FILE, which can serve as a baseline\n"
+" --bench-threshold PCT\n"
+"                    slowdown tolerated against the baseline (default 10)\n"
 " -d, --delay        duration (in sec) to wait between tests\n"
 " --force-d3d        force using D3D (Windows only)\n"
 " --force-opengl-1.2 force using OpenGL 1.2\n"
@@ -1718,9 +2182,20 @@ const char* help_str =
 " -v, --verbose      show additional information after each test\n"
 " -q, --quiet        do not draw test output to the display\n";
 
+static char const *option_value(void)
+{
+   if (argc < 2) {
+      fatal_error("missing argument for %s", argv[0]);
+   }
+   argc--;
+   argv++;
+   return argv[0];
+}
+
 int main(int _argc, char *_argv[])
 {
    int display_flags = 0;
+   char const *bench_output = NULL;
 
    argc = _argc;
    argv = _argv;
@@ -1757,6 +2232,31 @@ int main(int _argc, char *_argv[])
       else if (streq(opt, "-v") || streq(opt, "--verbose")) {
          verbose++;
       }
+      else if (streq(opt, "--bench")) {
+         bench = true;
+      }
+      else if (streq(opt, "--bench-iterations")) {
+         bench = true;
+         bench_iterations = atoi(option_value());
+         if (bench_iterations < 1)
+            fatal_error("invalid number of iterations");
+      }
+      else if (streq(opt, "--bench-output")) {
+         bench = true;
+         bench_output = option_value();
+      }
+      else if (streq(opt, "--bench-baseline")) {
+         char const *filename = option_value();
+         bench = true;
+         al_destroy_config(bench_baseline);
+         bench_baseline = al_load_config_file(filename);
+         if (!bench_baseline)
+            fatal_error("failed to load baseline %s", filename);
+      }
+      else if (streq(opt, "--bench-threshold")) {
+         bench = true;
+         bench_threshold = atof(option_value());
+      }
       else if (streq(opt, "--force-opengl-1.2")) {
          ALLEGRO_CONFIG *cfg = al_get_system_config();
          al_set_config_value(cfg, "opengl", "force_opengl_version", "1.2");
@@ -1805,8 +2305,19 @@ int main(int _argc, char *_argv[])
       membuf = al_create_bitmap(640, 480);
    }
 
+   if (bench) {
+      bench_results = al_create_config();
+      set_config_int(bench_results, "", "iterations", bench_iterations);
+   }
+
    process_ini_files();
 
+   if (bench_output && !al_save_config_file(bench_output, bench_results)) {
+      fatal_error("failed to save %s", bench_output);
+   }
+   al_destroy_config(bench_results);
+   al_destroy_config(bench_baseline);
+
    printf("\n");
    printf("total tests:  %d\n", total_tests);
    printf("passed tests: %d\n", passed_tests);